@@ -0,0 +1,415 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ 在同一个进程中启动两个 gnb core(1001 和 1002), 通过 127.0.0.1 上的 udp 互联, tun 使用 gnb_drv_bench
+ 1001 的 tun 以最快的速度产生发往 1002 的 ip 分组, 统计 1002 写入 tun 的分组数量, 得到整条转发路径的吞吐
+
+ 每种配置(crypto, zip, pf_worker, 分组长度)在单独 fork 的子进程中执行, 互不影响, 每种配置输出一行 key=value 格式的结果
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "gnb.h"
+#include "gnb_core.h"
+#include "gnb_time.h"
+#include "gnb_version.h"
+#include "gnb_drv_bench.h"
+
+#define BENCH_TX_UUID           1001
+#define BENCH_RX_UUID           1002
+
+#define BENCH_MTU               1500
+#define BENCH_CONNECT_TIMEOUT_SEC 20
+#define BENCH_SETTLE_MSEC       1000
+#define BENCH_WARMUP_MSEC       500
+#define BENCH_MAX_LIST_ITEM     16
+
+gnb_conf_t* gnb_argv(int argc,char *argv[]);
+
+typedef struct _bench_conf_t {
+    unsigned int duration_sec;
+    uint32_t flow_num;
+    int payload_type;
+    const char *pcap_file;
+    uint16_t port;
+} bench_conf_t;
+
+typedef struct _bench_case_t {
+    const char *crypto;
+    const char *zip;
+    const char *pf_worker;
+    size_t packet_size;
+} bench_case_t;
+
+void log_out_description(gnb_log_ctx_t *log) {
+    GNB_LOG1(log, GNB_LOG_ID_CORE, "%s\n", GNB_VERSION_STRING);
+}
+
+void show_description() {
+    printf("%s\n", GNB_VERSION_STRING);
+}
+
+static void signal_alrm_handler(int signum) {
+    return;
+}
+
+static void update_core_time(gnb_core_t *gnb_core) {
+    gettimeofday(&gnb_core->now_timeval, NULL);
+    gnb_core->now_time_sec  = gnb_core->now_timeval.tv_sec;
+    gnb_core->now_time_usec = gnb_core->now_timeval.tv_sec * 1000000 + gnb_core->now_timeval.tv_usec;
+    gnb_core->ctl_block->status_zone->keep_alive_ts_sec = (uint64_t)gnb_core->now_timeval.tv_sec;
+    gnb_ctl_block_latency_calibrate(gnb_core->ctl_block);
+}
+
+static void sleep_msec(gnb_core_t *core_a, gnb_core_t *core_b, unsigned int msec) {
+    //worker 之间的 notify 会用信号打断 usleep, 所以按时间戳判断是否到期
+    uint64_t end_usec = gnb_timestamp_usec() + (uint64_t)msec * 1000;
+    //gnb_core 中的时间原本由 primary_process_loop 每秒更新一次
+    do {
+        update_core_time(core_a);
+        update_core_time(core_b);
+        GNB_SLEEP_MILLISECOND(10);
+    } while ( gnb_timestamp_usec() < end_usec );
+}
+
+static int node_connected(gnb_core_t *gnb_core, gnb_uuid_t uuid64) {
+    gnb_node_t *node = GNB_HASH32_UINT64_GET_PTR(gnb_core->uuid_node_map, uuid64);
+    if ( NULL == node ) {
+        return 0;
+    }
+    return 0 != (node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG);
+}
+
+static uint64_t sum_drop_num(gnb_core_t *gnb_core) {
+    uint64_t num = 0;
+    int i;
+    for ( i=0; i<GNB_CTL_DROP_NUM; i++ ) {
+        num += gnb_core->ctl_block->status_zone->drop_num[i];
+    }
+    return num;
+}
+
+static gnb_core_t* create_core(bench_conf_t *bench_conf, bench_case_t *bench_case, gnb_uuid_t uuid64, gnb_uuid_t peer_uuid64, uint16_t port, uint16_t peer_port, char *map_file) {
+    char nodeid_string[32];
+    char listen_string[64];
+    char address_string[128];
+    char mtu_string[16];
+    char *argv[32];
+    int argc = 0;
+    gnb_conf_t *conf;
+    gnb_core_t *gnb_core;
+    snprintf(nodeid_string,  sizeof(nodeid_string),  "%llu", (unsigned long long)uuid64);
+    snprintf(listen_string,  sizeof(listen_string),  "127.0.0.1:%u", port);
+    snprintf(address_string, sizeof(address_string), "n|%llu|127.0.0.1|%u", (unsigned long long)peer_uuid64, peer_port);
+    snprintf(mtu_string,     sizeof(mtu_string),     "%u", BENCH_MTU);
+    snprintf(map_file, PATH_MAX, "/tmp/gnb_bench.%d.%llu.map", (int)getpid(), (unsigned long long)uuid64);
+    argv[argc++] = "gnb_bench";
+    argv[argc++] = "-n";
+    argv[argc++] = nodeid_string;
+    argv[argc++] = "-4";
+    argv[argc++] = "-q";
+    argv[argc++] = "-l";
+    argv[argc++] = listen_string;
+    argv[argc++] = "-a";
+    argv[argc++] = address_string;
+    argv[argc++] = "-b";
+    argv[argc++] = map_file;
+    argv[argc++] = "--mtu";
+    argv[argc++] = mtu_string;
+    argv[argc++] = "--index-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--node-detect-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--crypto";
+    argv[argc++] = (char *)bench_case->crypto;
+    argv[argc++] = "--pf-worker";
+    argv[argc++] = (char *)bench_case->pf_worker;
+    if ( !strcmp(bench_case->zip, "zlib") || !strcmp(bench_case->zip, "lz4") ) {
+        argv[argc++] = "--zip-type";
+        argv[argc++] = (char *)bench_case->zip;
+        argv[argc++] = "--zip-level";
+        argv[argc++] = "1";
+    }
+    argv[argc] = NULL;
+    //gnb_argv 使用 getopt_long, 每次解析前都要重置
+    optind = 0;
+    conf = gnb_argv(argc, argv);
+    gnb_core = gnb_core_create(conf);
+    free(conf);
+    return gnb_core;
+}
+
+static int run_case(bench_conf_t *bench_conf, bench_case_t *bench_case) {
+    char tx_map_file[PATH_MAX];
+    char rx_map_file[PATH_MAX];
+    gnb_core_t *tx_core;
+    gnb_core_t *rx_core;
+    gnb_bench_tun_conf_t tx_tun_conf;
+    gnb_bench_tun_conf_t rx_tun_conf;
+    gnb_bench_tun_stats_t tx_stats0, tx_stats1;
+    gnb_bench_tun_stats_t rx_stats0, rx_stats1;
+    uint64_t drop_num0, drop_num1;
+    uint64_t start_usec, end_usec;
+    double sec;
+    double tx_pps, rx_pps, rx_gbps, loss;
+    size_t packet_size;
+    int ret = 1;
+
+    tx_core = create_core(bench_conf, bench_case, BENCH_TX_UUID, BENCH_RX_UUID, bench_conf->port,   bench_conf->port+1, tx_map_file);
+    rx_core = create_core(bench_conf, bench_case, BENCH_RX_UUID, BENCH_TX_UUID, bench_conf->port+1, bench_conf->port,   rx_map_file);
+    if ( NULL == tx_core || NULL == rx_core ) {
+        printf("gnb core create error!\n");
+        goto finish;
+    }
+
+    memset(&tx_tun_conf, 0, sizeof(gnb_bench_tun_conf_t));
+    tx_tun_conf.packet_size  = bench_case->packet_size;
+    tx_tun_conf.flow_num     = bench_conf->flow_num;
+    tx_tun_conf.payload_type = bench_conf->payload_type;
+    tx_tun_conf.dst_addr4    = rx_core->local_node->tun_addr4.s_addr;
+    tx_tun_conf.pcap_file    = bench_conf->pcap_file;
+    memset(&rx_tun_conf, 0, sizeof(gnb_bench_tun_conf_t));
+    if ( gnb_bench_tun_setup(tx_core, &tx_tun_conf) <= 0 ) {
+        goto finish;
+    }
+    gnb_bench_tun_setup(rx_core, &rx_tun_conf);
+
+    update_core_time(tx_core);
+    update_core_time(rx_core);
+    gnb_core_start(tx_core);
+    gnb_core_start(rx_core);
+
+    start_usec = gnb_timestamp_usec();
+    while ( !node_connected(tx_core, BENCH_RX_UUID) || !node_connected(rx_core, BENCH_TX_UUID) ) {
+        if ( gnb_timestamp_usec() - start_usec > BENCH_CONNECT_TIMEOUT_SEC * 1000000ull ) {
+            break;
+        }
+        sleep_msec(tx_core, rx_core, 100);
+    }
+    if ( !node_connected(tx_core, BENCH_RX_UUID) || !node_connected(rx_core, BENCH_TX_UUID) ) {
+        printf("node %d and %d are not connected in %d sec\n", BENCH_TX_UUID, BENCH_RX_UUID, BENCH_CONNECT_TIMEOUT_SEC);
+        goto finish;
+    }
+
+    //刚收到 pong 时 node 的状态还可能被 node worker 的检查重置一次, 等状态稳定之后再开始
+    sleep_msec(tx_core, rx_core, BENCH_SETTLE_MSEC);
+    gnb_bench_tun_start(tx_core);
+    sleep_msec(tx_core, rx_core, BENCH_WARMUP_MSEC);
+
+    gnb_bench_tun_stats(tx_core, &tx_stats0);
+    gnb_bench_tun_stats(rx_core, &rx_stats0);
+    drop_num0 = sum_drop_num(tx_core) + sum_drop_num(rx_core);
+    start_usec = gnb_timestamp_usec();
+    sleep_msec(tx_core, rx_core, bench_conf->duration_sec * 1000);
+    gnb_bench_tun_stats(tx_core, &tx_stats1);
+    gnb_bench_tun_stats(rx_core, &rx_stats1);
+    drop_num1 = sum_drop_num(tx_core) + sum_drop_num(rx_core);
+    end_usec = gnb_timestamp_usec();
+    gnb_bench_tun_stop(tx_core);
+
+    sec     = (double)(end_usec - start_usec) / 1000000;
+    tx_pps  = (double)(tx_stats1.read_num  - tx_stats0.read_num)  / sec;
+    rx_pps  = (double)(rx_stats1.write_num - rx_stats0.write_num) / sec;
+    rx_gbps = (double)(rx_stats1.write_bytes - rx_stats0.write_bytes) * 8 / sec / 1000000000;
+    loss    = tx_pps > 0 ? (1 - rx_pps / tx_pps) * 100 : 0;
+    if ( loss < 0 ) {
+        //warmup 期间发出的分组在统计期间才被收到
+        loss = 0;
+    }
+    packet_size = tx_tun_conf.packet_size;
+    if ( NULL != bench_conf->pcap_file && tx_stats1.read_num > tx_stats0.read_num ) {
+        packet_size = (tx_stats1.read_bytes - tx_stats0.read_bytes) / (tx_stats1.read_num - tx_stats0.read_num);
+    }
+
+    printf("crypto=%s zip=%s pf_worker=%s size=%zu flows=%u tx_mpps=%.3f rx_mpps=%.3f rx_gbps=%.3f loss=%.2f%% drops=%"PRIu64"\n",
+           bench_case->crypto, bench_case->zip, bench_case->pf_worker, packet_size, NULL != bench_conf->pcap_file ? 0 : bench_conf->flow_num,
+           tx_pps / 1000000, rx_pps / 1000000, rx_gbps, loss, drop_num1 - drop_num0);
+    ret = 0;
+
+finish:
+    unlink(tx_map_file);
+    unlink(rx_map_file);
+    fflush(stdout);
+    return ret;
+}
+
+static int split_list(char *string, char *items[]) {
+    int num = 0;
+    char *p;
+    for ( p=strtok(string, ","); NULL!=p && num<BENCH_MAX_LIST_ITEM; p=strtok(NULL, ",") ) {
+        items[num++] = p;
+    }
+    return num;
+}
+
+static void show_useage(int argc,char *argv[]) {
+    printf("usage: %s [options]\n", argv[0]);
+    printf("  -d, --duration      seconds of each case, default 3\n");
+    printf("  -c, --crypto        crypto list, default 'xor,arc4'\n");
+    printf("  -z, --zip           zip list 'off' 'zlib' 'lz4', default 'off,lz4'\n");
+    printf("  -w, --pf-worker     pf worker num list, default '0,2'\n");
+    printf("  -s, --size          ip packet size list, default '1400'\n");
+    printf("  -f, --flows         flow num, odd flows are tcp and even flows are udp, default 16\n");
+    printf("  -m, --payload       'random' 'text' 'mix', default 'mix'\n");
+    printf("  -r, --replay        replay ipv4 packets in pcap file instead of synthetic packets\n");
+    printf("  -l, --listen        udp port of node %d, node %d use port+1, default 19001\n", BENCH_TX_UUID, BENCH_RX_UUID);
+    printf("  -h, --help\n");
+}
+
+int main (int argc,char *argv[]) {
+
+    static struct option long_options[] = {
+      { "duration",  required_argument, 0, 'd' },
+      { "crypto",    required_argument, 0, 'c' },
+      { "zip",       required_argument, 0, 'z' },
+      { "pf-worker", required_argument, 0, 'w' },
+      { "size",      required_argument, 0, 's' },
+      { "flows",     required_argument, 0, 'f' },
+      { "payload",   required_argument, 0, 'm' },
+      { "replay",    required_argument, 0, 'r' },
+      { "listen",    required_argument, 0, 'l' },
+      { "help",      no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+    };
+
+    bench_conf_t bench_conf;
+    bench_case_t bench_case;
+    char crypto_string[256]    = "xor,arc4";
+    char zip_string[256]       = "off,lz4";
+    char pf_worker_string[256] = "0,2";
+    char size_string[256]      = "1400";
+    char *crypto_items[BENCH_MAX_LIST_ITEM];
+    char *zip_items[BENCH_MAX_LIST_ITEM];
+    char *pf_worker_items[BENCH_MAX_LIST_ITEM];
+    char *size_items[BENCH_MAX_LIST_ITEM];
+    int crypto_num, zip_num, pf_worker_num, size_num;
+    int i, j, k, l;
+    int opt;
+    int status;
+    int failed = 0;
+    pid_t pid;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    memset(&bench_conf, 0, sizeof(bench_conf_t));
+    bench_conf.duration_sec = 3;
+    bench_conf.flow_num     = 16;
+    bench_conf.payload_type = GNB_BENCH_PAYLOAD_MIX;
+    bench_conf.port         = 19001;
+
+    while (1) {
+        int option_index = 0;
+        opt = getopt_long (argc, argv, "d:c:z:w:s:f:m:r:l:h",long_options, &option_index);
+        if ( -1 == opt ) {
+            break;
+        }
+        switch (opt) {
+        case 'd':
+            bench_conf.duration_sec = (unsigned int)strtoul(optarg, NULL, 10);
+            break;
+        case 'c':
+            snprintf(crypto_string, sizeof(crypto_string), "%s", optarg);
+            break;
+        case 'z':
+            snprintf(zip_string, sizeof(zip_string), "%s", optarg);
+            break;
+        case 'w':
+            snprintf(pf_worker_string, sizeof(pf_worker_string), "%s", optarg);
+            break;
+        case 's':
+            snprintf(size_string, sizeof(size_string), "%s", optarg);
+            break;
+        case 'f':
+            bench_conf.flow_num = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'm':
+            if ( !strcmp(optarg, "random") ) {
+                bench_conf.payload_type = GNB_BENCH_PAYLOAD_RANDOM;
+            } else if ( !strcmp(optarg, "text") ) {
+                bench_conf.payload_type = GNB_BENCH_PAYLOAD_TEXT;
+            } else {
+                bench_conf.payload_type = GNB_BENCH_PAYLOAD_MIX;
+            }
+            break;
+        case 'r':
+            bench_conf.pcap_file = optarg;
+            break;
+        case 'l':
+            bench_conf.port = (uint16_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            show_useage(argc, argv);
+            exit(0);
+        }
+    }
+
+    if ( 0 == bench_conf.duration_sec ) {
+        bench_conf.duration_sec = 1;
+    }
+
+    crypto_num    = split_list(crypto_string, crypto_items);
+    zip_num       = split_list(zip_string, zip_items);
+    pf_worker_num = split_list(pf_worker_string, pf_worker_items);
+    size_num      = split_list(size_string, size_items);
+    if ( NULL != bench_conf.pcap_file ) {
+        size_num = 1;
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    //primary worker 用 SIGALRM 打断 select
+    signal(SIGALRM, signal_alrm_handler);
+
+    for ( i=0; i<crypto_num; i++ ) {
+        for ( j=0; j<zip_num; j++ ) {
+            for ( k=0; k<pf_worker_num; k++ ) {
+                for ( l=0; l<size_num; l++ ) {
+                    bench_case.crypto      = crypto_items[i];
+                    bench_case.zip         = zip_items[j];
+                    bench_case.pf_worker   = pf_worker_items[k];
+                    bench_case.packet_size = NULL != bench_conf.pcap_file ? 0 : (size_t)strtoul(size_items[l], NULL, 10);
+                    fflush(stdout);
+                    pid = fork();
+                    if ( -1 == pid ) {
+                        perror("fork");
+                        exit(1);
+                    }
+                    if ( 0 == pid ) {
+                        _exit(run_case(&bench_conf, &bench_case));
+                    }
+                    if ( -1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status) ) {
+                        printf("crypto=%s zip=%s pf_worker=%s size=%zu failed\n", bench_case.crypto, bench_case.zip, bench_case.pf_worker, bench_case.packet_size);
+                        failed++;
+                    }
+                }
+            }
+        }
+    }
+
+    return 0 == failed ? 0 : 1;
+
+}
@@ -0,0 +1,968 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ 基础数据结构, 加密函数和 pf 模块的 micro benchmark
+
+ 每一项输出一行, 格式固定为
+   name=<name> size=<bytes> ops=<n> ns_per_op=<ns> mops=<Mops> mb_per_sec=<MB/s>
+ 失败的项输出 name=<name> size=<bytes> failed
+ 升级编译器或者修改代码之后可以直接 diff 两次的输出
+
+ 每一项先找到运行时间不少于 -t 指定的毫秒数的循环次数, 再用这个次数运行 BENCH_ROUND_NUM 轮, 取最快的一轮
+
+ pf 模块的测试在同一个进程中创建两个不启动 worker 的 gnb core(1001 和 1002),
+ 1001 以 route + 被测模块 处理发往 1002 的 ip 分组(pf_tun_*), 得到的 payload 再由 1002 以同样的组合处理(pf_inet_*),
+ 每个模块的耗时是 route + 被测模块 减去只有 route 时的耗时, route 的耗时是减去恢复 payload 的耗时,
+ 两者交替测量, 各取最快的一轮
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sched.h>
+#include <pthread.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "gnb.h"
+#include "gnb_core.h"
+#include "gnb_node.h"
+#include "gnb_keys.h"
+#include "gnb_time.h"
+#include "gnb_version.h"
+#include "gnb_hash32.h"
+#include "gnb_lru32.h"
+#include "gnb_payload16.h"
+#include "gnb_ring_buffer_fixed.h"
+#include "crypto/xor/xor.h"
+#include "crypto/arc4/arc4.h"
+#include "ed25519/ed25519.h"
+
+#define BENCH_ROUND_NUM          3
+
+#define BENCH_HASH_KEY_NUM       65536
+#define BENCH_LRU_SIZE           4096
+#define BENCH_LRU_BLOCK_SIZE     32
+
+#define BENCH_RING_BLOCK_SIZE    64
+#define BENCH_RING_BLOCK_MASK    0x3FF
+
+#define BENCH_STREAM_FRAME_NUM   256
+//tcp 每次读到的数据长度, 与 frame 长度不同使得 frame 会被切开
+#define BENCH_STREAM_CHUNK_SIZE  1460
+
+#define BENCH_SIGN_MESSAGE_SIZE  64
+
+#define BENCH_TX_UUID            1001
+#define BENCH_RX_UUID            1002
+#define BENCH_MTU                1500
+
+#define BENCH_STAGE_TUN_FRAME    0
+#define BENCH_STAGE_INET_FRAME   3
+
+static size_t bench_sizes[] = { 64, 512, 1400 };
+
+#define BENCH_SIZE_NUM (sizeof(bench_sizes)/sizeof(size_t))
+
+gnb_conf_t* gnb_argv(int argc,char *argv[]);
+
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name);
+
+typedef void (*micro_bench_cb_t)(void *ctx, uint64_t ops);
+
+static uint64_t bench_min_usec = 100000;
+
+static const char *bench_filter = NULL;
+
+//防止编译器把没有被使用的结果优化掉
+static volatile uint64_t bench_sink;
+
+void log_out_description(gnb_log_ctx_t *log) {
+    GNB_LOG1(log, GNB_LOG_ID_CORE, "%s\n", GNB_VERSION_STRING);
+}
+
+void show_description() {
+    printf("%s\n", GNB_VERSION_STRING);
+}
+
+static int bench_enable(const char *name) {
+    if ( NULL == bench_filter ) {
+        return 1;
+    }
+    return NULL != strstr(name, bench_filter);
+}
+
+static double bench_measure(micro_bench_cb_t cb, void *ctx, uint64_t *ops_ptr) {
+    uint64_t ops = 1;
+    uint64_t start_usec;
+    uint64_t usec;
+    double ns_per_op;
+    double best_ns_per_op;
+    int i;
+    while (1) {
+        start_usec = gnb_timestamp_usec();
+        cb(ctx, ops);
+        usec = gnb_timestamp_usec() - start_usec;
+        if ( usec >= bench_min_usec ) {
+            break;
+        }
+        if ( usec < bench_min_usec/100 ) {
+            ops *= 10;
+        } else {
+            ops = ops * bench_min_usec / usec * 11 / 10 + 1;
+        }
+    }
+    best_ns_per_op = (double)usec * 1000 / ops;
+    for ( i=1; i<BENCH_ROUND_NUM; i++ ) {
+        start_usec = gnb_timestamp_usec();
+        cb(ctx, ops);
+        usec = gnb_timestamp_usec() - start_usec;
+        ns_per_op = (double)usec * 1000 / ops;
+        if ( ns_per_op < best_ns_per_op ) {
+            best_ns_per_op = ns_per_op;
+        }
+    }
+    *ops_ptr = ops;
+    return best_ns_per_op;
+}
+
+static void bench_print(const char *name, size_t size, uint64_t ops, double ns_per_op) {
+    double mops = ns_per_op > 0 ? 1000 / ns_per_op : 0;
+    printf("name=%s size=%zu ops=%"PRIu64" ns_per_op=%.1f mops=%.3f mb_per_sec=%.1f\n", name, size, ops, ns_per_op, mops, mops * size);
+}
+
+static void bench_print_failed(const char *name, size_t size) {
+    printf("name=%s size=%zu failed\n", name, size);
+}
+
+static void bench_run(const char *name, size_t size, micro_bench_cb_t cb, void *ctx) {
+    uint64_t ops;
+    double ns_per_op;
+    if ( !bench_enable(name) ) {
+        return;
+    }
+    ns_per_op = bench_measure(cb, ctx, &ops);
+    bench_print(name, size, ops, ns_per_op);
+}
+
+static uint32_t bench_xorshift32(uint32_t *seed) {
+    uint32_t x = *seed;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+
+/* gnb_hash32 */
+
+typedef struct _hash32_bench_ctx_t {
+    gnb_hash32_map_t *map;
+} hash32_bench_ctx_t;
+
+//key 都已经存在, set 测的是更新 value 的路径, 与 node 表的使用方式相同
+static void bench_hash32_set_cb(void *p, uint64_t ops) {
+    hash32_bench_ctx_t *ctx = (hash32_bench_ctx_t *)p;
+    uint64_t key;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        key = i & (BENCH_HASH_KEY_NUM-1);
+        GNB_HASH32_UINT64_SET(ctx->map, key, (void *)(uintptr_t)i);
+    }
+}
+
+static void bench_hash32_get_cb(void *p, uint64_t ops) {
+    hash32_bench_ctx_t *ctx = (hash32_bench_ctx_t *)p;
+    uint64_t sum = 0;
+    uint64_t key;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        key = i & (BENCH_HASH_KEY_NUM-1);
+        sum += (uintptr_t)GNB_HASH32_UINT64_GET(ctx->map, key);
+    }
+    bench_sink = sum;
+}
+
+static void bench_hash32(gnb_heap_t *heap) {
+    hash32_bench_ctx_t ctx;
+    uint64_t key;
+    ctx.map = gnb_hash32_create(heap, BENCH_HASH_KEY_NUM, BENCH_HASH_KEY_NUM);
+    for ( key=0; key<BENCH_HASH_KEY_NUM; key++ ) {
+        GNB_HASH32_UINT64_SET(ctx.map, key, (void *)(uintptr_t)key);
+    }
+    bench_run("hash32_set", 0, bench_hash32_set_cb, &ctx);
+    bench_run("hash32_get", 0, bench_hash32_get_cb, &ctx);
+}
+
+
+/* gnb_lru32 */
+
+typedef struct _lru32_bench_ctx_t {
+    gnb_lru32_t *lru;
+    uint32_t seed;
+} lru32_bench_ctx_t;
+
+//key 的范围是 lru 容量的两倍, 大约一半的 store 需要淘汰最旧的 node
+static void bench_lru32_store_cb(void *p, uint64_t ops) {
+    lru32_bench_ctx_t *ctx = (lru32_bench_ctx_t *)p;
+    unsigned char block[BENCH_LRU_BLOCK_SIZE];
+    uint64_t key;
+    uint64_t i;
+    memset(block, 0x5a, BENCH_LRU_BLOCK_SIZE);
+    for ( i=0; i<ops; i++ ) {
+        key = bench_xorshift32(&ctx->seed) % (BENCH_LRU_SIZE*2);
+        gnb_lru32_fixed_store(ctx->lru, (unsigned char *)&key, sizeof(uint64_t), block);
+    }
+}
+
+static void bench_lru32_get_cb(void *p, uint64_t ops) {
+    lru32_bench_ctx_t *ctx = (lru32_bench_ctx_t *)p;
+    uint64_t sum = 0;
+    uint64_t key;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        key = bench_xorshift32(&ctx->seed) % (BENCH_LRU_SIZE*2);
+        sum += (uintptr_t)gnb_lru32_get(ctx->lru, (unsigned char *)&key, sizeof(uint64_t));
+    }
+    bench_sink = sum;
+}
+
+static void bench_lru32(gnb_heap_t *heap) {
+    lru32_bench_ctx_t ctx;
+    unsigned char block[BENCH_LRU_BLOCK_SIZE];
+    uint64_t key;
+    ctx.lru  = gnb_lru32_create(heap, BENCH_LRU_SIZE, BENCH_LRU_BLOCK_SIZE);
+    ctx.seed = 2463534242u;
+    memset(block, 0x5a, BENCH_LRU_BLOCK_SIZE);
+    for ( key=0; key<BENCH_LRU_SIZE; key++ ) {
+        gnb_lru32_fixed_store(ctx.lru, (unsigned char *)&key, sizeof(uint64_t), block);
+    }
+    bench_run("lru32_store", BENCH_LRU_BLOCK_SIZE, bench_lru32_store_cb, &ctx);
+    bench_run("lru32_get", BENCH_LRU_BLOCK_SIZE, bench_lru32_get_cb, &ctx);
+}
+
+
+/* gnb_ring_buffer_fixed, 一个生产者线程, 一个消费者线程 */
+
+typedef struct _ring_bench_ctx_t {
+    gnb_ring_buffer_fixed_t *ring;
+    uint64_t ops;
+    uint64_t error_num;
+} ring_bench_ctx_t;
+
+static void* ring_consumer_thread(void *p) {
+    ring_bench_ctx_t *ctx = (ring_bench_ctx_t *)p;
+    void *block;
+    uint64_t i;
+    for ( i=0; i<ctx->ops; i++ ) {
+        //只有一个 cpu 时自旋等待会用完整个时间片, 所以 ring 为空时让出 cpu
+        while ( NULL == (block = gnb_ring_buffer_fixed_pop(ctx->ring)) ) {
+            sched_yield();
+        }
+        if ( *(uint64_t *)block != i ) {
+            ctx->error_num++;
+        }
+        gnb_ring_buffer_fixed_pop_submit(ctx->ring);
+    }
+    return NULL;
+}
+
+static void bench_ring_cb(void *p, uint64_t ops) {
+    ring_bench_ctx_t *ctx = (ring_bench_ctx_t *)p;
+    pthread_t consumer;
+    void *block;
+    uint64_t i;
+    ctx->ops = ops;
+    pthread_create(&consumer, NULL, ring_consumer_thread, ctx);
+    for ( i=0; i<ops; i++ ) {
+        while ( NULL == (block = gnb_ring_buffer_fixed_push(ctx->ring)) ) {
+            sched_yield();
+        }
+        *(uint64_t *)block = i;
+        gnb_ring_buffer_fixed_push_submit(ctx->ring);
+    }
+    pthread_join(consumer, NULL);
+}
+
+static void bench_ring_buffer_fixed() {
+    ring_bench_ctx_t ctx;
+    uint64_t ops;
+    double ns_per_op;
+    void *memory;
+    if ( !bench_enable("ring_buffer_fixed") ) {
+        return;
+    }
+    memory = malloc(gnb_ring_buffer_fixed_sum_size(BENCH_RING_BLOCK_SIZE, BENCH_RING_BLOCK_MASK));
+    memset(&ctx, 0, sizeof(ring_bench_ctx_t));
+    ctx.ring = gnb_ring_buffer_fixed_init(memory, BENCH_RING_BLOCK_SIZE, BENCH_RING_BLOCK_MASK);
+    ns_per_op = bench_measure(bench_ring_cb, &ctx, &ops);
+    if ( 0 != ctx.error_num ) {
+        bench_print_failed("ring_buffer_fixed", BENCH_RING_BLOCK_SIZE);
+    } else {
+        bench_print("ring_buffer_fixed", BENCH_RING_BLOCK_SIZE, ops, ns_per_op);
+    }
+    free(memory);
+}
+
+
+/* gnb_payload16_handle, 从 tcp 流中切分出 payload */
+
+typedef struct _payload16_bench_ctx_t {
+    gnb_payload16_ctx_t *payload16_ctx;
+    unsigned char *stream;
+    size_t stream_size;
+    uint64_t frame_num;
+} payload16_bench_ctx_t;
+
+static int payload16_frame_cb(gnb_payload16_t *payload, void *udata) {
+    payload16_bench_ctx_t *ctx = (payload16_bench_ctx_t *)udata;
+    ctx->frame_num++;
+    return 0;
+}
+
+//每个 op 处理 BENCH_STREAM_FRAME_NUM 个 frame
+static void bench_payload16_cb(void *p, uint64_t ops) {
+    payload16_bench_ctx_t *ctx = (payload16_bench_ctx_t *)p;
+    size_t offset;
+    size_t chunk_size;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        for ( offset=0; offset<ctx->stream_size; offset+=chunk_size ) {
+            chunk_size = ctx->stream_size - offset;
+            if ( chunk_size > BENCH_STREAM_CHUNK_SIZE ) {
+                chunk_size = BENCH_STREAM_CHUNK_SIZE;
+            }
+            gnb_payload16_handle(ctx->stream + offset, chunk_size, ctx->payload16_ctx, payload16_frame_cb);
+        }
+    }
+}
+
+static void bench_payload16(size_t frame_size) {
+    payload16_bench_ctx_t ctx;
+    gnb_payload16_t *payload;
+    uint64_t ops;
+    double ns_per_op;
+    size_t i;
+    if ( !bench_enable("payload16_handle") ) {
+        return;
+    }
+    memset(&ctx, 0, sizeof(payload16_bench_ctx_t));
+    ctx.stream_size = frame_size * BENCH_STREAM_FRAME_NUM;
+    ctx.stream = (unsigned char *)malloc(ctx.stream_size);
+    for ( i=0; i<BENCH_STREAM_FRAME_NUM; i++ ) {
+        payload = (gnb_payload16_t *)(ctx.stream + frame_size * i);
+        gnb_payload16_set_size(payload, (uint16_t)frame_size);
+        payload->type = GNB_PAYLOAD_TYPE_IPFRAME;
+        payload->sub_type = 0;
+        memset(payload->data, (int)i, frame_size - GNB_PAYLOAD16_HEAD_SIZE);
+    }
+    ctx.payload16_ctx = gnb_payload16_ctx_init(GNB_MAX_PAYLOAD_SIZE);
+    ctx.payload16_ctx->udata = &ctx;
+    ns_per_op = bench_measure(bench_payload16_cb, &ctx, &ops);
+    if ( ctx.frame_num % BENCH_STREAM_FRAME_NUM != 0 || 0 != ctx.payload16_ctx->r_len ) {
+        bench_print_failed("payload16_handle", frame_size);
+    } else {
+        bench_print("payload16_handle", frame_size, ops * BENCH_STREAM_FRAME_NUM, ns_per_op / BENCH_STREAM_FRAME_NUM);
+    }
+    gnb_payload16_ctx_free(ctx.payload16_ctx);
+    free(ctx.stream);
+}
+
+
+/* 加密 */
+
+typedef struct _crypto_bench_ctx_t {
+    unsigned char key[64];
+    struct arc4_sbox sbox;
+    unsigned char data[BENCH_MTU];
+    size_t size;
+} crypto_bench_ctx_t;
+
+static void bench_xor_crypto_cb(void *p, uint64_t ops) {
+    crypto_bench_ctx_t *ctx = (crypto_bench_ctx_t *)p;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        xor_crypto(ctx->key, ctx->data, (unsigned int)ctx->size);
+    }
+    bench_sink = ctx->data[0];
+}
+
+static void bench_arc4_crypt_cb(void *p, uint64_t ops) {
+    crypto_bench_ctx_t *ctx = (crypto_bench_ctx_t *)p;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        arc4_crypt(&ctx->sbox, ctx->data, (unsigned int)ctx->size);
+    }
+    bench_sink = ctx->data[0];
+}
+
+static void bench_crypto(size_t size) {
+    crypto_bench_ctx_t ctx;
+    int i;
+    for ( i=0; i<64; i++ ) {
+        ctx.key[i] = (unsigned char)(i * 7 + 1);
+    }
+    arc4_init(&ctx.sbox, ctx.key, 64);
+    memset(ctx.data, 0x5a, sizeof(ctx.data));
+    ctx.size = size;
+    bench_run("xor_crypto", size, bench_xor_crypto_cb, &ctx);
+    bench_run("arc4_crypt", size, bench_arc4_crypt_cb, &ctx);
+}
+
+typedef struct _key_bench_ctx_t {
+    gnb_core_t *gnb_core;
+    gnb_node_t *node;
+} key_bench_ctx_t;
+
+static void bench_build_crypto_key_cb(void *p, uint64_t ops) {
+    key_bench_ctx_t *ctx = (key_bench_ctx_t *)p;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        gnb_build_crypto_key(ctx->gnb_core, ctx->node);
+    }
+    bench_sink = ctx->node->crypto_key[0];
+}
+
+static void bench_build_crypto_key() {
+    static gnb_core_t gnb_core;
+    static gnb_conf_t conf;
+    static gnb_node_t node;
+    key_bench_ctx_t ctx;
+    memset(&gnb_core, 0, sizeof(gnb_core_t));
+    memset(&conf, 0, sizeof(gnb_conf_t));
+    memset(&node, 0, sizeof(gnb_node_t));
+    conf.crypto_key_update_interval = GNB_CRYPTO_KEY_UPDATE_INTERVAL_HOUR;
+    gnb_core.conf = &conf;
+    memset(gnb_core.time_seed, 0x11, sizeof(gnb_core.time_seed));
+    memset(node.shared_secret, 0x22, sizeof(node.shared_secret));
+    ctx.gnb_core = &gnb_core;
+    ctx.node = &node;
+    bench_run("build_crypto_key", 0, bench_build_crypto_key_cb, &ctx);
+}
+
+typedef struct _ed25519_bench_ctx_t {
+    unsigned char public_key[32];
+    unsigned char private_key[64];
+    unsigned char signature[64];
+    unsigned char message[BENCH_SIGN_MESSAGE_SIZE];
+    uint64_t error_num;
+} ed25519_bench_ctx_t;
+
+static void bench_ed25519_sign_cb(void *p, uint64_t ops) {
+    ed25519_bench_ctx_t *ctx = (ed25519_bench_ctx_t *)p;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        ed25519_sign(ctx->signature, ctx->message, BENCH_SIGN_MESSAGE_SIZE, ctx->public_key, ctx->private_key);
+    }
+}
+
+static void bench_ed25519_verify_cb(void *p, uint64_t ops) {
+    ed25519_bench_ctx_t *ctx = (ed25519_bench_ctx_t *)p;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        if ( 1 != ed25519_verify(ctx->signature, ctx->message, BENCH_SIGN_MESSAGE_SIZE, ctx->public_key) ) {
+            ctx->error_num++;
+        }
+    }
+}
+
+static void bench_ed25519() {
+    ed25519_bench_ctx_t ctx;
+    unsigned char seed[32];
+    uint64_t ops;
+    double ns_per_op;
+    memset(&ctx, 0, sizeof(ed25519_bench_ctx_t));
+    memset(seed, 0x33, sizeof(seed));
+    memset(ctx.message, 0x44, BENCH_SIGN_MESSAGE_SIZE);
+    ed25519_create_keypair(ctx.public_key, ctx.private_key, seed);
+    bench_run("ed25519_sign", BENCH_SIGN_MESSAGE_SIZE, bench_ed25519_sign_cb, &ctx);
+    if ( !bench_enable("ed25519_verify") ) {
+        return;
+    }
+    ed25519_sign(ctx.signature, ctx.message, BENCH_SIGN_MESSAGE_SIZE, ctx.public_key, ctx.private_key);
+    ns_per_op = bench_measure(bench_ed25519_verify_cb, &ctx, &ops);
+    if ( 0 != ctx.error_num ) {
+        bench_print_failed("ed25519_verify", BENCH_SIGN_MESSAGE_SIZE);
+    } else {
+        bench_print("ed25519_verify", BENCH_SIGN_MESSAGE_SIZE, ops, ns_per_op);
+    }
+}
+
+
+/* pf 模块 */
+
+typedef struct _pf_bench_ctx_t {
+    gnb_core_t *gnb_core;
+    //为 NULL 时只恢复 payload 和 pf_ctx, 用于扣除恢复的耗时
+    gnb_pf_core_t *pf_core;
+    int first_stage;
+    gnb_payload16_t *payload_template;
+    gnb_payload16_t *payload;
+    gnb_pf_ctx_t pf_ctx;
+    gnb_sockaddress_t source_node_addr;
+    int pf_status;
+} pf_bench_ctx_t;
+
+static gnb_pf_chain_cb_t pf_stage_cb(gnb_pf_t *pf, int stage) {
+    switch (stage) {
+        case 0: return pf->pf_tun_frame;
+        case 1: return pf->pf_tun_route;
+        case 2: return pf->pf_tun_fwd;
+        case 3: return pf->pf_inet_frame;
+        case 4: return pf->pf_inet_route;
+        case 5: return pf->pf_inet_fwd;
+        default: return NULL;
+    }
+}
+
+static gnb_pf_array_t* pf_stage_array(gnb_pf_core_t *pf_core, int stage) {
+    switch (stage) {
+        case 0: return pf_core->pf_tun_frame_array;
+        case 1: return pf_core->pf_tun_route_array;
+        case 2: return pf_core->pf_tun_fwd_array;
+        case 3: return pf_core->pf_inet_frame_array;
+        case 4: return pf_core->pf_inet_route_array;
+        case 5: return pf_core->pf_inet_fwd_array;
+        default: return NULL;
+    }
+}
+
+/*
+ 按 gnb_pf_core_conf 确定的次序依次调用 frame route fwd 三个 stage 的 call back,
+ 与 gnb_pf.c 相同: GNB_PF_FINISH 跳过当前 stage 余下的模块, GNB_PF_ERROR GNB_PF_DROP GNB_PF_NOROUTE 结束处理
+*/
+static int pf_run_stages(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, int first_stage, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_array_t *pf_array;
+    gnb_pf_chain_cb_t cb;
+    int stage;
+    int i;
+    for ( stage=first_stage; stage<first_stage+3; stage++ ) {
+        pf_array = pf_stage_array(pf_core, stage);
+        for ( i=0; i<pf_array->num; i++ ) {
+            cb = pf_stage_cb(pf_array->pf[i], stage);
+            if ( NULL == cb ) {
+                continue;
+            }
+            pf_ctx->pf_status = cb(gnb_core, pf_array->pf[i], pf_ctx);
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                break;
+            }
+            if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status || GNB_PF_NOROUTE == pf_ctx->pf_status ) {
+                return pf_ctx->pf_status;
+            }
+        }
+    }
+    return GNB_PF_NEXT;
+}
+
+static void pf_bench_restore(pf_bench_ctx_t *ctx) {
+    memcpy(ctx->payload, ctx->payload_template, gnb_payload16_size(ctx->payload_template));
+    memset(&ctx->pf_ctx, 0, sizeof(gnb_pf_ctx_t));
+    ctx->pf_ctx.pf_fwd = GNB_PF_FWD_INIT;
+    ctx->pf_ctx.fwd_payload = ctx->payload;
+    if ( BENCH_STAGE_TUN_FRAME == ctx->first_stage ) {
+        ctx->payload->type = GNB_PAYLOAD_TYPE_IPFRAME;
+        ctx->payload->sub_type = GNB_PAYLOAD_SUB_TYPE_IPFRAME_INIT;
+        ctx->pf_ctx.pf_status = GNB_PF_TUN_FRAME_INIT;
+    } else {
+        ctx->pf_ctx.source_node_addr = &ctx->source_node_addr;
+    }
+}
+
+static void bench_pf_cb(void *p, uint64_t ops) {
+    pf_bench_ctx_t *ctx = (pf_bench_ctx_t *)p;
+    int pf_status = GNB_PF_NEXT;
+    uint64_t i;
+    for ( i=0; i<ops; i++ ) {
+        pf_bench_restore(ctx);
+        if ( NULL != ctx->pf_core ) {
+            pf_status |= pf_run_stages(ctx->gnb_core, ctx->pf_core, ctx->first_stage, &ctx->pf_ctx);
+        }
+    }
+    ctx->pf_status = pf_status;
+}
+
+static gnb_core_t* create_core(gnb_uuid_t uuid64, gnb_uuid_t peer_uuid64, uint16_t port, uint16_t peer_port, char *map_file) {
+    char nodeid_string[32];
+    char listen_string[64];
+    char address_string[128];
+    char mtu_string[16];
+    char *argv[32];
+    int argc = 0;
+    gnb_conf_t *conf;
+    gnb_core_t *gnb_core;
+    snprintf(nodeid_string,  sizeof(nodeid_string),  "%llu", (unsigned long long)uuid64);
+    snprintf(listen_string,  sizeof(listen_string),  "127.0.0.1:%u", port);
+    snprintf(address_string, sizeof(address_string), "n|%llu|127.0.0.1|%u", (unsigned long long)peer_uuid64, peer_port);
+    snprintf(mtu_string,     sizeof(mtu_string),     "%u", BENCH_MTU);
+    snprintf(map_file, PATH_MAX, "/tmp/gnb_bench_micro.%d.%llu.map", (int)getpid(), (unsigned long long)uuid64);
+    argv[argc++] = "gnb_bench_micro";
+    argv[argc++] = "-n";
+    argv[argc++] = nodeid_string;
+    argv[argc++] = "-4";
+    argv[argc++] = "-q";
+    argv[argc++] = "-l";
+    argv[argc++] = listen_string;
+    argv[argc++] = "-a";
+    argv[argc++] = address_string;
+    argv[argc++] = "-b";
+    argv[argc++] = map_file;
+    argv[argc++] = "--mtu";
+    argv[argc++] = mtu_string;
+    argv[argc++] = "--index-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--node-detect-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--pf-worker";
+    argv[argc++] = "0";
+    //zip 模块总是压缩, 使得每次测的都是同一条路径
+    argv[argc++] = "--zip";
+    argv[argc++] = "force";
+    argv[argc++] = "--zip-level";
+    argv[argc++] = "1";
+    argv[argc] = NULL;
+    //gnb_argv 使用 getopt_long, 每次解析前都要重置
+    optind = 0;
+    conf = gnb_argv(argc, argv);
+    gnb_core = gnb_core_create(conf);
+    free(conf);
+    return gnb_core;
+}
+
+static gnb_pf_core_t* create_pf_core(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+    gnb_pf_core_t *pf_core = gnb_pf_core_init(gnb_core->heap, 8);
+    //与 primary worker 一样使用 shard 0, 测得的开销包含计数和 flight record, 同一个 gnb_core 的 pf_core 都在主线程中运行
+    pf_core->node_counter_shard = gnb_ctl_block_counter_shard(gnb_core->ctl_block, 0);
+    pf_core->latency_shard      = gnb_ctl_block_latency_shard(gnb_core->ctl_block, 0);
+    pf_core->pf_status_counter  = gnb_ctl_block_pf_status_shard(gnb_core->ctl_block, 0);
+    pf_core->flight_recorder    = gnb_ctl_block_flight_shard(gnb_core->ctl_block, 0);
+    gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, gnb_core->conf->pf_route));
+    if ( NULL != pf ) {
+        gnb_pf_install(pf_core->pf_install_array, pf);
+    }
+    gnb_pf_core_conf(gnb_core, pf_core);
+    return pf_core;
+}
+
+static uint16_t ip_checksum(void *data, size_t size) {
+    uint16_t *p = (uint16_t *)data;
+    uint32_t sum = 0;
+    while ( size > 1 ) {
+        sum += *p++;
+        size -= 2;
+    }
+    while ( sum >> 16 ) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+//在 payload 中 tun_payload_offset 之后构造一个 udp 分组, 内容是可以压缩的文本
+static void build_tun_payload(gnb_core_t *gnb_core, gnb_payload16_t *payload, size_t size, uint32_t src_addr4, uint32_t dst_addr4) {
+    static const char text[] = "GET /index.html HTTP/1.1\r\nHost: www.example.com\r\nAccept: text/html\r\nConnection: keep-alive\r\n\r\n";
+    unsigned char *packet = payload->data + gnb_core->tun_payload_offset;
+    struct iphdr *iph = (struct iphdr *)packet;
+    struct udphdr *udph = (struct udphdr *)(packet + sizeof(struct iphdr));
+    size_t i;
+    memset(packet, 0, sizeof(struct iphdr) + sizeof(struct udphdr));
+    iph->version  = 4;
+    iph->ihl      = 5;
+    iph->ttl      = 64;
+    iph->protocol = IPPROTO_UDP;
+    iph->tot_len  = htons((uint16_t)size);
+    iph->id       = htons(1);
+    iph->saddr    = src_addr4;
+    iph->daddr    = dst_addr4;
+    iph->check    = ip_checksum(iph, sizeof(struct iphdr));
+    udph->source  = htons(10000);
+    udph->dest    = htons(5001);
+    udph->len     = htons((uint16_t)(size - sizeof(struct iphdr)));
+    for ( i=sizeof(struct iphdr)+sizeof(struct udphdr); i<size; i++ ) {
+        packet[i] = text[ i % (sizeof(text)-1) ];
+    }
+    gnb_payload16_set_size(payload, GNB_PAYLOAD16_HEAD_SIZE + gnb_core->tun_payload_offset + size);
+}
+
+/*
+ 交替测量 base_pf_core 和 pf_core 的耗时, 各取最快的一轮, 返回两者的差
+ base_pf_core 为 NULL 时只恢复 payload, 得到的是 pf_core 中 route 的耗时
+ 交替测量可以减小两次测量之间机器状态变化带来的误差, 差值在误差范围内为负数时输出 0
+*/
+static double bench_pf_measure(pf_bench_ctx_t *ctx, gnb_pf_core_t *base_pf_core, gnb_pf_core_t *pf_core, uint64_t *ops_ptr) {
+    uint64_t ops;
+    uint64_t start_usec;
+    double ns_per_op;
+    double base_ns_per_op;
+    double best_ns_per_op;
+    double best_base_ns_per_op = 0;
+    int i;
+    ctx->pf_core = pf_core;
+    best_ns_per_op = bench_measure(bench_pf_cb, ctx, &ops);
+    for ( i=0; i<BENCH_ROUND_NUM; i++ ) {
+        ctx->pf_core = base_pf_core;
+        start_usec = gnb_timestamp_usec();
+        bench_pf_cb(ctx, ops);
+        base_ns_per_op = (double)(gnb_timestamp_usec() - start_usec) * 1000 / ops;
+        if ( 0 == i || base_ns_per_op < best_base_ns_per_op ) {
+            best_base_ns_per_op = base_ns_per_op;
+        }
+        ctx->pf_core = pf_core;
+        start_usec = gnb_timestamp_usec();
+        bench_pf_cb(ctx, ops);
+        ns_per_op = (double)(gnb_timestamp_usec() - start_usec) * 1000 / ops;
+        if ( ns_per_op < best_ns_per_op ) {
+            best_ns_per_op = ns_per_op;
+        }
+    }
+    *ops_ptr = ops;
+    if ( best_ns_per_op < best_base_ns_per_op ) {
+        return 0;
+    }
+    return best_ns_per_op - best_base_ns_per_op;
+}
+
+//先走一遍完整的路径, 检查 1002 得到的 ip 分组与 1001 发出的相同, 同时得到 inet 方向的输入
+static int bench_pf_check(pf_bench_ctx_t *tun_ctx, gnb_pf_core_t *tx_pf_core, pf_bench_ctx_t *inet_ctx, gnb_pf_core_t *rx_pf_core, void *ip_frame, size_t size) {
+    gnb_payload16_t *fwd_payload;
+    pf_bench_restore(tun_ctx);
+    if ( GNB_PF_NEXT != pf_run_stages(tun_ctx->gnb_core, tx_pf_core, BENCH_STAGE_TUN_FRAME, &tun_ctx->pf_ctx) ) {
+        return -1;
+    }
+    fwd_payload = tun_ctx->pf_ctx.fwd_payload;
+    memcpy(inet_ctx->payload_template, fwd_payload, gnb_payload16_size(fwd_payload));
+    pf_bench_restore(inet_ctx);
+    if ( GNB_PF_NEXT != pf_run_stages(inet_ctx->gnb_core, rx_pf_core, BENCH_STAGE_INET_FRAME, &inet_ctx->pf_ctx) ) {
+        return -1;
+    }
+    if ( GNB_PF_FWD_TUN != inet_ctx->pf_ctx.pf_fwd || size != inet_ctx->pf_ctx.ip_frame_size ) {
+        return -1;
+    }
+    if ( 0 != memcmp(inet_ctx->pf_ctx.ip_frame, ip_frame, size) ) {
+        return -1;
+    }
+    return 0;
+}
+
+static void bench_pf_print(pf_bench_ctx_t *ctx, const char *name, size_t size, gnb_pf_core_t *base_pf_core, gnb_pf_core_t *pf_core) {
+    uint64_t ops;
+    double ns_per_op;
+    if ( !bench_enable(name) ) {
+        return;
+    }
+    ns_per_op = bench_pf_measure(ctx, base_pf_core, pf_core, &ops);
+    if ( GNB_PF_NEXT != ctx->pf_status ) {
+        bench_print_failed(name, size);
+        return;
+    }
+    bench_print(name, size, ops, ns_per_op);
+}
+
+static void bench_pf_size(gnb_core_t *tx_core, gnb_core_t *rx_core, size_t size) {
+    char tun_name[128];
+    char inet_name[128];
+    gnb_payload16_t *tun_payload;
+    gnb_payload16_t *inet_payload;
+    gnb_payload16_t *work_payload;
+    gnb_pf_core_t *tx_route_pf_core;
+    gnb_pf_core_t *rx_route_pf_core;
+    gnb_pf_core_t *tx_pf_core;
+    gnb_pf_core_t *rx_pf_core;
+    gnb_pf_t *pf;
+    pf_bench_ctx_t tun_ctx;
+    pf_bench_ctx_t inet_ctx;
+    unsigned char *ip_frame;
+    int i;
+    size_t block_size = sizeof(gnb_payload16_t) + tx_core->conf->payload_block_size;
+
+    tun_payload  = (gnb_payload16_t *)malloc(block_size);
+    inet_payload = (gnb_payload16_t *)malloc(block_size);
+    work_payload = (gnb_payload16_t *)malloc(block_size);
+    build_tun_payload(tx_core, tun_payload, size, tx_core->local_node->tun_addr4.s_addr, rx_core->local_node->tun_addr4.s_addr);
+    ip_frame = tun_payload->data + tx_core->tun_payload_offset;
+
+    memset(&tun_ctx, 0, sizeof(pf_bench_ctx_t));
+    tun_ctx.gnb_core = tx_core;
+    tun_ctx.first_stage = BENCH_STAGE_TUN_FRAME;
+    tun_ctx.payload_template = tun_payload;
+    tun_ctx.payload = work_payload;
+    memset(&inet_ctx, 0, sizeof(pf_bench_ctx_t));
+    inet_ctx.gnb_core = rx_core;
+    inet_ctx.first_stage = BENCH_STAGE_INET_FRAME;
+    inet_ctx.payload_template = inet_payload;
+    inet_ctx.payload = work_payload;
+
+    tx_route_pf_core = create_pf_core(tx_core, NULL);
+    rx_route_pf_core = create_pf_core(rx_core, NULL);
+
+    if ( 0 != bench_pf_check(&tun_ctx, tx_route_pf_core, &inet_ctx, rx_route_pf_core, ip_frame, size) ) {
+        if ( bench_enable("pf_tun.gnb_pf_route") ) {
+            bench_print_failed("pf_tun.gnb_pf_route", size);
+        }
+        if ( bench_enable("pf_inet.gnb_pf_route") ) {
+            bench_print_failed("pf_inet.gnb_pf_route", size);
+        }
+    } else {
+        bench_pf_print(&tun_ctx,  "pf_tun.gnb_pf_route",  size, NULL, tx_route_pf_core);
+        bench_pf_print(&inet_ctx, "pf_inet.gnb_pf_route", size, NULL, rx_route_pf_core);
+    }
+
+    for ( i=0; i<tx_core->pf_mod_array->num; i++ ) {
+        pf = tx_core->pf_mod_array->pf[i];
+        if ( !strcmp(pf->name, tx_core->conf->pf_route) ) {
+            continue;
+        }
+        snprintf(tun_name,  sizeof(tun_name),  "pf_tun.%s",  pf->name);
+        snprintf(inet_name, sizeof(inet_name), "pf_inet.%s", pf->name);
+        if ( !bench_enable(tun_name) && !bench_enable(inet_name) ) {
+            continue;
+        }
+        tx_pf_core = create_pf_core(tx_core, pf);
+        rx_pf_core = create_pf_core(rx_core, gnb_find_pf_mod_by_name(rx_core, pf->name));
+        if ( 0 != bench_pf_check(&tun_ctx, tx_pf_core, &inet_ctx, rx_pf_core, ip_frame, size) ) {
+            if ( bench_enable(tun_name) ) {
+                bench_print_failed(tun_name, size);
+            }
+            if ( bench_enable(inet_name) ) {
+                bench_print_failed(inet_name, size);
+            }
+            continue;
+        }
+        //inet_payload 是被测模块在 tun 方向的输出, 只有 route 时也用这个输入测量
+        bench_pf_print(&tun_ctx,  tun_name,  size, tx_route_pf_core, tx_pf_core);
+        bench_pf_print(&inet_ctx, inet_name, size, rx_route_pf_core, rx_pf_core);
+    }
+
+    free(work_payload);
+    free(inet_payload);
+    free(tun_payload);
+}
+
+static void bench_pf(uint16_t port) {
+    char tx_map_file[PATH_MAX];
+    char rx_map_file[PATH_MAX];
+    gnb_core_t *tx_core;
+    gnb_core_t *rx_core;
+    gnb_node_t *node;
+    gnb_uuid_t uuid64;
+    int i;
+    if ( !bench_enable("pf_") ) {
+        return;
+    }
+    tx_core = create_core(BENCH_TX_UUID, BENCH_RX_UUID, port,   port+1, tx_map_file);
+    rx_core = create_core(BENCH_RX_UUID, BENCH_TX_UUID, port+1, port,   rx_map_file);
+    if ( NULL == tx_core || NULL == rx_core ) {
+        printf("gnb core create error!\n");
+        goto finish;
+    }
+    //pf 模块在 worker 中初始化, 这里没有启动 worker, 每个模块只初始化一次, 被所有组合共用
+    gnb_pf_init(tx_core, tx_core->pf_mod_array);
+    gnb_pf_init(rx_core, rx_core->pf_mod_array);
+    gnb_pf_conf(tx_core, tx_core->pf_mod_array);
+    gnb_pf_conf(rx_core, rx_core->pf_mod_array);
+    //没有 node worker 探测, 直接把对端标记为直连可达
+    uuid64 = BENCH_RX_UUID;
+    node = GNB_HASH32_UINT64_GET_PTR(tx_core->uuid_node_map, uuid64);
+    node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PONG;
+    uuid64 = BENCH_TX_UUID;
+    node = GNB_HASH32_UINT64_GET_PTR(rx_core->uuid_node_map, uuid64);
+    node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PONG;
+    tx_core->select_fwd_node = gnb_select_forward_node(tx_core);
+    rx_core->select_fwd_node = gnb_select_forward_node(rx_core);
+    for ( i=0; i<BENCH_SIZE_NUM; i++ ) {
+        bench_pf_size(tx_core, rx_core, bench_sizes[i]);
+    }
+finish:
+    unlink(tx_map_file);
+    unlink(rx_map_file);
+}
+
+static void show_useage(int argc,char *argv[]) {
+    printf("usage: %s [options]\n", argv[0]);
+    printf("  -t, --time          minimum milliseconds of each round, default 100\n");
+    printf("  -f, --filter        only run benchmarks whose name contains the string\n");
+    printf("  -l, --listen        udp port of node %d in pf benchmarks, node %d use port+1, default 19101\n", BENCH_TX_UUID, BENCH_RX_UUID);
+    printf("  -h, --help\n");
+}
+
+int main (int argc,char *argv[]) {
+
+    static struct option long_options[] = {
+      { "time",    required_argument, 0, 't' },
+      { "filter",  required_argument, 0, 'f' },
+      { "listen",  required_argument, 0, 'l' },
+      { "help",    no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+    };
+
+    gnb_heap_t *heap;
+    uint16_t port = 19101;
+    int opt;
+    int i;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    while (1) {
+        int option_index = 0;
+        opt = getopt_long (argc, argv, "t:f:l:h",long_options, &option_index);
+        if ( -1 == opt ) {
+            break;
+        }
+        switch (opt) {
+        case 't':
+            bench_min_usec = (uint64_t)strtoul(optarg, NULL, 10) * 1000;
+            break;
+        case 'f':
+            bench_filter = optarg;
+            break;
+        case 'l':
+            port = (uint16_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            show_useage(argc, argv);
+            exit(0);
+        }
+    }
+
+    if ( 0 == bench_min_usec ) {
+        bench_min_usec = 1000;
+    }
+
+    heap = gnb_heap_create(1024*1024*8);
+
+    bench_hash32(heap);
+    bench_lru32(heap);
+    bench_ring_buffer_fixed();
+    for ( i=0; i<BENCH_SIZE_NUM; i++ ) {
+        bench_payload16(bench_sizes[i]);
+    }
+    for ( i=0; i<BENCH_SIZE_NUM; i++ ) {
+        bench_crypto(bench_sizes[i]);
+    }
+    bench_build_crypto_key();
+    bench_ed25519();
+    bench_pf(port);
+
+    return 0;
+
+}
@@ -0,0 +1,425 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ 模拟 pf 转发路径对 gnb_node_t 的访问:
+ 每个 packet 随机选中一个 peer, 读取 uuid64/udp_addr_status/udp_sockaddr/crypto_key 等
+ 转发时用到的字段，更新 node 的流量计数, 统计每个 packet 的平均耗时以及每个 node 转发时需要访问的 cache line 数量
+ 分别对拆分 hot/cold 之前的 gnb_node_t 布局(bench_legacy_node_t)和当前布局运行一次, linux 下用 perf_event 统计 cache miss
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stddef.h>
+#include <string.h>
+#include <getopt.h>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "gnb_node_type.h"
+#include "gnb_ctl_block.h"
+#include "gnb_time.h"
+
+#define BENCH_PAYLOAD_SIZE 1400
+
+/*
+ 拆分 hot/cold 之前的 gnb_node_t 布局, 只用于对比, 字段顺序与当时的 gnb_node_type.h 一致,
+ 流量计数 in_bytes/out_bytes 在 node 内, 转发时与其他 worker 共享同一个 cache line
+*/
+typedef struct _bench_legacy_node_t {
+	gnb_uuid_t uuid64;
+	uint64_t in_bytes;
+	uint64_t out_bytes;
+	unsigned char type;
+	struct in_addr  tun_addr4;
+	struct in_addr  tun_netmask_addr4;
+	struct in_addr  tun_subnet_addr4;
+	uint16_t tun_sin_port4;
+	struct in6_addr tun_ipv6_addr;
+	struct sockaddr_in  udp_sockaddr4;
+	struct sockaddr_in6 udp_sockaddr6;
+	uint8_t            socket6_idx;
+	uint8_t            socket4_idx;
+	gnb_uuid_t route_node[GNB_MAX_NODE_ROUTE][GNB_MAX_NODE_RELAY];
+	uint8_t  route_node_ttls[GNB_MAX_NODE_ROUTE];
+	uint8_t  selected_route_node;
+	uint8_t  node_relay_mode;
+	unsigned char static_address_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*GNB_NODE_STATIC_ADDRESS_NUM];
+	unsigned char dynamic_address_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*GNB_NODE_DYNAMIC_ADDRESS_NUM];
+	unsigned char resolv_address_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*GNB_NODE_RESOLV_ADDRESS_NUM];
+	unsigned char push_address_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*GNB_NODE_PUSH_ADDRESS_NUM];
+	unsigned char available_address6_list3_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
+	unsigned char available_address4_list3_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
+	unsigned char   detect_address4_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
+	uint8_t         detect_address4_idx;
+	struct in_addr  detect_addr4;
+	uint16_t        detect_port4;
+	uint32_t detect_count;
+	uint64_t ping_ts_sec;
+	uint64_t ping_ts_usec;
+	unsigned int udp_addr_status;
+	int64_t addr6_ping_latency_usec;
+	int64_t addr4_ping_latency_usec;
+	uint64_t addr4_update_ts_sec;
+	uint64_t addr6_update_ts_sec;
+	unsigned char public_key[32];
+	unsigned char shared_secret[32];
+	unsigned char crypto_key[64];
+	unsigned char pre_crypto_key[64];
+	unsigned char key512[64];
+	gnb_uuid_t last_relay_nodeid;
+	uint64_t last_relay_node_ts_sec;
+	gnb_uuid_t unified_forwarding_nodeid;
+	uint64_t  unified_forwarding_node_ts_sec;
+	gnb_unified_forwarding_node_t unified_forwarding_node_array[GNB_UNIFIED_FORWARDING_NODE_ARRAY_SIZE];
+	uint64_t unified_forwarding_send_seq;
+	uint64_t unified_forwarding_recv_seq;
+	uint64_t unified_forwarding_recv_seq_array[UNIFIED_FORWARDING_RECV_SEQ_ARRAY_SIZE];
+	uint64_t last_notify_uf_nodes_ts_sec;
+	uint64_t last_request_addr_sec;
+	uint64_t last_push_addr_sec;
+	uint64_t last_detect_sec;
+	uint64_t last_send_detect_usec;
+	uint64_t last_full_detect_sec;
+} bench_legacy_node_t;
+
+typedef struct _bench_field_t {
+    const char *name;
+    size_t offset;
+    size_t size;
+} bench_field_t;
+
+#define BENCH_FIELD(t, f) { #f, offsetof(t, f), sizeof(((t *)0)->f) }
+
+static bench_field_t bench_hot_fields[] = {
+    BENCH_FIELD(gnb_node_t, uuid64),
+    BENCH_FIELD(gnb_node_t, udp_addr_status),
+    BENCH_FIELD(gnb_node_t, node_relay_mode),
+    BENCH_FIELD(gnb_node_t, socket4_idx),
+    BENCH_FIELD(gnb_node_t, selected_route_node),
+    BENCH_FIELD(gnb_node_t, tun_addr4),
+    BENCH_FIELD(gnb_node_t, udp_sockaddr4),
+    BENCH_FIELD(gnb_node_t, udp_sockaddr6),
+    BENCH_FIELD(gnb_node_t, addr4_ping_latency_usec),
+    BENCH_FIELD(gnb_node_t, last_relay_nodeid),
+    BENCH_FIELD(gnb_node_t, crypto_key),
+};
+
+static bench_field_t bench_legacy_hot_fields[] = {
+    BENCH_FIELD(bench_legacy_node_t, uuid64),
+    BENCH_FIELD(bench_legacy_node_t, out_bytes),
+    BENCH_FIELD(bench_legacy_node_t, udp_addr_status),
+    BENCH_FIELD(bench_legacy_node_t, node_relay_mode),
+    BENCH_FIELD(bench_legacy_node_t, socket4_idx),
+    BENCH_FIELD(bench_legacy_node_t, selected_route_node),
+    BENCH_FIELD(bench_legacy_node_t, tun_addr4),
+    BENCH_FIELD(bench_legacy_node_t, udp_sockaddr4),
+    BENCH_FIELD(bench_legacy_node_t, udp_sockaddr6),
+    BENCH_FIELD(bench_legacy_node_t, addr4_ping_latency_usec),
+    BENCH_FIELD(bench_legacy_node_t, last_relay_nodeid),
+    BENCH_FIELD(bench_legacy_node_t, crypto_key),
+};
+
+#define BENCH_FIELD_NUM(fields) (sizeof(fields)/sizeof(bench_field_t))
+
+static size_t count_hot_cache_lines(bench_field_t *fields, size_t field_num) {
+    //按 node 的起始地址对齐到 cache line 计算, bench_legacy_node_t 的大小不是 cache line 的整数倍, 实际跨越的 cache line 可能更多
+    unsigned char line_map[ sizeof(bench_legacy_node_t)/GNB_CACHE_LINE_SIZE + sizeof(gnb_node_t)/GNB_CACHE_LINE_SIZE + 2 ];
+    size_t first_line;
+    size_t last_line;
+    size_t line;
+    size_t num = 0;
+    size_t i;
+    memset(line_map, 0, sizeof(line_map));
+    for ( i=0; i<field_num; i++ ) {
+        first_line = fields[i].offset / GNB_CACHE_LINE_SIZE;
+        last_line  = (fields[i].offset + fields[i].size - 1) / GNB_CACHE_LINE_SIZE;
+        for ( line=first_line; line<=last_line; line++ ) {
+            if ( 0 == line_map[line] ) {
+                line_map[line] = 1;
+                num++;
+            }
+        }
+    }
+    return num;
+}
+
+#define BENCH_NEXT_NODE(seed, node_num) ( seed ^= seed << 13, seed ^= seed >> 17, seed ^= seed << 5, seed % (node_num) )
+
+//两种布局的 node 字段名相同, 用宏展开同一段读取代码
+#define BENCH_READ_NODE(node, checksum, payload) do {                                   \
+    int _j;                                                                              \
+    if ( GNB_NODE_RELAY_DISABLE != (node)->node_relay_mode ) {                           \
+        checksum += (node)->last_relay_nodeid;                                           \
+    }                                                                                    \
+    if ( (node)->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG ) {                         \
+        checksum += (node)->udp_sockaddr6.sin6_port + (node)->addr4_ping_latency_usec;   \
+    } else {                                                                             \
+        checksum += (node)->udp_sockaddr4.sin_addr.s_addr + (node)->socket4_idx;        \
+    }                                                                                    \
+    checksum += (node)->uuid64 + (node)->tun_addr4.s_addr + (node)->selected_route_node; \
+    for ( _j=0; _j<64; _j++ ) {                                                          \
+        payload[_j] ^= (node)->crypto_key[_j];                                           \
+    }                                                                                    \
+} while(0)
+
+static uint64_t forward_packets(gnb_node_t *nodes, gnb_node_counter_t *counters, size_t node_num, size_t packet_num, unsigned char *payload) {
+    uint64_t checksum = 0;
+    uint32_t seed = 2463534242u;
+    gnb_node_t *node;
+    gnb_node_counter_t *counter;
+    size_t i;
+    for ( i=0; i<packet_num; i++ ) {
+        node = &nodes[ BENCH_NEXT_NODE(seed, node_num) ];
+        BENCH_READ_NODE(node, checksum, payload);
+        counter = &counters[ node - nodes ];
+        counter->out_bytes += BENCH_PAYLOAD_SIZE;
+        counter->out_packets++;
+    }
+    return checksum + payload[0];
+}
+
+static uint64_t forward_packets_legacy(bench_legacy_node_t *nodes, size_t node_num, size_t packet_num, unsigned char *payload) {
+    uint64_t checksum = 0;
+    uint32_t seed = 2463534242u;
+    bench_legacy_node_t *node;
+    size_t i;
+    for ( i=0; i<packet_num; i++ ) {
+        node = &nodes[ BENCH_NEXT_NODE(seed, node_num) ];
+        BENCH_READ_NODE(node, checksum, payload);
+        node->out_bytes += BENCH_PAYLOAD_SIZE;
+    }
+    return checksum + payload[0];
+}
+
+#define BENCH_PERF_L1D_MISS  0
+#define BENCH_PERF_LLC_MISS  1
+#define BENCH_PERF_NUM       2
+
+typedef struct _bench_perf_t {
+    int fd[BENCH_PERF_NUM];
+    uint64_t value[BENCH_PERF_NUM];
+} bench_perf_t;
+
+static void bench_perf_open(bench_perf_t *perf) {
+#if defined(__linux__)
+    struct perf_event_attr attr;
+    uint64_t config[BENCH_PERF_NUM];
+    uint32_t type[BENCH_PERF_NUM];
+    int i;
+    type[BENCH_PERF_L1D_MISS]   = PERF_TYPE_HW_CACHE;
+    config[BENCH_PERF_L1D_MISS] = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    type[BENCH_PERF_LLC_MISS]   = PERF_TYPE_HARDWARE;
+    config[BENCH_PERF_LLC_MISS] = PERF_COUNT_HW_CACHE_MISSES;
+    for ( i=0; i<BENCH_PERF_NUM; i++ ) {
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type[i];
+        attr.config = config[i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        perf->fd[i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        perf->value[i] = 0;
+    }
+#else
+    int i;
+    for ( i=0; i<BENCH_PERF_NUM; i++ ) {
+        perf->fd[i] = -1;
+        perf->value[i] = 0;
+    }
+#endif
+}
+
+static void bench_perf_start(bench_perf_t *perf) {
+#if defined(__linux__)
+    int i;
+    for ( i=0; i<BENCH_PERF_NUM; i++ ) {
+        if ( perf->fd[i] >= 0 ) {
+            ioctl(perf->fd[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(perf->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#endif
+}
+
+static void bench_perf_stop(bench_perf_t *perf) {
+#if defined(__linux__)
+    int i;
+    for ( i=0; i<BENCH_PERF_NUM; i++ ) {
+        if ( perf->fd[i] < 0 ) {
+            continue;
+        }
+        ioctl(perf->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+        if ( sizeof(uint64_t) != read(perf->fd[i], &perf->value[i], sizeof(uint64_t)) ) {
+            perf->value[i] = 0;
+        }
+    }
+#endif
+}
+
+static void bench_perf_close(bench_perf_t *perf) {
+#if defined(__linux__)
+    int i;
+    for ( i=0; i<BENCH_PERF_NUM; i++ ) {
+        if ( perf->fd[i] >= 0 ) {
+            close(perf->fd[i]);
+        }
+    }
+#endif
+}
+
+static void bench_perf_print(bench_perf_t *perf, const char *name, size_t packet_num) {
+    if ( perf->fd[BENCH_PERF_L1D_MISS] >= 0 ) {
+        printf(" %s_l1d_miss/packet=%.3f", name, (double)perf->value[BENCH_PERF_L1D_MISS]/(packet_num ? packet_num : 1));
+    } else {
+        printf(" %s_l1d_miss/packet=n/a", name);
+    }
+    if ( perf->fd[BENCH_PERF_LLC_MISS] >= 0 ) {
+        printf(" %s_llc_miss/packet=%.3f", name, (double)perf->value[BENCH_PERF_LLC_MISS]/(packet_num ? packet_num : 1));
+    } else {
+        printf(" %s_llc_miss/packet=n/a", name);
+    }
+}
+
+static void show_useage(int argc,char *argv[]) {
+    printf("usage: %s [-n node_num] [-p packet_num]\n",argv[0]);
+}
+
+int main (int argc,char *argv[]) {
+
+    static struct option long_options[] = {
+      { "nodes",    required_argument, 0, 'n' },
+      { "packets",  required_argument, 0, 'p' },
+      { "help",     no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+    };
+
+    int opt;
+    size_t node_num   = 65536;
+    size_t packet_num = 10000000;
+    gnb_node_t *nodes;
+    bench_legacy_node_t *legacy_nodes;
+    gnb_node_counter_t *counters;
+    unsigned char payload[BENCH_PAYLOAD_SIZE];
+    bench_perf_t perf;
+    uint64_t start_usec;
+    uint64_t end_usec;
+    uint64_t checksum;
+    size_t i;
+    int j;
+
+    while (1) {
+        int option_index = 0;
+        opt = getopt_long (argc, argv, "n:p:h",long_options, &option_index);
+        if ( -1 == opt ) {
+            break;
+        }
+        switch (opt) {
+        case 'n':
+            node_num = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'p':
+            packet_num = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            show_useage(argc, argv);
+            exit(0);
+        }
+    }
+
+    if ( 0 == node_num ) {
+        show_useage(argc, argv);
+        exit(0);
+    }
+
+    if ( 0 != posix_memalign((void **)&nodes, GNB_CACHE_LINE_SIZE, sizeof(gnb_node_t)*node_num) ) {
+        printf("alloc %zu nodes error\n", node_num);
+        exit(1);
+    }
+
+    if ( 0 != posix_memalign((void **)&legacy_nodes, GNB_CACHE_LINE_SIZE, sizeof(bench_legacy_node_t)*node_num) ) {
+        printf("alloc %zu legacy nodes error\n", node_num);
+        exit(1);
+    }
+
+    if ( 0 != posix_memalign((void **)&counters, GNB_CACHE_LINE_SIZE, sizeof(gnb_node_counter_t)*node_num) ) {
+        printf("alloc %zu node counters error\n", node_num);
+        exit(1);
+    }
+
+    memset(nodes, 0, sizeof(gnb_node_t)*node_num);
+    memset(legacy_nodes, 0, sizeof(bench_legacy_node_t)*node_num);
+    memset(counters, 0, sizeof(gnb_node_counter_t)*node_num);
+
+    for ( i=0; i<node_num; i++ ) {
+        nodes[i].uuid64 = legacy_nodes[i].uuid64 = 1000 + i;
+        nodes[i].udp_addr_status = legacy_nodes[i].udp_addr_status = (i & 1) ? GNB_NODE_STATUS_IPV4_PONG : GNB_NODE_STATUS_IPV6_PONG;
+        nodes[i].node_relay_mode = legacy_nodes[i].node_relay_mode = (i & 3) ? GNB_NODE_RELAY_DISABLE : GNB_NODE_RELAY_AUTO;
+        for ( j=0; j<64; j++ ) {
+            nodes[i].crypto_key[j] = legacy_nodes[i].crypto_key[j] = (unsigned char)(i + j);
+        }
+    }
+
+    bench_perf_open(&perf);
+
+    //预热
+    memset(payload, 0x5a, BENCH_PAYLOAD_SIZE);
+    forward_packets_legacy(legacy_nodes, node_num, node_num, payload);
+    bench_perf_start(&perf);
+    start_usec = gnb_timestamp_usec();
+    checksum = forward_packets_legacy(legacy_nodes, node_num, packet_num, payload);
+    end_usec = gnb_timestamp_usec();
+    bench_perf_stop(&perf);
+
+    printf("layout=legacy sizeof=%zu hot_cache_lines=%zu nodes=%zu packets=%zu time=%"PRIu64"usec %.2fns/packet",
+           sizeof(bench_legacy_node_t), count_hot_cache_lines(bench_legacy_hot_fields, BENCH_FIELD_NUM(bench_legacy_hot_fields)),
+           node_num, packet_num, end_usec - start_usec, (double)(end_usec - start_usec)*1000/(packet_num ? packet_num : 1));
+    bench_perf_print(&perf, "legacy", packet_num);
+    printf(" checksum=%"PRIu64"\n", checksum);
+
+    memset(payload, 0x5a, BENCH_PAYLOAD_SIZE);
+    forward_packets(nodes, counters, node_num, node_num, payload);
+    bench_perf_start(&perf);
+    start_usec = gnb_timestamp_usec();
+    checksum = forward_packets(nodes, counters, node_num, packet_num, payload);
+    end_usec = gnb_timestamp_usec();
+    bench_perf_stop(&perf);
+
+    printf("layout=current sizeof=%zu hot_cache_lines=%zu nodes=%zu packets=%zu time=%"PRIu64"usec %.2fns/packet",
+           sizeof(gnb_node_t), count_hot_cache_lines(bench_hot_fields, BENCH_FIELD_NUM(bench_hot_fields)),
+           node_num, packet_num, end_usec - start_usec, (double)(end_usec - start_usec)*1000/(packet_num ? packet_num : 1));
+    bench_perf_print(&perf, "current", packet_num);
+    printf(" checksum=%"PRIu64"\n", checksum);
+
+    bench_perf_close(&perf);
+
+    free(counters);
+    free(legacy_nodes);
+    free(nodes);
+
+    return 0;
+
+}
@@ -0,0 +1,409 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <arpa/inet.h>
+
+#include "gnb.h"
+#include "gnb_drv_bench.h"
+
+#define PCAP_MAGIC_USEC         0xa1b2c3d4
+#define PCAP_MAGIC_NSEC         0xa1b23c4d
+#define PCAP_MAGIC_USEC_SWAPPED 0xd4c3b2a1
+#define PCAP_MAGIC_NSEC_SWAPPED 0x4d3cb2a1
+
+#define PCAP_LINKTYPE_ETHERNET  1
+#define PCAP_LINKTYPE_RAW       101
+#define PCAP_LINKTYPE_LINUX_SLL 113
+#define PCAP_LINKTYPE_IPV4      228
+
+#define BENCH_MAX_PACKET_SIZE   0xFFFF
+
+typedef struct _bench_tun_ctx_t {
+
+    //所有分组的模板连续存放在 packet_buffer 中
+    unsigned char *packet_buffer;
+    size_t packet_buffer_size;
+    size_t packet_buffer_used;
+
+    uint32_t *packet_offset;
+    uint16_t *packet_size;
+    uint32_t packet_num;
+    uint32_t packet_array_size;
+
+    //只在 primary worker 的线程中读写
+    uint32_t cur_idx;
+
+    int running;
+
+    //tun_fd 为 pipe 的读端, pipe 中有数据时 primary worker 的 select 一直返回可读
+    int notify_fd;
+
+    gnb_bench_tun_stats_t stats;
+
+} bench_tun_ctx_t;
+
+static uint16_t ip_checksum(const unsigned char *data, size_t len) {
+    uint32_t sum = 0;
+    size_t i;
+    for ( i=0; i+1<len; i+=2 ) {
+        sum += (data[i] << 8) | data[i+1];
+    }
+    if ( len & 1 ) {
+        sum += data[len-1] << 8;
+    }
+    while ( sum >> 16 ) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return htons((uint16_t)~sum);
+}
+
+static unsigned char* add_packet(bench_tun_ctx_t *ctx, size_t size) {
+    unsigned char *p;
+    if ( ctx->packet_num == ctx->packet_array_size ) {
+        ctx->packet_array_size = 0 == ctx->packet_array_size ? 64 : ctx->packet_array_size * 2;
+        ctx->packet_offset = realloc(ctx->packet_offset, sizeof(uint32_t) * ctx->packet_array_size);
+        ctx->packet_size   = realloc(ctx->packet_size,   sizeof(uint16_t) * ctx->packet_array_size);
+    }
+    if ( ctx->packet_buffer_used + size > ctx->packet_buffer_size ) {
+        ctx->packet_buffer_size = (ctx->packet_buffer_used + size) * 2;
+        ctx->packet_buffer = realloc(ctx->packet_buffer, ctx->packet_buffer_size);
+    }
+    p = ctx->packet_buffer + ctx->packet_buffer_used;
+    ctx->packet_offset[ctx->packet_num] = (uint32_t)ctx->packet_buffer_used;
+    ctx->packet_size[ctx->packet_num]   = (uint16_t)size;
+    ctx->packet_buffer_used += size;
+    ctx->packet_num++;
+    return p;
+}
+
+static void fill_payload(unsigned char *data, size_t size, int text, uint32_t seed) {
+    static const char *text_line = "GET /static/index.html HTTP/1.1\r\nHost: 10.1.0.2\r\nAccept: */*\r\nConnection: keep-alive\r\n\r\n";
+    size_t text_len = strlen(text_line);
+    size_t i;
+    for ( i=0; i<size; i++ ) {
+        if ( text ) {
+            data[i] = (unsigned char)text_line[(i + seed) % text_len];
+        } else {
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            data[i] = (unsigned char)seed;
+        }
+    }
+}
+
+static void build_synthetic_packets(bench_tun_ctx_t *ctx, gnb_bench_tun_conf_t *bench_conf, uint32_t src_addr4) {
+    unsigned char *ip;
+    unsigned char *l4;
+    size_t size = bench_conf->packet_size;
+    size_t l4_head_size;
+    int is_tcp;
+    int text;
+    uint32_t i;
+    for ( i=0; i<bench_conf->flow_num; i++ ) {
+        is_tcp = i & 1;
+        l4_head_size = is_tcp ? 20 : 8;
+        if ( GNB_BENCH_PAYLOAD_MIX == bench_conf->payload_type ) {
+            text = (i & 2) ? 0 : 1;
+        } else {
+            text = GNB_BENCH_PAYLOAD_TEXT == bench_conf->payload_type;
+        }
+        ip = add_packet(ctx, size);
+        memset(ip, 0, 20 + l4_head_size);
+        ip[0] = 0x45;
+        *(uint16_t *)(ip + 2) = htons((uint16_t)size);
+        *(uint16_t *)(ip + 4) = htons((uint16_t)i);
+        ip[6] = 0x40;
+        ip[8] = 64;
+        ip[9] = is_tcp ? IPPROTO_TCP : IPPROTO_UDP;
+        memcpy(ip + 12, &src_addr4, 4);
+        memcpy(ip + 16, &bench_conf->dst_addr4, 4);
+        *(uint16_t *)(ip + 10) = ip_checksum(ip, 20);
+        l4 = ip + 20;
+        *(uint16_t *)(l4 + 0) = htons((uint16_t)(10000 + i));
+        *(uint16_t *)(l4 + 2) = htons((uint16_t)(is_tcp ? 80 : 5001));
+        if ( is_tcp ) {
+            *(uint32_t *)(l4 + 4) = htonl(i * 7919);
+            *(uint32_t *)(l4 + 8) = htonl(i * 104729);
+            l4[12] = 0x50;
+            l4[13] = 0x18; //PSH ACK
+            *(uint16_t *)(l4 + 14) = htons(65535);
+        } else {
+            *(uint16_t *)(l4 + 4) = htons((uint16_t)(size - 20));
+        }
+        //l4 的 checksum 保持为 0, 接收端直接丢弃不会校验
+        fill_payload(l4 + l4_head_size, size - 20 - l4_head_size, text, 2463534242u + i);
+    }
+}
+
+static uint32_t pcap_u32(uint32_t v, int swapped) {
+    if ( !swapped ) {
+        return v;
+    }
+    return ((v & 0xFF) << 24) | ((v & 0xFF00) << 8) | ((v >> 8) & 0xFF00) | (v >> 24);
+}
+
+/*
+ 只回放 ipv4 分组, src 和 dst 改为本地节点和对端节点的 tun 地址, 超过 mtu 或者被截断的分组跳过
+*/
+static int load_pcap_packets(bench_tun_ctx_t *ctx, gnb_bench_tun_conf_t *bench_conf, uint32_t src_addr4, unsigned int mtu) {
+    FILE *fp;
+    uint32_t global_head[6];
+    uint32_t record_head[4];
+    unsigned char *frame;
+    unsigned char *ip;
+    unsigned char *packet;
+    uint32_t magic;
+    uint32_t linktype;
+    uint32_t caplen;
+    size_t link_head_size;
+    size_t ip_size;
+    int swapped;
+    uint16_t ethertype;
+    fp = fopen(bench_conf->pcap_file, "rb");
+    if ( NULL == fp ) {
+        printf("open pcap file '%s' error: %s\n", bench_conf->pcap_file, strerror(errno));
+        return -1;
+    }
+    if ( 1 != fread(global_head, sizeof(global_head), 1, fp) ) {
+        printf("pcap file '%s' is too short\n", bench_conf->pcap_file);
+        fclose(fp);
+        return -1;
+    }
+    magic = global_head[0];
+    if ( PCAP_MAGIC_USEC == magic || PCAP_MAGIC_NSEC == magic ) {
+        swapped = 0;
+    } else if ( PCAP_MAGIC_USEC_SWAPPED == magic || PCAP_MAGIC_NSEC_SWAPPED == magic ) {
+        swapped = 1;
+    } else {
+        printf("pcap file '%s' unknown magic %08x, pcapng is not supported\n", bench_conf->pcap_file, magic);
+        fclose(fp);
+        return -1;
+    }
+    linktype = pcap_u32(global_head[5], swapped) & 0xFFFF;
+    switch (linktype) {
+    case PCAP_LINKTYPE_ETHERNET:
+        link_head_size = 14;
+        break;
+    case PCAP_LINKTYPE_LINUX_SLL:
+        link_head_size = 16;
+        break;
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_IPV4:
+        link_head_size = 0;
+        break;
+    default:
+        printf("pcap file '%s' unsupported linktype %u\n", bench_conf->pcap_file, linktype);
+        fclose(fp);
+        return -1;
+    }
+    frame = malloc(BENCH_MAX_PACKET_SIZE);
+    while ( 1 == fread(record_head, sizeof(record_head), 1, fp) ) {
+        caplen = pcap_u32(record_head[2], swapped);
+        if ( caplen > BENCH_MAX_PACKET_SIZE ) {
+            break;
+        }
+        if ( 1 != fread(frame, caplen, 1, fp) && 0 != caplen ) {
+            break;
+        }
+        if ( caplen < link_head_size + 20 ) {
+            continue;
+        }
+        if ( PCAP_LINKTYPE_ETHERNET == linktype || PCAP_LINKTYPE_LINUX_SLL == linktype ) {
+            ethertype = (frame[link_head_size-2] << 8) | frame[link_head_size-1];
+            if ( 0x0800 != ethertype ) {
+                continue;
+            }
+        }
+        ip = frame + link_head_size;
+        if ( 4 != (ip[0] >> 4) ) {
+            continue;
+        }
+        ip_size = (ip[2] << 8) | ip[3];
+        if ( ip_size < 20 || ip_size > caplen - link_head_size || ip_size > mtu ) {
+            continue;
+        }
+        packet = add_packet(ctx, ip_size);
+        memcpy(packet, ip, ip_size);
+        memcpy(packet + 12, &src_addr4, 4);
+        memcpy(packet + 16, &bench_conf->dst_addr4, 4);
+        *(uint16_t *)(packet + 10) = 0;
+        *(uint16_t *)(packet + 10) = ip_checksum(packet, (packet[0] & 0x0F) * 4);
+    }
+    free(frame);
+    fclose(fp);
+    if ( 0 == ctx->packet_num ) {
+        printf("pcap file '%s' has no ipv4 packet can be replayed\n", bench_conf->pcap_file);
+        return -1;
+    }
+    return 0;
+}
+
+int gnb_bench_tun_setup(gnb_core_t *gnb_core, gnb_bench_tun_conf_t *bench_conf) {
+    bench_tun_ctx_t *ctx;
+    uint32_t src_addr4 = gnb_core->local_node->tun_addr4.s_addr;
+    ctx = malloc(sizeof(bench_tun_ctx_t));
+    memset(ctx, 0, sizeof(bench_tun_ctx_t));
+    ctx->notify_fd = -1;
+    if ( 0 != bench_conf->dst_addr4 ) {
+        if ( NULL != bench_conf->pcap_file ) {
+            if ( 0 != load_pcap_packets(ctx, bench_conf, src_addr4, gnb_core->conf->mtu) ) {
+                free(ctx->packet_buffer);
+                free(ctx->packet_offset);
+                free(ctx->packet_size);
+                free(ctx);
+                return -1;
+            }
+        } else {
+            if ( bench_conf->packet_size < GNB_BENCH_MIN_PACKET_SIZE ) {
+                bench_conf->packet_size = GNB_BENCH_MIN_PACKET_SIZE;
+            }
+            if ( bench_conf->packet_size > gnb_core->conf->mtu ) {
+                bench_conf->packet_size = gnb_core->conf->mtu;
+            }
+            if ( 0 == bench_conf->flow_num ) {
+                bench_conf->flow_num = 1;
+            }
+            build_synthetic_packets(ctx, bench_conf, src_addr4);
+        }
+    }
+    //gnb_core_create 中已经用平台的 driver 执行过 init_tun, 这里换成 bench driver 重新 init
+    gnb_core->platform_ctx = ctx;
+    gnb_core->drv = &gnb_tun_drv_bench;
+    gnb_core->drv->init_tun(gnb_core);
+    return (int)ctx->packet_num;
+}
+
+void gnb_bench_tun_start(gnb_core_t *gnb_core) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    char c = 0;
+    ssize_t ret;
+    if ( 0 == ctx->packet_num || -1 == ctx->notify_fd ) {
+        return;
+    }
+    __atomic_store_n(&ctx->running, 1, __ATOMIC_RELEASE);
+    ret = write(ctx->notify_fd, &c, 1);
+    (void)ret;
+}
+
+void gnb_bench_tun_stop(gnb_core_t *gnb_core) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    //pipe 中的数据由 read_tun 取走, 之后 select 不再返回 tun_fd 可读
+    __atomic_store_n(&ctx->running, 0, __ATOMIC_RELEASE);
+}
+
+void gnb_bench_tun_stats(gnb_core_t *gnb_core, gnb_bench_tun_stats_t *stats) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    stats->read_num    = __atomic_load_n(&ctx->stats.read_num,    __ATOMIC_RELAXED);
+    stats->read_bytes  = __atomic_load_n(&ctx->stats.read_bytes,  __ATOMIC_RELAXED);
+    stats->write_num   = __atomic_load_n(&ctx->stats.write_num,   __ATOMIC_RELAXED);
+    stats->write_bytes = __atomic_load_n(&ctx->stats.write_bytes, __ATOMIC_RELAXED);
+}
+
+static int init_tun_bench(gnb_core_t *gnb_core) {
+    gnb_core->tun_fd = -1;
+    return 0;
+}
+
+static int open_tun_bench(gnb_core_t *gnb_core) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    int fds[2];
+    if ( -1 != gnb_core->tun_fd ) {
+        return -1;
+    }
+    if ( 0 != pipe(fds) ) {
+        perror("pipe");
+        return -2;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[1], F_SETFL, O_NONBLOCK);
+    gnb_core->tun_fd = fds[0];
+    ctx->notify_fd   = fds[1];
+    return 0;
+}
+
+static int read_tun_bench(gnb_core_t *gnb_core, void *buf, size_t buf_size) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    uint32_t idx = ctx->cur_idx;
+    size_t size;
+    char c[8];
+    ssize_t ret;
+    if ( !__atomic_load_n(&ctx->running, __ATOMIC_ACQUIRE) ) {
+        do {
+            ret = read(gnb_core->tun_fd, c, sizeof(c));
+        } while ( ret > 0 );
+        return -1;
+    }
+    size = ctx->packet_size[idx];
+    ctx->cur_idx = idx + 1 == ctx->packet_num ? 0 : idx + 1;
+    if ( size > buf_size ) {
+        return -1;
+    }
+    memcpy(buf, ctx->packet_buffer + ctx->packet_offset[idx], size);
+    __atomic_fetch_add(&ctx->stats.read_num,   1,    __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ctx->stats.read_bytes, size, __ATOMIC_RELAXED);
+    return (int)size;
+}
+
+/*
+ 有 pf worker 时会被多个 pf worker 同时调用
+*/
+static int write_tun_bench(gnb_core_t *gnb_core, void *buf, size_t buf_size) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    __atomic_fetch_add(&ctx->stats.write_num,   1,        __ATOMIC_RELAXED);
+    __atomic_fetch_add(&ctx->stats.write_bytes, buf_size, __ATOMIC_RELAXED);
+    return (int)buf_size;
+}
+
+static int close_tun_bench(gnb_core_t *gnb_core) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    if ( -1 != gnb_core->tun_fd ) {
+        close(gnb_core->tun_fd);
+        gnb_core->tun_fd = -1;
+    }
+    if ( -1 != ctx->notify_fd ) {
+        close(ctx->notify_fd);
+        ctx->notify_fd = -1;
+    }
+    return 0;
+}
+
+static int release_tun_bench(gnb_core_t *gnb_core) {
+    bench_tun_ctx_t *ctx = gnb_core->platform_ctx;
+    free(ctx->packet_buffer);
+    free(ctx->packet_offset);
+    free(ctx->packet_size);
+    free(ctx);
+    gnb_core->platform_ctx = NULL;
+    return 0;
+}
+
+gnb_tun_drv_t gnb_tun_drv_bench = {
+    init_tun_bench,
+    open_tun_bench,
+    read_tun_bench,
+    write_tun_bench,
+    close_tun_bench,
+    release_tun_bench
+};
@@ -0,0 +1,79 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_DRV_BENCH_H
+#define GNB_DRV_BENCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gnb_tun_drv.h"
+
+/*
+ 用于压测的 tun driver, 不需要 root 权限和内核的 tun 设备
+
+ read_tun 以最快的速度生成 ip 分组, 可以按指定的长度和 flow 数量合成, 也可以循环回放 pcap 文件中的 ipv4 分组
+ write_tun 只计数, 写入的分组直接丢弃
+ dst_addr4 为 0 时不生成分组, 只作为接收端使用
+*/
+
+#define GNB_BENCH_PAYLOAD_RANDOM   0
+#define GNB_BENCH_PAYLOAD_TEXT     1
+#define GNB_BENCH_PAYLOAD_MIX      2
+
+#define GNB_BENCH_MIN_PACKET_SIZE  40
+
+typedef struct _gnb_bench_tun_conf_t {
+
+    //ip 分组的长度, 包括 ip 首部
+    size_t packet_size;
+
+    //奇数 flow 为 tcp, 偶数 flow 为 udp, 每个 flow 使用不同的端口
+    uint32_t flow_num;
+
+    int payload_type;
+
+    //网络字节序
+    uint32_t dst_addr4;
+
+    //不为 NULL 时回放 pcap 文件, 忽略 packet_size flow_num payload_type
+    const char *pcap_file;
+
+} gnb_bench_tun_conf_t;
+
+typedef struct _gnb_bench_tun_stats_t {
+    uint64_t read_num;
+    uint64_t read_bytes;
+    uint64_t write_num;
+    uint64_t write_bytes;
+} gnb_bench_tun_stats_t;
+
+/*
+ 在 gnb_core_create 之后 gnb_core_start 之前调用, 替换 gnb_core 的 tun driver
+ 成功返回生成的分组模板的数量, 失败返回 -1
+*/
+int gnb_bench_tun_setup(gnb_core_t *gnb_core, gnb_bench_tun_conf_t *bench_conf);
+
+void gnb_bench_tun_start(gnb_core_t *gnb_core);
+
+void gnb_bench_tun_stop(gnb_core_t *gnb_core);
+
+void gnb_bench_tun_stats(gnb_core_t *gnb_core, gnb_bench_tun_stats_t *stats);
+
+extern gnb_tun_drv_t gnb_tun_drv_bench;
+
+#endif
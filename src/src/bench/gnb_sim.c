@@ -0,0 +1,1347 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ 单进程的多节点网络模拟器, 用于在一台机器上试验 relay, unified forwarding, forward node 切换等路径选择的策略
+
+ 在同一个进程中创建 N 个 lite 模式的 gnb core, 不启动任何 worker 线程, 不需要 root 权限和 tun 设备
+ 所有事件(udp 分组到达, node worker 的循环, 业务流量的发送)放在一个按虚拟时间排序的队列中由一个线程依次处理,
+ gnb core 看到的时间都是虚拟时钟的时间, 同样的参数和 seed 每次运行的结果完全相同
+
+ 节点之间的 udp 通过虚拟网络传递:
+   gnb_sim 链接时使用 -Wl,--wrap=sendto,--wrap=sendmsg,--wrap=send, gnb core 用 sim socket 调用 sendto sendmsg,
+   用 sim peer socket 调用 send 发出的 udp 分组进入虚拟网络, 其他 fd 照常调用 libc
+   --peer-socket on 时由 node poll 事件模拟 primary worker 为 P2P 节点打开和关闭 peer socket, peer socket 是 connect 到节点地址的 sim socket
+   到达节点的 udp 分组交给 gnb_primary_worker_handle_payload, 与 primary worker 收到的 udp 分组经过相同的处理
+   每一对节点之间的链路有各自的延迟, 抖动, 丢包率和带宽, 带宽不足时分组在链路上排队, 排队超过 SIM_LINK_QUEUE_USEC 的分组被丢弃
+   节点可以在 nat 后面, nat 的类型有 cone, restricted, port-restricted, symmetric
+   虚拟网络只有 ipv4
+
+ 节点的地址
+   uuid      1001 + idx
+   tun       10.1.x.y
+   公网      100.64.x.y:9001, nat 后面的节点没有公网地址, 内网地址是 192.168.x.y:9001, nat 的公网地址是 100.65.x.y
+   x = idx / 250, y = idx % 250 + 1
+
+ 业务流量在 tun 上注入 udp 分组, 负载中带有 flow 的序号和发送的时间, 分组到达目的节点的 tun 时统计延迟, 重复和丢失
+ 每隔 -i 指定的秒数输出一行统计, 结束时输出总的统计, 格式为 key=value
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <limits.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+
+#include "gnb.h"
+#include "gnb_core.h"
+#include "gnb_node.h"
+#include "gnb_time.h"
+#include "gnb_version.h"
+#include "gnb_hash32.h"
+#include "gnb_payload16.h"
+#include "gnb_ring_buffer_fixed.h"
+#include "gnb_worker_queue_data.h"
+
+//lite 模式的 ctl_block 最多容纳 256 个节点
+#define SIM_MAX_NODE              256
+#define SIM_BASE_UUID             1001
+#define SIM_UDP_PORT              9001
+#define SIM_MTU                   1400
+
+//sim socket 的 fd, 不会和进程中真实的 fd 重复
+#define SIM_SOCKET_FD_BASE        0x40000000
+
+//sim peer socket 的 fd 是 SIM_PEER_SOCKET_FD_BASE + 节点的 idx * SIM_MAX_NODE + node_zone 中对端节点的序号
+#define SIM_PEER_SOCKET_FD_BASE   (SIM_SOCKET_FD_BASE + SIM_MAX_NODE)
+
+//虚拟时钟的起点
+#define SIM_EPOCH_SEC             1700000000ULL
+
+//与 node worker 线程的循环间隔相同
+#define SIM_NODE_POLL_USEC        150000
+
+#define SIM_LINK_QUEUE_USEC       200000
+
+#define SIM_NAT_NONE              0
+#define SIM_NAT_CONE              1
+#define SIM_NAT_RESTRICTED        2
+#define SIM_NAT_PORT_RESTRICTED   3
+#define SIM_NAT_SYMMETRIC         4
+
+#define SIM_NAT_PORT_BASE         20000
+#define SIM_NAT_TIMEOUT_USEC      (120 * 1000000ULL)
+#define SIM_NAT_ENTRY_MAX         1024
+
+//延迟按 100 微秒分桶, 超过 10 秒的放在最后一个桶
+#define SIM_LATENCY_BUCKET_USEC   100
+#define SIM_LATENCY_BUCKET_NUM    100001
+
+#define SIM_PROBE_MAGIC           0x474E4253
+
+#define SIM_MAX_DOWN              64
+
+#define SIM_EVENT_UDP             0x1
+#define SIM_EVENT_NODE_POLL       0x2
+#define SIM_EVENT_FLOW            0x3
+#define SIM_EVENT_NODE_DOWN       0x4
+#define SIM_EVENT_NODE_UP         0x5
+#define SIM_EVENT_REPORT          0x6
+
+typedef struct _sim_link_t {
+    uint32_t latency_usec;
+    uint32_t jitter_usec;
+    //百万分之一
+    uint32_t loss_ppm;
+    //kbit/s, 0 为不限制
+    uint32_t bandwidth_kbps;
+    //链路上最后一个分组发送完的时间
+    uint64_t busy_until_usec;
+} sim_link_t;
+
+typedef struct _sim_nat_entry_t {
+    uint32_t remote_addr4;
+    uint16_t remote_port;
+    uint16_t ext_port;
+    uint64_t last_ts_usec;
+} sim_nat_entry_t;
+
+typedef struct _sim_node_t {
+    int idx;
+    gnb_uuid_t uuid64;
+    gnb_core_t *gnb_core;
+    gnb_pf_core_t *pf_core;
+    int down;
+    int nat_type;
+    //网络字节序, 在 nat 后面时是内网地址
+    uint32_t addr4;
+    //nat 的公网地址, 网络字节序
+    uint32_t ext_addr4;
+    uint16_t next_ext_port;
+    int nat_entry_num;
+    sim_nat_entry_t *nat_entries;
+    //peer socket connect 的地址, 按 node_zone 中节点的序号索引, 没有打开 --peer-socket 时为 NULL
+    struct sockaddr_in *peer_addr4;
+    char map_file[PATH_MAX];
+} sim_node_t;
+
+typedef struct _sim_datagram_t {
+    //源地址是经过 nat 转换之后的地址
+    struct sockaddr_in src_addr;
+    uint16_t dst_port;
+    size_t size;
+    unsigned char data[0];
+} sim_datagram_t;
+
+typedef struct _sim_event_t {
+    uint64_t ts_usec;
+    //同一时间的事件按加入的次序处理
+    uint64_t seq;
+    int type;
+    int idx;
+    void *data;
+} sim_event_t;
+
+typedef struct _sim_flow_t {
+    int src_idx;
+    int dst_idx;
+    uint32_t seq;
+    uint32_t seq_num;
+    //已经收到的序号, 用于发现重复的分组
+    uint8_t *seq_bitmap;
+} sim_flow_t;
+
+typedef struct _sim_stats_t {
+    uint64_t sent;
+    uint64_t delivered;
+    uint64_t dup;
+    uint64_t latency_sum_usec;
+    uint64_t latency_max_usec;
+    uint64_t udp_ipframe;
+    uint64_t udp_node;
+    uint64_t udp_bytes;
+    uint64_t drop_link;
+    uint64_t drop_queue;
+    uint64_t drop_nat;
+    uint64_t drop_down;
+    uint64_t drop_noaddr;
+    uint32_t *latency_buckets;
+} sim_stats_t;
+
+#pragma pack(push, 1)
+typedef struct _sim_probe_t {
+    uint32_t magic;
+    uint32_t flow_idx;
+    uint32_t seq;
+    uint64_t send_ts_usec;
+} __attribute__ ((__packed__)) sim_probe_t;
+#pragma pack(pop)
+
+typedef struct _sim_down_t {
+    gnb_uuid_t uuid64;
+    uint64_t down_sec;
+    uint64_t up_sec;
+} sim_down_t;
+
+gnb_conf_t* gnb_argv(int argc,char *argv[]);
+
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name);
+
+void update_node_crypto_key(gnb_core_t *gnb_core, uint64_t now_sec);
+
+void gnb_node_worker_poll(gnb_worker_t *gnb_node_worker, uint64_t now_time_usec);
+
+void gnb_primary_worker_handle_payload(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *inet_payload, gnb_sockaddress_t *node_addr, uint8_t socket_idx);
+
+ssize_t __real_sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen);
+
+ssize_t __real_sendmsg(int sockfd, const struct msghdr *msg, int flags);
+
+ssize_t __real_send(int sockfd, const void *buf, size_t len, int flags);
+
+static sim_node_t *sim_nodes;
+static int sim_node_num = 16;
+
+static sim_link_t *sim_links;
+
+static sim_flow_t *sim_flows;
+static int sim_flow_num = -1;
+
+static sim_event_t *sim_events;
+static size_t sim_event_num;
+static size_t sim_event_size;
+static uint64_t sim_event_seq;
+
+static uint64_t sim_now_usec;
+
+static uint64_t sim_rand_state = 1;
+
+static sim_stats_t sim_window_stats;
+static sim_stats_t sim_total_stats;
+
+static sim_down_t sim_downs[SIM_MAX_DOWN];
+static int sim_down_num;
+
+void log_out_description(gnb_log_ctx_t *log) {
+    GNB_LOG1(log, GNB_LOG_ID_CORE, "%s\n", GNB_VERSION_STRING);
+}
+
+void show_description() {
+    printf("%s\n", GNB_VERSION_STRING);
+}
+
+//xorshift64*, 所有随机数都来自同一个以 seed 初始化的序列
+static uint64_t sim_rand() {
+    sim_rand_state ^= sim_rand_state >> 12;
+    sim_rand_state ^= sim_rand_state << 25;
+    sim_rand_state ^= sim_rand_state >> 27;
+    return sim_rand_state * 0x2545F4914F6CDD1DULL;
+}
+
+static uint32_t sim_idx_to_addr4(uint8_t a, uint8_t b, int idx) {
+    uint32_t addr = ((uint32_t)a << 24) | ((uint32_t)b << 16) | ((uint32_t)(idx / 250) << 8) | (uint32_t)(idx % 250 + 1);
+    return htonl(addr);
+}
+
+//addr4 不是 a.b.x.y 时返回 -1
+static int sim_addr4_to_idx(uint32_t addr4, uint8_t a, uint8_t b) {
+    uint32_t addr = ntohl(addr4);
+    int idx;
+    if ( (addr >> 24) != a || ((addr >> 16) & 0xFF) != b || 0 == (addr & 0xFF) ) {
+        return -1;
+    }
+    idx = (int)((addr >> 8) & 0xFF) * 250 + (int)(addr & 0xFF) - 1;
+    if ( idx >= sim_node_num ) {
+        return -1;
+    }
+    return idx;
+}
+
+static void sim_event_push(uint64_t ts_usec, int type, int idx, void *data) {
+    sim_event_t event;
+    sim_event_t tmp;
+    size_t i;
+    size_t parent;
+    if ( sim_event_num == sim_event_size ) {
+        sim_event_size = 0 == sim_event_size ? 1024 : sim_event_size * 2;
+        sim_events = (sim_event_t *)realloc(sim_events, sizeof(sim_event_t) * sim_event_size);
+    }
+    event.ts_usec = ts_usec;
+    event.seq = sim_event_seq++;
+    event.type = type;
+    event.idx = idx;
+    event.data = data;
+    i = sim_event_num++;
+    sim_events[i] = event;
+    while ( i > 0 ) {
+        parent = (i - 1) / 2;
+        if ( sim_events[parent].ts_usec < sim_events[i].ts_usec ||
+             (sim_events[parent].ts_usec == sim_events[i].ts_usec && sim_events[parent].seq < sim_events[i].seq) ) {
+            break;
+        }
+        tmp = sim_events[parent];
+        sim_events[parent] = sim_events[i];
+        sim_events[i] = tmp;
+        i = parent;
+    }
+}
+
+static int sim_event_less(size_t a, size_t b) {
+    if ( sim_events[a].ts_usec != sim_events[b].ts_usec ) {
+        return sim_events[a].ts_usec < sim_events[b].ts_usec;
+    }
+    return sim_events[a].seq < sim_events[b].seq;
+}
+
+static int sim_event_pop(sim_event_t *event) {
+    sim_event_t tmp;
+    size_t i = 0;
+    size_t child;
+    if ( 0 == sim_event_num ) {
+        return -1;
+    }
+    *event = sim_events[0];
+    sim_events[0] = sim_events[--sim_event_num];
+    while ( 1 ) {
+        child = i * 2 + 1;
+        if ( child >= sim_event_num ) {
+            break;
+        }
+        if ( child + 1 < sim_event_num && sim_event_less(child + 1, child) ) {
+            child++;
+        }
+        if ( !sim_event_less(child, i) ) {
+            break;
+        }
+        tmp = sim_events[child];
+        sim_events[child] = sim_events[i];
+        sim_events[i] = tmp;
+        i = child;
+    }
+    return 0;
+}
+
+static void sim_set_core_time(gnb_core_t *gnb_core) {
+    gnb_core->now_timeval.tv_sec  = (time_t)(sim_now_usec / 1000000);
+    gnb_core->now_timeval.tv_usec = (suseconds_t)(sim_now_usec % 1000000);
+    gnb_core->now_time_sec  = sim_now_usec / 1000000;
+    gnb_core->now_time_usec = sim_now_usec;
+}
+
+static void sim_stats_add_latency(sim_stats_t *stats, uint64_t latency_usec) {
+    uint64_t bucket = latency_usec / SIM_LATENCY_BUCKET_USEC;
+    if ( bucket >= SIM_LATENCY_BUCKET_NUM ) {
+        bucket = SIM_LATENCY_BUCKET_NUM - 1;
+    }
+    stats->latency_buckets[bucket]++;
+    stats->latency_sum_usec += latency_usec;
+    if ( latency_usec > stats->latency_max_usec ) {
+        stats->latency_max_usec = latency_usec;
+    }
+}
+
+#define SIM_STATS_INC(field) do { sim_window_stats.field++; sim_total_stats.field++; } while(0)
+
+static sim_nat_entry_t* sim_nat_find(sim_node_t *node, uint32_t remote_addr4, uint16_t remote_port) {
+    int i;
+    sim_nat_entry_t *entry;
+    for ( i=0; i<node->nat_entry_num; i++ ) {
+        entry = &node->nat_entries[i];
+        if ( entry->remote_addr4 == remote_addr4 && entry->remote_port == remote_port ) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/*
+ 为发往 remote 的分组分配 nat 的外部端口
+ symmetric 为每个 remote 分配不同的端口, 其他类型所有 remote 共用一个端口, 过期的映射在端口不再被使用时重新分配
+*/
+static uint16_t sim_nat_outbound(sim_node_t *node, uint32_t remote_addr4, uint16_t remote_port) {
+    sim_nat_entry_t *entry;
+    int i;
+    uint16_t ext_port = 0;
+    entry = sim_nat_find(node, remote_addr4, remote_port);
+    if ( NULL != entry && sim_now_usec - entry->last_ts_usec <= SIM_NAT_TIMEOUT_USEC ) {
+        entry->last_ts_usec = sim_now_usec;
+        return entry->ext_port;
+    }
+    if ( SIM_NAT_SYMMETRIC != node->nat_type ) {
+        for ( i=0; i<node->nat_entry_num; i++ ) {
+            if ( sim_now_usec - node->nat_entries[i].last_ts_usec <= SIM_NAT_TIMEOUT_USEC ) {
+                ext_port = node->nat_entries[i].ext_port;
+                break;
+            }
+        }
+    }
+    if ( 0 == ext_port ) {
+        ext_port = node->next_ext_port++;
+    }
+    if ( NULL == entry ) {
+        if ( SIM_NAT_ENTRY_MAX == node->nat_entry_num ) {
+            //表满了时覆盖最久没有使用的映射
+            entry = &node->nat_entries[0];
+            for ( i=1; i<node->nat_entry_num; i++ ) {
+                if ( node->nat_entries[i].last_ts_usec < entry->last_ts_usec ) {
+                    entry = &node->nat_entries[i];
+                }
+            }
+        } else {
+            entry = &node->nat_entries[node->nat_entry_num++];
+        }
+    }
+    entry->remote_addr4 = remote_addr4;
+    entry->remote_port  = remote_port;
+    entry->ext_port     = ext_port;
+    entry->last_ts_usec = sim_now_usec;
+    return ext_port;
+}
+
+//返回 0 表示 nat 允许这个分组进入
+static int sim_nat_inbound(sim_node_t *node, uint16_t ext_port, uint32_t remote_addr4, uint16_t remote_port) {
+    int i;
+    sim_nat_entry_t *entry;
+    for ( i=0; i<node->nat_entry_num; i++ ) {
+        entry = &node->nat_entries[i];
+        if ( entry->ext_port != ext_port || sim_now_usec - entry->last_ts_usec > SIM_NAT_TIMEOUT_USEC ) {
+            continue;
+        }
+        switch ( node->nat_type ) {
+        case SIM_NAT_CONE:
+            return 0;
+        case SIM_NAT_RESTRICTED:
+            if ( entry->remote_addr4 == remote_addr4 ) {
+                return 0;
+            }
+            break;
+        default:
+            if ( entry->remote_addr4 == remote_addr4 && entry->remote_port == remote_port ) {
+                return 0;
+            }
+            break;
+        }
+    }
+    return -1;
+}
+
+static void sim_udp_send(sim_node_t *src_node, const struct sockaddr_in *dst_addr, const void *buf, size_t len) {
+    const gnb_payload16_t *payload = (const gnb_payload16_t *)buf;
+    sim_datagram_t *datagram;
+    sim_link_t *link;
+    int dst_idx;
+    uint64_t depart_usec;
+    uint64_t arrive_usec;
+    int64_t jitter_usec;
+    if ( len >= GNB_PAYLOAD16_HEAD_SIZE && GNB_PAYLOAD_TYPE_IPFRAME == payload->type ) {
+        SIM_STATS_INC(udp_ipframe);
+    } else {
+        SIM_STATS_INC(udp_node);
+    }
+    sim_window_stats.udp_bytes += len;
+    sim_total_stats.udp_bytes  += len;
+    if ( src_node->down ) {
+        SIM_STATS_INC(drop_down);
+        return;
+    }
+    dst_idx = sim_addr4_to_idx(dst_addr->sin_addr.s_addr, 100, 64);
+    if ( -1 != dst_idx && (SIM_NAT_NONE != sim_nodes[dst_idx].nat_type || htons(SIM_UDP_PORT) != dst_addr->sin_port) ) {
+        dst_idx = -1;
+    }
+    if ( -1 == dst_idx ) {
+        dst_idx = sim_addr4_to_idx(dst_addr->sin_addr.s_addr, 100, 65);
+        if ( -1 != dst_idx && SIM_NAT_NONE == sim_nodes[dst_idx].nat_type ) {
+            dst_idx = -1;
+        }
+    }
+    if ( -1 == dst_idx || dst_idx == src_node->idx ) {
+        SIM_STATS_INC(drop_noaddr);
+        return;
+    }
+    datagram = (sim_datagram_t *)malloc(sizeof(sim_datagram_t) + len);
+    memset(&datagram->src_addr, 0, sizeof(struct sockaddr_in));
+    datagram->src_addr.sin_family = AF_INET;
+    if ( SIM_NAT_NONE == src_node->nat_type ) {
+        datagram->src_addr.sin_addr.s_addr = src_node->addr4;
+        datagram->src_addr.sin_port = htons(SIM_UDP_PORT);
+    } else {
+        datagram->src_addr.sin_addr.s_addr = src_node->ext_addr4;
+        datagram->src_addr.sin_port = htons(sim_nat_outbound(src_node, dst_addr->sin_addr.s_addr, dst_addr->sin_port));
+    }
+    datagram->dst_port = dst_addr->sin_port;
+    datagram->size = len;
+    memcpy(datagram->data, buf, len);
+    link = &sim_links[src_node->idx * sim_node_num + dst_idx];
+    if ( 0 != link->loss_ppm && sim_rand() % 1000000 < link->loss_ppm ) {
+        SIM_STATS_INC(drop_link);
+        free(datagram);
+        return;
+    }
+    depart_usec = sim_now_usec;
+    if ( 0 != link->bandwidth_kbps ) {
+        if ( link->busy_until_usec > depart_usec ) {
+            depart_usec = link->busy_until_usec;
+        }
+        if ( depart_usec - sim_now_usec > SIM_LINK_QUEUE_USEC ) {
+            SIM_STATS_INC(drop_queue);
+            free(datagram);
+            return;
+        }
+        //kbit/s 等于 bit/ms
+        depart_usec += (uint64_t)len * 8 * 1000 / link->bandwidth_kbps;
+        link->busy_until_usec = depart_usec;
+    }
+    arrive_usec = depart_usec + link->latency_usec;
+    if ( 0 != link->jitter_usec ) {
+        jitter_usec = (int64_t)(sim_rand() % (2 * (uint64_t)link->jitter_usec + 1)) - (int64_t)link->jitter_usec;
+        if ( jitter_usec < 0 && (uint64_t)(-jitter_usec) > arrive_usec - depart_usec ) {
+            jitter_usec = -(int64_t)(arrive_usec - depart_usec);
+        }
+        arrive_usec += jitter_usec;
+    }
+    sim_event_push(arrive_usec, SIM_EVENT_UDP, dst_idx, datagram);
+}
+
+/*
+ gnb core 调用的 sendto, 只处理 sim socket, 其他 fd 交给 libc
+*/
+ssize_t __wrap_sendto(int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen) {
+    if ( sockfd < SIM_SOCKET_FD_BASE || sockfd >= SIM_SOCKET_FD_BASE + sim_node_num ) {
+        return __real_sendto(sockfd, buf, len, flags, dest_addr, addrlen);
+    }
+    if ( NULL != dest_addr && AF_INET == dest_addr->sa_family ) {
+        sim_udp_send(&sim_nodes[sockfd - SIM_SOCKET_FD_BASE], (const struct sockaddr_in *)dest_addr, buf, len);
+    }
+    return (ssize_t)len;
+}
+
+/*
+ gnb_send_to_address_with_head 用 sendmsg 把头部和 payload 拼成一个 udp 分组, 先合并到一个 buffer 中再进入虚拟网络
+*/
+ssize_t __wrap_sendmsg(int sockfd, const struct msghdr *msg, int flags) {
+    unsigned char buf[SIM_MTU * 2];
+    size_t len = 0;
+    size_t i;
+    if ( sockfd < SIM_SOCKET_FD_BASE || sockfd >= SIM_SOCKET_FD_BASE + sim_node_num ) {
+        return __real_sendmsg(sockfd, msg, flags);
+    }
+    for ( i=0; i<msg->msg_iovlen; i++ ) {
+        if ( len + msg->msg_iov[i].iov_len > sizeof(buf) ) {
+            return -1;
+        }
+        memcpy(buf + len, msg->msg_iov[i].iov_base, msg->msg_iov[i].iov_len);
+        len += msg->msg_iov[i].iov_len;
+    }
+    if ( NULL != msg->msg_name && AF_INET == ((const struct sockaddr *)msg->msg_name)->sa_family ) {
+        sim_udp_send(&sim_nodes[sockfd - SIM_SOCKET_FD_BASE], (const struct sockaddr_in *)msg->msg_name, buf, len);
+    }
+    return (ssize_t)len;
+}
+
+/*
+ peer socket 用 send 发送, 目的地址是 peer socket connect 的地址
+*/
+ssize_t __wrap_send(int sockfd, const void *buf, size_t len, int flags) {
+    sim_node_t *node;
+    int peer_idx;
+    if ( sockfd < SIM_PEER_SOCKET_FD_BASE || sockfd >= SIM_PEER_SOCKET_FD_BASE + sim_node_num * SIM_MAX_NODE ) {
+        return __real_send(sockfd, buf, len, flags);
+    }
+    node = &sim_nodes[(sockfd - SIM_PEER_SOCKET_FD_BASE) / SIM_MAX_NODE];
+    peer_idx = (sockfd - SIM_PEER_SOCKET_FD_BASE) % SIM_MAX_NODE;
+    if ( NULL == node->peer_addr4 ) {
+        return -1;
+    }
+    sim_udp_send(node, &node->peer_addr4[peer_idx], buf, len);
+    return (ssize_t)len;
+}
+
+/*
+ 与 primary worker 的 update_peer_sockets 相同, 为 P2P 节点打开 peer socket, P2P 地址变化或者不再可达时关闭
+ sim 中只有 ipv4
+*/
+static void sim_update_peer_sockets(sim_node_t *sim_node) {
+    gnb_core_t *gnb_core = sim_node->gnb_core;
+    gnb_node_t *node;
+    size_t num;
+    int i;
+    if ( NULL == sim_node->peer_addr4 ) {
+        return;
+    }
+    num = gnb_core->ctl_block->node_zone->node_num;
+    for ( i=0; i<num && i<SIM_MAX_NODE; i++ ) {
+        node = &gnb_core->ctl_block->node_zone->node[i];
+        if ( gnb_core->local_node == node ) {
+            continue;
+        }
+        if ( -1 != node->peer_socket4 ) {
+            if ( (node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) &&
+                 sim_node->peer_addr4[i].sin_port == node->udp_sockaddr4.sin_port &&
+                 sim_node->peer_addr4[i].sin_addr.s_addr == node->udp_sockaddr4.sin_addr.s_addr ) {
+                continue;
+            }
+            node->peer_socket4 = -1;
+        }
+        if ( node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG ) {
+            sim_node->peer_addr4[i] = node->udp_sockaddr4;
+            node->peer_socket4 = SIM_PEER_SOCKET_FD_BASE + sim_node->idx * SIM_MAX_NODE + i;
+        }
+    }
+}
+
+/*
+ sim 中没有 node worker 的线程, primary worker 通知 node worker 时直接执行一次 node worker 的处理
+*/
+static int sim_node_worker_notify(gnb_worker_t *gnb_worker) {
+    gnb_node_worker_poll(gnb_worker, sim_now_usec);
+    return 0;
+}
+
+static void sim_handle_udp(sim_node_t *node, sim_datagram_t *datagram) {
+    gnb_core_t *gnb_core = node->gnb_core;
+    gnb_payload16_t *inet_payload = gnb_core->inet_payload;
+    gnb_sockaddress_t node_addr_st;
+    if ( node->down ) {
+        SIM_STATS_INC(drop_down);
+        return;
+    }
+    if ( SIM_NAT_NONE != node->nat_type && 0 != sim_nat_inbound(node, ntohs(datagram->dst_port), datagram->src_addr.sin_addr.s_addr, datagram->src_addr.sin_port) ) {
+        SIM_STATS_INC(drop_nat);
+        return;
+    }
+    if ( datagram->size > gnb_core->conf->payload_block_size ) {
+        return;
+    }
+    memcpy(inet_payload, datagram->data, datagram->size);
+    if ( gnb_payload16_size(inet_payload) != datagram->size ) {
+        return;
+    }
+    memset(&node_addr_st, 0, sizeof(gnb_sockaddress_t));
+    node_addr_st.addr_type = AF_INET;
+    node_addr_st.protocol  = SOCK_DGRAM;
+    node_addr_st.addr.in   = datagram->src_addr;
+    node_addr_st.socklen   = sizeof(struct sockaddr_in);
+    sim_set_core_time(gnb_core);
+    gnb_primary_worker_handle_payload(gnb_core, node->pf_core, inet_payload, &node_addr_st, 0);
+}
+
+static int init_tun_sim(gnb_core_t *gnb_core) {
+    gnb_core->tun_fd = -1;
+    return 0;
+}
+
+static int open_tun_sim(gnb_core_t *gnb_core) {
+    return 0;
+}
+
+static int read_tun_sim(gnb_core_t *gnb_core, void *buf, size_t buf_size) {
+    return 0;
+}
+
+//到达 tun 的分组只做统计, 不是 sim 注入的分组直接丢弃
+static int write_tun_sim(gnb_core_t *gnb_core, void *buf, size_t buf_size) {
+    sim_node_t *node = gnb_core->platform_ctx;
+    sim_probe_t probe;
+    sim_flow_t *flow;
+    uint64_t latency_usec;
+    if ( buf_size < sizeof(struct iphdr) + sizeof(struct udphdr) + sizeof(sim_probe_t) ) {
+        return (int)buf_size;
+    }
+    memcpy(&probe, (unsigned char *)buf + sizeof(struct iphdr) + sizeof(struct udphdr), sizeof(sim_probe_t));
+    if ( SIM_PROBE_MAGIC != probe.magic || probe.flow_idx >= sim_flow_num ) {
+        return (int)buf_size;
+    }
+    flow = &sim_flows[probe.flow_idx];
+    if ( flow->dst_idx != node->idx || probe.seq >= flow->seq_num ) {
+        return (int)buf_size;
+    }
+    if ( flow->seq_bitmap[probe.seq / 8] & (1 << (probe.seq % 8)) ) {
+        SIM_STATS_INC(dup);
+        return (int)buf_size;
+    }
+    flow->seq_bitmap[probe.seq / 8] |= (uint8_t)(1 << (probe.seq % 8));
+    SIM_STATS_INC(delivered);
+    latency_usec = sim_now_usec - probe.send_ts_usec;
+    sim_stats_add_latency(&sim_window_stats, latency_usec);
+    sim_stats_add_latency(&sim_total_stats,  latency_usec);
+    return (int)buf_size;
+}
+
+static int close_tun_sim(gnb_core_t *gnb_core) {
+    return 0;
+}
+
+static int release_tun_sim(gnb_core_t *gnb_core) {
+    return 0;
+}
+
+static gnb_tun_drv_t gnb_tun_drv_sim = {
+    init_tun_sim,
+    open_tun_sim,
+    read_tun_sim,
+    write_tun_sim,
+    close_tun_sim,
+    release_tun_sim
+};
+
+static uint16_t ip_checksum(void *data, size_t size) {
+    uint16_t *p = (uint16_t *)data;
+    uint32_t sum = 0;
+    while ( size > 1 ) {
+        sum += *p++;
+        size -= 2;
+    }
+    while ( sum >> 16 ) {
+        sum = (sum & 0xFFFF) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+//与 primary worker 从 tun 读到分组之后的处理相同, 在 tun_payload 的 tun_payload_offset 之后构造分组交给 pf
+static void sim_flow_send(int flow_idx, size_t packet_size) {
+    sim_flow_t *flow = &sim_flows[flow_idx];
+    sim_node_t *src_node = &sim_nodes[flow->src_idx];
+    sim_node_t *dst_node = &sim_nodes[flow->dst_idx];
+    gnb_core_t *gnb_core = src_node->gnb_core;
+    gnb_payload16_t *payload = gnb_core->tun_payload;
+    unsigned char *packet = payload->data + gnb_core->tun_payload_offset;
+    struct iphdr *iph = (struct iphdr *)packet;
+    struct udphdr *udph = (struct udphdr *)(packet + sizeof(struct iphdr));
+    sim_probe_t probe;
+    if ( src_node->down || flow->seq >= flow->seq_num ) {
+        return;
+    }
+    memset(packet, 0, packet_size);
+    iph->version  = 4;
+    iph->ihl      = 5;
+    iph->ttl      = 64;
+    iph->protocol = IPPROTO_UDP;
+    iph->tot_len  = htons((uint16_t)packet_size);
+    iph->id       = htons((uint16_t)flow->seq);
+    iph->saddr    = src_node->gnb_core->local_node->tun_addr4.s_addr;
+    iph->daddr    = dst_node->gnb_core->local_node->tun_addr4.s_addr;
+    iph->check    = ip_checksum(iph, sizeof(struct iphdr));
+    udph->source  = htons((uint16_t)(10000 + flow_idx));
+    udph->dest    = htons(5001);
+    udph->len     = htons((uint16_t)(packet_size - sizeof(struct iphdr)));
+    probe.magic = SIM_PROBE_MAGIC;
+    probe.flow_idx = (uint32_t)flow_idx;
+    probe.seq = flow->seq++;
+    probe.send_ts_usec = sim_now_usec;
+    memcpy(packet + sizeof(struct iphdr) + sizeof(struct udphdr), &probe, sizeof(sim_probe_t));
+    gnb_payload16_set_size(payload, GNB_PAYLOAD16_HEAD_SIZE + gnb_core->tun_payload_offset + packet_size);
+    SIM_STATS_INC(sent);
+    sim_set_core_time(gnb_core);
+    gnb_pf_tun(gnb_core, src_node->pf_core, payload);
+}
+
+//与 primary worker 装载相同的 pf 模块, 这些模块已经在 primary worker 的 init 中初始化过
+static gnb_pf_core_t* sim_pf_core_create(gnb_core_t *gnb_core) {
+    gnb_pf_core_t *pf_core = gnb_pf_core_init(gnb_core->heap, 32);
+    //sim 中 primary worker 线程不运行, 由这个 pf_core 代替 primary worker 使用 shard 0, gnb_ctl 能看到每个节点的计数和 flight record
+    pf_core->node_counter_shard = gnb_ctl_block_counter_shard(gnb_core->ctl_block, 0);
+    pf_core->latency_shard      = gnb_ctl_block_latency_shard(gnb_core->ctl_block, 0);
+    pf_core->pf_status_counter  = gnb_ctl_block_pf_status_shard(gnb_core->ctl_block, 0);
+    pf_core->flight_recorder    = gnb_ctl_block_flight_shard(gnb_core->ctl_block, 0);
+    gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, gnb_core->conf->pf_route));
+    if ( 0 != gnb_core->conf->zip_level ) {
+        gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, GNB_ZIP_TYPE_LZ4 == gnb_core->conf->zip_type ? "gnb_pf_lz4":"gnb_pf_zip"));
+    }
+    if ( gnb_core->conf->header_zip ) {
+        gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_header_zip"));
+    }
+    if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_XOR ) {
+        gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_xor"));
+    }
+    if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_ARC4 ) {
+        gnb_pf_install(pf_core->pf_install_array, gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_arc4"));
+    }
+    gnb_pf_core_conf(gnb_core, pf_core);
+    return pf_core;
+}
+
+static int sim_create_node(sim_node_t *node, char *route_string, char *address_string, int extra_argc, char **extra_argv) {
+    char nodeid_string[32];
+    char listen_string[16];
+    char mtu_string[16];
+    char *argv[64];
+    int argc = 0;
+    int i;
+    gnb_conf_t *conf;
+    gnb_core_t *gnb_core;
+    snprintf(nodeid_string, sizeof(nodeid_string), "%llu", (unsigned long long)node->uuid64);
+    snprintf(listen_string, sizeof(listen_string), "%u", SIM_UDP_PORT);
+    snprintf(mtu_string,    sizeof(mtu_string),    "%u", SIM_MTU);
+    snprintf(node->map_file, PATH_MAX, "/tmp/gnb_sim.%d.%llu.map", (int)getpid(), (unsigned long long)node->uuid64);
+    argv[argc++] = "gnb_sim";
+    argv[argc++] = "-n";
+    argv[argc++] = nodeid_string;
+    argv[argc++] = "-4";
+    argv[argc++] = "-q";
+    argv[argc++] = "-l";
+    argv[argc++] = listen_string;
+    argv[argc++] = "-r";
+    argv[argc++] = route_string;
+    argv[argc++] = "-a";
+    argv[argc++] = address_string;
+    argv[argc++] = "-b";
+    argv[argc++] = node->map_file;
+    argv[argc++] = "--mtu";
+    argv[argc++] = mtu_string;
+    argv[argc++] = "--index-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--node-detect-worker";
+    argv[argc++] = "0";
+    argv[argc++] = "--pf-worker";
+    argv[argc++] = "0";
+    for ( i=0; i<extra_argc && argc < 63; i++ ) {
+        argv[argc++] = extra_argv[i];
+    }
+    argv[argc] = NULL;
+    //gnb_argv 使用 getopt_long, 每次解析前都要重置
+    optind = 0;
+    conf = gnb_argv(argc, argv);
+    gnb_core = gnb_core_create(conf);
+    free(conf);
+    if ( NULL == gnb_core ) {
+        return -1;
+    }
+    gnb_core->drv = &gnb_tun_drv_sim;
+    gnb_core->platform_ctx = node;
+    gnb_core->drv->init_tun(gnb_core);
+    gnb_core->udp_ipv4_sockets[0] = SIM_SOCKET_FD_BASE + node->idx;
+    //gnb_core_create 用真实的时间生成了密钥, 改为用虚拟时钟的时间, 所有节点得到相同的密钥
+    update_node_crypto_key(gnb_core, SIM_EPOCH_SEC);
+    if ( NULL != gnb_core->node_worker ) {
+        gnb_core->node_worker->notify = sim_node_worker_notify;
+    }
+    if ( gnb_core->conf->peer_socket ) {
+        node->peer_addr4 = (struct sockaddr_in *)calloc(SIM_MAX_NODE, sizeof(struct sockaddr_in));
+    }
+    node->gnb_core = gnb_core;
+    node->pf_core = sim_pf_core_create(gnb_core);
+    return 0;
+}
+
+static double sim_latency_percentile_ms(sim_stats_t *stats, double percentile) {
+    uint64_t target;
+    uint64_t count = 0;
+    size_t i;
+    if ( 0 == stats->delivered ) {
+        return 0;
+    }
+    target = (uint64_t)(stats->delivered * percentile);
+    if ( target >= stats->delivered ) {
+        target = stats->delivered - 1;
+    }
+    for ( i=0; i<SIM_LATENCY_BUCKET_NUM; i++ ) {
+        count += stats->latency_buckets[i];
+        if ( count > target ) {
+            break;
+        }
+    }
+    return (double)(i * SIM_LATENCY_BUCKET_USEC) / 1000;
+}
+
+//节点之间直连可达(收到过 pong)的比例
+static double sim_p2p_percent() {
+    int i;
+    int j;
+    uint64_t uuid64;
+    gnb_node_t *node;
+    uint64_t p2p_num = 0;
+    if ( sim_node_num < 2 ) {
+        return 0;
+    }
+    for ( i=0; i<sim_node_num; i++ ) {
+        if ( sim_nodes[i].down ) {
+            continue;
+        }
+        for ( j=0; j<sim_node_num; j++ ) {
+            if ( i == j ) {
+                continue;
+            }
+            uuid64 = sim_nodes[j].uuid64;
+            node = GNB_HASH32_UINT64_GET_PTR(sim_nodes[i].gnb_core->uuid_node_map, uuid64);
+            if ( NULL != node && (GNB_NODE_STATUS_IPV4_PONG & node->udp_addr_status) ) {
+                p2p_num++;
+            }
+        }
+    }
+    return (double)p2p_num * 100 / ((uint64_t)sim_node_num * (sim_node_num - 1));
+}
+
+static void sim_report(const char *type, sim_stats_t *stats) {
+    printf("type=%s time=%.3f sent=%"PRIu64" delivered=%"PRIu64" dup=%"PRIu64" loss_pct=%.2f "
+           "lat_avg_ms=%.3f lat_p50_ms=%.1f lat_p99_ms=%.1f lat_max_ms=%.3f hops=%.2f "
+           "udp_ipframe=%"PRIu64" udp_node=%"PRIu64" udp_bytes=%"PRIu64" "
+           "drop_link=%"PRIu64" drop_queue=%"PRIu64" drop_nat=%"PRIu64" drop_down=%"PRIu64" drop_noaddr=%"PRIu64" p2p_pct=%.1f\n",
+           type, (double)(sim_now_usec - SIM_EPOCH_SEC * 1000000) / 1000000,
+           stats->sent, stats->delivered, stats->dup,
+           0 == stats->sent ? 0 : (double)(stats->sent > stats->delivered ? stats->sent - stats->delivered : 0) * 100 / stats->sent,
+           0 == stats->delivered ? 0 : (double)stats->latency_sum_usec / stats->delivered / 1000,
+           sim_latency_percentile_ms(stats, 0.5), sim_latency_percentile_ms(stats, 0.99),
+           (double)stats->latency_max_usec / 1000,
+           0 == stats->delivered ? 0 : (double)stats->udp_ipframe / stats->delivered,
+           stats->udp_ipframe, stats->udp_node, stats->udp_bytes,
+           stats->drop_link, stats->drop_queue, stats->drop_nat, stats->drop_down, stats->drop_noaddr,
+           sim_p2p_percent());
+}
+
+static void sim_stats_reset(sim_stats_t *stats) {
+    uint32_t *latency_buckets = stats->latency_buckets;
+    memset(stats, 0, sizeof(sim_stats_t));
+    stats->latency_buckets = latency_buckets;
+    memset(latency_buckets, 0, sizeof(uint32_t) * SIM_LATENCY_BUCKET_NUM);
+}
+
+static void sim_set_link(int src_idx, int dst_idx, double latency_ms, double jitter_ms, double loss_pct, uint32_t bandwidth_kbps) {
+    sim_link_t *link = &sim_links[src_idx * sim_node_num + dst_idx];
+    link->latency_usec   = (uint32_t)(latency_ms * 1000);
+    link->jitter_usec    = (uint32_t)(jitter_ms * 1000);
+    link->loss_ppm       = (uint32_t)(loss_pct * 10000);
+    link->bandwidth_kbps = bandwidth_kbps;
+}
+
+/*
+ 每行一条链路, 同时设置两个方向
+ src_uuid|dst_uuid|latency_ms|jitter_ms|loss_pct|bandwidth_kbps
+*/
+static int sim_load_link_file(const char *link_file) {
+    FILE *file;
+    char line_buffer[1024];
+    unsigned long long src_uuid64;
+    unsigned long long dst_uuid64;
+    double latency_ms;
+    double jitter_ms;
+    double loss_pct;
+    unsigned int bandwidth_kbps;
+    int src_idx;
+    int dst_idx;
+    int num;
+    file = fopen(link_file, "r");
+    if ( NULL == file ) {
+        printf("open link file '%s' error\n", link_file);
+        return -1;
+    }
+    while ( NULL != fgets(line_buffer, sizeof(line_buffer), file) ) {
+        if ( '#' == line_buffer[0] ) {
+            continue;
+        }
+        num = sscanf(line_buffer, "%llu|%llu|%lf|%lf|%lf|%u", &src_uuid64, &dst_uuid64, &latency_ms, &jitter_ms, &loss_pct, &bandwidth_kbps);
+        if ( 6 != num ) {
+            continue;
+        }
+        src_idx = (int)(src_uuid64 - SIM_BASE_UUID);
+        dst_idx = (int)(dst_uuid64 - SIM_BASE_UUID);
+        if ( src_uuid64 < SIM_BASE_UUID || dst_uuid64 < SIM_BASE_UUID || src_idx >= sim_node_num || dst_idx >= sim_node_num ) {
+            continue;
+        }
+        sim_set_link(src_idx, dst_idx, latency_ms, jitter_ms, loss_pct, bandwidth_kbps);
+        sim_set_link(dst_idx, src_idx, latency_ms, jitter_ms, loss_pct, bandwidth_kbps);
+    }
+    fclose(file);
+    return 0;
+}
+
+static int sim_parse_nat_type(const char *string) {
+    if ( !strncmp(string, "cone", 16) ) {
+        return SIM_NAT_CONE;
+    }
+    if ( !strncmp(string, "restricted", 16) ) {
+        return SIM_NAT_RESTRICTED;
+    }
+    if ( !strncmp(string, "port-restricted", 16) ) {
+        return SIM_NAT_PORT_RESTRICTED;
+    }
+    if ( !strncmp(string, "symmetric", 16) ) {
+        return SIM_NAT_SYMMETRIC;
+    }
+    return -1;
+}
+
+static void show_useage(int argc,char *argv[]) {
+    printf("usage: %s [options] [-- gnb options for every node]\n", argv[0]);
+    printf("  -N, --nodes            number of nodes, node uuid is %d..%d+N-1, max %d, default 16\n", SIM_BASE_UUID, SIM_BASE_UUID, SIM_MAX_NODE);
+    printf("  -t, --time             simulated seconds, default 60\n");
+    printf("  -s, --seed             random seed, default 1\n");
+    printf("  -i, --interval         seconds between interval reports, 0 only report the total, default 10\n");
+    printf("      --latency          one way latency of every link in milliseconds, default 20\n");
+    printf("      --latency-spread   add a random 0..N milliseconds to the latency of every node pair, default 0\n");
+    printf("      --jitter           latency varies by +/- N milliseconds for every packet, default 0\n");
+    printf("      --loss             packet loss percent of every link, default 0\n");
+    printf("      --bandwidth        bandwidth of every link in kbit/s, 0 is unlimited, default 0\n");
+    printf("      --link-file        per link settings, one 'src_uuid|dst_uuid|latency_ms|jitter_ms|loss_pct|bandwidth_kbps' per line\n");
+    printf("      --fwd-num          the first N nodes are forward nodes of all nodes, default 0\n");
+    printf("      --nat-num          the last N nodes are behind NAT, default 0\n");
+    printf("      --nat-type         'cone' 'restricted' 'port-restricted' 'symmetric', default 'port-restricted'\n");
+    printf("      --down             'uuid:down_sec[:up_sec]' take a node offline, can be repeated\n");
+    printf("      --flows            number of flows between random node pairs, default the number of nodes\n");
+    printf("      --pps              packets per second of every flow, default 10\n");
+    printf("      --size             ip packet size of the flows, default 256\n");
+    printf("      --start            seconds before the flows start, default 5\n");
+    printf("  -h, --help\n");
+    printf("example: %s -N 100 --fwd-num 2 --nat-num 60 --nat-type symmetric -t 120 -- --unified-forwarding force\n", argv[0]);
+}
+
+int main (int argc,char *argv[]) {
+
+    #define SIM_OPT_LATENCY          (0x100 + 1)
+    #define SIM_OPT_LATENCY_SPREAD   (0x100 + 2)
+    #define SIM_OPT_JITTER           (0x100 + 3)
+    #define SIM_OPT_LOSS             (0x100 + 4)
+    #define SIM_OPT_BANDWIDTH        (0x100 + 5)
+    #define SIM_OPT_LINK_FILE        (0x100 + 6)
+    #define SIM_OPT_FWD_NUM          (0x100 + 7)
+    #define SIM_OPT_NAT_NUM          (0x100 + 8)
+    #define SIM_OPT_NAT_TYPE         (0x100 + 9)
+    #define SIM_OPT_DOWN             (0x100 + 10)
+    #define SIM_OPT_FLOWS            (0x100 + 11)
+    #define SIM_OPT_PPS              (0x100 + 12)
+    #define SIM_OPT_SIZE             (0x100 + 13)
+    #define SIM_OPT_START            (0x100 + 14)
+
+    static struct option long_options[] = {
+      { "nodes",          required_argument, 0, 'N' },
+      { "time",           required_argument, 0, 't' },
+      { "seed",           required_argument, 0, 's' },
+      { "interval",       required_argument, 0, 'i' },
+      { "latency",        required_argument, 0, SIM_OPT_LATENCY },
+      { "latency-spread", required_argument, 0, SIM_OPT_LATENCY_SPREAD },
+      { "jitter",         required_argument, 0, SIM_OPT_JITTER },
+      { "loss",           required_argument, 0, SIM_OPT_LOSS },
+      { "bandwidth",      required_argument, 0, SIM_OPT_BANDWIDTH },
+      { "link-file",      required_argument, 0, SIM_OPT_LINK_FILE },
+      { "fwd-num",        required_argument, 0, SIM_OPT_FWD_NUM },
+      { "nat-num",        required_argument, 0, SIM_OPT_NAT_NUM },
+      { "nat-type",       required_argument, 0, SIM_OPT_NAT_TYPE },
+      { "down",           required_argument, 0, SIM_OPT_DOWN },
+      { "flows",          required_argument, 0, SIM_OPT_FLOWS },
+      { "pps",            required_argument, 0, SIM_OPT_PPS },
+      { "size",           required_argument, 0, SIM_OPT_SIZE },
+      { "start",          required_argument, 0, SIM_OPT_START },
+      { "help",           no_argument,       0, 'h' },
+      { 0, 0, 0, 0 }
+    };
+
+    uint64_t sim_sec = 60;
+    uint64_t seed = 1;
+    uint64_t interval_sec = 10;
+    double latency_ms = 20;
+    double latency_spread_ms = 0;
+    double jitter_ms = 0;
+    double loss_pct = 0;
+    uint32_t bandwidth_kbps = 0;
+    const char *link_file = NULL;
+    int fwd_num = 0;
+    int nat_num = 0;
+    int nat_type = SIM_NAT_PORT_RESTRICTED;
+    uint32_t pps = 10;
+    size_t packet_size = 256;
+    uint64_t start_sec = 5;
+    unsigned long long down_uuid64;
+    unsigned long long down_sec;
+    unsigned long long up_sec;
+    char *route_string;
+    char *address_string;
+    size_t string_size;
+    size_t len;
+    char addr_string[INET_ADDRSTRLEN];
+    uint64_t end_usec;
+    uint64_t flow_interval_usec;
+    sim_event_t event;
+    sim_node_t *node;
+    int extra_argc;
+    char **extra_argv;
+    int opt;
+    int num;
+    int i;
+    int j;
+
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    while (1) {
+        int option_index = 0;
+        opt = getopt_long (argc, argv, "N:t:s:i:h",long_options, &option_index);
+        if ( -1 == opt ) {
+            break;
+        }
+        switch (opt) {
+        case 'N':
+            sim_node_num = (int)strtoul(optarg, NULL, 10);
+            break;
+        case 't':
+            sim_sec = (uint64_t)strtoull(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = (uint64_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'i':
+            interval_sec = (uint64_t)strtoull(optarg, NULL, 10);
+            break;
+        case SIM_OPT_LATENCY:
+            latency_ms = strtod(optarg, NULL);
+            break;
+        case SIM_OPT_LATENCY_SPREAD:
+            latency_spread_ms = strtod(optarg, NULL);
+            break;
+        case SIM_OPT_JITTER:
+            jitter_ms = strtod(optarg, NULL);
+            break;
+        case SIM_OPT_LOSS:
+            loss_pct = strtod(optarg, NULL);
+            break;
+        case SIM_OPT_BANDWIDTH:
+            bandwidth_kbps = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_LINK_FILE:
+            link_file = optarg;
+            break;
+        case SIM_OPT_FWD_NUM:
+            fwd_num = (int)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_NAT_NUM:
+            nat_num = (int)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_NAT_TYPE:
+            nat_type = sim_parse_nat_type(optarg);
+            if ( -1 == nat_type ) {
+                printf("unknown nat type '%s'\n", optarg);
+                exit(1);
+            }
+            break;
+        case SIM_OPT_DOWN:
+            up_sec = 0;
+            num = sscanf(optarg, "%llu:%llu:%llu", &down_uuid64, &down_sec, &up_sec);
+            if ( num < 2 || SIM_MAX_DOWN == sim_down_num ) {
+                printf("invalid down '%s'\n", optarg);
+                exit(1);
+            }
+            sim_downs[sim_down_num].uuid64 = (gnb_uuid_t)down_uuid64;
+            sim_downs[sim_down_num].down_sec = down_sec;
+            sim_downs[sim_down_num].up_sec = up_sec;
+            sim_down_num++;
+            break;
+        case SIM_OPT_FLOWS:
+            sim_flow_num = (int)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_PPS:
+            pps = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_SIZE:
+            packet_size = (size_t)strtoul(optarg, NULL, 10);
+            break;
+        case SIM_OPT_START:
+            start_sec = (uint64_t)strtoull(optarg, NULL, 10);
+            break;
+        case 'h':
+        default:
+            show_useage(argc, argv);
+            exit(0);
+        }
+    }
+
+    if ( sim_node_num < 2 || sim_node_num > SIM_MAX_NODE ) {
+        printf("nodes must be 2..%d\n", SIM_MAX_NODE);
+        exit(1);
+    }
+    if ( fwd_num + nat_num > sim_node_num ) {
+        printf("fwd-num + nat-num must not exceed nodes\n");
+        exit(1);
+    }
+    if ( packet_size < sizeof(struct iphdr) + sizeof(struct udphdr) + sizeof(sim_probe_t) || packet_size > SIM_MTU ) {
+        printf("size must be %zu..%d\n", sizeof(struct iphdr) + sizeof(struct udphdr) + sizeof(sim_probe_t), SIM_MTU);
+        exit(1);
+    }
+    //sim_create_node 解析每个节点的参数时会重置 optind, 先保存 "--" 之后的参数
+    extra_argc = argc - optind;
+    extra_argv = argv + optind;
+    if ( -1 == sim_flow_num ) {
+        sim_flow_num = sim_node_num;
+    }
+    if ( 0 == pps ) {
+        sim_flow_num = 0;
+        pps = 1;
+    }
+    if ( 0 == seed ) {
+        seed = 1;
+    }
+    sim_rand_state = seed;
+
+    sim_nodes = (sim_node_t *)calloc(sim_node_num, sizeof(sim_node_t));
+    sim_links = (sim_link_t *)calloc((size_t)sim_node_num * sim_node_num, sizeof(sim_link_t));
+    sim_window_stats.latency_buckets = (uint32_t *)calloc(SIM_LATENCY_BUCKET_NUM, sizeof(uint32_t));
+    sim_total_stats.latency_buckets  = (uint32_t *)calloc(SIM_LATENCY_BUCKET_NUM, sizeof(uint32_t));
+
+    for ( i=0; i<sim_node_num; i++ ) {
+        node = &sim_nodes[i];
+        node->idx = i;
+        node->uuid64 = SIM_BASE_UUID + i;
+        if ( i >= sim_node_num - nat_num ) {
+            node->nat_type = nat_type;
+            node->addr4 = sim_idx_to_addr4(192, 168, i);
+            node->ext_addr4 = sim_idx_to_addr4(100, 65, i);
+            node->next_ext_port = SIM_NAT_PORT_BASE;
+            node->nat_entries = (sim_nat_entry_t *)calloc(SIM_NAT_ENTRY_MAX, sizeof(sim_nat_entry_t));
+        } else {
+            node->nat_type = SIM_NAT_NONE;
+            node->addr4 = sim_idx_to_addr4(100, 64, i);
+        }
+    }
+
+    for ( i=0; i<sim_node_num; i++ ) {
+        for ( j=i+1; j<sim_node_num; j++ ) {
+            double pair_latency_ms = latency_ms;
+            if ( latency_spread_ms > 0 ) {
+                pair_latency_ms += (double)(sim_rand() % ((uint64_t)(latency_spread_ms * 1000) + 1)) / 1000;
+            }
+            sim_set_link(i, j, pair_latency_ms, jitter_ms, loss_pct, bandwidth_kbps);
+            sim_set_link(j, i, pair_latency_ms, jitter_ms, loss_pct, bandwidth_kbps);
+        }
+    }
+    if ( NULL != link_file && 0 != sim_load_link_file(link_file) ) {
+        exit(1);
+    }
+
+    //所有节点使用相同的 route 和 address, nat 后面的节点没有公网地址, 只能由它们先发出 ping 建立连接
+    string_size = (size_t)sim_node_num * 64;
+    route_string = (char *)malloc(string_size);
+    address_string = (char *)malloc(string_size);
+    route_string[0] = '\0';
+    address_string[0] = '\0';
+    for ( i=0; i<sim_node_num; i++ ) {
+        node = &sim_nodes[i];
+        len = strlen(route_string);
+        inet_ntop(AF_INET, &(uint32_t){ sim_idx_to_addr4(10, 1, i) }, addr_string, INET_ADDRSTRLEN);
+        snprintf(route_string + len, string_size - len, "%s%llu|%s|255.255.0.0", 0 == i ? "":",", (unsigned long long)node->uuid64, addr_string);
+        if ( SIM_NAT_NONE != node->nat_type ) {
+            continue;
+        }
+        len = strlen(address_string);
+        inet_ntop(AF_INET, &node->addr4, addr_string, INET_ADDRSTRLEN);
+        snprintf(address_string + len, string_size - len, "%s%s|%llu|%s|%u", '\0' == address_string[0] ? "":",", i < fwd_num ? "f":"n",
+                 (unsigned long long)node->uuid64, addr_string, SIM_UDP_PORT);
+    }
+
+    for ( i=0; i<sim_node_num; i++ ) {
+        if ( 0 != sim_create_node(&sim_nodes[i], route_string, address_string, extra_argc, extra_argv) ) {
+            printf("gnb core %llu create error!\n", (unsigned long long)sim_nodes[i].uuid64);
+            goto finish;
+        }
+    }
+
+    printf("type=conf nodes=%d fwd_num=%d nat_num=%d nat_type=%d flows=%d pps=%u size=%zu time=%"PRIu64" seed=%"PRIu64"\n",
+           sim_node_num, fwd_num, nat_num, 0 == nat_num ? SIM_NAT_NONE : nat_type, sim_flow_num, pps, packet_size, sim_sec, seed);
+
+    sim_now_usec = SIM_EPOCH_SEC * 1000000;
+    end_usec = sim_now_usec + sim_sec * 1000000;
+
+    //node worker 的循环错开执行
+    for ( i=0; i<sim_node_num; i++ ) {
+        sim_event_push(sim_now_usec + (uint64_t)i * SIM_NODE_POLL_USEC / sim_node_num, SIM_EVENT_NODE_POLL, i, NULL);
+    }
+
+    flow_interval_usec = 1000000 / pps;
+    sim_flows = (sim_flow_t *)calloc(sim_flow_num > 0 ? sim_flow_num : 1, sizeof(sim_flow_t));
+    for ( i=0; i<sim_flow_num; i++ ) {
+        sim_flows[i].src_idx = (int)(sim_rand() % sim_node_num);
+        sim_flows[i].dst_idx = (int)(sim_rand() % (sim_node_num - 1));
+        if ( sim_flows[i].dst_idx >= sim_flows[i].src_idx ) {
+            sim_flows[i].dst_idx++;
+        }
+        sim_flows[i].seq_num = (uint32_t)((sim_sec > start_sec ? sim_sec - start_sec : 0) * pps + 1);
+        sim_flows[i].seq_bitmap = (uint8_t *)calloc(sim_flows[i].seq_num / 8 + 1, 1);
+        sim_event_push(sim_now_usec + start_sec * 1000000 + sim_rand() % flow_interval_usec, SIM_EVENT_FLOW, i, NULL);
+    }
+
+    for ( i=0; i<sim_down_num; i++ ) {
+        if ( sim_downs[i].uuid64 < SIM_BASE_UUID || sim_downs[i].uuid64 - SIM_BASE_UUID >= (gnb_uuid_t)sim_node_num ) {
+            continue;
+        }
+        j = (int)(sim_downs[i].uuid64 - SIM_BASE_UUID);
+        sim_event_push(sim_now_usec + sim_downs[i].down_sec * 1000000, SIM_EVENT_NODE_DOWN, j, NULL);
+        if ( sim_downs[i].up_sec > sim_downs[i].down_sec ) {
+            sim_event_push(sim_now_usec + sim_downs[i].up_sec * 1000000, SIM_EVENT_NODE_UP, j, NULL);
+        }
+    }
+
+    if ( 0 != interval_sec ) {
+        sim_event_push(sim_now_usec + interval_sec * 1000000, SIM_EVENT_REPORT, 0, NULL);
+    }
+
+    while ( 0 == sim_event_pop(&event) ) {
+        if ( event.ts_usec > end_usec ) {
+            if ( SIM_EVENT_UDP == event.type ) {
+                free(event.data);
+            }
+            continue;
+        }
+        sim_now_usec = event.ts_usec;
+        node = &sim_nodes[event.idx];
+        switch ( event.type ) {
+        case SIM_EVENT_UDP:
+            sim_handle_udp(node, (sim_datagram_t *)event.data);
+            free(event.data);
+            break;
+        case SIM_EVENT_NODE_POLL:
+            if ( !node->down && NULL != node->gnb_core->node_worker ) {
+                sim_set_core_time(node->gnb_core);
+                gnb_node_worker_poll(node->gnb_core->node_worker, sim_now_usec);
+                sim_update_peer_sockets(node);
+            }
+            sim_event_push(sim_now_usec + SIM_NODE_POLL_USEC, SIM_EVENT_NODE_POLL, event.idx, NULL);
+            break;
+        case SIM_EVENT_FLOW:
+            sim_flow_send(event.idx, packet_size);
+            sim_event_push(sim_now_usec + flow_interval_usec, SIM_EVENT_FLOW, event.idx, NULL);
+            break;
+        case SIM_EVENT_NODE_DOWN:
+            node->down = 1;
+            break;
+        case SIM_EVENT_NODE_UP:
+            node->down = 0;
+            break;
+        case SIM_EVENT_REPORT:
+            sim_report("interval", &sim_window_stats);
+            sim_stats_reset(&sim_window_stats);
+            sim_event_push(sim_now_usec + interval_sec * 1000000, SIM_EVENT_REPORT, 0, NULL);
+            break;
+        default:
+            break;
+        }
+    }
+
+    sim_now_usec = end_usec;
+    sim_report("total", &sim_total_stats);
+
+finish:
+    for ( i=0; i<sim_node_num; i++ ) {
+        if ( '\0' != sim_nodes[i].map_file[0] ) {
+            unlink(sim_nodes[i].map_file);
+        }
+    }
+    return 0;
+
+}
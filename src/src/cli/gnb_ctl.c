@@ -35,6 +35,12 @@
 
 void gnb_ctl_dump_status(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8_t online_opt);
 void gnb_ctl_dump_address_list(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8_t online_opt);
+void gnb_ctl_dump_latency(gnb_ctl_block_t *ctl_block);
+void gnb_ctl_dump_drops(gnb_ctl_block_t *ctl_block);
+void gnb_ctl_dump_flight(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid);
+int  gnb_ctl_metrics_format(const char *format_string);
+void gnb_ctl_dump_metrics(gnb_ctl_block_t *ctl_block, int format, gnb_uuid_t in_nodeid, uint8_t online_opt);
+int  gnb_ctl_metrics_http_serve(gnb_ctl_block_t *ctl_block, const char *listen_string, gnb_uuid_t in_nodeid, uint8_t online_opt);
 
 static void show_useage(int argc,char *argv[]) {
     printf("GNB Ctl\n");
@@ -51,10 +57,17 @@ static void show_useage(int argc,char *argv[]) {
     printf("  -s, --status              dunmp node status\n");
     printf("  -o, --online              dunmp online node\n");
     printf("  -n, --node                node id\n");
+    printf("  -l, --latency             dunmp per stage latency p50/p99/p999\n");
+    printf("  -d, --drops               dunmp drop counters, queue high watermark and pf status\n");
+    printf("  -f, --flight              dunmp recent packets in the flight recorder of each worker\n");
+    printf("  -m, --metrics             dunmp metrics, \"json\" for json lines or \"prometheus\" for prometheus text format\n");
+    printf("  -L, --metrics-listen      serve metrics over http on [ipv4:]port, GET /metrics or /metrics.json\n");
     printf("      --help\n");
 
     printf("example:\n");
     printf("%s -b gnb.map -c -s\n",argv[0]);
+    printf("%s -b gnb.map -m prometheus\n",argv[0]);
+    printf("%s -b gnb.map -L 127.0.0.1:9100\n",argv[0]);
 }
 
 int main (int argc,char *argv[]) {
@@ -65,6 +78,11 @@ int main (int argc,char *argv[]) {
     uint8_t  core_opt         = 0;
     uint8_t  node_status_opt  = 0;
     uint8_t  online_opt       = 0;
+    uint8_t  latency_opt      = 0;
+    uint8_t  drops_opt        = 0;
+    uint8_t  flight_opt       = 0;
+    int      metrics_format   = -1;
+    char    *metrics_listen   = NULL;
     gnb_uuid_t nodeid = 0;
 
     static struct option long_options[] = {
@@ -74,6 +92,11 @@ int main (int argc,char *argv[]) {
       { "status",               no_argument,       0, 's' },
       { "address",              no_argument,       0, 'a' },
       { "online",               no_argument,       0, 'o' },
+      { "latency",              no_argument,       0, 'l' },
+      { "drops",                no_argument,       0, 'd' },
+      { "flight",               no_argument,       0, 'f' },
+      { "metrics",              required_argument, 0, 'm' },
+      { "metrics-listen",       required_argument, 0, 'L' },
       { "help",                 no_argument,       0, 'h' },
       { 0, 0, 0, 0 }
     };
@@ -82,7 +105,7 @@ int main (int argc,char *argv[]) {
     int opt;
     while (1) {
         int option_index = 0;
-        opt = getopt_long (argc, argv, "b:n:csaoh",long_options, &option_index);
+        opt = getopt_long (argc, argv, "b:n:m:L:csaoldfh",long_options, &option_index);
         if ( opt == -1 ) {
             break;
         }
@@ -105,6 +128,25 @@ int main (int argc,char *argv[]) {
         case 'o':
             online_opt = 1;
             break;
+        case 'l':
+            latency_opt = 1;
+            break;
+        case 'd':
+            drops_opt = 1;
+            break;
+        case 'f':
+            flight_opt = 1;
+            break;
+        case 'm':
+            metrics_format = gnb_ctl_metrics_format(optarg);
+            if ( -1 == metrics_format ) {
+                printf("invalid metrics format [%s]\n", optarg);
+                exit(1);
+            }
+            break;
+        case 'L':
+            metrics_listen = optarg;
+            break;
         case 'h':
             show_useage(argc,argv);
             exit(0);
@@ -137,6 +179,21 @@ int main (int argc,char *argv[]) {
     if ( address_opt ) {
         gnb_ctl_dump_address_list(ctl_block, nodeid, online_opt);
     }
+    if ( latency_opt ) {
+        gnb_ctl_dump_latency(ctl_block);
+    }
+    if ( drops_opt ) {
+        gnb_ctl_dump_drops(ctl_block);
+    }
+    if ( flight_opt ) {
+        gnb_ctl_dump_flight(ctl_block, nodeid);
+    }
+    if ( -1 != metrics_format ) {
+        gnb_ctl_dump_metrics(ctl_block, metrics_format, nodeid, online_opt);
+    }
+    if ( NULL != metrics_listen ) {
+        gnb_ctl_metrics_http_serve(ctl_block, metrics_listen, nodeid, online_opt);
+    }
 
 #ifdef _WIN32
     WSACleanup();
@@ -0,0 +1,424 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "compress/lz4/lz4.h"
+#include "gnb_version.h"
+
+/*
+ 从 pcap 文件中取出 ip 分组作为样本, 训练 gnb_pf_lz4 使用的字典
+
+ 样本中出现次数最多的 8 字节片段(dmer)认为是最值得放入字典的内容,
+ 把全部样本分成若干段, 每段中选出包含的 dmer 出现次数之和最大的 segment 放入字典,
+ 一个 dmer 被选入字典之后不再计分, 避免相同的内容在字典中重复出现,
+ 得分越高的 segment 放在字典越靠后的位置, lz4 的 hash table 中字典尾部的位置优先保留
+
+ pcap 文件可以在 gnb 的 tun 网卡上抓包得到, 例如 tcpdump -i gnb_tun -w sample.pcap
+*/
+
+#define GNB_ZIP_DICT_DMER             8
+#define GNB_ZIP_DICT_HASH_LOG         22
+#define GNB_ZIP_DICT_DEFAULT_SIZE     16384
+#define GNB_ZIP_DICT_DEFAULT_SEGMENT  64
+#define GNB_ZIP_DICT_MAX_SAMPLE_BYTES (256*1024*1024)
+#define GNB_ZIP_DICT_MAX_PACKET       65535
+
+#define PCAP_LINKTYPE_NULL       0
+#define PCAP_LINKTYPE_ETHERNET   1
+#define PCAP_LINKTYPE_RAW        101
+#define PCAP_LINKTYPE_LINUX_SLL  113
+#define PCAP_LINKTYPE_IPV4       228
+#define PCAP_LINKTYPE_IPV6       229
+#define PCAP_LINKTYPE_LINUX_SLL2 276
+
+typedef struct _zip_dict_samples_t {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    size_t *offsets;
+    size_t num;
+    size_t offsets_capacity;
+} zip_dict_samples_t;
+
+typedef struct _zip_dict_segment_t {
+    size_t offset;
+    uint64_t score;
+} zip_dict_segment_t;
+
+static void show_useage(int argc,char *argv[]) {
+    printf("%s\n", GNB_BUILD_STRING);
+    printf("usage: %s -o dict_file [-s dict_size] [-k segment_size] pcap_file ...\n",argv[0]);
+    printf("example:\n");
+    printf("%s -o zip.dict -s 16384 sample.pcap\n",argv[0]);
+}
+
+static uint32_t read_u32(const unsigned char *p, int swap) {
+    if ( swap ) {
+        return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+    }
+    return ((uint32_t)p[3] << 24) | ((uint32_t)p[2] << 16) | ((uint32_t)p[1] << 8) | p[0];
+}
+
+static void samples_add(zip_dict_samples_t *samples, const unsigned char *packet, size_t size) {
+    if ( 0 == size || samples->size + size > GNB_ZIP_DICT_MAX_SAMPLE_BYTES ) {
+        return;
+    }
+    if ( samples->size + size > samples->capacity ) {
+        samples->capacity = (samples->capacity + size) * 2;
+        samples->data = realloc(samples->data, samples->capacity);
+    }
+    if ( samples->num == samples->offsets_capacity ) {
+        samples->offsets_capacity = (samples->offsets_capacity + 1024) * 2;
+        samples->offsets = realloc(samples->offsets, sizeof(size_t) * (samples->offsets_capacity + 1));
+    }
+    if ( NULL == samples->data || NULL == samples->offsets ) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+    memcpy(samples->data + samples->size, packet, size);
+    samples->offsets[samples->num++] = samples->size;
+    samples->size += size;
+    samples->offsets[samples->num] = samples->size;
+}
+
+//返回 link header 的长度, 不支持的 linktype 返回 -1
+static int pcap_link_header_size(uint32_t linktype) {
+    switch (linktype) {
+    case PCAP_LINKTYPE_NULL:
+        return 4;
+    case PCAP_LINKTYPE_ETHERNET:
+        return 14;
+    case PCAP_LINKTYPE_RAW:
+    case PCAP_LINKTYPE_IPV4:
+    case PCAP_LINKTYPE_IPV6:
+        return 0;
+    case PCAP_LINKTYPE_LINUX_SLL:
+        return 16;
+    case PCAP_LINKTYPE_LINUX_SLL2:
+        return 20;
+    default:
+        return -1;
+    }
+}
+
+static int load_pcap(zip_dict_samples_t *samples, const char *pcap_file) {
+    unsigned char header[24];
+    unsigned char record[16];
+    unsigned char *packet;
+    uint32_t magic;
+    uint32_t caplen;
+    int swap;
+    int link_header_size;
+    size_t num = 0;
+    FILE *fp = fopen(pcap_file, "rb");
+    if ( NULL == fp ) {
+        perror(pcap_file);
+        return -1;
+    }
+    if ( 1 != fread(header, sizeof(header), 1, fp) ) {
+        fprintf(stderr, "%s: not a pcap file\n", pcap_file);
+        fclose(fp);
+        return -1;
+    }
+    magic = read_u32(header, 0);
+    if ( 0xa1b2c3d4 == magic || 0xa1b23c4d == magic ) {
+        swap = 0;
+    } else if ( 0xd4c3b2a1 == magic || 0x4d3cb2a1 == magic ) {
+        swap = 1;
+    } else {
+        fprintf(stderr, "%s: not a pcap file\n", pcap_file);
+        fclose(fp);
+        return -1;
+    }
+    link_header_size = pcap_link_header_size(read_u32(header + 20, swap) & 0xffff);
+    if ( link_header_size < 0 ) {
+        fprintf(stderr, "%s: unsupported linktype %u\n", pcap_file, read_u32(header + 20, swap) & 0xffff);
+        fclose(fp);
+        return -1;
+    }
+    packet = malloc(GNB_ZIP_DICT_MAX_PACKET);
+    while ( 1 == fread(record, sizeof(record), 1, fp) ) {
+        caplen = read_u32(record + 8, swap);
+        if ( caplen > GNB_ZIP_DICT_MAX_PACKET ) {
+            fprintf(stderr, "%s: bad record length %u\n", pcap_file, caplen);
+            break;
+        }
+        if ( caplen != fread(packet, 1, caplen, fp) ) {
+            break;
+        }
+        if ( caplen <= (uint32_t)link_header_size ) {
+            continue;
+        }
+        samples_add(samples, packet + link_header_size, caplen - link_header_size);
+        num++;
+    }
+    free(packet);
+    fclose(fp);
+    printf("%s: %zu packets\n", pcap_file, num);
+    return 0;
+}
+
+static inline uint32_t dmer_hash(const unsigned char *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return (uint32_t)((v * 0x9E3779B185EBCA87ULL) >> (64 - GNB_ZIP_DICT_HASH_LOG));
+}
+
+static int segment_cmp(const void *a, const void *b) {
+    const zip_dict_segment_t *sa = a;
+    const zip_dict_segment_t *sb = b;
+    if ( sa->score == sb->score ) {
+        return 0;
+    }
+    return sa->score < sb->score ? -1 : 1;
+}
+
+/*
+ 返回写入 dict 的长度
+*/
+static size_t train(zip_dict_samples_t *samples, unsigned char *dict, size_t dict_capacity, size_t segment_size) {
+    uint32_t *freq;
+    uint32_t *last_sample;
+    uint16_t *in_window;
+    zip_dict_segment_t *segments;
+    size_t segments_num = 0;
+    size_t epochs;
+    size_t epoch_size;
+    size_t epoch;
+    size_t begin;
+    size_t end;
+    size_t i;
+    size_t j;
+    size_t s;
+    size_t dict_size = 0;
+    uint32_t h;
+    uint64_t score;
+    zip_dict_segment_t best;
+
+    freq        = calloc(1 << GNB_ZIP_DICT_HASH_LOG, sizeof(uint32_t));
+    last_sample = calloc(1 << GNB_ZIP_DICT_HASH_LOG, sizeof(uint32_t));
+    in_window   = calloc(1 << GNB_ZIP_DICT_HASH_LOG, sizeof(uint16_t));
+    if ( NULL == freq || NULL == last_sample || NULL == in_window ) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    //统计每个 dmer 出现在多少个样本中
+    for ( s=0; s<samples->num; s++ ) {
+        for ( i=samples->offsets[s]; i + GNB_ZIP_DICT_DMER <= samples->offsets[s+1]; i++ ) {
+            h = dmer_hash(samples->data + i);
+            if ( last_sample[h] != s + 1 ) {
+                last_sample[h] = (uint32_t)(s + 1);
+                freq[h]++;
+            }
+        }
+    }
+
+    epochs = dict_capacity / segment_size;
+    if ( epochs > samples->size / segment_size ) {
+        epochs = samples->size / segment_size;
+    }
+    if ( 0 == epochs ) {
+        goto finish;
+    }
+    epoch_size = samples->size / epochs;
+    segments = calloc(epochs, sizeof(zip_dict_segment_t));
+
+    for ( epoch=0; epoch<epochs; epoch++ ) {
+        begin = epoch * epoch_size;
+        end   = begin + epoch_size;
+        if ( end + GNB_ZIP_DICT_DMER > samples->size ) {
+            end = samples->size - GNB_ZIP_DICT_DMER + 1;
+        }
+        best.offset = begin;
+        best.score  = 0;
+        score = 0;
+        //滑动窗口, 窗口内重复出现的 dmer 只计一次分
+        for ( i=begin; i<end; i++ ) {
+            h = dmer_hash(samples->data + i);
+            if ( 0 == in_window[h]++ ) {
+                score += freq[h];
+            }
+            if ( i >= begin + segment_size - GNB_ZIP_DICT_DMER + 1 ) {
+                j = i - (segment_size - GNB_ZIP_DICT_DMER + 1);
+                h = dmer_hash(samples->data + j);
+                if ( 0 == --in_window[h] ) {
+                    score -= freq[h];
+                }
+            }
+            if ( i + 1 >= begin + segment_size - GNB_ZIP_DICT_DMER + 1 && score > best.score ) {
+                best.offset = i + GNB_ZIP_DICT_DMER - segment_size;
+                best.score  = score;
+            }
+        }
+        //清空窗口
+        j = end > begin + segment_size - GNB_ZIP_DICT_DMER + 1 ? end - (segment_size - GNB_ZIP_DICT_DMER + 1) : begin;
+        for ( ; j<end; j++ ) {
+            in_window[dmer_hash(samples->data + j)] = 0;
+        }
+        //只出现在一个样本中的内容放入字典没有意义
+        if ( best.score <= segment_size - GNB_ZIP_DICT_DMER + 1 ) {
+            continue;
+        }
+        for ( i=best.offset; i + GNB_ZIP_DICT_DMER <= best.offset + segment_size; i++ ) {
+            freq[dmer_hash(samples->data + i)] = 0;
+        }
+        segments[segments_num++] = best;
+    }
+
+    qsort(segments, segments_num, sizeof(zip_dict_segment_t), segment_cmp);
+    for ( i=0; i<segments_num; i++ ) {
+        memcpy(dict + dict_size, samples->data + segments[i].offset, segment_size);
+        dict_size += segment_size;
+    }
+    free(segments);
+
+finish:
+    free(freq);
+    free(last_sample);
+    free(in_window);
+    return dict_size;
+}
+
+static void evaluate(zip_dict_samples_t *samples, unsigned char *dict, size_t dict_size) {
+    lz4_ctx_t lz4_ctx;
+    lz4_ctx_t dict_lz4_ctx;
+    lz4_ctx_t work_lz4_ctx;
+    unsigned char *buffer = malloc(dict_size + GNB_ZIP_DICT_MAX_PACKET);
+    unsigned char *out = malloc(LZ4_COMPRESS_BOUND(GNB_ZIP_DICT_MAX_PACKET));
+    size_t plain = 0;
+    size_t zipped = 0;
+    size_t dict_zipped = 0;
+    size_t s;
+    int size;
+    lz4_ctx_init(&lz4_ctx);
+    lz4_ctx_load_dict(&dict_lz4_ctx, dict, (int)dict_size);
+    memcpy(buffer, dict, dict_size);
+    for ( s=0; s<samples->num; s++ ) {
+        size = (int)(samples->offsets[s+1] - samples->offsets[s]);
+        plain += size;
+        zipped += lz4_compress(&lz4_ctx, samples->data + samples->offsets[s], size, out, LZ4_COMPRESS_BOUND(size), 1);
+        memcpy(&work_lz4_ctx, &dict_lz4_ctx, sizeof(lz4_ctx_t));
+        memcpy(buffer + dict_size, samples->data + samples->offsets[s], size);
+        dict_zipped += lz4_compress_prefix(&work_lz4_ctx, buffer, (int)dict_size, size, out, LZ4_COMPRESS_BOUND(size), 1);
+    }
+    if ( 0 != plain ) {
+        printf("samples %zu bytes, lz4 %zu bytes (%.1f%%), lz4 with dict %zu bytes (%.1f%%)\n",
+               plain, zipped, 100.0 * zipped / plain, dict_zipped, 100.0 * dict_zipped / plain);
+    }
+    free(buffer);
+    free(out);
+}
+
+int main (int argc,char *argv[]) {
+
+    static struct option long_options[] = {
+      { "output",   required_argument, 0, 'o' },
+      { "size",     required_argument, 0, 's' },
+      { "segment",  required_argument, 0, 'k' },
+      { 0, 0, 0, 0 }
+    };
+
+    int opt;
+    char *dict_file = NULL;
+    size_t dict_capacity = GNB_ZIP_DICT_DEFAULT_SIZE;
+    size_t segment_size  = GNB_ZIP_DICT_DEFAULT_SEGMENT;
+    zip_dict_samples_t samples;
+    unsigned char *dict;
+    size_t dict_size;
+    FILE *fp;
+    int i;
+
+    while (1) {
+        int option_index = 0;
+        opt = getopt_long (argc, argv, "o:s:k:h",long_options, &option_index);
+        if ( -1 == opt ) {
+            break;
+        }
+
+        switch (opt) {
+        case 'o':
+            dict_file = optarg;
+            break;
+        case 's':
+            dict_capacity = strtoul(optarg, NULL, 10);
+            break;
+        case 'k':
+            segment_size = strtoul(optarg, NULL, 10);
+            break;
+        case 'h':
+            break;
+        default:
+            break;
+        }
+    }
+
+    if ( NULL == dict_file || optind >= argc ) {
+        show_useage(argc, argv);
+        exit(0);
+    }
+    if ( dict_capacity > LZ4_DICT_MAX_SIZE ) {
+        dict_capacity = LZ4_DICT_MAX_SIZE;
+    }
+    if ( segment_size < GNB_ZIP_DICT_DMER * 2 ) {
+        segment_size = GNB_ZIP_DICT_DMER * 2;
+    }
+    if ( segment_size > dict_capacity ) {
+        segment_size = dict_capacity;
+    }
+
+    memset(&samples, 0, sizeof(zip_dict_samples_t));
+    for ( i=optind; i<argc; i++ ) {
+        load_pcap(&samples, argv[i]);
+    }
+    if ( 0 == samples.num ) {
+        fprintf(stderr, "no samples\n");
+        exit(1);
+    }
+
+    dict = malloc(dict_capacity);
+    dict_size = train(&samples, dict, dict_capacity, segment_size);
+    if ( 0 == dict_size ) {
+        fprintf(stderr, "samples are too small or have nothing in common\n");
+        exit(1);
+    }
+
+    fp = fopen(dict_file, "wb");
+    if ( NULL == fp ) {
+        perror(dict_file);
+        exit(1);
+    }
+    if ( 1 != fwrite(dict, dict_size, 1, fp) ) {
+        perror(dict_file);
+        exit(1);
+    }
+    fclose(fp);
+    printf("write %s %zu bytes\n", dict_file, dict_size);
+
+    evaluate(&samples, dict, dict_size);
+
+    free(dict);
+    free(samples.data);
+    free(samples.offsets);
+    return 0;
+
+}
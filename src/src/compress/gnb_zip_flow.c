@@ -0,0 +1,130 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "gnb_zip_flow.h"
+
+#define GNB_ZIP_FLOW_SCORE_INIT   64
+#define GNB_ZIP_FLOW_SCORE_MIN    8
+
+#define GNB_ZIP_FLOW_BYPASS_MIN   32
+#define GNB_ZIP_FLOW_BYPASS_MAX   4096
+
+/*
+ 64 个随机字节中不同字节值的期望个数约为 57, 文本和大部分未压缩的协议数据远低于这个数
+*/
+#define GNB_ZIP_FLOW_SAMPLE_SIZE      64
+#define GNB_ZIP_FLOW_SAMPLE_DISTINCT  52
+//太小的 packet 采样会落在首部中
+#define GNB_ZIP_FLOW_SAMPLE_MIN_FRAME 256
+
+static uint64_t zip_flow_hash(uint64_t hash, const unsigned char *data, size_t size) {
+    size_t i;
+    for ( i=0; i<size; i++ ) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static uint64_t zip_flow_key(uint64_t dst_uuid64, const unsigned char *ip_frame, size_t ip_frame_size) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ dst_uuid64;
+    size_t header_size;
+    uint8_t proto;
+    if ( ip_frame_size >= 20 && 0x4 == (ip_frame[0] >> 4) ) {
+        header_size = (ip_frame[0] & 0xf) * 4;
+        proto = ip_frame[9];
+        //src dst addr
+        hash = zip_flow_hash(hash, ip_frame + 12, 8);
+    } else if ( ip_frame_size >= 40 && 0x6 == (ip_frame[0] >> 4) ) {
+        header_size = 40;
+        proto = ip_frame[6];
+        hash = zip_flow_hash(hash, ip_frame + 8, 32);
+    } else {
+        return hash | 1;
+    }
+    hash = zip_flow_hash(hash, &proto, 1);
+    //tcp udp 的 src dst port
+    if ( (6 == proto || 17 == proto) && ip_frame_size >= header_size + 4 ) {
+        hash = zip_flow_hash(hash, ip_frame + header_size, 4);
+    }
+    return hash | 1;
+}
+
+static int zip_flow_high_entropy(const unsigned char *ip_frame, size_t ip_frame_size) {
+    uint64_t seen[4] = {0};
+    const unsigned char *sample;
+    int distinct = 0;
+    int i;
+    if ( ip_frame_size < GNB_ZIP_FLOW_SAMPLE_MIN_FRAME ) {
+        return 0;
+    }
+    sample = ip_frame + ip_frame_size - GNB_ZIP_FLOW_SAMPLE_SIZE;
+    for ( i=0; i<GNB_ZIP_FLOW_SAMPLE_SIZE; i++ ) {
+        if ( !(seen[sample[i] >> 6] & (1ULL << (sample[i] & 63))) ) {
+            seen[sample[i] >> 6] |= 1ULL << (sample[i] & 63);
+            distinct++;
+        }
+    }
+    return distinct >= GNB_ZIP_FLOW_SAMPLE_DISTINCT;
+}
+
+void gnb_zip_flow_table_init(gnb_zip_flow_table_t *table) {
+    memset(table, 0, sizeof(gnb_zip_flow_table_t));
+}
+
+gnb_zip_flow_t* gnb_zip_flow_get(gnb_zip_flow_table_t *table, uint64_t dst_uuid64, const unsigned char *ip_frame, size_t ip_frame_size) {
+    uint64_t key = zip_flow_key(dst_uuid64, ip_frame, ip_frame_size);
+    gnb_zip_flow_t *flow = &table->flows[ (key ^ (key >> 32)) & (GNB_ZIP_FLOW_TABLE_SIZE - 1) ];
+    if ( key != flow->key ) {
+        flow->key        = key;
+        flow->score      = GNB_ZIP_FLOW_SCORE_INIT;
+        flow->bypass_num = 0;
+        flow->backoff    = GNB_ZIP_FLOW_BYPASS_MIN;
+    }
+    if ( flow->bypass_num > 0 ) {
+        flow->bypass_num--;
+        table->bypass_count++;
+        return NULL;
+    }
+    if ( zip_flow_high_entropy(ip_frame, ip_frame_size) ) {
+        gnb_zip_flow_update(flow, ip_frame_size, ip_frame_size);
+        table->entropy_skip_count++;
+        return NULL;
+    }
+    return flow;
+}
+
+void gnb_zip_flow_update(gnb_zip_flow_t *flow, size_t in_size, size_t zipped_size) {
+    uint32_t saved = 0;
+    if ( 0 != in_size && zipped_size < in_size ) {
+        saved = (uint32_t)((in_size - zipped_size) * 256 / in_size);
+    }
+    flow->score = (uint16_t)(flow->score - flow->score / 4 + saved / 4);
+    if ( saved >= GNB_ZIP_FLOW_SCORE_MIN ) {
+        flow->backoff = GNB_ZIP_FLOW_BYPASS_MIN;
+    }
+    if ( flow->score >= GNB_ZIP_FLOW_SCORE_MIN ) {
+        return;
+    }
+    //score 回到阈值, 下一次试探失败就会再次进入 bypass 状态
+    flow->score      = GNB_ZIP_FLOW_SCORE_MIN;
+    flow->bypass_num = flow->backoff;
+    if ( flow->backoff < GNB_ZIP_FLOW_BYPASS_MAX ) {
+        flow->backoff *= 2;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_ZIP_FLOW_H
+#define GNB_ZIP_FLOW_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ 按 flow 记录压缩效果, 用于在 GNB_ZIP_AUTO 模式下跳过不能压缩的 flow (TLS QUIC 等已加密的数据)
+
+ flow 由 dst node 和 ip 首部中的 src dst proto port 决定, 用 hash 直接映射到固定大小的表中,
+ 冲突时新的 flow 覆盖旧的 flow
+
+ 每个 flow 维护一个压缩节省比例的滑动平均 score, score 低于阈值后 flow 进入 bypass 状态,
+ 之后的 bypass_num 个 packet 不压缩, bypass 结束后重新压缩一个 packet 试探,
+ 连续试探失败 bypass 的 packet 数量翻倍, 直到 GNB_ZIP_FLOW_BYPASS_MAX
+
+ 在压缩之前对 packet 尾部的一段数据估算熵, 字节分布接近随机的 packet 直接当作压缩失败处理
+
+ 每个 pf 实例(pf worker)使用独立的 gnb_zip_flow_table_t, 不需要加锁
+*/
+
+#define GNB_ZIP_FLOW_TABLE_SIZE 1024
+
+typedef struct _gnb_zip_flow_t {
+    uint64_t key;
+    //压缩节省的比例, 1/256 为单位
+    uint16_t score;
+    //剩余不压缩的 packet 数
+    uint16_t bypass_num;
+    //下一次进入 bypass 状态时的 bypass_num
+    uint16_t backoff;
+    uint16_t reserved;
+} gnb_zip_flow_t;
+
+typedef struct _gnb_zip_flow_table_t {
+    gnb_zip_flow_t flows[GNB_ZIP_FLOW_TABLE_SIZE];
+    uint64_t bypass_count;
+    uint64_t entropy_skip_count;
+} gnb_zip_flow_table_t;
+
+void gnb_zip_flow_table_init(gnb_zip_flow_table_t *table);
+
+/*
+ 返回 NULL 时这个 packet 不需要压缩,
+ 否则压缩后用 gnb_zip_flow_update 把压缩前后的长度记录到返回的 flow 中
+*/
+gnb_zip_flow_t* gnb_zip_flow_get(gnb_zip_flow_table_t *table, uint64_t dst_uuid64, const unsigned char *ip_frame, size_t ip_frame_size);
+
+//压缩失败或者压缩后没有变小时 zipped_size 传入 in_size
+void gnb_zip_flow_update(gnb_zip_flow_t *flow, size_t in_size, size_t zipped_size);
+
+#endif
@@ -0,0 +1,273 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <string.h>
+#include "lz4.h"
+
+//参考来自这里的信息
+//https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+#define LZ4_MINMATCH     4
+//最后一个 match 必须在 block 结束前 12 个字节之前开始
+#define LZ4_MFLIMIT      12
+//block 的最后 5 个字节必须是 literal
+#define LZ4_LASTLITERALS 5
+#define LZ4_MAX_DISTANCE 65535
+#define LZ4_ML_BITS      4
+#define LZ4_ML_MASK      ((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_MASK     ((1U << (8 - LZ4_ML_BITS)) - 1)
+#define LZ4_SKIP_TRIGGER 6
+
+static inline uint32_t lz4_read32(const unsigned char *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t lz4_hash(uint32_t sequence) {
+    return (sequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline unsigned char* lz4_write_length(unsigned char *op, uint32_t len) {
+    for ( ; len >= 255; len -= 255 ) {
+        *op++ = 255;
+    }
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+void lz4_ctx_init(lz4_ctx_t *ctx) {
+    memset(ctx, 0, sizeof(lz4_ctx_t));
+}
+
+void lz4_ctx_load_dict(lz4_ctx_t *ctx, const unsigned char *dict, int dict_size) {
+    int i;
+    memset(ctx, 0, sizeof(lz4_ctx_t));
+    //靠后的位置覆盖靠前的位置, 字典中最常用的内容应该放在尾部
+    for ( i=0; i + LZ4_MINMATCH <= dict_size; i++ ) {
+        ctx->hash_table[ lz4_hash(lz4_read32(dict + i)) ] = (uint32_t)i;
+    }
+}
+
+/*
+ hash table 中的位置都是相对 base 的, base 到 src 之间是字典
+*/
+int lz4_compress_prefix(lz4_ctx_t *ctx, const unsigned char *base, int prefix_size, int src_size, unsigned char *dst, int dst_capacity, int acceleration) {
+    uint32_t *hash_table = ctx->hash_table;
+    const unsigned char *src = base + prefix_size;
+    const unsigned char *ip = src;
+    const unsigned char *anchor = src;
+    const unsigned char *iend = src + src_size;
+    const unsigned char *mflimit = iend - LZ4_MFLIMIT;
+    const unsigned char *matchlimit = iend - LZ4_LASTLITERALS;
+    const unsigned char *match;
+    const unsigned char *forward_ip;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + dst_capacity;
+    unsigned char *token;
+    uint32_t h;
+    uint32_t ref;
+    uint32_t cur;
+    uint32_t step;
+    uint32_t search_match_nb;
+    uint32_t lit_len;
+    uint32_t match_len;
+    uint32_t last_run;
+    if ( src_size < 0 || dst_capacity <= 0 ) {
+        return 0;
+    }
+    if ( acceleration < 1 ) {
+        acceleration = 1;
+    }
+    if ( src_size < LZ4_MFLIMIT + 1 ) {
+        goto last_literals;
+    }
+    hash_table[ lz4_hash(lz4_read32(ip)) ] = (uint32_t)prefix_size;
+    ip++;
+    for ( ;; ) {
+        //查找 match, 连续找不到时逐渐加大步长
+        forward_ip = ip;
+        step = 1;
+        search_match_nb = (uint32_t)acceleration << LZ4_SKIP_TRIGGER;
+        do {
+            ip = forward_ip;
+            forward_ip += step;
+            step = search_match_nb++ >> LZ4_SKIP_TRIGGER;
+            if ( forward_ip > mflimit ) {
+                goto last_literals;
+            }
+            h = lz4_hash(lz4_read32(ip));
+            ref = hash_table[h];
+            cur = (uint32_t)(ip - base);
+            hash_table[h] = cur;
+            //hash table 中可能是上一次压缩留下的位置
+        } while ( ref >= cur || cur - ref > LZ4_MAX_DISTANCE || lz4_read32(base + ref) != lz4_read32(ip) );
+        match = base + ref;
+        while ( ip > anchor && match > base && ip[-1] == match[-1] ) {
+            ip--;
+            match--;
+        }
+        lit_len = (uint32_t)(ip - anchor);
+        if ( op + 1 + lit_len/255 + 1 + lit_len + 2 + LZ4_LASTLITERALS > oend ) {
+            return 0;
+        }
+        token = op++;
+        if ( lit_len >= LZ4_RUN_MASK ) {
+            *token = LZ4_RUN_MASK << LZ4_ML_BITS;
+            op = lz4_write_length(op, lit_len - LZ4_RUN_MASK);
+        } else {
+            *token = (unsigned char)(lit_len << LZ4_ML_BITS);
+        }
+        memcpy(op, anchor, lit_len);
+        op += lit_len;
+next_match:
+        op[0] = (unsigned char)((ip - match) & 0xff);
+        op[1] = (unsigned char)((ip - match) >> 8);
+        op += 2;
+        ip += LZ4_MINMATCH;
+        match += LZ4_MINMATCH;
+        anchor = ip;
+        while ( ip < matchlimit && *ip == *match ) {
+            ip++;
+            match++;
+        }
+        match_len = (uint32_t)(ip - anchor);
+        if ( op + 1 + match_len/255 + LZ4_LASTLITERALS > oend ) {
+            return 0;
+        }
+        if ( match_len >= LZ4_ML_MASK ) {
+            *token += LZ4_ML_MASK;
+            op = lz4_write_length(op, match_len - LZ4_ML_MASK);
+        } else {
+            *token += (unsigned char)match_len;
+        }
+        anchor = ip;
+        if ( ip > mflimit ) {
+            break;
+        }
+        hash_table[ lz4_hash(lz4_read32(ip-2)) ] = (uint32_t)(ip - 2 - base);
+        //紧接着的位置如果也能 match 就不需要输出 literal
+        h = lz4_hash(lz4_read32(ip));
+        ref = hash_table[h];
+        cur = (uint32_t)(ip - base);
+        hash_table[h] = cur;
+        if ( ref < cur && cur - ref <= LZ4_MAX_DISTANCE && lz4_read32(base + ref) == lz4_read32(ip) ) {
+            match = base + ref;
+            token = op++;
+            *token = 0;
+            goto next_match;
+        }
+        ip++;
+    }
+last_literals:
+    last_run = (uint32_t)(iend - anchor);
+    if ( op + 1 + (last_run + 255 - LZ4_RUN_MASK)/255 + last_run > oend ) {
+        return 0;
+    }
+    if ( last_run >= LZ4_RUN_MASK ) {
+        *op++ = LZ4_RUN_MASK << LZ4_ML_BITS;
+        op = lz4_write_length(op, last_run - LZ4_RUN_MASK);
+    } else {
+        *op++ = (unsigned char)(last_run << LZ4_ML_BITS);
+    }
+    memcpy(op, anchor, last_run);
+    op += last_run;
+    return (int)(op - dst);
+}
+
+int lz4_compress(lz4_ctx_t *ctx, const unsigned char *src, int src_size, unsigned char *dst, int dst_capacity, int acceleration) {
+    return lz4_compress_prefix(ctx, src, 0, src_size, dst, dst_capacity, acceleration);
+}
+
+int lz4_decompress_prefix(const unsigned char *src, int src_size, unsigned char *base, int prefix_size, int dst_capacity) {
+    unsigned char *dst = base + prefix_size;
+    const unsigned char *ip = src;
+    const unsigned char *iend = src + src_size;
+    const unsigned char *match;
+    unsigned char *op = dst;
+    unsigned char *oend = dst + dst_capacity;
+    unsigned int token;
+    size_t length;
+    size_t offset;
+    unsigned int s;
+    size_t i;
+    if ( src_size <= 0 || dst_capacity < 0 ) {
+        return -1;
+    }
+    for ( ;; ) {
+        token = *ip++;
+        length = token >> LZ4_ML_BITS;
+        if ( LZ4_RUN_MASK == length ) {
+            do {
+                if ( ip >= iend ) {
+                    return -1;
+                }
+                s = *ip++;
+                length += s;
+            } while ( 255 == s );
+        }
+        if ( length > (size_t)(iend - ip) || length > (size_t)(oend - op) ) {
+            return -1;
+        }
+        memcpy(op, ip, length);
+        op += length;
+        ip += length;
+        if ( ip == iend ) {
+            break;
+        }
+        if ( iend - ip < 2 ) {
+            return -1;
+        }
+        offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+        ip += 2;
+        if ( 0 == offset || offset > (size_t)(op - base) ) {
+            return -1;
+        }
+        match = op - offset;
+        length = token & LZ4_ML_MASK;
+        if ( LZ4_ML_MASK == length ) {
+            do {
+                if ( ip >= iend ) {
+                    return -1;
+                }
+                s = *ip++;
+                length += s;
+            } while ( 255 == s );
+        }
+        length += LZ4_MINMATCH;
+        if ( length > (size_t)(oend - op) ) {
+            return -1;
+        }
+        if ( offset >= length ) {
+            memcpy(op, match, length);
+        } else {
+            //match 与输出重叠时逐个字节复制
+            for ( i=0; i<length; i++ ) {
+                op[i] = match[i];
+            }
+        }
+        op += length;
+        if ( ip >= iend ) {
+            return -1;
+        }
+    }
+    return (int)(op - dst);
+}
+
+int lz4_decompress(const unsigned char *src, int src_size, unsigned char *dst, int dst_capacity) {
+    return lz4_decompress_prefix(src, src_size, dst, 0, dst_capacity);
+}
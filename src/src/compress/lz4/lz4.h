@@ -0,0 +1,64 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stdint.h>
+
+/*
+ LZ4 block format 的压缩和解压, 输出与 lz4 参考实现的 block format 兼容
+ lz4_ctx_t 中的 hash table 在压缩不同的数据时可以重复使用而不需要清零,
+ 每个候选的 match 在使用前都会与当前位置比较
+*/
+
+#define LZ4_HASH_LOG 12
+
+typedef struct _lz4_ctx_t {
+    uint32_t hash_table[1 << LZ4_HASH_LOG];
+} lz4_ctx_t;
+
+//压缩 size 个字节最坏情况下需要的输出空间
+#define LZ4_COMPRESS_BOUND(size) ( (size) + (size)/255 + 16 )
+
+void lz4_ctx_init(lz4_ctx_t *ctx);
+
+/*
+ acceleration 越大压缩越快, 压缩率越低, 小于 1 时按 1 处理
+ 返回压缩后的长度, dst_capacity 放不下压缩结果时返回 0
+*/
+int lz4_compress(lz4_ctx_t *ctx, const unsigned char *src, int src_size, unsigned char *dst, int dst_capacity, int acceleration);
+
+//返回解压后的长度, 数据格式错误或者 dst_capacity 不足时返回 -1
+int lz4_decompress(const unsigned char *src, int src_size, unsigned char *dst, int dst_capacity);
+
+/*
+ 使用字典压缩, 字典放在 base 开始的 prefix_size 个字节, 要压缩的数据紧接在字典之后,
+ match 可以引用字典中的数据, 字典不能超过 LZ4_DICT_MAX_SIZE
+
+ ctx 需要先用 lz4_ctx_load_dict 对字典建立 hash table, 压缩之后 ctx 中会混入被压缩数据的位置,
+ 每次压缩前应该复制一份 load_dict 之后的 ctx 使用, 这样同一个字典压缩的结果不依赖之前压缩过的数据
+*/
+#define LZ4_DICT_MAX_SIZE 65535
+
+void lz4_ctx_load_dict(lz4_ctx_t *ctx, const unsigned char *dict, int dict_size);
+int lz4_compress_prefix(lz4_ctx_t *ctx, const unsigned char *base, int prefix_size, int src_size, unsigned char *dst, int dst_capacity, int acceleration);
+
+//解压到 base + prefix_size, base 开始的 prefix_size 个字节是压缩时使用的字典
+int lz4_decompress_prefix(const unsigned char *src, int src_size, unsigned char *base, int prefix_size, int dst_capacity);
+
+#endif
@@ -16,6 +16,8 @@
 */
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <limits.h>
 #include <stddef.h>
 #include <inttypes.h>
@@ -47,6 +49,8 @@ void gnb_ctl_dump_status(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8
     char shared_secret_sha512[64];
     char  in_bytes_string[128];
     char out_bytes_string[128];
+    gnb_node_counter_t node_counter_st;
+    gnb_node_addr_snapshot_t addr_snapshot;
     conf = &ctl_block->conf_zone->conf_st;
     printf("conf->conf_dir[%s]\n",conf->conf_dir);
     gnb_address_list_t *available_address6_list;
@@ -73,7 +77,9 @@ void gnb_ctl_dump_status(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8
         }
 
 dump_all_node:
-        if ( 0 != online_opt && !((GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV4_PONG) & node->udp_addr_status) ) {
+        //地址 状态 ping 延时取自同一个快照
+        gnb_ctl_block_node_addr_snapshot(node, &addr_snapshot);
+        if ( 0 != online_opt && !((GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV4_PONG) & addr_snapshot.udp_addr_status) ) {
             continue;
         }
         available_address6_list = (gnb_address_list_t *)&node->available_address6_list3_block;
@@ -86,29 +92,39 @@ dump_all_node:
         available_address4_list = (gnb_address_list_t *)&node->available_address4_list3_block;
         printf("\n====================\n");
         printf("node %llu\n",node->uuid64);
-        printf("addr4_ping_latency_usec %"PRIu64"\n",node->addr4_ping_latency_usec);
+        printf("addr4_ping_latency_usec %"PRIu64"\n",addr_snapshot.addr4_ping_latency_usec);
         printf("tun_ipv4 %s\n",GNB_ADDR4STR1(&node->tun_addr4));
         printf("tun_ipv6 %s\n",GNB_ADDR6STR1(&node->tun_ipv6_addr));
-        if ( (node->in_bytes > 1024) && (node->in_bytes < 1024*1024) ) {
-            snprintf(in_bytes_string, 128, "%.3fK bytes", ((float)node->in_bytes/1024));
-        } else if ( (node->in_bytes > 1024) && (node->in_bytes < 1024*1024*1024) ) {
-            snprintf(in_bytes_string, 128, "%.3fM bytes", ((float)node->in_bytes/(1024*1024)));
-        } else if ( (node->in_bytes >= 1024*1024*1024) ) {
-            snprintf(in_bytes_string, 128, "%.3fG bytes", ((float)node->in_bytes/(1024*1024*1024)));
+        //汇总各个 worker shard 中的计数
+        gnb_ctl_block_node_counter_sum(ctl_block, i, &node_counter_st);
+        if ( (node_counter_st.in_bytes > 1024) && (node_counter_st.in_bytes < 1024*1024) ) {
+            snprintf(in_bytes_string, 128, "%.3fK bytes", ((float)node_counter_st.in_bytes/1024));
+        } else if ( (node_counter_st.in_bytes > 1024) && (node_counter_st.in_bytes < 1024*1024*1024) ) {
+            snprintf(in_bytes_string, 128, "%.3fM bytes", ((float)node_counter_st.in_bytes/(1024*1024)));
+        } else if ( (node_counter_st.in_bytes >= 1024*1024*1024) ) {
+            snprintf(in_bytes_string, 128, "%.3fG bytes", ((float)node_counter_st.in_bytes/(1024*1024*1024)));
         } else {
-            snprintf(in_bytes_string, 128, "%"PRIu64" bytes", node->in_bytes);
+            snprintf(in_bytes_string, 128, "%"PRIu64" bytes", node_counter_st.in_bytes);
         }
-        if ( (node->out_bytes > 1024) && (node->out_bytes < 1024*1024) ) {
-            snprintf(out_bytes_string, 128, "%.3fK bytes", ((float)node->out_bytes/1024));
-        } else if ( (node->out_bytes > 1024) && (node->out_bytes < 1024*1024*1024) ) {
-            snprintf(out_bytes_string, 128, "%.3fM bytes", ((float)node->out_bytes/(1024*1024)));
-        } else if ( (node->out_bytes >= 1024*1024*1024) ) {
-            snprintf(out_bytes_string, 128, "%.3fG bytes", ((float)node->out_bytes/(1024*1024*1024)));
+        if ( (node_counter_st.out_bytes > 1024) && (node_counter_st.out_bytes < 1024*1024) ) {
+            snprintf(out_bytes_string, 128, "%.3fK bytes", ((float)node_counter_st.out_bytes/1024));
+        } else if ( (node_counter_st.out_bytes > 1024) && (node_counter_st.out_bytes < 1024*1024*1024) ) {
+            snprintf(out_bytes_string, 128, "%.3fM bytes", ((float)node_counter_st.out_bytes/(1024*1024)));
+        } else if ( (node_counter_st.out_bytes >= 1024*1024*1024) ) {
+            snprintf(out_bytes_string, 128, "%.3fG bytes", ((float)node_counter_st.out_bytes/(1024*1024*1024)));
         } else {
-            snprintf(out_bytes_string, 128, "%"PRIu64" bytes", node->out_bytes);
+            snprintf(out_bytes_string, 128, "%"PRIu64" bytes", node_counter_st.out_bytes);
+        }
+        printf("in  %"PRIu64" (%s)\n", node_counter_st.in_bytes,  in_bytes_string);
+        printf("out %"PRIu64" (%s)\n", node_counter_st.out_bytes, out_bytes_string);
+        printf("in_packets  %"PRIu64"\n", node_counter_st.in_packets);
+        printf("out_packets %"PRIu64"\n", node_counter_st.out_packets);
+        for ( j=0; j<GNB_PF_STATUS_NUM; j++ ) {
+            if ( 0 == node_counter_st.drops[j] ) {
+                continue;
+            }
+            printf("drop %s %"PRIu64"\n", gnb_pf_status_strings[j], node_counter_st.drops[j]);
         }
-        printf("in  %"PRIu64" (%s)\n", node->in_bytes,  in_bytes_string);
-        printf("out %"PRIu64" (%s)\n", node->out_bytes, out_bytes_string);
         printf("public_key %s\n",GNB_HEX1_BYTE64(node->public_key));
         sha512((const unsigned char *)(node->shared_secret), 32, (unsigned char *)shared_secret_sha512);
         printf("shared_secret_sha512 %s\n",GNB_HEX1_BYTE128(shared_secret_sha512));
@@ -116,13 +132,13 @@ dump_all_node:
         printf("key512 %s\n",GNB_HEX1_BYTE64(node->key512));
 
         if ( node->uuid64 != ctl_block->core_zone->local_uuid ) {
-            if ( (node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) ) {
+            if ( (addr_snapshot.udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) ) {
                 printf("ipv6 Direct Point to Point\n");
             } else {
                 printf("ipv6 InDirect\n");
             }
 
-            if ( (node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) ) {
+            if ( (addr_snapshot.udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) ) {
                 printf("ipv4 Direct Point to Point\n");
             } else {
                 printf("ipv4 InDirect\n");
@@ -134,11 +150,11 @@ dump_all_node:
 
         gnb_timef("%Y-%m-%d %H:%M:%S", (time_t)node->ping_ts_sec, time_string, 128);
         printf("ping_ts_sec:%"PRIu64"(%s)\n", node->ping_ts_sec, time_string);
-        printf("addr6_ping_latency_usec:%"PRIu64"\n", node->addr6_ping_latency_usec);
-        printf("addr4_ping_latency_usec:%"PRIu64"\n", node->addr4_ping_latency_usec);
+        printf("addr6_ping_latency_usec:%"PRIu64"\n", addr_snapshot.addr6_ping_latency_usec);
+        printf("addr4_ping_latency_usec:%"PRIu64"\n", addr_snapshot.addr4_ping_latency_usec);
         printf("detect_count %u\n", node->detect_count);
-        printf("wan_ipv4 %s\n", GNB_SOCKADDR4STR1(&node->udp_sockaddr4));
-        printf("wan_ipv6 %s\n", GNB_SOCKADDR6STR1(&node->udp_sockaddr6));
+        printf("wan_ipv4 %s\n", GNB_SOCKADDR4STR1(&addr_snapshot.udp_sockaddr4));
+        printf("wan_ipv6 %s\n", GNB_SOCKADDR6STR1(&addr_snapshot.udp_sockaddr6));
         printf("available_address6:\n");
         for ( j=0; j<available_address6_list->num; j++ ) {
             gnb_address = &available_address6_list->array[j];
@@ -230,6 +246,7 @@ dump_all_node:
 
 void gnb_ctl_dump_address_list(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8_t online_opt) {
     gnb_address_t *gnb_address;
+    gnb_node_addr_snapshot_t addr_snapshot;
     gnb_address_list_t *available_address6_list;
     gnb_address_list_t *available_address4_list;
     gnb_address_list_t *static_address_list;
@@ -250,20 +267,20 @@ void gnb_ctl_dump_address_list(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid,
             continue;
         }
 dump_all_node_address:
-
+        gnb_ctl_block_node_addr_snapshot(node, &addr_snapshot);
         if ( node->uuid64 == ctl_block->core_zone->local_uuid ) {
-            printf( "l|%llu|%s\n", node->uuid64, GNB_SOCKADDR6STR1(&node->udp_sockaddr6) );
-            printf( "l|%llu|%s\n", node->uuid64, GNB_SOCKADDR4STR1(&node->udp_sockaddr4) );
+            printf( "l|%llu|%s\n", node->uuid64, GNB_SOCKADDR6STR1(&addr_snapshot.udp_sockaddr6) );
+            printf( "l|%llu|%s\n", node->uuid64, GNB_SOCKADDR4STR1(&addr_snapshot.udp_sockaddr4) );
             continue;
         }
-        if ( 0 != online_opt && !((GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV4_PONG) & node->udp_addr_status) ) {
+        if ( 0 != online_opt && !((GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV4_PONG) & addr_snapshot.udp_addr_status) ) {
             continue;
         }
-        if ( GNB_NODE_STATUS_IPV6_PONG & node->udp_addr_status ) {
-            printf( "w|%llu|%s\n", node->uuid64, GNB_SOCKADDR6STR1(&node->udp_sockaddr6) );
+        if ( GNB_NODE_STATUS_IPV6_PONG & addr_snapshot.udp_addr_status ) {
+            printf( "w|%llu|%s\n", node->uuid64, GNB_SOCKADDR6STR1(&addr_snapshot.udp_sockaddr6) );
         }
-        if ( GNB_NODE_STATUS_IPV4_PONG & node->udp_addr_status  ) {
-            printf( "w|%llu|%s\n", node->uuid64, GNB_SOCKADDR4STR1(&node->udp_sockaddr4) );
+        if ( GNB_NODE_STATUS_IPV4_PONG & addr_snapshot.udp_addr_status  ) {
+            printf( "w|%llu|%s\n", node->uuid64, GNB_SOCKADDR4STR1(&addr_snapshot.udp_sockaddr4) );
         }
         if ( 0 != online_opt ) {
             continue;
@@ -364,3 +381,140 @@ dump_all_node_address:
         }
     }
 }
+
+static double latency_ticks_to_usec(gnb_ctl_latency_zone_t *latency_zone, uint64_t ticks) {
+    if ( 0 == latency_zone->ticks_per_sec ) {
+        return 0.0;
+    }
+    return (double)ticks * 1000000.0 / (double)latency_zone->ticks_per_sec;
+}
+
+/*
+ 汇总各个 worker shard 中的 histogram, 按 stage 输出样本数和以微秒为单位的平均值 p50 p99 p999 max
+*/
+void gnb_ctl_dump_latency(gnb_ctl_block_t *ctl_block) {
+    gnb_ctl_latency_zone_t *latency_zone = ctl_block->latency_zone;
+    gnb_latency_histogram_t histogram_st;
+    int stage;
+    if ( NULL == latency_zone ) {
+        printf("latency stats is not enabled, start gnb with --latency-stats=on\n");
+        return;
+    }
+    if ( 0 == latency_zone->ticks_per_sec ) {
+        printf("latency clock is not calibrated yet\n");
+        return;
+    }
+    printf("shard_num[%u] ticks_per_sec[%"PRIu64"]\n", latency_zone->shard_num, latency_zone->ticks_per_sec);
+    printf("%-10s %14s %10s %10s %10s %10s %10s\n", "stage", "count", "avg(us)", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+    for ( stage=0; stage<GNB_LATENCY_STAGE_NUM && stage<latency_zone->stage_num; stage++ ) {
+        gnb_ctl_block_latency_sum(ctl_block, stage, &histogram_st);
+        if ( 0 == histogram_st.count ) {
+            printf("%-10s %14d %10s %10s %10s %10s %10s\n", gnb_latency_stage_strings[stage], 0, "-", "-", "-", "-", "-");
+            continue;
+        }
+        printf("%-10s %14"PRIu64" %10.3f %10.3f %10.3f %10.3f %10.3f\n", gnb_latency_stage_strings[stage], histogram_st.count,
+               latency_ticks_to_usec(latency_zone, histogram_st.sum / histogram_st.count),
+               latency_ticks_to_usec(latency_zone, gnb_latency_percentile(&histogram_st, 0.5)),
+               latency_ticks_to_usec(latency_zone, gnb_latency_percentile(&histogram_st, 0.99)),
+               latency_ticks_to_usec(latency_zone, gnb_latency_percentile(&histogram_st, 0.999)),
+               latency_ticks_to_usec(latency_zone, histogram_st.max));
+    }
+}
+
+/*
+ 输出 primary worker 的丢弃计数, 各个 worker ring buffer 的占用和高水位, 以及每个 worker 中 packet 在 pf 中的最终结果
+*/
+void gnb_ctl_dump_drops(gnb_ctl_block_t *ctl_block) {
+    gnb_ctl_status_zone_t *status_zone = ctl_block->status_zone;
+    gnb_ctl_queue_stats_t *queue_stats;
+    gnb_pf_status_counter_t *pf_status_counter;
+    int shard_idx;
+    int i;
+    printf("drops:\n");
+    for ( i=0; i<GNB_CTL_DROP_NUM; i++ ) {
+        printf("  %-26s %"PRIu64"\n", gnb_ctl_drop_strings[i], status_zone->drop_num[i]);
+    }
+    printf("  %-26s %"PRIu64"\n", "pbuf_exhausted", status_zone->pbuf_exhausted_num);
+    printf("queues:\n");
+    printf("  %-32s %6s %10s %10s %10s %12s\n", "name", "unit", "capacity", "used", "high", "full");
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        printf("  %-32s %6s %10u %10u %10u %12"PRIu64"\n", queue_stats->name, GNB_CTL_QUEUE_UNIT_BYTE == queue_stats->unit ? "byte":"block",
+               queue_stats->capacity, queue_stats->used, queue_stats->high_watermark, queue_stats->full_num);
+    }
+    printf("pf status:\n");
+    for ( shard_idx=0; shard_idx<status_zone->pf_shard_num; shard_idx++ ) {
+        pf_status_counter = &status_zone->pf_status_counter[shard_idx];
+        printf("  shard %d%s\n", shard_idx, 0 == shard_idx ? " (primary worker)":"");
+        for ( i=0; i<GNB_PF_STATUS_NUM; i++ ) {
+            if ( 0 == pf_status_counter->status[i] ) {
+                continue;
+            }
+            printf("    %-24s %"PRIu64"\n", gnb_pf_status_strings[i], pf_status_counter->status[i]);
+        }
+    }
+}
+
+static void flight_mode_string(uint8_t mode, char *mode_string, size_t size) {
+    snprintf(mode_string, size, "%s%s%s%s%s",
+             mode & GNB_FLIGHT_MODE_RELAY   ? "relay,"   : "",
+             mode & GNB_FLIGHT_MODE_UNIFIED ? "unified," : "",
+             mode & GNB_FLIGHT_MODE_DIRECT  ? "direct,"  : "",
+             mode & GNB_FLIGHT_MODE_STD     ? "std,"     : "",
+             mode & GNB_FLIGHT_MODE_UR0     ? "ur0,"     : "");
+    if ( '\0' == mode_string[0] ) {
+        snprintf(mode_string, size, "%s", "-");
+        return;
+    }
+    mode_string[ strlen(mode_string) - 1 ] = '\0';
+}
+
+/*
+ 按 shard 输出 flight recorder 中的记录, 从旧到新, age 是记录写入到现在经过的时间
+ in_nodeid 不为 0 时只输出 src dst fwd 中有这个 node 的记录
+*/
+void gnb_ctl_dump_flight(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid) {
+    gnb_ctl_flight_zone_t *flight_zone = ctl_block->flight_zone;
+    gnb_flight_record_t *record_vec;
+    gnb_flight_record_t *record;
+    uint64_t first_idx;
+    uint64_t now_ticks;
+    char mode_string[64];
+    char age_string[32];
+    int shard_idx;
+    int num;
+    int i;
+    if ( NULL == flight_zone ) {
+        printf("flight recorder is not enabled, start gnb with --flight-record=1024\n");
+        return;
+    }
+    record_vec = (gnb_flight_record_t *)malloc(sizeof(gnb_flight_record_t) * flight_zone->record_num);
+    if ( NULL == record_vec ) {
+        return;
+    }
+    printf("shard_num[%u] record_num[%u] ticks_per_sec[%"PRIu64"]\n", flight_zone->shard_num, flight_zone->record_num, flight_zone->ticks_per_sec);
+    for ( shard_idx=0; shard_idx<flight_zone->shard_num; shard_idx++ ) {
+        num = gnb_ctl_block_flight_snapshot(ctl_block, shard_idx, record_vec, &first_idx);
+        now_ticks = gnb_latency_now();
+        printf("shard %d%s\n", shard_idx, 0 == shard_idx ? " (primary worker)":"");
+        printf("  %-12s %14s %4s %20s %20s %20s %-16s %6s %s\n", "idx", "age(us)", "dir", "src", "dst", "fwd", "mode", "size", "status");
+        for ( i=0; i<num; i++ ) {
+            record = &record_vec[i];
+            if ( 0 != in_nodeid && in_nodeid != record->src_uuid64 && in_nodeid != record->dst_uuid64 && in_nodeid != record->fwd_uuid64 ) {
+                continue;
+            }
+            if ( 0 != flight_zone->ticks_per_sec && now_ticks >= record->ts_ticks ) {
+                snprintf(age_string, 32, "%.1f", (double)(now_ticks - record->ts_ticks) * 1000000.0 / (double)flight_zone->ticks_per_sec);
+            } else {
+                snprintf(age_string, 32, "%s", "-");
+            }
+            flight_mode_string(record->mode, mode_string, 64);
+            printf("  %-12"PRIu64" %14s %4s %20llu %20llu %20llu %-16s %6u %s\n", first_idx + i, age_string,
+                   GNB_FLIGHT_DIRECTION_TUN == record->direction ? "tun":"inet",
+                   (unsigned long long)record->src_uuid64, (unsigned long long)record->dst_uuid64, (unsigned long long)record->fwd_uuid64,
+                   mode_string, record->ip_frame_size,
+                   record->pf_status < GNB_PF_STATUS_NUM ? gnb_pf_status_strings[record->pf_status] : "-");
+        }
+    }
+    free(record_vec);
+}
@@ -0,0 +1,526 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <inttypes.h>
+#include <time.h>
+
+#if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__) || defined(__OpenBSD__)
+#include <unistd.h>
+#include <signal.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#endif
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include <windows.h>
+#endif
+
+#include "gnb_conf_type.h"
+#include "gnb_node_type.h"
+#include "gnb_address.h"
+#include "gnb_ctl_block.h"
+
+#define GNB_CTL_METRICS_JSON        0
+#define GNB_CTL_METRICS_PROMETHEUS  1
+
+typedef struct _gnb_ctl_metrics_buf_t {
+    char *data;
+    size_t len;
+    size_t size;
+} gnb_ctl_metrics_buf_t;
+
+/*
+ 先把每个 node 需要输出的字段和各个 shard 汇总后的计数复制出来, 再按格式输出,
+ prometheus 格式要求同一个 metric 的样本连续输出, 这样每个 metric 只需要遍历一次复制出来的数组
+*/
+typedef struct _gnb_ctl_metrics_node_t {
+    gnb_uuid_t uuid64;
+    uint8_t local;
+    unsigned int udp_addr_status;
+    int64_t addr4_ping_latency_usec;
+    int64_t addr6_ping_latency_usec;
+    uint64_t ping_ts_sec;
+    uint64_t addr4_update_ts_sec;
+    uint64_t addr6_update_ts_sec;
+    char tun_ipv4[INET_ADDRSTRLEN];
+    char wan_ipv4[INET_ADDRSTRLEN + 8];
+    char wan_ipv6[INET6_ADDRSTRLEN + 8];
+    gnb_node_counter_t counter;
+} gnb_ctl_metrics_node_t;
+
+static void metrics_printf(gnb_ctl_metrics_buf_t *buf, const char *format, ...) {
+    va_list ap;
+    int n;
+    size_t new_size;
+    char *new_data;
+    while (1) {
+        va_start(ap, format);
+        n = vsnprintf(buf->data + buf->len, buf->size - buf->len, format, ap);
+        va_end(ap);
+        if ( n < 0 ) {
+            return;
+        }
+        if ( (size_t)n < buf->size - buf->len ) {
+            buf->len += n;
+            return;
+        }
+        new_size = buf->size * 2;
+        if ( new_size < buf->len + n + 1 ) {
+            new_size = buf->len + n + 1;
+        }
+        new_data = realloc(buf->data, new_size);
+        if ( NULL == new_data ) {
+            return;
+        }
+        buf->data = new_data;
+        buf->size = new_size;
+    }
+}
+
+static double latency_ticks_to_sec(gnb_ctl_latency_zone_t *latency_zone, uint64_t ticks) {
+    if ( 0 == latency_zone->ticks_per_sec ) {
+        return 0.0;
+    }
+    return (double)ticks / (double)latency_zone->ticks_per_sec;
+}
+
+static int metrics_node_snapshot(gnb_ctl_block_t *ctl_block, gnb_uuid_t in_nodeid, uint8_t online_opt, gnb_ctl_metrics_node_t *metrics_node_array) {
+    gnb_node_t *node;
+    gnb_ctl_metrics_node_t *metrics_node;
+    gnb_node_addr_snapshot_t addr_snapshot;
+    int num = 0;
+    int i;
+    for ( i=0; i<ctl_block->node_zone->node_num; i++ ) {
+        node = &ctl_block->node_zone->node[i];
+        if ( 0 != in_nodeid && in_nodeid != node->uuid64 ) {
+            continue;
+        }
+        gnb_ctl_block_node_addr_snapshot(node, &addr_snapshot);
+        if ( 0 != online_opt && !((GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV4_PONG) & addr_snapshot.udp_addr_status) ) {
+            continue;
+        }
+        metrics_node = &metrics_node_array[num];
+        metrics_node->uuid64                  = node->uuid64;
+        metrics_node->local                   = node->uuid64 == ctl_block->core_zone->local_uuid ? 1:0;
+        metrics_node->udp_addr_status         = addr_snapshot.udp_addr_status;
+        metrics_node->addr4_ping_latency_usec = addr_snapshot.addr4_ping_latency_usec;
+        metrics_node->addr6_ping_latency_usec = addr_snapshot.addr6_ping_latency_usec;
+        metrics_node->ping_ts_sec             = node->ping_ts_sec;
+        metrics_node->addr4_update_ts_sec     = addr_snapshot.addr4_update_ts_sec;
+        metrics_node->addr6_update_ts_sec     = addr_snapshot.addr6_update_ts_sec;
+        snprintf(metrics_node->tun_ipv4, sizeof(metrics_node->tun_ipv4), "%s", GNB_ADDR4STR_PLAINTEXT1(&node->tun_addr4));
+        snprintf(metrics_node->wan_ipv4, sizeof(metrics_node->wan_ipv4), "%s", GNB_SOCKADDR4STR1(&addr_snapshot.udp_sockaddr4));
+        snprintf(metrics_node->wan_ipv6, sizeof(metrics_node->wan_ipv6), "%s", GNB_SOCKADDR6STR1(&addr_snapshot.udp_sockaddr6));
+        gnb_ctl_block_node_counter_sum(ctl_block, i, &metrics_node->counter);
+        num++;
+    }
+    return num;
+}
+
+static void metrics_json(gnb_ctl_block_t *ctl_block, gnb_ctl_metrics_node_t *metrics_node_array, int node_num, gnb_ctl_metrics_buf_t *buf) {
+    gnb_ctl_status_zone_t  *status_zone  = ctl_block->status_zone;
+    gnb_ctl_latency_zone_t *latency_zone = ctl_block->latency_zone;
+    gnb_ctl_metrics_node_t *metrics_node;
+    gnb_ctl_queue_stats_t *queue_stats;
+    gnb_pf_status_counter_t *pf_status_counter;
+    gnb_latency_histogram_t histogram_st;
+    uint64_t now_sec = (uint64_t)time(NULL);
+    int i,j;
+
+    metrics_printf(buf, "{\"type\":\"core\",\"ts\":%"PRIu64",\"local_uuid\":%llu,\"node_num\":%d,\"keep_alive_ts_sec\":%"PRIu64",\"up\":%d}\n",
+                   now_sec, ctl_block->core_zone->local_uuid, ctl_block->node_zone->node_num, status_zone->keep_alive_ts_sec,
+                   (now_sec - status_zone->keep_alive_ts_sec) < GNB_CTL_KEEP_ALIVE_TS ? 1:0);
+
+    for ( i=0; i<node_num; i++ ) {
+        metrics_node = &metrics_node_array[i];
+        metrics_printf(buf, "{\"type\":\"node\",\"uuid\":%llu,\"local\":%d,\"tun_ipv4\":\"%s\",\"wan_ipv4\":\"%s\",\"wan_ipv6\":\"%s\","
+                       "\"ipv4_direct\":%d,\"ipv6_direct\":%d,\"addr4_ping_latency_usec\":%"PRId64",\"addr6_ping_latency_usec\":%"PRId64","
+                       "\"ping_ts_sec\":%"PRIu64",\"addr4_update_ts_sec\":%"PRIu64",\"addr6_update_ts_sec\":%"PRIu64","
+                       "\"in_bytes\":%"PRIu64",\"out_bytes\":%"PRIu64",\"in_packets\":%"PRIu64",\"out_packets\":%"PRIu64",\"drops\":{",
+                       metrics_node->uuid64, metrics_node->local, metrics_node->tun_ipv4, metrics_node->wan_ipv4, metrics_node->wan_ipv6,
+                       (metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) ? 1:0, (metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) ? 1:0,
+                       metrics_node->addr4_ping_latency_usec, metrics_node->addr6_ping_latency_usec,
+                       metrics_node->ping_ts_sec, metrics_node->addr4_update_ts_sec, metrics_node->addr6_update_ts_sec,
+                       metrics_node->counter.in_bytes, metrics_node->counter.out_bytes, metrics_node->counter.in_packets, metrics_node->counter.out_packets);
+        for ( j=0; j<GNB_PF_STATUS_NUM; j++ ) {
+            if ( 0 == metrics_node->counter.drops[j] ) {
+                continue;
+            }
+            metrics_printf(buf, "%s\"%s\":%"PRIu64, '{' == buf->data[buf->len-1] ? "":",", gnb_pf_status_strings[j], metrics_node->counter.drops[j]);
+        }
+        metrics_printf(buf, "}}\n");
+    }
+
+    if ( NULL != latency_zone && 0 != latency_zone->ticks_per_sec ) {
+        for ( i=0; i<GNB_LATENCY_STAGE_NUM && i<latency_zone->stage_num; i++ ) {
+            gnb_ctl_block_latency_sum(ctl_block, i, &histogram_st);
+            metrics_printf(buf, "{\"type\":\"latency\",\"stage\":\"%s\",\"count\":%"PRIu64",\"sum_usec\":%.3f,\"p50_usec\":%.3f,\"p99_usec\":%.3f,\"p999_usec\":%.3f,\"max_usec\":%.3f}\n",
+                           gnb_latency_stage_strings[i], histogram_st.count,
+                           latency_ticks_to_sec(latency_zone, histogram_st.sum) * 1000000.0,
+                           latency_ticks_to_sec(latency_zone, gnb_latency_percentile(&histogram_st, 0.5)) * 1000000.0,
+                           latency_ticks_to_sec(latency_zone, gnb_latency_percentile(&histogram_st, 0.99)) * 1000000.0,
+                           latency_ticks_to_sec(latency_zone, gnb_latency_percentile(&histogram_st, 0.999)) * 1000000.0,
+                           latency_ticks_to_sec(latency_zone, histogram_st.max) * 1000000.0);
+        }
+    }
+
+    metrics_printf(buf, "{\"type\":\"drops\"");
+    for ( i=0; i<GNB_CTL_DROP_NUM; i++ ) {
+        metrics_printf(buf, ",\"%s\":%"PRIu64, gnb_ctl_drop_strings[i], status_zone->drop_num[i]);
+    }
+    metrics_printf(buf, ",\"pbuf_exhausted\":%"PRIu64"}\n", status_zone->pbuf_exhausted_num);
+
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        metrics_printf(buf, "{\"type\":\"queue\",\"name\":\"%.32s\",\"unit\":\"%s\",\"capacity\":%u,\"used\":%u,\"high_watermark\":%u,\"full\":%"PRIu64"}\n",
+                       queue_stats->name, GNB_CTL_QUEUE_UNIT_BYTE == queue_stats->unit ? "byte":"block",
+                       queue_stats->capacity, queue_stats->used, queue_stats->high_watermark, queue_stats->full_num);
+    }
+
+    for ( i=0; i<status_zone->pf_shard_num; i++ ) {
+        pf_status_counter = &status_zone->pf_status_counter[i];
+        metrics_printf(buf, "{\"type\":\"pf_status\",\"shard\":%d", i);
+        for ( j=0; j<GNB_PF_STATUS_NUM; j++ ) {
+            if ( 0 == pf_status_counter->status[j] ) {
+                continue;
+            }
+            metrics_printf(buf, ",\"%s\":%"PRIu64, gnb_pf_status_strings[j], pf_status_counter->status[j]);
+        }
+        metrics_printf(buf, "}\n");
+    }
+}
+
+#define METRICS_NODE_COUNTER(metric, field, help) do {                                                       \
+    metrics_printf(buf, "# HELP " metric " " help "\n# TYPE " metric " counter\n");                           \
+    for ( i=0; i<node_num; i++ ) {                                                                           \
+        metrics_printf(buf, metric "{node=\"%llu\"} %"PRIu64"\n", metrics_node_array[i].uuid64, metrics_node_array[i].counter.field); \
+    }                                                                                                        \
+} while(0)
+
+static void metrics_prometheus(gnb_ctl_block_t *ctl_block, gnb_ctl_metrics_node_t *metrics_node_array, int node_num, gnb_ctl_metrics_buf_t *buf) {
+    gnb_ctl_status_zone_t  *status_zone  = ctl_block->status_zone;
+    gnb_ctl_latency_zone_t *latency_zone = ctl_block->latency_zone;
+    gnb_ctl_metrics_node_t *metrics_node;
+    gnb_ctl_queue_stats_t *queue_stats;
+    gnb_pf_status_counter_t *pf_status_counter;
+    gnb_latency_histogram_t histogram_st;
+    uint64_t now_sec = (uint64_t)time(NULL);
+    static const double quantiles[3] = { 0.5, 0.99, 0.999 };
+    int i,j;
+
+    metrics_printf(buf, "# HELP gnb_up whether gnb refreshed the ctl block within the keep alive interval\n# TYPE gnb_up gauge\n");
+    metrics_printf(buf, "gnb_up{local_uuid=\"%llu\"} %d\n", ctl_block->core_zone->local_uuid, (now_sec - status_zone->keep_alive_ts_sec) < GNB_CTL_KEEP_ALIVE_TS ? 1:0);
+    metrics_printf(buf, "# HELP gnb_node_num number of nodes in the ctl block\n# TYPE gnb_node_num gauge\n");
+    metrics_printf(buf, "gnb_node_num %d\n", ctl_block->node_zone->node_num);
+
+    metrics_printf(buf, "# HELP gnb_node_info static information of a node\n# TYPE gnb_node_info gauge\n");
+    for ( i=0; i<node_num; i++ ) {
+        metrics_node = &metrics_node_array[i];
+        metrics_printf(buf, "gnb_node_info{node=\"%llu\",tun_ipv4=\"%s\",local=\"%d\"} 1\n", metrics_node->uuid64, metrics_node->tun_ipv4, metrics_node->local);
+    }
+
+    metrics_printf(buf, "# HELP gnb_node_direct whether the node answered a ping directly over the address family\n# TYPE gnb_node_direct gauge\n");
+    for ( i=0; i<node_num; i++ ) {
+        metrics_node = &metrics_node_array[i];
+        if ( metrics_node->local ) {
+            continue;
+        }
+        metrics_printf(buf, "gnb_node_direct{node=\"%llu\",family=\"ipv4\"} %d\n", metrics_node->uuid64, (metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) ? 1:0);
+        metrics_printf(buf, "gnb_node_direct{node=\"%llu\",family=\"ipv6\"} %d\n", metrics_node->uuid64, (metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) ? 1:0);
+    }
+
+    metrics_printf(buf, "# HELP gnb_node_ping_latency_seconds last ping latency of the node\n# TYPE gnb_node_ping_latency_seconds gauge\n");
+    for ( i=0; i<node_num; i++ ) {
+        metrics_node = &metrics_node_array[i];
+        if ( metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG ) {
+            metrics_printf(buf, "gnb_node_ping_latency_seconds{node=\"%llu\",family=\"ipv4\"} %.6f\n", metrics_node->uuid64, (double)metrics_node->addr4_ping_latency_usec / 1000000.0);
+        }
+        if ( metrics_node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG ) {
+            metrics_printf(buf, "gnb_node_ping_latency_seconds{node=\"%llu\",family=\"ipv6\"} %.6f\n", metrics_node->uuid64, (double)metrics_node->addr6_ping_latency_usec / 1000000.0);
+        }
+    }
+
+    METRICS_NODE_COUNTER("gnb_node_in_bytes_total",    in_bytes,    "bytes received from the node");
+    METRICS_NODE_COUNTER("gnb_node_out_bytes_total",   out_bytes,   "bytes sent to the node");
+    METRICS_NODE_COUNTER("gnb_node_in_packets_total",  in_packets,  "packets received from the node");
+    METRICS_NODE_COUNTER("gnb_node_out_packets_total", out_packets, "packets sent to the node");
+
+    metrics_printf(buf, "# HELP gnb_node_drops_total packets of the node dropped by packet filter\n# TYPE gnb_node_drops_total counter\n");
+    for ( i=0; i<node_num; i++ ) {
+        metrics_node = &metrics_node_array[i];
+        for ( j=0; j<GNB_PF_STATUS_NUM; j++ ) {
+            if ( 0 == metrics_node->counter.drops[j] ) {
+                continue;
+            }
+            metrics_printf(buf, "gnb_node_drops_total{node=\"%llu\",status=\"%s\"} %"PRIu64"\n", metrics_node->uuid64, gnb_pf_status_strings[j], metrics_node->counter.drops[j]);
+        }
+    }
+
+    if ( NULL != latency_zone && 0 != latency_zone->ticks_per_sec ) {
+        metrics_printf(buf, "# HELP gnb_stage_latency_seconds per packet latency of a processing stage\n# TYPE gnb_stage_latency_seconds summary\n");
+        for ( i=0; i<GNB_LATENCY_STAGE_NUM && i<latency_zone->stage_num; i++ ) {
+            gnb_ctl_block_latency_sum(ctl_block, i, &histogram_st);
+            for ( j=0; j<3; j++ ) {
+                metrics_printf(buf, "gnb_stage_latency_seconds{stage=\"%s\",quantile=\"%g\"} %.9f\n", gnb_latency_stage_strings[i], quantiles[j],
+                               latency_ticks_to_sec(latency_zone, gnb_latency_percentile(&histogram_st, quantiles[j])));
+            }
+            metrics_printf(buf, "gnb_stage_latency_seconds_sum{stage=\"%s\"} %.9f\n", gnb_latency_stage_strings[i], latency_ticks_to_sec(latency_zone, histogram_st.sum));
+            metrics_printf(buf, "gnb_stage_latency_seconds_count{stage=\"%s\"} %"PRIu64"\n", gnb_latency_stage_strings[i], histogram_st.count);
+        }
+    }
+
+    metrics_printf(buf, "# HELP gnb_drops_total packets dropped by the primary worker\n# TYPE gnb_drops_total counter\n");
+    for ( i=0; i<GNB_CTL_DROP_NUM; i++ ) {
+        metrics_printf(buf, "gnb_drops_total{reason=\"%s\"} %"PRIu64"\n", gnb_ctl_drop_strings[i], status_zone->drop_num[i]);
+    }
+    metrics_printf(buf, "# HELP gnb_pbuf_exhausted_total times the pbuf pool was empty and the payload was copied\n# TYPE gnb_pbuf_exhausted_total counter\n");
+    metrics_printf(buf, "gnb_pbuf_exhausted_total %"PRIu64"\n", status_zone->pbuf_exhausted_num);
+
+    metrics_printf(buf, "# HELP gnb_queue_capacity capacity of a worker ring buffer\n# TYPE gnb_queue_capacity gauge\n");
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        metrics_printf(buf, "gnb_queue_capacity{queue=\"%.32s\",unit=\"%s\"} %u\n", queue_stats->name, GNB_CTL_QUEUE_UNIT_BYTE == queue_stats->unit ? "byte":"block", queue_stats->capacity);
+    }
+    metrics_printf(buf, "# HELP gnb_queue_used current occupancy of a worker ring buffer\n# TYPE gnb_queue_used gauge\n");
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        metrics_printf(buf, "gnb_queue_used{queue=\"%.32s\",unit=\"%s\"} %u\n", queue_stats->name, GNB_CTL_QUEUE_UNIT_BYTE == queue_stats->unit ? "byte":"block", queue_stats->used);
+    }
+    metrics_printf(buf, "# HELP gnb_queue_high_watermark highest occupancy of a worker ring buffer\n# TYPE gnb_queue_high_watermark gauge\n");
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        metrics_printf(buf, "gnb_queue_high_watermark{queue=\"%.32s\",unit=\"%s\"} %u\n", queue_stats->name, GNB_CTL_QUEUE_UNIT_BYTE == queue_stats->unit ? "byte":"block", queue_stats->high_watermark);
+    }
+    metrics_printf(buf, "# HELP gnb_queue_full_total pushes that found a worker ring buffer full\n# TYPE gnb_queue_full_total counter\n");
+    for ( i=0; i<status_zone->queue_num && i<GNB_CTL_QUEUE_STATS_MAX; i++ ) {
+        queue_stats = &status_zone->queue[i];
+        metrics_printf(buf, "gnb_queue_full_total{queue=\"%.32s\"} %"PRIu64"\n", queue_stats->name, queue_stats->full_num);
+    }
+
+    metrics_printf(buf, "# HELP gnb_pf_status_total final packet filter status of packets per worker shard\n# TYPE gnb_pf_status_total counter\n");
+    for ( i=0; i<status_zone->pf_shard_num; i++ ) {
+        pf_status_counter = &status_zone->pf_status_counter[i];
+        for ( j=0; j<GNB_PF_STATUS_NUM; j++ ) {
+            if ( 0 == pf_status_counter->status[j] ) {
+                continue;
+            }
+            metrics_printf(buf, "gnb_pf_status_total{shard=\"%d\",status=\"%s\"} %"PRIu64"\n", i, gnb_pf_status_strings[j], pf_status_counter->status[j]);
+        }
+    }
+}
+
+static void metrics_build(gnb_ctl_block_t *ctl_block, int format, gnb_uuid_t in_nodeid, uint8_t online_opt, gnb_ctl_metrics_buf_t *buf) {
+    gnb_ctl_metrics_node_t *metrics_node_array;
+    int node_num;
+    metrics_node_array = (gnb_ctl_metrics_node_t *)malloc(sizeof(gnb_ctl_metrics_node_t) * (ctl_block->node_zone->node_num + 1));
+    if ( NULL == metrics_node_array ) {
+        return;
+    }
+    node_num = metrics_node_snapshot(ctl_block, in_nodeid, online_opt, metrics_node_array);
+    if ( GNB_CTL_METRICS_PROMETHEUS == format ) {
+        metrics_prometheus(ctl_block, metrics_node_array, node_num, buf);
+    } else {
+        metrics_json(ctl_block, metrics_node_array, node_num, buf);
+    }
+    free(metrics_node_array);
+}
+
+static void metrics_buf_init(gnb_ctl_metrics_buf_t *buf) {
+    buf->size = 1024*64;
+    buf->len  = 0;
+    buf->data = (char *)malloc(buf->size);
+    if ( NULL == buf->data ) {
+        buf->size = 0;
+    }
+}
+
+int gnb_ctl_metrics_format(const char *format_string) {
+    if ( 0 == strncmp(format_string, "prom", 4) ) {
+        return GNB_CTL_METRICS_PROMETHEUS;
+    }
+    if ( 0 == strcmp(format_string, "json") ) {
+        return GNB_CTL_METRICS_JSON;
+    }
+    return -1;
+}
+
+void gnb_ctl_dump_metrics(gnb_ctl_block_t *ctl_block, int format, gnb_uuid_t in_nodeid, uint8_t online_opt) {
+    gnb_ctl_metrics_buf_t buf;
+    metrics_buf_init(&buf);
+    if ( NULL == buf.data ) {
+        return;
+    }
+    metrics_build(ctl_block, format, in_nodeid, online_opt, &buf);
+    fwrite(buf.data, 1, buf.len, stdout);
+    fflush(stdout);
+    free(buf.data);
+}
+
+#ifdef _WIN32
+#define METRICS_CLOSE_SOCKET closesocket
+#else
+#define METRICS_CLOSE_SOCKET close
+#endif
+
+static void metrics_http_send(int fd, const char *data, size_t len) {
+    int n;
+    while ( len > 0 ) {
+        n = send(fd, data, len, 0);
+        if ( n <= 0 ) {
+            return;
+        }
+        data += n;
+        len  -= n;
+    }
+}
+
+static void metrics_http_reply(int fd, const char *status, const char *content_type, gnb_ctl_metrics_buf_t *buf) {
+    char head[256];
+    int head_len;
+    head_len = snprintf(head, sizeof(head), "HTTP/1.0 %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+                        status, content_type, (unsigned long)buf->len);
+    metrics_http_send(fd, head, head_len);
+    metrics_http_send(fd, buf->data, buf->len);
+}
+
+/*
+ 只处理 GET /metrics(prometheus 格式) 和 GET /metrics.json(json lines 格式),
+ 每个连接只响应一个请求, 顺序处理, 每次请求都重新从 ctl_block 读取
+*/
+static void metrics_http_handle(gnb_ctl_block_t *ctl_block, int fd, gnb_uuid_t in_nodeid, uint8_t online_opt, gnb_ctl_metrics_buf_t *buf) {
+    char request[2048];
+    char path[256];
+    int request_len = 0;
+    int n;
+    int format;
+    char *query;
+    #ifdef _WIN32
+    DWORD timeout = 2000;
+    #else
+    struct timeval timeout = { 2, 0 };
+    #endif
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, (const char *)&timeout, sizeof(timeout));
+    while ( request_len < (int)sizeof(request) - 1 ) {
+        n = recv(fd, request + request_len, sizeof(request) - 1 - request_len, 0);
+        if ( n <= 0 ) {
+            return;
+        }
+        request_len += n;
+        request[request_len] = '\0';
+        if ( NULL != strstr(request, "\r\n\r\n") || NULL != strstr(request, "\n\n") ) {
+            break;
+        }
+    }
+    buf->len = 0;
+    if ( 1 != sscanf(request, "GET %255s", path) ) {
+        metrics_printf(buf, "method not allowed\n");
+        metrics_http_reply(fd, "405 Method Not Allowed", "text/plain", buf);
+        return;
+    }
+    query = strchr(path, '?');
+    if ( NULL != query ) {
+        *query = '\0';
+        query++;
+    }
+    if ( 0 == strcmp(path, "/metrics.json") || (0 == strcmp(path, "/metrics") && NULL != query && NULL != strstr(query, "format=json")) ) {
+        format = GNB_CTL_METRICS_JSON;
+    } else if ( 0 == strcmp(path, "/metrics") ) {
+        format = GNB_CTL_METRICS_PROMETHEUS;
+    } else {
+        metrics_printf(buf, "not found\n");
+        metrics_http_reply(fd, "404 Not Found", "text/plain", buf);
+        return;
+    }
+    metrics_build(ctl_block, format, in_nodeid, online_opt, buf);
+    metrics_http_reply(fd, "200 OK", GNB_CTL_METRICS_PROMETHEUS == format ? "text/plain; version=0.0.4" : "application/x-ndjson", buf);
+}
+
+/*
+ listen_string 为 port 或 ipv4:port, 只指定端口时只监听 127.0.0.1
+*/
+int gnb_ctl_metrics_http_serve(gnb_ctl_block_t *ctl_block, const char *listen_string, gnb_uuid_t in_nodeid, uint8_t online_opt) {
+    struct sockaddr_in listen_addr;
+    char host_string[INET_ADDRSTRLEN];
+    const char *port_string;
+    gnb_ctl_metrics_buf_t buf;
+    int listen_fd;
+    int fd;
+    int on = 1;
+    int port;
+
+    memset(&listen_addr, 0, sizeof(struct sockaddr_in));
+    listen_addr.sin_family = AF_INET;
+    port_string = strrchr(listen_string, ':');
+    if ( NULL == port_string ) {
+        snprintf(host_string, INET_ADDRSTRLEN, "127.0.0.1");
+        port_string = listen_string;
+    } else {
+        snprintf(host_string, INET_ADDRSTRLEN, "%.*s", (int)(port_string - listen_string), listen_string);
+        port_string++;
+    }
+    port = atoi(port_string);
+    if ( port <= 0 || port > 65535 || 1 != inet_pton(AF_INET, host_string, &listen_addr.sin_addr) ) {
+        printf("invalid metrics listen address [%s]\n", listen_string);
+        return -1;
+    }
+    listen_addr.sin_port = htons(port);
+
+    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if ( listen_fd < 0 ) {
+        perror("socket");
+        return -1;
+    }
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, (const char *)&on, sizeof(on));
+    if ( 0 != bind(listen_fd, (struct sockaddr *)&listen_addr, sizeof(struct sockaddr_in)) || 0 != listen(listen_fd, 16) ) {
+        perror("metrics listen");
+        METRICS_CLOSE_SOCKET(listen_fd);
+        return -1;
+    }
+
+    #ifndef _WIN32
+    signal(SIGPIPE, SIG_IGN);
+    #endif
+
+    metrics_buf_init(&buf);
+    if ( NULL == buf.data ) {
+        METRICS_CLOSE_SOCKET(listen_fd);
+        return -1;
+    }
+    printf("metrics listen on %s:%d\n", host_string, port);
+
+    while (1) {
+        fd = accept(listen_fd, NULL, NULL);
+        if ( fd < 0 ) {
+            continue;
+        }
+        metrics_http_handle(ctl_block, fd, in_nodeid, online_opt, &buf);
+        METRICS_CLOSE_SOCKET(fd);
+    }
+
+    free(buf.data);
+    METRICS_CLOSE_SOCKET(listen_fd);
+    return 0;
+}
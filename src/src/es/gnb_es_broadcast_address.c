@@ -64,16 +64,19 @@ static void send_address_to_node(gnb_es_ctx *es_ctx, gnb_node_t *src_node, gnb_n
 
     push_addr_frame_t *push_addr_frame = (push_addr_frame_t *)payload->data;
 
+    gnb_node_addr_snapshot_t addr_snapshot;
+    gnb_ctl_block_node_addr_snapshot(src_node, &addr_snapshot);
+
     push_addr_frame->data.node_uuid64 = gnb_htonll(src_node->uuid64);
     memcpy(push_addr_frame->data.node_key, src_node->key512, 64);
 
     push_addr_frame->data.arg0 = 'N';
 
-    memcpy(&push_addr_frame->data.addr6_a, &src_node->udp_sockaddr6.sin6_addr, 16);
-    push_addr_frame->data.port6_a = src_node->udp_sockaddr6.sin6_port;
+    memcpy(&push_addr_frame->data.addr6_a, &addr_snapshot.udp_sockaddr6.sin6_addr, 16);
+    push_addr_frame->data.port6_a = addr_snapshot.udp_sockaddr6.sin6_port;
 
-    memcpy(&push_addr_frame->data.addr4_a, &src_node->udp_sockaddr4.sin_addr.s_addr, 4);
-    push_addr_frame->data.port4_a = src_node->udp_sockaddr4.sin_port;
+    memcpy(&push_addr_frame->data.addr4_a, &addr_snapshot.udp_sockaddr4.sin_addr.s_addr, 4);
+    push_addr_frame->data.port4_a = addr_snapshot.udp_sockaddr4.sin_port;
 
     snprintf(push_addr_frame->data.text,32,"%llu>%llu>%llu", ctl_block->core_zone->local_uuid, src_node->uuid64, dst_node->uuid64);
 
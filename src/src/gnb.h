@@ -45,6 +45,7 @@
 #include "gnb_pf.h"
 #include "gnb_address.h"
 #include "gnb_worker.h"
+#include "gnb_pbuf.h"
 #include "gnb_conf_type.h"
 #include "gnb_node_type.h"
 #include "gnb_ctl_block.h"
@@ -124,6 +125,13 @@ typedef struct _gnb_core_t {
 
 	//route ip frame 类型的 paylaod 的 head size
 	size_t route_frame_head_size;
+
+	//primary worker 把从 tun 读到的 packet 交给 pf worker 时使用, 只在 pf_worker_num > 0 时创建
+	gnb_pbuf_pool_t  *pbuf_pool;
+
+	//从 gnb_pf_mods 复制的 pf 模块, pf 的 private_ctx 与 gnb_core 相关, 同一个进程中的多个 gnb_core 不能共用
+	gnb_pf_array_t   *pf_mod_array;
+
 	gnb_ctl_block_t  *ctl_block;
 	gnb_log_ctx_t    *log;
 } gnb_core_t;
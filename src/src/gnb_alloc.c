@@ -16,120 +16,453 @@
 */
 
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
-#include "gnb_alloc.h"
 
-#ifndef offsetof
-#define offsetof(TYPE, MEMBER) ((size_t) &((TYPE *)0)->MEMBER)
+#if defined(__linux__)
+#include <sys/mman.h>
 #endif
 
-#ifndef container_of
+#include "gnb_alloc.h"
 
-#define container_of(ptr, type, member) ({                                    \
-                      const typeof( ((type *)0)->member ) *__mptr = (ptr);    \
-                       (type *)( (char *)__mptr - offsetof(type,member) );})
-#endif
+struct _gnb_heap_chunk_t {
+    gnb_heap_chunk_t *prev;
+    gnb_heap_chunk_t *next;
+    uint64_t size;
+    uint64_t used;
+    #define GNB_HEAP_CHUNK_MALLOC  0x0
+    #define GNB_HEAP_CHUNK_MMAP    0x1
+    uint64_t type;
+    //向系统申请的内存的起始地址, large chunk 为了对齐可能与 chunk 的地址不同
+    void *memory;
+    unsigned char data[0] __attribute__((aligned(16)));
+};
 
-typedef struct _gnb_heap_fragment_t {
+struct _gnb_heap_block_t {
+    //size class 的大小或 large block 申请的大小
     uint32_t size;
-    uint32_t idx;
-    unsigned char block[0];
-} gnb_heap_fragment_t;
+    uint32_t size_class;
+    gnb_heap_block_t *next;
+    //32 位平台上 block 头只有 12 字节, 按 16 字节对齐 data 使 block 头在所有平台上都是 16 字节
+    unsigned char data[0] __attribute__((aligned(16)));
+};
+
+_Static_assert(sizeof(gnb_heap_block_t) % 16 == 0, "gnb_heap_block_t must keep data 16-byte aligned");
+
+/*
+ large chunk 的 data 固定在 chunk 之后 GNB_HEAP_ALIGNED_SIZE 字节处,
+ chunk 头和 block 头放在这 GNB_HEAP_ALIGNED_SIZE 字节内, block 头紧挨着 data
+*/
+_Static_assert(offsetof(gnb_heap_chunk_t, data) + sizeof(gnb_heap_block_t) <= GNB_HEAP_ALIGNED_SIZE, "large chunk header must fit in GNB_HEAP_ALIGNED_SIZE");
+
+#define GNB_HEAP_BLOCK(p) ((gnb_heap_block_t *)((unsigned char *)(p) - sizeof(gnb_heap_block_t)))
+#define GNB_HEAP_LARGE_CHUNK(p) ((gnb_heap_chunk_t *)((unsigned char *)(p) - GNB_HEAP_ALIGNED_SIZE))
+
+//每个线程每个 size class 最多缓存的 block 数量, 超出时把一半归还到 heap 的 free list
+#define GNB_HEAP_THREAD_CACHE_SIZE  64
+
+typedef struct _gnb_heap_thread_cache_t {
+    uint32_t heap_id;
+    gnb_heap_t *heap;
+    uint32_t num[GNB_HEAP_CLASS_NUM];
+    gnb_heap_block_t *free_list[GNB_HEAP_CLASS_NUM];
+} gnb_heap_thread_cache_t;
+
+static __thread gnb_heap_thread_cache_t gnb_heap_thread_cache;
+
+static uint32_t gnb_heap_id_seq = 0;
+
+static pthread_mutex_t gnb_heap_list_lock = PTHREAD_MUTEX_INITIALIZER;
+static gnb_heap_t *gnb_heap_list = NULL;
+
+static int size_to_class(uint32_t size) {
+    int size_class = 0;
+    uint32_t class_size = 1 << GNB_HEAP_MIN_CLASS_SHIFT;
+    while ( class_size < size ) {
+        class_size <<= 1;
+        size_class++;
+    }
+    return size_class;
+}
+
+static void* chunk_memory_alloc(gnb_heap_t *gnb_heap, size_t size) {
+    void *memory;
+#if defined(__linux__)
+    if ( size >= GNB_HEAP_HUGEPAGE_SIZE ) {
+        if ( 0 != posix_memalign(&memory, GNB_HEAP_HUGEPAGE_SIZE, size) ) {
+            return NULL;
+        }
+        #ifdef MADV_HUGEPAGE
+        madvise(memory, size, MADV_HUGEPAGE);
+        #endif
+        return memory;
+    }
+#endif
+    memory = malloc(size);
+    return memory;
+}
+
+static gnb_heap_chunk_t* chunk_create(gnb_heap_t *gnb_heap) {
+    gnb_heap_chunk_t *chunk = chunk_memory_alloc(gnb_heap, gnb_heap->chunk_size);
+    if ( NULL == chunk ) {
+        return NULL;
+    }
+    chunk->type = GNB_HEAP_CHUNK_MALLOC;
+    chunk->memory = chunk;
+    chunk->prev = NULL;
+    chunk->next = gnb_heap->chunk_list;
+    chunk->size = gnb_heap->chunk_size - sizeof(gnb_heap_chunk_t);
+    chunk->used = 0;
+    gnb_heap->chunk_list = chunk;
+    gnb_heap->chunk_nums++;
+    gnb_heap->ralloc_byte += gnb_heap->chunk_size;
+    return chunk;
+}
 
-gnb_heap_t* gnb_heap_create(uint32_t max_fragment) {
-    gnb_heap_t *gnb_heap = (gnb_heap_t *)malloc( sizeof(gnb_heap_t) + sizeof(gnb_heap_fragment_t) * max_fragment );
+gnb_heap_t* gnb_heap_create(uint32_t chunk_size) {
+    gnb_heap_t *gnb_heap = (gnb_heap_t *)malloc( sizeof(gnb_heap_t) );
     if ( NULL==gnb_heap ) {
         return NULL;
     }
     memset(gnb_heap, 0, sizeof(gnb_heap_t));
-    gnb_heap->max_fragment = max_fragment;
-    gnb_heap->fragment_nums  = 0;
+    //chunk 至少能容纳一个最大 size class 的 block
+    if ( chunk_size < sizeof(gnb_heap_chunk_t) + (sizeof(gnb_heap_block_t) + GNB_HEAP_MAX_CLASS_SIZE) * 2 ) {
+        chunk_size = GNB_HEAP_DEFAULT_CHUNK_SIZE;
+    }
+    gnb_heap->id = __sync_add_and_fetch(&gnb_heap_id_seq, 1);
+    gnb_heap->chunk_size = chunk_size;
+    pthread_mutex_init(&gnb_heap->lock, NULL);
+    pthread_mutex_lock(&gnb_heap_list_lock);
+    gnb_heap->next = gnb_heap_list;
+    gnb_heap_list = gnb_heap;
+    pthread_mutex_unlock(&gnb_heap_list_lock);
     return gnb_heap;
 }
 
+static gnb_heap_block_t* class_block_alloc(gnb_heap_t *gnb_heap, int size_class) {
+    gnb_heap_block_t *block;
+    gnb_heap_chunk_t *chunk;
+    uint32_t class_size = 1 << (size_class + GNB_HEAP_MIN_CLASS_SHIFT);
+    block = gnb_heap->free_list[size_class];
+    if ( NULL != block ) {
+        gnb_heap->free_list[size_class] = block->next;
+        return block;
+    }
+    chunk = gnb_heap->chunk_list;
+    if ( NULL == chunk || chunk->size - chunk->used < sizeof(gnb_heap_block_t) + class_size ) {
+        chunk = chunk_create(gnb_heap);
+        if ( NULL == chunk ) {
+            return NULL;
+        }
+    }
+    block = (gnb_heap_block_t *)(chunk->data + chunk->used);
+    chunk->used += sizeof(gnb_heap_block_t) + class_size;
+    block->size = class_size;
+    block->size_class = size_class;
+    return block;
+}
+
+static void chunk_memory_free(gnb_heap_chunk_t *chunk) {
+#if defined(__linux__)
+    if ( GNB_HEAP_CHUNK_MMAP == chunk->type ) {
+        munmap(chunk, chunk->size);
+        return;
+    }
+#endif
+    free(chunk->memory);
+}
+
+#if defined(__linux__)
+static gnb_heap_chunk_t* chunk_hugepage_alloc(size_t size) {
+    void *memory;
+    size_t map_size;
+    uintptr_t aligned;
+    //MAP_HUGETLB 需要系统预留 huge page
+    #ifdef MAP_HUGETLB
+    memory = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0);
+    if ( MAP_FAILED != memory ) {
+        return (gnb_heap_chunk_t *)memory;
+    }
+    #endif
+    #ifdef MADV_HUGEPAGE
+    //多映射一个 huge page 以便按 2MB 对齐, 再把对齐后前后多余的部分 unmap
+    map_size = size + GNB_HEAP_HUGEPAGE_SIZE;
+    memory = mmap(NULL, map_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if ( MAP_FAILED == memory ) {
+        return NULL;
+    }
+    aligned = ((uintptr_t)memory + GNB_HEAP_HUGEPAGE_SIZE - 1) & ~((uintptr_t)GNB_HEAP_HUGEPAGE_SIZE - 1);
+    if ( aligned > (uintptr_t)memory ) {
+        munmap(memory, aligned - (uintptr_t)memory);
+    }
+    if ( (uintptr_t)memory + map_size > aligned + size ) {
+        munmap((void *)(aligned + size), (uintptr_t)memory + map_size - (aligned + size));
+    }
+    madvise((void *)aligned, size, MADV_HUGEPAGE);
+    return (gnb_heap_chunk_t *)aligned;
+    #else
+    return NULL;
+    #endif
+}
+#endif
+
+static void large_chunk_link(gnb_heap_t *gnb_heap, gnb_heap_chunk_t *chunk) {
+    chunk->prev = NULL;
+    chunk->next = gnb_heap->large_chunk_list;
+    if ( NULL != gnb_heap->large_chunk_list ) {
+        gnb_heap->large_chunk_list->prev = chunk;
+    }
+    gnb_heap->large_chunk_list = chunk;
+    gnb_heap->large_chunk_nums++;
+    gnb_heap->ralloc_byte += chunk->size;
+}
+
+static gnb_heap_block_t* large_chunk_block(gnb_heap_chunk_t *chunk, uint32_t size) {
+    gnb_heap_block_t *block;
+    block = (gnb_heap_block_t *)((unsigned char *)chunk + GNB_HEAP_ALIGNED_SIZE - sizeof(gnb_heap_block_t));
+    block->size = size;
+    block->size_class = GNB_HEAP_LARGE_CLASS;
+    return block;
+}
+
+static gnb_heap_block_t* large_block_alloc(gnb_heap_t *gnb_heap, uint32_t size) {
+    gnb_heap_chunk_t *chunk;
+    void *memory;
+    //多申请 GNB_HEAP_ALIGNED_SIZE 字节用于把 chunk 对齐到 GNB_HEAP_ALIGNED_SIZE
+    size_t chunk_size = GNB_HEAP_ALIGNED_SIZE * 2 + (size_t)size;
+    memory = chunk_memory_alloc(gnb_heap, chunk_size);
+    if ( NULL == memory ) {
+        return NULL;
+    }
+    chunk = (gnb_heap_chunk_t *)(((uintptr_t)memory + GNB_HEAP_ALIGNED_SIZE - 1) & ~((uintptr_t)GNB_HEAP_ALIGNED_SIZE - 1));
+    chunk->type = GNB_HEAP_CHUNK_MALLOC;
+    chunk->memory = memory;
+    chunk->size = chunk_size;
+    chunk->used = chunk_size;
+    large_chunk_link(gnb_heap, chunk);
+    return large_chunk_block(chunk, size);
+}
+
 void* gnb_heap_alloc(gnb_heap_t *gnb_heap, uint32_t size) {
+    gnb_heap_thread_cache_t *cache = &gnb_heap_thread_cache;
+    gnb_heap_block_t *block;
+    int size_class;
     if ( 0 == size ) {
 		printf("gnb_heap_alloc fail size is %u\n", size);
         return NULL;
     }
-    if ( gnb_heap->max_fragment == gnb_heap->fragment_nums ) {
-        printf("gnb_heap_alloc fail heap is full\n");
+    if ( size > GNB_HEAP_MAX_CLASS_SIZE ) {
+        pthread_mutex_lock(&gnb_heap->lock);
+        block = large_block_alloc(gnb_heap, size);
+        if ( NULL != block ) {
+            __sync_add_and_fetch(&gnb_heap->alloc_byte, size);
+        }
+        pthread_mutex_unlock(&gnb_heap->lock);
+        goto finish;
+    }
+    size_class = size_to_class(size);
+    if ( cache->heap == gnb_heap && cache->heap_id == gnb_heap->id && NULL != cache->free_list[size_class] ) {
+        block = cache->free_list[size_class];
+        cache->free_list[size_class] = block->next;
+        cache->num[size_class]--;
+        __sync_add_and_fetch(&gnb_heap->alloc_byte, block->size);
+        goto finish;
+    }
+    pthread_mutex_lock(&gnb_heap->lock);
+    block = class_block_alloc(gnb_heap, size_class);
+    if ( NULL != block ) {
+        __sync_add_and_fetch(&gnb_heap->alloc_byte, block->size);
+    }
+    pthread_mutex_unlock(&gnb_heap->lock);
+
+finish:
+    if ( NULL == block ) {
+		printf("gnb_heap_alloc error malloc false\n");
         return NULL;
     }
-	/*
-    if ( size > (uint32_t)(1024l * 1024l * 1024l * 4) - 1 ) {
-		printf("gnb_heap_alloc fail  alloc memory > %u \n", (uint32_t)(1024l * 1024l * 1024l * 4) - 1);
+    return (void *)block->data;
+}
+
+void* gnb_heap_alloc_aligned(gnb_heap_t *gnb_heap, uint32_t size) {
+    gnb_heap_block_t *block;
+    if ( 0 == size ) {
+		printf("gnb_heap_alloc_aligned fail size is %u\n", size);
         return NULL;
     }
-	*/
-    gnb_heap_fragment_t *fragment = malloc( sizeof(gnb_heap_fragment_t) + sizeof(unsigned char) * size );
-    if ( NULL == fragment ) {
-		printf("gnb_heap_alloc error  malloc false\n");
+    pthread_mutex_lock(&gnb_heap->lock);
+    block = large_block_alloc(gnb_heap, size);
+    if ( NULL != block ) {
+        __sync_add_and_fetch(&gnb_heap->alloc_byte, size);
+    }
+    pthread_mutex_unlock(&gnb_heap->lock);
+    if ( NULL == block ) {
+		printf("gnb_heap_alloc_aligned error malloc false\n");
         return NULL;
     }
-    fragment->idx = gnb_heap->fragment_nums;
-    gnb_heap->fragment_list[ gnb_heap->fragment_nums ] = fragment;
-    gnb_heap->fragment_nums++;
+    return (void *)block->data;
+}
 
-    gnb_heap->alloc_byte  += size;
-    gnb_heap->ralloc_byte += sizeof(gnb_heap_fragment_t)+size;
-    return (void *)fragment->block;
+void* gnb_heap_alloc_hugepage(gnb_heap_t *gnb_heap, uint32_t size) {
+#if defined(__linux__)
+    gnb_heap_chunk_t *chunk;
+    gnb_heap_block_t *block;
+    size_t chunk_size;
+    if ( 0 == size ) {
+        return NULL;
+    }
+    chunk_size = GNB_HEAP_ALIGNED_SIZE + (size_t)size;
+    chunk_size = (chunk_size + GNB_HEAP_HUGEPAGE_SIZE - 1) & ~((size_t)GNB_HEAP_HUGEPAGE_SIZE - 1);
+    chunk = chunk_hugepage_alloc(chunk_size);
+    if ( NULL == chunk ) {
+        goto fallback;
+    }
+    chunk->type = GNB_HEAP_CHUNK_MMAP;
+    chunk->memory = chunk;
+    chunk->size = chunk_size;
+    chunk->used = chunk_size;
+    pthread_mutex_lock(&gnb_heap->lock);
+    large_chunk_link(gnb_heap, chunk);
+    pthread_mutex_unlock(&gnb_heap->lock);
+    __sync_add_and_fetch(&gnb_heap->alloc_byte, size);
+    block = large_chunk_block(chunk, size);
+    return (void *)block->data;
+fallback:
+#endif
+    return gnb_heap_alloc_aligned(gnb_heap, size);
 }
 
-void gnb_heap_free(gnb_heap_t *gnb_heap, void *p){
-    gnb_heap_fragment_t *fragment;
-    if ( 0 == gnb_heap->fragment_nums ) {
-        //发生错误了
-        return;
+static void thread_cache_flush(gnb_heap_t *gnb_heap, gnb_heap_thread_cache_t *cache, int size_class, uint32_t keep_num) {
+    gnb_heap_block_t *block;
+    pthread_mutex_lock(&gnb_heap->lock);
+    while ( cache->num[size_class] > keep_num ) {
+        block = cache->free_list[size_class];
+        cache->free_list[size_class] = block->next;
+        cache->num[size_class]--;
+        block->next = gnb_heap->free_list[size_class];
+        gnb_heap->free_list[size_class] = block;
     }
+    pthread_mutex_unlock(&gnb_heap->lock);
+}
+
+/*
+ 线程 cache 换绑到另一个 heap 前, 把 cache 中的 block 归还到原 heap 的 free list,
+ 原 heap 已经 release 或 clean 过时 block 已随 chunk 释放, 直接丢弃
+*/
+static void thread_cache_rebind(gnb_heap_thread_cache_t *cache, gnb_heap_t *gnb_heap) {
+    gnb_heap_t *owner;
+    gnb_heap_block_t *block;
+    int i;
+    if ( NULL != cache->heap ) {
+        pthread_mutex_lock(&gnb_heap_list_lock);
+        for ( owner = gnb_heap_list; NULL != owner; owner = owner->next ) {
+            if ( owner == cache->heap ) {
+                break;
+            }
+        }
+        if ( NULL != owner ) {
+            pthread_mutex_lock(&owner->lock);
+            if ( owner->id == cache->heap_id ) {
+                for ( i=0; i<GNB_HEAP_CLASS_NUM; i++ ) {
+                    while ( NULL != cache->free_list[i] ) {
+                        block = cache->free_list[i];
+                        cache->free_list[i] = block->next;
+                        block->next = owner->free_list[i];
+                        owner->free_list[i] = block;
+                    }
+                }
+            }
+            pthread_mutex_unlock(&owner->lock);
+        }
+        pthread_mutex_unlock(&gnb_heap_list_lock);
+    }
+    for ( i=0; i<GNB_HEAP_CLASS_NUM; i++ ) {
+        cache->free_list[i] = NULL;
+        cache->num[i] = 0;
+    }
+    cache->heap    = gnb_heap;
+    cache->heap_id = gnb_heap->id;
+}
+
+void gnb_heap_free(gnb_heap_t *gnb_heap, void *p){
+    gnb_heap_thread_cache_t *cache = &gnb_heap_thread_cache;
+    gnb_heap_block_t *block;
+    gnb_heap_chunk_t *chunk;
     if ( NULL == p ) {
         return;
     }
-    fragment = container_of(p, struct _gnb_heap_fragment_t, block);
-    gnb_heap_fragment_t *last_fragment = gnb_heap->fragment_list[gnb_heap->fragment_nums - 1];
-    if ( fragment->idx > (gnb_heap->max_fragment-1)  ) {
-        //发生错误了
+    block = GNB_HEAP_BLOCK(p);
+    if ( GNB_HEAP_LARGE_CLASS == block->size_class ) {
+        chunk = GNB_HEAP_LARGE_CHUNK(p);
+        pthread_mutex_lock(&gnb_heap->lock);
+        if ( NULL != chunk->prev ) {
+            chunk->prev->next = chunk->next;
+        } else {
+            gnb_heap->large_chunk_list = chunk->next;
+        }
+        if ( NULL != chunk->next ) {
+            chunk->next->prev = chunk->prev;
+        }
+        gnb_heap->large_chunk_nums--;
+        __sync_sub_and_fetch(&gnb_heap->alloc_byte, block->size);
+        gnb_heap->ralloc_byte -= chunk->size;
+        pthread_mutex_unlock(&gnb_heap->lock);
+        chunk_memory_free(chunk);
         return;
     }
-    if ( last_fragment->idx > (gnb_heap->max_fragment-1) ) {
+    if ( block->size_class >= GNB_HEAP_CLASS_NUM ) {
         //发生错误了
         return;
     }
-    if ( 1 == gnb_heap->fragment_nums ) {
-        if ( fragment->idx != last_fragment->idx ) {
-            //发生错误了
-            return;
-        }
-        goto finish;
+    __sync_sub_and_fetch(&gnb_heap->alloc_byte, block->size);
+    if ( cache->heap != gnb_heap || cache->heap_id != gnb_heap->id ) {
+        thread_cache_rebind(cache, gnb_heap);
     }
-    if ( last_fragment->idx == fragment->idx ) {
-        goto finish;
+    block->next = cache->free_list[block->size_class];
+    cache->free_list[block->size_class] = block;
+    cache->num[block->size_class]++;
+    if ( cache->num[block->size_class] > GNB_HEAP_THREAD_CACHE_SIZE ) {
+        thread_cache_flush(gnb_heap, cache, block->size_class, GNB_HEAP_THREAD_CACHE_SIZE/2);
     }
-    gnb_heap->alloc_byte -= fragment->size;
-    gnb_heap->ralloc_byte -= (sizeof(gnb_heap_fragment_t)+fragment->size);
-    last_fragment->idx = fragment->idx;
-    gnb_heap->fragment_list[last_fragment->idx] = last_fragment;
-
-finish:
-
-    gnb_heap->fragment_nums--;
-    free(fragment);
 }
 
 void gnb_heap_clean(gnb_heap_t *gnb_heap) {
+    gnb_heap_chunk_t *chunk;
+    gnb_heap_chunk_t *next;
     int i;
-    if ( 0 == gnb_heap->fragment_nums ) {
-        return;
+    pthread_mutex_lock(&gnb_heap->lock);
+    for ( chunk = gnb_heap->chunk_list; NULL != chunk; chunk = next ) {
+        next = chunk->next;
+        chunk_memory_free(chunk);
     }
-    for ( i=0; i < gnb_heap->fragment_nums; i++ ) {
-        free(gnb_heap->fragment_list[i]);
+    for ( chunk = gnb_heap->large_chunk_list; NULL != chunk; chunk = next ) {
+        next = chunk->next;
+        chunk_memory_free(chunk);
     }
-    gnb_heap->fragment_nums = 0;
+    gnb_heap->chunk_list = NULL;
+    gnb_heap->large_chunk_list = NULL;
+    for ( i=0; i<GNB_HEAP_CLASS_NUM; i++ ) {
+        gnb_heap->free_list[i] = NULL;
+    }
+    gnb_heap->chunk_nums = 0;
+    gnb_heap->large_chunk_nums = 0;
     gnb_heap->alloc_byte  = 0;
     gnb_heap->ralloc_byte = 0;
+    //其他线程 cache 中的 block 已经随 chunk 释放, 更换 id 使这些 cache 失效
+    gnb_heap->id = __sync_add_and_fetch(&gnb_heap_id_seq, 1);
+    pthread_mutex_unlock(&gnb_heap->lock);
 }
 
 void gnb_heap_release(gnb_heap_t *gnb_heap) {
+    gnb_heap_t **pp;
+    pthread_mutex_lock(&gnb_heap_list_lock);
+    for ( pp = &gnb_heap_list; NULL != *pp; pp = &(*pp)->next ) {
+        if ( *pp == gnb_heap ) {
+            *pp = gnb_heap->next;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&gnb_heap_list_lock);
     gnb_heap_clean(gnb_heap);
+    pthread_mutex_destroy(&gnb_heap->lock);
     free(gnb_heap);
 }
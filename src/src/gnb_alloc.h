@@ -20,20 +20,65 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
 
-typedef struct _gnb_heap_fragment_t gnb_heap_fragment_t;
+/*
+ gnb_heap 是一个 arena 分配器:
+ 不大于 GNB_HEAP_MAX_CLASS_SIZE 的内存按 2 的幂次分为若干 size class,
+ 从 chunk_size 大小的 chunk 中顺序切分，释放后挂到对应 size class 的 free list 中复用;
+ 大于 GNB_HEAP_MAX_CLASS_SIZE 的内存单独分配一个 chunk, 释放时直接归还系统
+ 每个线程对每个 size class 有一个小的 cache, 线程 cache 命中时不需要加锁
+ chunk_size 不小于 GNB_HEAP_HUGEPAGE_SIZE 时, linux 下 chunk 按 huge page 对齐并通过 madvise 申请使用透明大页
+ size class 分配的内存按 16 字节对齐, large chunk 和 gnb_heap_alloc_aligned 分配的内存按 GNB_HEAP_ALIGNED_SIZE 对齐
+*/
+
+#define GNB_HEAP_MIN_CLASS_SHIFT      4
+#define GNB_HEAP_MAX_CLASS_SHIFT      12
+#define GNB_HEAP_MAX_CLASS_SIZE       (1 << GNB_HEAP_MAX_CLASS_SHIFT)
+#define GNB_HEAP_CLASS_NUM            (GNB_HEAP_MAX_CLASS_SHIFT - GNB_HEAP_MIN_CLASS_SHIFT + 1)
+#define GNB_HEAP_LARGE_CLASS          0xFF
+
+//cache line 大小, 与 gnb_type.h 中的 GNB_CACHE_LINE_SIZE 一致
+#define GNB_HEAP_ALIGNED_SIZE         64
+
+#define GNB_HEAP_DEFAULT_CHUNK_SIZE   (1024*64)
+#define GNB_HEAP_HUGEPAGE_SIZE        (1024*1024*2)
+
+typedef struct _gnb_heap_chunk_t   gnb_heap_chunk_t;
+typedef struct _gnb_heap_block_t   gnb_heap_block_t;
 
 typedef struct _gnb_heap_t {
-    uint32_t max_fragment;
-    uint32_t fragment_nums;
-    uint32_t alloc_byte;
-    uint32_t ralloc_byte;
-    gnb_heap_fragment_t *fragment_list[0];
+    uint32_t id;
+    uint32_t chunk_size;
+    pthread_mutex_t lock;
+    //顺序切分的 chunk 链表, 第一个是当前使用的 chunk
+    gnb_heap_chunk_t *chunk_list;
+    //单独分配的 large chunk 双向链表
+    gnb_heap_chunk_t *large_chunk_list;
+    gnb_heap_block_t *free_list[GNB_HEAP_CLASS_NUM];
+    uint32_t chunk_nums;
+    uint32_t large_chunk_nums;
+    //用户申请的字节数
+    uint64_t alloc_byte;
+    //实际向系统申请的字节数
+    uint64_t ralloc_byte;
+    //所有存活的 heap 的链表, 线程 cache 换绑 heap 时据此把 block 归还到原 heap
+    struct _gnb_heap_t *next;
 } gnb_heap_t;
 
-gnb_heap_t* gnb_heap_create(uint32_t max_fragment);
+gnb_heap_t* gnb_heap_create(uint32_t chunk_size);
 
 void* gnb_heap_alloc(gnb_heap_t *gnb_heap, uint32_t size);
+/*
+ 分配的内存按 GNB_HEAP_ALIGNED_SIZE 对齐, 用于带 GNB_CACHE_ALIGNED 成员的结构体,
+ 总是单独分配一个 large chunk, 不要用于频繁分配的小对象
+*/
+void* gnb_heap_alloc_aligned(gnb_heap_t *gnb_heap, uint32_t size);
+/*
+ 分配的内存以 2MB huge page 为单位向系统申请, 优先使用 MAP_HUGETLB,
+ 系统没有预留 huge page 时使用 transparent huge page, 都不支持时与 gnb_heap_alloc_aligned 相同
+*/
+void* gnb_heap_alloc_hugepage(gnb_heap_t *gnb_heap, uint32_t size);
 void gnb_heap_free(gnb_heap_t *gnb_heap, void *p);
 void gnb_heap_clean(gnb_heap_t *gnb_heap);
 void gnb_heap_release(gnb_heap_t *gnb_heap);
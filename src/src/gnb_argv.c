@@ -112,6 +112,17 @@ void gnb_setup_es_argv(char *es_argv_string);
 
 #define SET_SAFE_INDEX                 (GNB_OPT_INIT + 52)
 
+#define SET_HUGEPAGE                   (GNB_OPT_INIT + 53)
+
+#define SET_ZIP_TYPE                   (GNB_OPT_INIT + 54)
+#define SET_ZIP_DICT                   (GNB_OPT_INIT + 55)
+#define SET_HEADER_ZIP                 (GNB_OPT_INIT + 56)
+#define SET_RELAY_CUT_THROUGH          (GNB_OPT_INIT + 57)
+#define SET_PEER_SOCKET                (GNB_OPT_INIT + 58)
+#define SET_LOG_ASYNC                  (GNB_OPT_INIT + 59)
+#define SET_LATENCY_STATS              (GNB_OPT_INIT + 60)
+#define SET_FLIGHT_RECORD              (GNB_OPT_INIT + 61)
+
 gnb_arg_list_t *gnb_es_arg_list;
 
 int is_self_test = 0;
@@ -166,6 +177,11 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
     conf->crypto_passcode[0] = 0xFE;
 
     conf->zip_level = 0;
+    conf->zip_type  = GNB_ZIP_TYPE_ZLIB;
+    conf->header_zip = 0;
+
+    conf->relay_cut_through = 0;
+    conf->peer_socket = 0;
 
     conf->memory = GNB_MEMORY_SCALE_TINY;
 
@@ -173,8 +189,11 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
     conf->multi_forward_type = GNB_MULTI_ADDRESS_TYPE_SIMPLE_LOAD_BALANCE;
 
     conf->if_dump = 0;
+    conf->latency_stats = 0;
+    conf->flight_record_num = 1024;
 
     conf->log_udp_type = GNB_LOG_UDP_TYPE_BINARY;
+    conf->log_async = 0;
 
     conf->console_log_level = GNB_LOG_LEVEL_UNSET;
     conf->file_log_level    = GNB_LOG_LEVEL_UNSET;
@@ -208,6 +227,7 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
     conf->address_detect_interval_usec = GNB_ADDRESS_DETECT_INTERVAL_USEC;
     conf->full_detect_interval_sec     = GNB_FULL_DETECT_INTERVAL_SEC;
     conf->safe_index = 0;
+    conf->hugepage = 0;
     conf->daemon = 0;
     conf->systemd_daemon = 0;
 
@@ -274,11 +294,16 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
       { "crypto",   required_argument, 0, SET_CRYPTO_TYPE },
       { "passcode", required_argument, 0, 'p' },
       { "crypto-key-update-interval", required_argument,  0, SET_CRYPTO_KEY_UPDATE_INTERVAL },
+      { "relay-cut-through", required_argument,  0, SET_RELAY_CUT_THROUGH },
 
       { "zip",       required_argument,  0, SET_ZIP },
       { "zip-level", required_argument,  0, SET_ZIP_LEVEL },
+      { "zip-type",  required_argument,  0, SET_ZIP_TYPE },
+      { "zip-dict",  required_argument,  0, SET_ZIP_DICT },
+      { "header-zip", required_argument, 0, SET_HEADER_ZIP },
 
       { "memory",    required_argument,  0, SET_MEMORY_SCALE },
+      { "hugepage",  required_argument,  0, SET_HUGEPAGE },
 
       { "multi-index-type",    required_argument,  0, SET_MULTI_INDEX_TYPE },
       { "multi-forward-type",  required_argument,  0, SET_MULTI_FORWARD_TYPE },
@@ -288,6 +313,8 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
       { "listen",              required_argument,  0, 'l' },
       { "ctl-block",           required_argument,  0, 'b' },
       { "if-dump",             required_argument,  0, SET_IF_DUMP },
+      { "latency-stats",       required_argument,  0, SET_LATENCY_STATS },
+      { "flight-record",       required_argument,  0, SET_FLIGHT_RECORD },
 
       { "ipv4-only", no_argument,   0, '4'},
       { "ipv6-only", no_argument,   0, '6'},
@@ -323,6 +350,7 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
       { "pf-worker",                 required_argument,  0, SET_PF_WORKER_NUM },
 
       { "multi-socket",              required_argument,  0,  SET_MULTI_SOCKET },
+      { "peer-socket",               required_argument,  0,  SET_PEER_SOCKET },
 
       { "ur0",                       required_argument,  0,  SET_UR0 },
       { "ur1",                       required_argument,  0,  SET_UR1 },
@@ -342,6 +370,7 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
       { "log-udp4",                  optional_argument,  &flag, SET_LOG_UDP4 },
 
       { "log-udp-type",              required_argument,  0,   SET_LOG_UDP_TYPE },
+      { "log-async",                 required_argument,  0,   SET_LOG_ASYNC },
 
       { "console-log-level",         required_argument,  0,   SET_CONSOLE_LOG_LEVEL },
       { "file-log-level",            required_argument,  0,   SET_FILE_LOG_LEVEL },
@@ -490,6 +519,13 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
                 conf->log_udp_type = GNB_LOG_UDP_TYPE_TEXT;
             }
             break;
+        case SET_LOG_ASYNC:
+            if ( !strncmp(optarg, "off", 3) ) {
+                conf->log_async = 0;
+            } else {
+                conf->log_async = 1;
+            }
+            break;
         case SET_CONSOLE_LOG_LEVEL:
             conf->console_log_level = (uint8_t)strtoul(optarg, NULL, 10);
             break;
@@ -550,6 +586,23 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
                 conf->zip_level = -1;
             }
             break;
+        case SET_ZIP_TYPE:
+            if ( !strncmp(optarg, "lz4", sizeof("lz4")-1) ) {
+                conf->zip_type = GNB_ZIP_TYPE_LZ4;
+            } else {
+                conf->zip_type = GNB_ZIP_TYPE_ZLIB;
+            }
+            break;
+        case SET_ZIP_DICT:
+            snprintf(conf->zip_dict_file, PATH_MAX+NAME_MAX, "%s", optarg);
+            break;
+        case SET_HEADER_ZIP:
+            if ( !strncmp(optarg, "on", 2) ) {
+                conf->header_zip = 1;
+            } else {
+                conf->header_zip = 0;
+            }
+            break;
         case SET_MEMORY_SCALE:
             if ( !strncmp(optarg, "tiny", 16) ) {
                 conf->memory = GNB_MEMORY_SCALE_TINY;
@@ -563,6 +616,13 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
                 conf->memory = GNB_MEMORY_SCALE_TINY;
             }
             break;
+        case SET_HUGEPAGE:
+            if ( !strncmp(optarg, "on", sizeof("on")-1) ) {
+                conf->hugepage = 1;
+            } else {
+                conf->hugepage = 0;
+            }
+            break;
         case SET_MULTI_INDEX_TYPE:
             if ( !strncmp(optarg, "simple-fault-tolerant", 16) ) {
                 conf->multi_index_type = GNB_MULTI_ADDRESS_TYPE_SIMPLE_FAULT_TOLERANT;
@@ -594,6 +654,20 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
                 conf->crypto_key_update_interval = GNB_CRYPTO_KEY_UPDATE_INTERVAL_NONE;
             }
             break;
+        case SET_RELAY_CUT_THROUGH:
+            if ( !strncmp(optarg, "on", 2) ) {
+                conf->relay_cut_through = 1;
+            } else {
+                conf->relay_cut_through = 0;
+            }
+            break;
+        case SET_PEER_SOCKET:
+            if ( !strncmp(optarg, "on", 2) ) {
+                conf->peer_socket = 1;
+            } else {
+                conf->peer_socket = 0;
+            }
+            break;
         case SET_MULTI_SOCKET:
             if ( !strncmp(optarg, "on", 2) ) {
                 conf->multi_socket = 1;
@@ -709,6 +783,16 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
                 conf->if_dump = 0;
             }
             break;
+        case SET_LATENCY_STATS:
+            if ( !strncmp(optarg, "on", 2) ) {
+                conf->latency_stats = 1;
+            } else {
+                conf->latency_stats = 0;
+            }
+            break;
+        case SET_FLIGHT_RECORD:
+            conf->flight_record_num = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
         case SET_SOCKET_IF_NAME:
             snprintf(conf->socket_ifname, 16, "%s", optarg);
             break;
@@ -778,27 +862,27 @@ gnb_conf_t* gnb_argv(int argc,char *argv[]) {
 	switch (conf->memory) {
 	case GNB_MEMORY_SCALE_TINY:
 		conf->payload_block_size = 1024*8;
-		conf->max_heap_fragment  = 1024*8;
+		conf->heap_chunk_size    = 1024*64;
 		conf->index_service_lru_size = 1024*2;
 		break;
 	case GNB_MEMORY_SCALE_SMALL:
 		conf->payload_block_size = 1024*16;
-		conf->max_heap_fragment  = 1024*16;
+		conf->heap_chunk_size    = 1024*256;
 		conf->index_service_lru_size = 1024*4;
 		break;
 	case GNB_MEMORY_SCALE_LARGE:
 		conf->payload_block_size = 1024*32;
-		conf->max_heap_fragment  = 1024*32;
+		conf->heap_chunk_size    = 1024*1024;
 		conf->index_service_lru_size = 1024*32;
 		break;
 	case GNB_MEMORY_SCALE_HUGE:
 		conf->payload_block_size = 1024*64;
-		conf->max_heap_fragment  = 1024*64;
+		conf->heap_chunk_size    = 1024*1024*2;
 		conf->index_service_lru_size = 1024*64;
 		break;
 	default:
 		conf->payload_block_size = 1024*8;
-		conf->max_heap_fragment  = 1024*8;
+		conf->heap_chunk_size    = 1024*64;
 		conf->index_service_lru_size = 1024*2;
 		break;
 	}
@@ -973,10 +1057,14 @@ static void show_useage(int argc,char *argv[]) {
     printf("      --mtu                         TUN Device MTU ipv4:532~1500,ipv6:1280~1500\n");
     printf("      --crypto                      ip frame crypto \"xor\",\"arc4\",\"none\" default:\"xor\"\n");
     printf("      --crypto-key-update-interval  crypto key update interval, \"hour\",\"minute\",none default:\"none\"\n");
+    printf("      --relay-cut-through           relay node only decrypt and encrypt the relay header \"on\",\"off\" default:\"off\"\n");
     printf("      --multi-index-type            \"simple-fault-tolerant\",\"simple-load-balance\",\"full\" default:\"simple-load-balance\"\n");
 
     printf("      --zip                         \"auto\", \"force\" default:\"auto\"\n");
     printf("      --zip-level                   \"0\": no compression \"1\": best speed,\"9\": best compression\n");
+    printf("      --zip-type                    \"zlib\", \"lz4\" default:\"zlib\"\n");
+    printf("      --zip-dict                    lz4 dictionary file, relative to conf dir\n");
+    printf("      --header-zip                  ip/udp/tcp header compression \"on\",\"off\" default:\"off\"\n");
 
     printf("      --multi-forward-type          \"simple-fault-tolerant\",\"simple-load-balance\" default:\"simple-fault-tolerant\"\n");
 
@@ -990,11 +1078,14 @@ static void show_useage(int argc,char *argv[]) {
 
     printf("      --address-secure              hide part of ip address in logs \"on\",\"off\" default:\"on\"\n");
     printf("      --if-dump                     dump the interface data frame \"on\",\"off\" default:\"off\"\n");
+    printf("      --latency-stats               record per stage latency histograms in ctl block \"on\",\"off\" default:\"off\"\n");
+    printf("      --flight-record               [0-65536] number of recent packets each pf worker records in ctl block, 0 to disable default:1024\n");
     printf("      --pf-route                    packet filter route\n");
 	printf("      --pf-route-bits               pf route 32bits options 0x1:forwading without key exchange\n");
 
     printf("      --safe-index                  \"on\",\"off\" default:\"off\"\n");
     printf("      --multi-socket                \"on\",\"off\" default:\"off\"\n");
+    printf("      --peer-socket                 connected udp socket for each p2p node \"on\",\"off\" default:\"off\"\n");
 
     printf("      --standard-forwarding         \"on\",\"off\" default:\"on\"\n");
     printf("      --direct-forwarding           \"on\",\"off\" default:\"on\"\n");
@@ -1008,6 +1099,7 @@ static void show_useage(int argc,char *argv[]) {
     #endif
 
     printf("      --memory                      \"tiny\",\"small\",\"large\",\"huge\" default:\"tiny\"\n");
+    printf("      --hugepage                    back ctl block and packet filter worker queue with 2MB huge pages \"on\",\"off\" default:\"off\"\n");
     printf("      --ur0                         universal relay type 0 \"on\",\"off\" default:\"off\"\n");
     printf("      --ur1                         universal relay type 1 \"on\",\"off\" default:\"off\"\n");
     printf("      --pid-file                    pid file\n");
@@ -1015,6 +1107,7 @@ static void show_useage(int argc,char *argv[]) {
     printf("      --log-file-path               log file path\n");
     printf("      --log-udp4                    send log to the address ipv4 default:\"127.0.0.1:8666\"\n");
     printf("      --log-udp-type                log udp type \"binary\",\"text\" default:\"binary\"\n");
+    printf("      --log-async                   format and output log in a writer thread \"on\",\"off\" default:\"off\"\n");
     printf("      --console-log-level           log console level 0-3\n");
     printf("      --file-log-level              log file level    0-3\n" );
     printf("      --udp-log-level               log udp level     0-3\n");
@@ -373,6 +373,18 @@ void local_node_file_config(gnb_conf_t *conf) {
                 conf->multi_socket = 0;
             }
         }
+        if ( !strncmp(line_buffer, "peer-socket", sizeof("peer-socket")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %4s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "peer-socket", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "on", sizeof("on")-1) ) {
+                conf->peer_socket = 1;
+            } else {
+                conf->peer_socket = 0;
+            }
+        }
         if ( !strncmp(line_buffer, "standard-forwarding", sizeof("standard-forwarding")-1) ) {
             num = sscanf(line_buffer,"%32[^ ] %4s", field, value);
             if ( 2 != num ) {
@@ -614,6 +626,37 @@ void local_node_file_config(gnb_conf_t *conf) {
                 conf->log_udp_type = GNB_LOG_UDP_TYPE_TEXT;
             }
         }
+        if ( !strncmp(line_buffer, "latency-stats", sizeof("latency-stats")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %4s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "latency-stats", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "on", sizeof("on")-1) ) {
+                conf->latency_stats = 1;
+            } else {
+                conf->latency_stats = 0;
+            }
+        }
+        if ( !strncmp(line_buffer, "flight-record", sizeof("flight-record")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %u", field, &conf->flight_record_num);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "flight-record", node_conf_file);
+                exit(1);
+            }
+        }
+        if ( !strncmp(line_buffer, "log-async", sizeof("log-async")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %4s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "log-async", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "off", sizeof("off")-1) ) {
+                conf->log_async = 0;
+            } else {
+                conf->log_async = 1;
+            }
+        }
         if ( !strncmp(line_buffer, "console-log-level", sizeof("console-log-level")-1) ) {
             num = sscanf(line_buffer, "%32[^ ] %u", field, &log_level);
             if ( 2 != num ) {
@@ -732,7 +775,20 @@ void local_node_file_config(gnb_conf_t *conf) {
                 conf->pf_bits |= GNB_PF_BITS_CRYPTO_XOR;
             }
         }
-        if (!strncmp(line_buffer, "zip", sizeof("zip")-1) ) {
+        if ( !strncmp(line_buffer, "relay-cut-through", sizeof("relay-cut-through")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %10s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "relay-cut-through", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "on", sizeof("on")-1) ) {
+                conf->relay_cut_through = 1;
+            } else {
+                conf->relay_cut_through = 0;
+            }
+        }
+        //不能匹配 zip-level 和 zip-type
+        if (!strncmp(line_buffer, "zip", sizeof("zip")-1) && '-' != line_buffer[sizeof("zip")-1] ) {
             num = sscanf(line_buffer,"%32[^ ] %10s", field, value);
             if ( 2 != num ) {
                 printf("config %s error in [%s]\n", "zip", node_conf_file);
@@ -760,6 +816,37 @@ void local_node_file_config(gnb_conf_t *conf) {
             }
             conf->zip_level = value_int;
         }
+        if ( !strncmp(line_buffer, "zip-type", sizeof("zip-type")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %10s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "zip-type", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "lz4", sizeof("lz4")-1) ) {
+                conf->zip_type = GNB_ZIP_TYPE_LZ4;
+            } else {
+                conf->zip_type = GNB_ZIP_TYPE_ZLIB;
+            }
+        }
+        if ( !strncmp(line_buffer, "header-zip", sizeof("header-zip")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %10s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "header-zip", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "on", sizeof("on")-1) ) {
+                conf->header_zip = 1;
+            } else {
+                conf->header_zip = 0;
+            }
+        }
+        if ( !strncmp(line_buffer, "zip-dict", sizeof("zip-dict")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %s", field, conf->zip_dict_file);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "zip-dict", node_conf_file);
+                exit(1);
+            }
+        }
         if ( !strncmp(line_buffer, "memory", sizeof("memory")-1) ) {
             num = sscanf(line_buffer, "%32[^ ] %16s", field, value);
             if ( 2 != num ) {
@@ -778,6 +865,18 @@ void local_node_file_config(gnb_conf_t *conf) {
                 conf->memory = GNB_MEMORY_SCALE_TINY;
             }
         }
+        if ( !strncmp(line_buffer, "hugepage", sizeof("hugepage")-1) ) {
+            num = sscanf(line_buffer, "%32[^ ] %4s", field, value);
+            if ( 2 != num ) {
+                printf("config %s error in [%s]\n", "hugepage", node_conf_file);
+                exit(1);
+            }
+            if ( !strncmp(value, "on", sizeof("on")-1) ) {
+                conf->hugepage = 1;
+            } else {
+                conf->hugepage = 0;
+            }
+        }
         if ( !strncmp(line_buffer, "ur0", sizeof("ur0")-1) ) {
             num = sscanf(line_buffer, "%32[^ ] %4s", field, value);
             if ( 2 != num ) {
@@ -820,27 +919,27 @@ void local_node_file_config(gnb_conf_t *conf) {
     switch (conf->memory) {
     case GNB_MEMORY_SCALE_TINY:
         conf->payload_block_size = 1024*8;
-        conf->max_heap_fragment  = 1024*8;
+        conf->heap_chunk_size    = 1024*64;
         conf->index_service_lru_size = 1024*2;
         break;
     case GNB_MEMORY_SCALE_SMALL:
         conf->payload_block_size = 1024*16;
-        conf->max_heap_fragment  = 1024*16;
+        conf->heap_chunk_size    = 1024*256;
 		conf->index_service_lru_size = 1024*4;
         break;
     case GNB_MEMORY_SCALE_LARGE:
         conf->payload_block_size = 1024*32;
-        conf->max_heap_fragment  = 1024*32;
+        conf->heap_chunk_size    = 1024*1024;
 		conf->index_service_lru_size = 1024*32;
         break;
     case GNB_MEMORY_SCALE_HUGE:
         conf->payload_block_size = 1024*64;
-        conf->max_heap_fragment  = 1024*64;
+        conf->heap_chunk_size    = 1024*1024*2;
 		conf->index_service_lru_size = 1024*64;
         break;
     default:
         conf->payload_block_size = 1024*8;
-        conf->max_heap_fragment  = 1024*8;
+        conf->heap_chunk_size    = 1024*64;
 		conf->index_service_lru_size = 1024*2;
         break;
     }
@@ -32,6 +32,7 @@
 #define GNB_PF_BITS_NONE            (0x0)
 #define GNB_PF_BITS_CRYPTO_XOR      (0x1)
 #define GNB_PF_BITS_CRYPTO_ARC4     (0x1 << 1)
+#define GNB_PF_BITS_RELAY_CUT_THROUGH (0x1 << 2)  //relay payload 使用 cut-through 模式逐跳加密
 #define GNB_PF_BITS_ZIP             (0x1 << 4)
 #define GNB_PF_BITS_7               (0x1 << 7)
 
@@ -78,6 +79,8 @@ typedef struct _gnb_conf_t {
 	uint8_t detect_log_level;
 
 	uint8_t log_udp_type;
+	//日志由 writer 线程异步格式化和输出
+	uint8_t log_async;
 	char log_udp_sockaddress4_string[16 + 1 + sizeof("65535") + 1];
 
 	char ifname[256];
@@ -89,6 +92,9 @@ typedef struct _gnb_conf_t {
 	unsigned char pf_bits;
 	unsigned char crypto_key_update_interval;
 	unsigned char crypto_passcode[4];
+
+	//relay payload 逐跳加密时只加密 route frame head 和 relay node id, 同一条 relay 路径上的节点需要使用相同的设置
+	uint8_t relay_cut_through;
 	
     #define GNB_ZIP_AUTO   0
     #define GNB_ZIP_FORCE  1
@@ -96,22 +102,43 @@ typedef struct _gnb_conf_t {
 
 	int8_t zip_level; // 0:Z_NO_COMPRESSION 9:Z_BEST_COMPRESSION -1 Z_DEFAULT_COMPRESSION
 
+    //zip_level 不为 0 时使用的压缩 pf 模块
+    #define GNB_ZIP_TYPE_ZLIB  0
+    #define GNB_ZIP_TYPE_LZ4   1
+	uint8_t zip_type;
+
+    //lz4 压缩使用的字典, 相对路径以 conf_dir 为起点, 通信的双方需要使用相同的字典
+    char zip_dict_file[PATH_MAX+NAME_MAX];
+
+    //ip udp tcp 首部压缩
+    uint8_t header_zip;
+
     #define  GNB_MEMORY_SCALE_TINY    (0x1)
     #define  GNB_MEMORY_SCALE_SMALL   (0x2)
     #define  GNB_MEMORY_SCALE_LARGE   (0x3)
     #define  GNB_MEMORY_SCALE_HUGE    (0x4)
     unsigned char memory;
 
+    //ctl_block 和 pf worker ring 使用 2MB huge page
+    uint8_t hugepage;
+
 	uint32_t index_service_lru_size;
     uint32_t payload_block_size;
-    uint32_t max_heap_fragment;
+    //gnb_heap 每次向系统申请的 chunk 大小
+    uint32_t heap_chunk_size;
 
 	unsigned char multi_index_type;
 	unsigned char multi_forward_type;
 
 	unsigned char if_dump;
+	//在 ctl_block 的 latency_zone 中统计各个处理阶段的耗时
+	uint8_t latency_stats;
+	//ctl_block 的 flight_zone 中每个 pf worker 保留的记录数, 为 0 时不记录
+	uint32_t flight_record_num;
 	unsigned char udp_socket_type;
 	uint8_t multi_socket;
+	//为 P2P 通信中的节点打开 connect 到对端地址的 udp socket
+	uint8_t peer_socket;
 	//用户自定义的 packet filter 模块
 	char pf_route[NAME_MAX];
 	//用户自定义的 packet filter 模块启动选项
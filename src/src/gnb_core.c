@@ -49,6 +49,8 @@
 void gnb_set_env(const char *name, const char *value);
 void log_out_description(gnb_log_ctx_t *log);
 
+gnb_pf_array_t* gnb_pf_mod_array_create(gnb_heap_t *heap);
+
 extern  gnb_arg_list_t *gnb_es_arg_list;
 extern int is_verbose;
 extern int is_trace;
@@ -64,6 +66,7 @@ static void gnb_setup_env(gnb_core_t *gnb_core) {
 
 static void init_ctl_block(gnb_core_t *gnb_core, gnb_conf_t *conf) {
     gnb_mmap_block_t *mmap_block;
+    int mmap_type;
     void *memory;
     size_t node_num = 0;
     if ( 0 == conf->public_index_service && 0 == conf->lite_mode ) {
@@ -83,20 +86,31 @@ static void init_ctl_block(gnb_core_t *gnb_core, gnb_conf_t *conf) {
 	/*
     (1 + conf->pf_worker_num) 是为  gnb_ctl_core_zone_t 中的 pf_worker_payload_blocks 预留 share memory 空间中 (primary_worker + pf_worker) 个 memmory block
     primary_worker 所使用的是 pf_worker_payload_blocks 第1块,后面的块由 pf_worker 依次占用 
-    sizeof(gnb_block32_t) * 5 是 share memory 中ctl_block 有5个 zone 的 gnb_block32_t 结构占用的空间
+    sizeof(gnb_block32_t) * 6 是 share memory 中ctl_block 有6个 zone 的 gnb_block32_t 结构占用的空间
+    GNB_CACHE_LINE_SIZE * 3 是 status_zone node_zone 和 counter_zone 按 cache line 对齐所需的填充空间
+    counter_zone 中 primary_worker 和每个 pf_worker 各有一个 shard
+    打开 latency_stats 时再多一个 latency_zone, 同样按 cache line 对齐
+    flight_record_num 不为 0 时再多一个 flight_zone, 同样按 cache line 对齐
     */
     size_t block_size = sizeof(uint32_t)*256 + sizeof(gnb_ctl_magic_number_t) + sizeof(gnb_ctl_conf_zone_t) + sizeof(gnb_ctl_core_zone_t) + 
                         (sizeof(gnb_payload16_t) + conf->payload_block_size + sizeof(gnb_payload16_t) + conf->payload_block_size) * (1 + conf->pf_worker_num) +
-                        sizeof(gnb_ctl_status_zone_t) + sizeof(gnb_ctl_node_zone_t) + sizeof(gnb_node_t)*node_num + sizeof(gnb_block32_t) * 5;
+                        gnb_ctl_status_zone_size(conf->pf_worker_num) + sizeof(gnb_ctl_node_zone_t) + sizeof(gnb_node_t)*node_num +
+                        gnb_ctl_counter_zone_size(node_num, conf->pf_worker_num) + sizeof(gnb_block32_t) * 6 + GNB_CACHE_LINE_SIZE * 3 +
+                        gnb_ctl_latency_zone_size(conf->pf_worker_num, conf->latency_stats) + sizeof(gnb_block32_t) + GNB_CACHE_LINE_SIZE +
+                        gnb_ctl_flight_zone_size(conf->pf_worker_num, conf->flight_record_num) + sizeof(gnb_block32_t) + GNB_CACHE_LINE_SIZE;
 
     unlink(conf->map_file);
-    mmap_block = gnb_mmap_create(conf->map_file, block_size, GNB_MMAP_TYPE_READWRITE|GNB_MMAP_TYPE_CREATE);
+    mmap_type = GNB_MMAP_TYPE_READWRITE|GNB_MMAP_TYPE_CREATE;
+    if ( conf->hugepage ) {
+        mmap_type |= GNB_MMAP_TYPE_HUGEPAGE;
+    }
+    mmap_block = gnb_mmap_create(conf->map_file, block_size, mmap_type);
     if ( NULL==mmap_block ) {
         printf("init_ctl_block error[%p] map_file=%s\n",mmap_block, conf->map_file);
         exit(1);
     }
     memory = gnb_mmap_get_block(mmap_block);
-    gnb_core->ctl_block = gnb_ctl_block_build(memory, conf->payload_block_size, node_num, conf->pf_worker_num);
+    gnb_core->ctl_block = gnb_ctl_block_build(memory, conf->payload_block_size, node_num, conf->pf_worker_num, conf->latency_stats, conf->flight_record_num);
     gnb_core->ctl_block->mmap_block = mmap_block;
 }
 
@@ -362,10 +376,11 @@ void update_node_crypto_key(gnb_core_t *gnb_core, uint64_t now_sec) {
 
 gnb_core_t* gnb_core_create(gnb_conf_t *conf) {
     gnb_core_t *gnb_core;
-    gnb_heap_t *heap = gnb_heap_create(conf->max_heap_fragment);
+    gnb_heap_t *heap = gnb_heap_create(conf->heap_chunk_size);
     gnb_core = gnb_heap_alloc(heap, sizeof(gnb_core_t));
     memset(gnb_core, 0, sizeof(gnb_core_t));
     gnb_core->heap = heap;
+    gnb_core->pf_mod_array = gnb_pf_mod_array_create(heap);
     init_ctl_block(gnb_core, conf);
     gnb_core->conf = &gnb_core->ctl_block->conf_zone->conf_st;
     memcpy(gnb_core->conf, conf, sizeof(gnb_conf_t));
@@ -483,7 +498,6 @@ gnb_core_t* gnb_core_create(gnb_conf_t *conf) {
         gnb_core->drv = &gnb_tun_drv_wintun;
     }
 #endif
-    gnb_pf_status_strings_init();
     if ( gnb_core->conf->activate_tun ) {
         gnb_core->drv->init_tun(gnb_core);
     }
@@ -514,6 +528,9 @@ gnb_core_t* gnb_core_create(gnb_conf_t *conf) {
             gnb_core->pf_worker_ring->worker[gnb_core->pf_worker_ring->cur_idx] = gnb_worker_init("gnb_pf_worker", gnb_core);
         }
         gnb_core->pf_worker_ring->cur_idx=0;
+        //pf worker 的 init 中已经确定了 tun_payload_offset
+        gnb_core->pbuf_pool = gnb_pbuf_pool_create(gnb_core->heap, ((uint32_t)gnb_core->conf->pf_woker_out_queue_length + 1) * gnb_core->conf->pf_worker_num,
+                                                   GNB_PAYLOAD16_HEAD_SIZE + gnb_core->tun_payload_offset + gnb_core->conf->mtu + GNB_PBUF_TAILROOM);
     } else {
         gnb_core->pf_worker_ring = (gnb_worker_ring_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_worker_ring_t) );
         gnb_core->pf_worker_ring->size = 0;
@@ -524,10 +541,11 @@ gnb_core_t* gnb_core_create(gnb_conf_t *conf) {
 
 gnb_core_t* gnb_core_index_service_create(gnb_conf_t *conf) {
     gnb_core_t *gnb_core;
-    gnb_heap_t *heap = gnb_heap_create(8192);
+    gnb_heap_t *heap = gnb_heap_create(GNB_HEAP_DEFAULT_CHUNK_SIZE);
     gnb_core = gnb_heap_alloc(heap, sizeof(gnb_core_t));
     memset(gnb_core, 0, sizeof(gnb_core_t));
     gnb_core->heap = heap;
+    gnb_core->pf_mod_array = gnb_pf_mod_array_create(heap);
     init_ctl_block(gnb_core, conf);
     gnb_core->conf = &gnb_core->ctl_block->conf_zone->conf_st;
     memcpy(gnb_core->conf, conf, sizeof(gnb_conf_t));
@@ -590,6 +608,9 @@ PUBLIC_INDEX_RELEASE:
 
 void gnb_core_index_service_start(gnb_core_t *gnb_core) {
     int ret;
+    if ( gnb_core->conf->log_async ) {
+        gnb_log_async_start(gnb_core->log);
+    }
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_CORE,"GNB Public Index Service Start.....\n");
     gnb_core->index_service_worker->start(gnb_core->index_service_worker);
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_CORE,"%s start\n", gnb_core->index_service_worker->name);
@@ -600,6 +621,10 @@ void gnb_core_index_service_start(gnb_core_t *gnb_core) {
 void gnb_core_start(gnb_core_t *gnb_core) {
     int ret;
     int i;
+    //gnb_daemon() 之后才启动 writer 线程
+    if ( gnb_core->conf->log_async ) {
+        gnb_log_async_start(gnb_core->log);
+    }
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_CORE, "Start.....\n");
     gnb_setup_env(gnb_core);
     update_node_crypto_key(gnb_core, 1);
@@ -680,6 +705,8 @@ void gnb_core_stop(gnb_core_t *gnb_core) {
     }
 #endif
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_CORE,"if[%s] closeed\n", gnb_core->ifname);
+    //worker 都已经停止, 输出 writer 线程中剩下的日志
+    gnb_log_async_stop(gnb_core->log);
 }
 
 #ifdef __UNIX_LIKE_OS__
@@ -735,6 +762,56 @@ static void exec_loop_script(gnb_core_t *gnb_core, const char *script_file_name)
     return;
 }
 
+static void add_queue_stats(gnb_ctl_status_zone_t *status_zone, const char *worker_name, const char *queue_name, gnb_ring_buffer_fixed_t *ring_buffer_fixed, gnb_ring_buffer_var_t *ring_buffer_var) {
+    gnb_ctl_queue_stats_t *queue_stats;
+    if ( status_zone->queue_num >= GNB_CTL_QUEUE_STATS_MAX || (NULL == ring_buffer_fixed && NULL == ring_buffer_var) ) {
+        return;
+    }
+    queue_stats = &status_zone->queue[status_zone->queue_num];
+    snprintf(queue_stats->name, sizeof(queue_stats->name), "%s.%s", worker_name, queue_name);
+    if ( NULL != ring_buffer_fixed ) {
+        queue_stats->unit           = GNB_CTL_QUEUE_UNIT_BLOCK;
+        queue_stats->capacity       = ring_buffer_fixed->block_num_mask;
+        queue_stats->used           = gnb_ring_buffer_fixed_used(ring_buffer_fixed);
+        queue_stats->high_watermark = ring_buffer_fixed->high_watermark;
+        queue_stats->full_num       = ring_buffer_fixed->full_num;
+    } else {
+        queue_stats->unit           = GNB_CTL_QUEUE_UNIT_BYTE;
+        queue_stats->capacity       = ring_buffer_var->capacity;
+        queue_stats->used           = gnb_ring_buffer_var_used(ring_buffer_var);
+        queue_stats->high_watermark = ring_buffer_var->high_watermark;
+        queue_stats->full_num       = ring_buffer_var->full_num;
+    }
+    status_zone->queue_num++;
+}
+
+/*
+ ring buffer 的计数由生产者线程更新, 这里每秒复制一次到 status_zone, 读到的值可能稍有滞后
+*/
+static void update_queue_stats(gnb_core_t *gnb_core) {
+    gnb_ctl_status_zone_t *status_zone = gnb_core->ctl_block->status_zone;
+    gnb_worker_t *worker_vec[4] = { gnb_core->node_worker, gnb_core->index_worker, gnb_core->index_service_worker, gnb_core->detect_worker };
+    gnb_worker_t *worker;
+    int i;
+    status_zone->queue_num = 0;
+    for ( i=0; i<4; i++ ) {
+        worker = worker_vec[i];
+        if ( NULL == worker ) {
+            continue;
+        }
+        add_queue_stats(status_zone, worker->name, "in", worker->ring_buffer_in, NULL);
+        add_queue_stats(status_zone, worker->name, "out", worker->ring_buffer_out, NULL);
+    }
+    if ( NULL == gnb_core->pf_worker_ring ) {
+        return;
+    }
+    for ( i=0; i<gnb_core->pf_worker_ring->size; i++ ) {
+        worker = gnb_core->pf_worker_ring->worker[i];
+        add_queue_stats(status_zone, worker->name, "in", NULL, worker->ring_buffer_var_in);
+        add_queue_stats(status_zone, worker->name, "out", NULL, worker->ring_buffer_var_out);
+    }
+}
+
 #define GNB_EXEC_ES_INTERVAL_TIME_SEC      (60*5)
 #define GNB_EXEC_SCRIPT_INTERVAL_TIME_SEC  (60)
 void primary_process_loop( gnb_core_t *gnb_core ) {
@@ -750,6 +827,8 @@ void primary_process_loop( gnb_core_t *gnb_core ) {
         gnb_core->now_time_sec  = gnb_core->now_timeval.tv_sec;
         gnb_core->now_time_usec = gnb_core->now_timeval.tv_sec * 1000000 + gnb_core->now_timeval.tv_usec;
         gnb_core->ctl_block->status_zone->keep_alive_ts_sec = (uint64_t)gnb_core->now_timeval.tv_sec;
+        gnb_ctl_block_latency_calibrate(gnb_core->ctl_block);
+        update_queue_stats(gnb_core);
         gnb_log_file_rotate(gnb_core->log);
         #ifdef __UNIX_LIKE_OS__
         sleep(1);
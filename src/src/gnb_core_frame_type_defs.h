@@ -27,6 +27,10 @@
 #define GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED             (0x1 << 2)
 #define GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED_MULTI_PATH  (0x1 << 3)
 #define GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP                 (0x1 << 4)
+#define GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4                 (0x1 << 5)
+//与 GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4 一起使用, 表示压缩时使用了字典
+#define GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP_DICT            (0x1 << 6)
+#define GNB_PAYLOAD_SUB_TYPE_IPFRAME_HEADER_ZIP          (0x1 << 7)
 
 #define GNB_PAYLOAD_TYPE_INDEX                (0x8)
 #define PAYLOAD_SUB_TYPE_POST_ADDR            (0x1)
@@ -41,6 +45,7 @@
 #define PAYLOAD_SUB_TYPE_PONG2                (0x3)
 #define PAYLOAD_SUB_TYPE_LAN_PING             (0x4)
 #define PAYLOAD_SUB_TYPE_NODE_UNIFIED_NOTIFY  (0x5)
+#define PAYLOAD_SUB_TYPE_NODE_HEADER_ZIP_IR_REQUEST  (0x6)
 
 #define GNB_PAYLOAD_TYPE_LAN_DISCOVER         (0x43)
 
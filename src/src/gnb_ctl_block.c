@@ -24,6 +24,7 @@
 #include "gnb_mmap.h"
 #include "gnb_time.h"
 #include "gnb_block.h"
+#include "gnb_seqlock.h"
 
 
 //entry_table256 的类型是 uint32_t,
@@ -35,6 +36,9 @@
 #define GNB_CTL_CORE          4
 #define GNB_CTL_STATUS        5
 #define GNB_CTL_NODE          6
+#define GNB_CTL_COUNTER       7
+#define GNB_CTL_LATENCY       8
+#define GNB_CTL_FLIGHT        9
 
 ssize_t gnb_ctl_file_size(const char *filename) {
     struct stat s;
@@ -46,9 +50,10 @@ ssize_t gnb_ctl_file_size(const char *filename) {
     return s.st_size;
 }
 
-gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size, size_t node_num, uint8_t pf_worker_num) {
+gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size, size_t node_num, uint8_t pf_worker_num, uint8_t latency_stats, uint32_t flight_record_num) {
     uint32_t off_set = sizeof(uint32_t)*256;
     gnb_block32_t *block;
+    int i;
     gnb_ctl_block_t *ctl_block = (gnb_ctl_block_t *)malloc(sizeof(gnb_ctl_block_t));
     ctl_block->entry_table256 = memory;
     //向量表清零
@@ -70,11 +75,17 @@ gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size,
     block->size = sizeof(gnb_ctl_core_zone_t) + ( sizeof(gnb_payload16_t) + payload_block_size + sizeof(gnb_payload16_t) + payload_block_size ) * (1+pf_worker_num);
     ctl_block->core_zone = (gnb_ctl_core_zone_t *)block->data;
     off_set += sizeof(gnb_block32_t) + sizeof(gnb_ctl_core_zone_t) + ( sizeof(gnb_payload16_t) + payload_block_size + sizeof(gnb_payload16_t) + payload_block_size ) * (1+pf_worker_num);
+    //pf_status_counter 按 cache line 对齐, status_zone 的起始地址也需要按 cache line 对齐
+    off_set = GNB_CACHE_ALIGN_SIZE(off_set + sizeof(gnb_block32_t)) - sizeof(gnb_block32_t);
     ctl_block->entry_table256[GNB_CTL_STATUS] = off_set;
     block = memory + ctl_block->entry_table256[GNB_CTL_STATUS];
-    block->size = sizeof(gnb_ctl_status_zone_t);
+    block->size = gnb_ctl_status_zone_size(pf_worker_num);
     ctl_block->status_zone = (gnb_ctl_status_zone_t *)block->data;
-    off_set += sizeof(gnb_block32_t) + sizeof(gnb_ctl_status_zone_t);
+    off_set += sizeof(gnb_block32_t) + gnb_ctl_status_zone_size(pf_worker_num);
+    memset(ctl_block->status_zone, 0, gnb_ctl_status_zone_size(pf_worker_num));
+    ctl_block->status_zone->pf_shard_num = 1 + pf_worker_num;
+    //gnb_node_t 按 cache line 对齐, node_zone 的起始地址也需要按 cache line 对齐
+    off_set = GNB_CACHE_ALIGN_SIZE(off_set + sizeof(gnb_block32_t)) - sizeof(gnb_block32_t);
     ctl_block->entry_table256[GNB_CTL_NODE] = off_set;
     block = memory + ctl_block->entry_table256[GNB_CTL_NODE];
     block->size = sizeof(gnb_ctl_node_zone_t) + sizeof(gnb_node_t)*node_num;
@@ -82,6 +93,54 @@ gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size,
     off_set += sizeof(gnb_block32_t) + sizeof(gnb_ctl_node_zone_t) + sizeof(gnb_node_t)*node_num;
     snprintf((char *)ctl_block->node_zone->name,    8, "%s", "NODE");
     ctl_block->node_zone->node_num = node_num;
+    off_set = GNB_CACHE_ALIGN_SIZE(off_set + sizeof(gnb_block32_t)) - sizeof(gnb_block32_t);
+    ctl_block->entry_table256[GNB_CTL_COUNTER] = off_set;
+    block = memory + ctl_block->entry_table256[GNB_CTL_COUNTER];
+    block->size = gnb_ctl_counter_zone_size(node_num, pf_worker_num);
+    ctl_block->counter_zone = (gnb_ctl_counter_zone_t *)block->data;
+    off_set += sizeof(gnb_block32_t) + gnb_ctl_counter_zone_size(node_num, pf_worker_num);
+    memset(ctl_block->counter_zone, 0, gnb_ctl_counter_zone_size(node_num, pf_worker_num));
+    snprintf((char *)ctl_block->counter_zone->name, 8, "%s", "COUNTER");
+    ctl_block->counter_zone->shard_num = 1 + pf_worker_num;
+    ctl_block->counter_zone->node_num  = node_num;
+    //flight_record_num 为 0 时不分配 flight_zone, entry 为 0
+    ctl_block->flight_zone = NULL;
+    flight_record_num = gnb_ctl_flight_record_num(flight_record_num);
+    if ( 0 != flight_record_num ) {
+        off_set = GNB_CACHE_ALIGN_SIZE(off_set + sizeof(gnb_block32_t)) - sizeof(gnb_block32_t);
+        ctl_block->entry_table256[GNB_CTL_FLIGHT] = off_set;
+        block = memory + ctl_block->entry_table256[GNB_CTL_FLIGHT];
+        block->size = gnb_ctl_flight_zone_size(pf_worker_num, flight_record_num);
+        ctl_block->flight_zone = (gnb_ctl_flight_zone_t *)block->data;
+        off_set += sizeof(gnb_block32_t) + gnb_ctl_flight_zone_size(pf_worker_num, flight_record_num);
+        memset(ctl_block->flight_zone, 0, gnb_ctl_flight_zone_size(pf_worker_num, flight_record_num));
+        snprintf((char *)ctl_block->flight_zone->name, 8, "%s", "FLIGHT");
+        ctl_block->flight_zone->shard_num     = 1 + pf_worker_num;
+        ctl_block->flight_zone->record_num    = flight_record_num;
+        ctl_block->flight_zone->recorder_size = GNB_CACHE_ALIGN_SIZE(sizeof(gnb_flight_recorder_t) + sizeof(gnb_flight_record_t) * flight_record_num);
+        ctl_block->flight_zone->calibrate_ticks = gnb_latency_now();
+        ctl_block->flight_zone->calibrate_nsec  = gnb_latency_clock_nsec();
+        for ( i=0; i<ctl_block->flight_zone->shard_num; i++ ) {
+            gnb_ctl_block_flight_shard(ctl_block, i)->record_mask = flight_record_num - 1;
+        }
+    }
+    //没有打开 latency_stats 时不分配 latency_zone, entry 为 0
+    ctl_block->latency_zone = NULL;
+    if ( 0 == latency_stats ) {
+        return ctl_block;
+    }
+    off_set = GNB_CACHE_ALIGN_SIZE(off_set + sizeof(gnb_block32_t)) - sizeof(gnb_block32_t);
+    ctl_block->entry_table256[GNB_CTL_LATENCY] = off_set;
+    block = memory + ctl_block->entry_table256[GNB_CTL_LATENCY];
+    block->size = gnb_ctl_latency_zone_size(pf_worker_num, latency_stats);
+    ctl_block->latency_zone = (gnb_ctl_latency_zone_t *)block->data;
+    off_set += sizeof(gnb_block32_t) + gnb_ctl_latency_zone_size(pf_worker_num, latency_stats);
+    memset(ctl_block->latency_zone, 0, gnb_ctl_latency_zone_size(pf_worker_num, latency_stats));
+    snprintf((char *)ctl_block->latency_zone->name, 8, "%s", "LATENCY");
+    ctl_block->latency_zone->shard_num = 1 + pf_worker_num;
+    ctl_block->latency_zone->stage_num = GNB_LATENCY_STAGE_NUM;
+    ctl_block->latency_zone->calibrate_ticks = gnb_latency_now();
+    ctl_block->latency_zone->calibrate_nsec  = gnb_latency_clock_nsec();
     return ctl_block;
 }
 
@@ -109,6 +168,245 @@ void gnb_ctl_block_setup(gnb_ctl_block_t *ctl_block, void *memory) {
     ctl_block->status_zone = (gnb_ctl_status_zone_t *)block->data;
     block = memory + ctl_block->entry_table256[GNB_CTL_NODE];
     ctl_block->node_zone = (gnb_ctl_node_zone_t *)block->data;
+    if ( 0 != ctl_block->entry_table256[GNB_CTL_COUNTER] ) {
+        block = memory + ctl_block->entry_table256[GNB_CTL_COUNTER];
+        ctl_block->counter_zone = (gnb_ctl_counter_zone_t *)block->data;
+    } else {
+        ctl_block->counter_zone = NULL;
+    }
+    if ( 0 != ctl_block->entry_table256[GNB_CTL_LATENCY] ) {
+        block = memory + ctl_block->entry_table256[GNB_CTL_LATENCY];
+        ctl_block->latency_zone = (gnb_ctl_latency_zone_t *)block->data;
+    } else {
+        ctl_block->latency_zone = NULL;
+    }
+    if ( 0 != ctl_block->entry_table256[GNB_CTL_FLIGHT] ) {
+        block = memory + ctl_block->entry_table256[GNB_CTL_FLIGHT];
+        ctl_block->flight_zone = (gnb_ctl_flight_zone_t *)block->data;
+    } else {
+        ctl_block->flight_zone = NULL;
+    }
+}
+
+const char *gnb_ctl_drop_strings[GNB_CTL_DROP_NUM] = {
+    "udp_payload_invalid",
+    "pf_in_ring_full",
+    "pf_out_ring_full",
+    "node_ring_full",
+    "index_ring_full",
+    "index_service_ring_full",
+};
+
+size_t gnb_ctl_status_zone_size(uint8_t pf_worker_num) {
+    return sizeof(gnb_ctl_status_zone_t) + sizeof(gnb_pf_status_counter_t) * (1 + pf_worker_num);
+}
+
+/*
+ shard_idx 0 给 primary worker 使用, pf worker 依次使用后面的 shard
+*/
+gnb_pf_status_counter_t *gnb_ctl_block_pf_status_shard(gnb_ctl_block_t *ctl_block, int shard_idx) {
+    if ( shard_idx >= ctl_block->status_zone->pf_shard_num ) {
+        return NULL;
+    }
+    return &ctl_block->status_zone->pf_status_counter[shard_idx];
+}
+
+size_t gnb_ctl_counter_zone_size(size_t node_num, uint8_t pf_worker_num) {
+    return sizeof(gnb_ctl_counter_zone_t) + sizeof(gnb_node_counter_t) * node_num * (1 + pf_worker_num);
+}
+
+/*
+ shard_idx 0 给 primary worker 使用, pf worker 依次使用后面的 shard
+*/
+gnb_node_counter_t *gnb_ctl_block_counter_shard(gnb_ctl_block_t *ctl_block, int shard_idx) {
+    if ( NULL == ctl_block->counter_zone || shard_idx >= ctl_block->counter_zone->shard_num ) {
+        return NULL;
+    }
+    return &ctl_block->counter_zone->counter[ shard_idx * ctl_block->counter_zone->node_num ];
+}
+
+void gnb_ctl_block_node_counter_sum(gnb_ctl_block_t *ctl_block, int node_idx, gnb_node_counter_t *sum) {
+    gnb_node_counter_t *counter;
+    int shard_idx;
+    int i;
+    memset(sum, 0, sizeof(gnb_node_counter_t));
+    if ( NULL == ctl_block->counter_zone || node_idx >= ctl_block->counter_zone->node_num ) {
+        return;
+    }
+    for ( shard_idx=0; shard_idx<ctl_block->counter_zone->shard_num; shard_idx++ ) {
+        counter = &ctl_block->counter_zone->counter[ shard_idx * ctl_block->counter_zone->node_num + node_idx ];
+        sum->in_bytes    += counter->in_bytes;
+        sum->out_bytes   += counter->out_bytes;
+        sum->in_packets  += counter->in_packets;
+        sum->out_packets += counter->out_packets;
+        for ( i=0; i<GNB_PF_STATUS_NUM; i++ ) {
+            sum->drops[i] += counter->drops[i];
+        }
+    }
+}
+
+/*
+ 用 node->addr_seq 读取地址和 ping 延时的一致快照, 成功返回 0,
+ 重试 GNB_CTL_SNAPSHOT_MAX_RETRY 次仍然冲突时返回 -1, 这时 snapshot 中是最后一次读到的值
+*/
+#define GNB_CTL_SNAPSHOT_MAX_RETRY 1000
+int gnb_ctl_block_node_addr_snapshot(gnb_node_t *node, gnb_node_addr_snapshot_t *snapshot) {
+    uint32_t seq;
+    int i;
+    for ( i=0; i<GNB_CTL_SNAPSHOT_MAX_RETRY; i++ ) {
+        seq = gnb_seqlock_read_begin(&node->addr_seq);
+        snapshot->udp_addr_status         = node->udp_addr_status;
+        snapshot->socket6_idx             = node->socket6_idx;
+        snapshot->socket4_idx             = node->socket4_idx;
+        snapshot->udp_sockaddr4           = node->udp_sockaddr4;
+        snapshot->udp_sockaddr6           = node->udp_sockaddr6;
+        snapshot->addr6_ping_latency_usec = node->addr6_ping_latency_usec;
+        snapshot->addr4_ping_latency_usec = node->addr4_ping_latency_usec;
+        snapshot->addr6_update_ts_sec     = node->addr6_update_ts_sec;
+        snapshot->addr4_update_ts_sec     = node->addr4_update_ts_sec;
+        if ( !gnb_seqlock_read_retry(&node->addr_seq, seq) ) {
+            return 0;
+        }
+        gnb_seqlock_cpu_relax();
+    }
+    return -1;
+}
+
+size_t gnb_ctl_latency_zone_size(uint8_t pf_worker_num, uint8_t latency_stats) {
+    if ( 0 == latency_stats ) {
+        return 0;
+    }
+    return sizeof(gnb_ctl_latency_zone_t) + sizeof(gnb_latency_histogram_t) * GNB_LATENCY_STAGE_NUM * (1 + pf_worker_num);
+}
+
+/*
+ 与 counter shard 相同, shard_idx 0 给 primary worker 使用, 返回的是这个 shard 中 stage 0 的 histogram
+*/
+gnb_latency_histogram_t *gnb_ctl_block_latency_shard(gnb_ctl_block_t *ctl_block, int shard_idx) {
+    if ( NULL == ctl_block->latency_zone || shard_idx >= ctl_block->latency_zone->shard_num ) {
+        return NULL;
+    }
+    return &ctl_block->latency_zone->histogram[ shard_idx * ctl_block->latency_zone->stage_num ];
+}
+
+void gnb_ctl_block_latency_sum(gnb_ctl_block_t *ctl_block, int stage, gnb_latency_histogram_t *sum) {
+    gnb_latency_histogram_t *histogram;
+    int shard_idx;
+    int i;
+    memset(sum, 0, sizeof(gnb_latency_histogram_t));
+    if ( NULL == ctl_block->latency_zone || stage >= ctl_block->latency_zone->stage_num ) {
+        return;
+    }
+    for ( shard_idx=0; shard_idx<ctl_block->latency_zone->shard_num; shard_idx++ ) {
+        histogram = &ctl_block->latency_zone->histogram[ shard_idx * ctl_block->latency_zone->stage_num + stage ];
+        sum->count += histogram->count;
+        sum->sum   += histogram->sum;
+        if ( histogram->max > sum->max ) {
+            sum->max = histogram->max;
+        }
+        for ( i=0; i<GNB_LATENCY_BUCKET_NUM; i++ ) {
+            sum->bucket[i] += histogram->bucket[i];
+        }
+    }
+}
+
+static void ctl_block_calibrate(uint64_t calibrate_ticks, uint64_t calibrate_nsec, uint64_t *ticks_per_sec) {
+    uint64_t ticks;
+    uint64_t nsec;
+    ticks = gnb_latency_now();
+    nsec  = gnb_latency_clock_nsec();
+    if ( nsec <= calibrate_nsec || ticks <= calibrate_ticks ) {
+        return;
+    }
+    *ticks_per_sec = (uint64_t)( (double)(ticks - calibrate_ticks) * 1000000000.0 / (double)(nsec - calibrate_nsec) );
+}
+
+/*
+ 用从 build 到现在经过的时间计算计数器的频率, 时间越长越准确, flight_zone 的时间戳使用同一个计数器
+*/
+void gnb_ctl_block_latency_calibrate(gnb_ctl_block_t *ctl_block) {
+    gnb_ctl_latency_zone_t *latency_zone = ctl_block->latency_zone;
+    gnb_ctl_flight_zone_t  *flight_zone  = ctl_block->flight_zone;
+    if ( NULL != latency_zone ) {
+        ctl_block_calibrate(latency_zone->calibrate_ticks, latency_zone->calibrate_nsec, &latency_zone->ticks_per_sec);
+    }
+    if ( NULL != flight_zone ) {
+        ctl_block_calibrate(flight_zone->calibrate_ticks, flight_zone->calibrate_nsec, &flight_zone->ticks_per_sec);
+    }
+}
+
+/*
+ 按 2 的幂向上取整, 最大 GNB_CTL_FLIGHT_RECORD_MAX, 为 0 时不记录
+*/
+#define GNB_CTL_FLIGHT_RECORD_MAX (1024*64)
+uint32_t gnb_ctl_flight_record_num(uint32_t flight_record_num) {
+    uint32_t num = 1;
+    if ( 0 == flight_record_num ) {
+        return 0;
+    }
+    if ( flight_record_num > GNB_CTL_FLIGHT_RECORD_MAX ) {
+        return GNB_CTL_FLIGHT_RECORD_MAX;
+    }
+    while ( num < flight_record_num ) {
+        num <<= 1;
+    }
+    return num;
+}
+
+size_t gnb_ctl_flight_zone_size(uint8_t pf_worker_num, uint32_t flight_record_num) {
+    flight_record_num = gnb_ctl_flight_record_num(flight_record_num);
+    if ( 0 == flight_record_num ) {
+        return 0;
+    }
+    return sizeof(gnb_ctl_flight_zone_t) + GNB_CACHE_ALIGN_SIZE(sizeof(gnb_flight_recorder_t) + sizeof(gnb_flight_record_t) * flight_record_num) * (1 + pf_worker_num);
+}
+
+/*
+ 与 counter shard 相同, shard_idx 0 给 primary worker 使用, 没有 flight_zone 时返回 NULL
+*/
+gnb_flight_recorder_t *gnb_ctl_block_flight_shard(gnb_ctl_block_t *ctl_block, int shard_idx) {
+    if ( NULL == ctl_block->flight_zone || shard_idx >= ctl_block->flight_zone->shard_num ) {
+        return NULL;
+    }
+    return (gnb_flight_recorder_t *)( (unsigned char *)ctl_block->flight_zone->recorder + (size_t)ctl_block->flight_zone->recorder_size * shard_idx );
+}
+
+/*
+ 把 shard 中的记录按从旧到新的次序复制到 record_vec, record_vec 至少要有 record_num 个元素,
+ 返回有效记录的数量, first_idx 是 record_vec[0] 的序号
+ 复制之后再读一次 write_idx, 复制期间可能已经被 worker 覆盖的记录不返回
+*/
+int gnb_ctl_block_flight_snapshot(gnb_ctl_block_t *ctl_block, int shard_idx, gnb_flight_record_t *record_vec, uint64_t *first_idx) {
+    gnb_flight_recorder_t *recorder;
+    uint32_t record_num;
+    uint64_t begin_idx;
+    uint64_t end_idx;
+    uint64_t valid_idx;
+    uint64_t idx;
+    *first_idx = 0;
+    if ( NULL == ctl_block->flight_zone || shard_idx >= ctl_block->flight_zone->shard_num ) {
+        return 0;
+    }
+    record_num = ctl_block->flight_zone->record_num;
+    recorder = gnb_ctl_block_flight_shard(ctl_block, shard_idx);
+    end_idx = __atomic_load_n(&recorder->write_idx, __ATOMIC_ACQUIRE);
+    begin_idx = end_idx > record_num ? end_idx - record_num : 0;
+    for ( idx=begin_idx; idx<end_idx; idx++ ) {
+        record_vec[idx - begin_idx] = recorder->record[ idx & (record_num - 1) ];
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    //worker 正在写入序号为 write_idx 的记录, 它占用的是序号为 write_idx - record_num 的位置
+    valid_idx = __atomic_load_n(&recorder->write_idx, __ATOMIC_RELAXED) + 1;
+    valid_idx = valid_idx > record_num ? valid_idx - record_num : 0;
+    if ( valid_idx >= end_idx ) {
+        return 0;
+    }
+    if ( valid_idx > begin_idx ) {
+        memmove(record_vec, record_vec + (valid_idx - begin_idx), sizeof(gnb_flight_record_t) * (end_idx - valid_idx));
+        begin_idx = valid_idx;
+    }
+    *first_idx = begin_idx;
+    return (int)(end_idx - begin_idx);
 }
 
 /*
@@ -25,6 +25,8 @@
 #include "gnb_conf_type.h"
 #include "gnb_node_type.h"
 #include "gnb_log_type.h"
+#include "gnb_pf_status.h"
+#include "gnb_latency.h"
 
 #define GNB_MAX_PAYLOAD_BLOCK_SIZE 1024*64
 #define GNB_PAYLOAD_BUFFER_PADDING_SIZE 1024
@@ -61,8 +63,52 @@ typedef struct _gnb_ctl_core_zone_t {
 	unsigned char pf_worker_payload_blocks[0];
 } gnb_ctl_core_zone_t;
 
+/*
+ primary worker 在这些地方丢弃 packet 或者因为 ring buffer 已满而不能把 packet 交给其他 worker
+*/
+#define GNB_CTL_DROP_UDP_PAYLOAD_INVALID       0
+#define GNB_CTL_DROP_PF_IN_RING_FULL           1
+#define GNB_CTL_DROP_PF_OUT_RING_FULL          2
+#define GNB_CTL_DROP_NODE_RING_FULL            3
+#define GNB_CTL_DROP_INDEX_RING_FULL           4
+#define GNB_CTL_DROP_INDEX_SERVICE_RING_FULL   5
+#define GNB_CTL_DROP_NUM                       6
+
+extern const char *gnb_ctl_drop_strings[GNB_CTL_DROP_NUM];
+
+#define GNB_CTL_QUEUE_STATS_MAX 64
+
+typedef struct _gnb_ctl_queue_stats_t {
+	char name[32];
+	//fixed ring buffer 按 block 计算, pf worker 的变长 ring buffer 按字节计算
+	#define GNB_CTL_QUEUE_UNIT_BLOCK 0
+	#define GNB_CTL_QUEUE_UNIT_BYTE  1
+	uint32_t unit;
+	uint32_t capacity;
+	uint32_t used;
+	uint32_t high_watermark;
+	uint64_t full_num;
+} gnb_ctl_queue_stats_t;
+
+/*
+ 按 gnb_pf_status 统计每个 packet 在 pf 中的最终结果, 每个执行 packet filter 的 worker 一个, 只由所属的 worker 写入
+*/
+typedef struct GNB_CACHE_ALIGNED _gnb_pf_status_counter_t {
+	uint64_t status[GNB_PF_STATUS_NUM];
+} gnb_pf_status_counter_t;
+
 typedef struct _gnb_ctl_status_zone_t {
 	uint64_t keep_alive_ts_sec;
+	//只由 primary worker 写入
+	uint64_t drop_num[GNB_CTL_DROP_NUM];
+	//pbuf 用完, 退回到把 payload 拷贝进 ring buffer 的次数
+	uint64_t pbuf_exhausted_num;
+	//主进程每秒从各个 worker 的 ring buffer 复制一次
+	uint32_t queue_num;
+	gnb_ctl_queue_stats_t queue[GNB_CTL_QUEUE_STATS_MAX];
+	uint32_t pf_shard_num;
+	//pf_status_counter[ shard_idx ], shard_idx 与 counter_zone 相同
+	gnb_pf_status_counter_t pf_status_counter[0];
 } gnb_ctl_status_zone_t;
 
 typedef struct _gnb_ctl_node_zone_t {
@@ -71,6 +117,90 @@ typedef struct _gnb_ctl_node_zone_t {
 	gnb_node_t node[0];
 } gnb_ctl_node_zone_t;
 
+/*
+ 每个执行 packet filter 的 worker(primary worker 和 pf worker) 在 counter_zone 中有一个 shard,
+ shard 里每个 node 对应一个按 cache line 对齐的 gnb_node_counter_t, 只由所属的 worker 写入,
+ 不需要原子操作，也不会在 worker 之间争抢 cache line; gnb_ctl 读取时再把所有 shard 累加
+*/
+typedef struct GNB_CACHE_ALIGNED _gnb_node_counter_t {
+	uint64_t in_bytes;
+	uint64_t out_bytes;
+	uint64_t in_packets;
+	uint64_t out_packets;
+	//按 gnb_pf_status 统计丢弃的分组, TUN_* 和 INET_* 区分了方向
+	uint64_t drops[GNB_PF_STATUS_NUM];
+} gnb_node_counter_t;
+
+typedef struct _gnb_ctl_counter_zone_t {
+	unsigned char name[8];
+	uint32_t shard_num;
+	uint32_t node_num;
+	//counter[ shard_idx * node_num + node_idx ]
+	gnb_node_counter_t counter[0];
+} gnb_ctl_counter_zone_t;
+
+/*
+ 与 counter_zone 相同, 每个执行 packet filter 的 worker 有一个 shard, 每个 shard 有 stage_num 个 histogram,
+ histogram 中记录的是计数器的 tick, ticks_per_sec 由主进程每秒校准一次, 为 0 时表示还没有校准
+*/
+typedef struct _gnb_ctl_latency_zone_t {
+	unsigned char name[8];
+	uint32_t shard_num;
+	uint32_t stage_num;
+	uint64_t calibrate_ticks;
+	uint64_t calibrate_nsec;
+	uint64_t ticks_per_sec;
+	//histogram[ shard_idx * stage_num + stage ]
+	gnb_latency_histogram_t histogram[0];
+} gnb_ctl_latency_zone_t;
+
+/*
+ flight recorder, 每个执行 packet filter 的 worker 有一个固定长度的环形缓冲区, 每个 packet 在 pf 中得到最终结果时写入一条记录,
+ 只由所属的 worker 写入, write_idx 只增不减, 新的记录覆盖最旧的记录
+ gnb_ctl 读取时不加锁, 先后两次读取 write_idx, 丢弃期间可能被覆盖的记录
+*/
+#define GNB_FLIGHT_DIRECTION_TUN   0
+#define GNB_FLIGHT_DIRECTION_INET  1
+
+//mode 中的各个 bit 对应 gnb_pf_ctx_t 中的转发方式, 可以同时有多个 bit
+#define GNB_FLIGHT_MODE_RELAY      0x1
+#define GNB_FLIGHT_MODE_UNIFIED    0x2
+#define GNB_FLIGHT_MODE_DIRECT     0x4
+#define GNB_FLIGHT_MODE_STD        0x8
+#define GNB_FLIGHT_MODE_UR0        0x10
+
+typedef struct _gnb_flight_record_t {
+	//与 latency 相同的计数器 tick, 按 flight_zone 中的 ticks_per_sec 换算
+	uint64_t ts_ticks;
+	gnb_uuid_t src_uuid64;
+	gnb_uuid_t dst_uuid64;
+	gnb_uuid_t fwd_uuid64;
+	uint16_t ip_frame_size;
+	uint8_t direction;
+	uint8_t mode;
+	uint8_t pf_status;
+	uint8_t reserved[3];
+} gnb_flight_record_t;
+
+typedef struct GNB_CACHE_ALIGNED _gnb_flight_recorder_t {
+	uint64_t write_idx;
+	//record_num 是 2 的幂
+	uint32_t record_mask;
+	gnb_flight_record_t record[0] GNB_CACHE_ALIGNED;
+} gnb_flight_recorder_t;
+
+typedef struct _gnb_ctl_flight_zone_t {
+	unsigned char name[8];
+	uint32_t shard_num;
+	uint32_t record_num;
+	//每个 recorder 占用 recorder_size 字节, 按 cache line 对齐
+	uint32_t recorder_size;
+	uint64_t calibrate_ticks;
+	uint64_t calibrate_nsec;
+	uint64_t ticks_per_sec;
+	gnb_flight_recorder_t recorder[0];
+} gnb_ctl_flight_zone_t;
+
 typedef struct _gnb_ctl_block_t {
 	uint32_t *entry_table256;
 	gnb_ctl_magic_number_t *magic_number;
@@ -78,14 +208,31 @@ typedef struct _gnb_ctl_block_t {
 	gnb_ctl_core_zone_t    *core_zone;
 	gnb_ctl_status_zone_t  *status_zone;
 	gnb_ctl_node_zone_t    *node_zone;
+	gnb_ctl_counter_zone_t *counter_zone;
+	gnb_ctl_latency_zone_t *latency_zone;
+	gnb_ctl_flight_zone_t  *flight_zone;
 	gnb_mmap_block_t       *mmap_block;
 } gnb_ctl_block_t;
 
 ssize_t gnb_ctl_file_size(const char *filename);
-gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size, size_t node_num, uint8_t pf_worker_num);
+gnb_ctl_block_t *gnb_ctl_block_build(void *memory, uint32_t payload_block_size, size_t node_num, uint8_t pf_worker_num, uint8_t latency_stats, uint32_t flight_record_num);
 void gnb_ctl_block_build_finish(void *memory);
 void gnb_ctl_block_setup(gnb_ctl_block_t *ctl_block, void *memory);
 gnb_ctl_block_t *gnb_get_ctl_block(const char *ctl_block_file, int flag);
+size_t gnb_ctl_status_zone_size(uint8_t pf_worker_num);
+gnb_pf_status_counter_t *gnb_ctl_block_pf_status_shard(gnb_ctl_block_t *ctl_block, int shard_idx);
+size_t gnb_ctl_counter_zone_size(size_t node_num, uint8_t pf_worker_num);
+gnb_node_counter_t *gnb_ctl_block_counter_shard(gnb_ctl_block_t *ctl_block, int shard_idx);
+void gnb_ctl_block_node_counter_sum(gnb_ctl_block_t *ctl_block, int node_idx, gnb_node_counter_t *sum);
+int gnb_ctl_block_node_addr_snapshot(gnb_node_t *node, gnb_node_addr_snapshot_t *snapshot);
+size_t gnb_ctl_latency_zone_size(uint8_t pf_worker_num, uint8_t latency_stats);
+gnb_latency_histogram_t *gnb_ctl_block_latency_shard(gnb_ctl_block_t *ctl_block, int shard_idx);
+void gnb_ctl_block_latency_sum(gnb_ctl_block_t *ctl_block, int stage, gnb_latency_histogram_t *sum);
+void gnb_ctl_block_latency_calibrate(gnb_ctl_block_t *ctl_block);
+uint32_t gnb_ctl_flight_record_num(uint32_t flight_record_num);
+size_t gnb_ctl_flight_zone_size(uint8_t pf_worker_num, uint32_t flight_record_num);
+gnb_flight_recorder_t *gnb_ctl_block_flight_shard(gnb_ctl_block_t *ctl_block, int shard_idx);
+int gnb_ctl_block_flight_snapshot(gnb_ctl_block_t *ctl_block, int shard_idx, gnb_flight_record_t *record_vec, uint64_t *first_idx);
 #define MIN_CTL_BLOCK_FILE_SIZE  (sizeof(uint32_t)*256 + sizeof(gnb_ctl_magic_number_t) + sizeof(gnb_ctl_conf_zone_t) + sizeof(gnb_ctl_core_zone_t) + sizeof(gnb_ctl_status_zone_t) + sizeof(gnb_ctl_node_zone_t) + sizeof(gnb_node_t))
 #define GNB_CTL_KEEP_ALIVE_TS 15
 
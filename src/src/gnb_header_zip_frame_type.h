@@ -0,0 +1,40 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_HEADER_ZIP_FRAME_TYPE_H
+#define GNB_HEADER_ZIP_FRAME_TYPE_H
+
+#pragma pack(push, 1)
+
+/*
+ gnb_pf_header_zip 的接收方收到没有 context 的 CO packet 时, 请求发送方对这个 cid 重新发送 IR
+*/
+typedef struct _header_zip_ir_request_frame_t {
+    struct __attribute__((__packed__)) header_zip_ir_request_frame_data {
+      gnb_uuid_t src_uuid64;   //发送方的uuid64, 即 header zip 的接收方
+      gnb_uuid_t dst_uuid64;   //接收方的uuid64, 即 header zip 的发送方
+      uint16_t cid;
+      unsigned char text[32];
+    }data;
+    unsigned char src_sign[ED25519_SIGN_SIZE];
+}__attribute__ ((__packed__)) header_zip_ir_request_frame_t;
+
+#define HEADER_ZIP_IR_REQUEST_FRAME_PAYLOAD_SIZE (sizeof(gnb_payload16_t) + sizeof(header_zip_ir_request_frame_t))
+
+#pragma pack(pop)
+
+#endif
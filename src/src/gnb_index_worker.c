@@ -39,6 +39,7 @@
 #include "gnb_binary.h"
 #include "gnb_worker_queue_data.h"
 #include "gnb_index_frame_type.h"
+#include "gnb_seqlock.h"
 #include "ed25519/ed25519.h"
 
 typedef struct _index_worker_ctx_t {
@@ -387,12 +388,16 @@ static void handle_echo_addr_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *i
     //更新返回 ehco 的index 节点的地址对应的时间戳
     gnb_core->index_address_ring.address_list->array[idx].ts_sec = index_worker_ctx->now_time_sec;
     if ( '6' == echo_addr_frame->data.addr_type ) {
+        gnb_seqlock_write_begin(&gnb_core->local_node->addr_seq);
         memcpy(&gnb_core->local_node->udp_sockaddr6.sin6_addr, &echo_addr_frame->data.addr, 16);
         gnb_core->local_node->udp_sockaddr6.sin6_port = echo_addr_frame->data.port;
+        gnb_seqlock_write_end(&gnb_core->local_node->addr_seq);
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_INDEX_WORKER,"get echo address %s:%d from index %s\n", GNB_ADDR6STR1(echo_addr_frame->data.addr), ntohs(echo_addr_frame->data.port), GNB_SOCKETADDRSTR2(sockaddress));
     } else if ( '4' == echo_addr_frame->data.addr_type ) {
+        gnb_seqlock_write_begin(&gnb_core->local_node->addr_seq);
         memcpy(&gnb_core->local_node->udp_sockaddr4.sin_addr, &echo_addr_frame->data.addr, 4);
         gnb_core->local_node->udp_sockaddr4.sin_port = echo_addr_frame->data.port;
+        gnb_seqlock_write_end(&gnb_core->local_node->addr_seq);
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_INDEX_WORKER,"get echo address %s:%d from index %s\n", GNB_ADDR4STR1(echo_addr_frame->data.addr), ntohs(echo_addr_frame->data.port), GNB_SOCKETADDRSTR2(sockaddress));
     } else {
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_INDEX_WORKER,"handle echo address type error%.*s from %s\n", 80, echo_addr_frame->data.text, GNB_SOCKETADDRSTR2(sockaddress));
@@ -441,6 +446,7 @@ static void handle_detect_addr_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t
             );
             return;
         }
+        gnb_seqlock_write_begin(&src_node->addr_seq);
         if ( 'e' == detect_addr_frame->data.arg0 ) {
             src_node->udp_addr_status |= GNB_NODE_STATUS_IPV6_PONG;
             src_node->addr6_update_ts_sec = index_worker_ctx->now_time_sec;
@@ -452,6 +458,7 @@ static void handle_detect_addr_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t
             src_node->udp_sockaddr6 = sockaddress->addr.in6;
             src_node->socket6_idx   = index_worker_in_data->socket_idx;
         }
+        gnb_seqlock_write_end(&src_node->addr_seq);
         gnb_set_address6(address, &sockaddress->addr.in6);
         GNB_LOG2(gnb_core->log, GNB_LOG_ID_INDEX_WORKER, "==###== RECEIVE_DETECT_ADDR6 node[%llu]->[%llu] idx[%u]%s[%c] ==###==\n", src_uuid64, dst_uuid64, src_node->socket6_idx, GNB_IP_PORT_STR1(address), detect_addr_frame->data.arg0);
     }
@@ -465,6 +472,7 @@ static void handle_detect_addr_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t
             );
             return;
         }
+        gnb_seqlock_write_begin(&src_node->addr_seq);
         if ( 'e' == detect_addr_frame->data.arg0 ) {
             src_node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PONG;
             src_node->addr4_update_ts_sec = index_worker_ctx->now_time_sec;
@@ -476,6 +484,7 @@ static void handle_detect_addr_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t
             src_node->udp_sockaddr4 = sockaddress->addr.in;
             src_node->socket4_idx   = index_worker_in_data->socket_idx;
         }
+        gnb_seqlock_write_end(&src_node->addr_seq);
         gnb_set_address4(address, &sockaddress->addr.in);
         GNB_LOG2(gnb_core->log, GNB_LOG_ID_INDEX_WORKER, "==###== RECEIVE_DETECT_ADDR4 node[%llu]->[%llu] idx[%u]%s[%c] ==###==\n", src_uuid64, dst_uuid64, src_node->socket4_idx, GNB_IP_PORT_STR1(address), detect_addr_frame->data.arg0);
     }
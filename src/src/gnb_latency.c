@@ -0,0 +1,62 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gnb_latency.h"
+
+const char *gnb_latency_stage_strings[GNB_LATENCY_STAGE_NUM] = {
+    "pf_tun",
+    "pf_inet",
+    "pf_route",
+    "pf_zip",
+    "pf_crypto",
+    "ring_in",
+    "ring_out",
+    "send_inet",
+    "write_tun",
+};
+
+uint64_t gnb_latency_bucket_value(int bucket_idx) {
+    int shift;
+    uint64_t low;
+    if ( bucket_idx < GNB_LATENCY_SUB_BUCKET_NUM ) {
+        return (uint64_t)bucket_idx;
+    }
+    shift = bucket_idx / GNB_LATENCY_SUB_BUCKET_NUM - 1;
+    low = (uint64_t)(GNB_LATENCY_SUB_BUCKET_NUM + bucket_idx % GNB_LATENCY_SUB_BUCKET_NUM) << shift;
+    return low + ((1ULL << shift) >> 1);
+}
+
+uint64_t gnb_latency_percentile(gnb_latency_histogram_t *histogram, double q) {
+    uint64_t rank;
+    uint64_t n = 0;
+    int i;
+    if ( 0 == histogram->count ) {
+        return 0;
+    }
+    rank = (uint64_t)(q * histogram->count);
+    if ( rank < 1 ) {
+        rank = 1;
+    }
+    for ( i=0; i<GNB_LATENCY_BUCKET_NUM; i++ ) {
+        n += histogram->bucket[i];
+        if ( n >= rank ) {
+            //bucket 的中点可能大于实际记录到的最大值
+            return gnb_latency_bucket_value(i) < histogram->max ? gnb_latency_bucket_value(i) : histogram->max;
+        }
+    }
+    return histogram->max;
+}
@@ -0,0 +1,115 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_LATENCY_H
+#define GNB_LATENCY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "gnb_type.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/*
+ packet 在各个处理阶段的耗时统计
+
+ 时间戳用 CPU 的计数器(x86 的 TSC, aarch64 的 cntvct), 其他平台用 CLOCK_MONOTONIC 的纳秒,
+ 计数器的频率由主进程每秒用 CLOCK_MONOTONIC 校准一次, 写在 ctl_block 的 latency_zone 中, gnb_ctl 读取时再换算成纳秒
+
+ 直方图按 HDR 的方式分桶: 小于 8 的值每个值一个桶, 之后每个 2 的幂区间再均分为 8 个子桶,
+ 相对误差不超过 12.5%, 记录一个值只需要一次 clz 和几次移位
+*/
+
+#define GNB_LATENCY_STAGE_PF_TUN       0
+#define GNB_LATENCY_STAGE_PF_INET      1
+#define GNB_LATENCY_STAGE_PF_ROUTE     2
+#define GNB_LATENCY_STAGE_PF_ZIP       3
+#define GNB_LATENCY_STAGE_PF_CRYPTO    4
+#define GNB_LATENCY_STAGE_RING_IN      5
+#define GNB_LATENCY_STAGE_RING_OUT     6
+#define GNB_LATENCY_STAGE_SEND_INET    7
+#define GNB_LATENCY_STAGE_WRITE_TUN    8
+
+#define GNB_LATENCY_STAGE_NUM          9
+
+#define GNB_LATENCY_SUB_BUCKET_BITS    3
+#define GNB_LATENCY_SUB_BUCKET_NUM     (1 << GNB_LATENCY_SUB_BUCKET_BITS)
+#define GNB_LATENCY_BUCKET_NUM         ( (64 - GNB_LATENCY_SUB_BUCKET_BITS + 1) * GNB_LATENCY_SUB_BUCKET_NUM )
+
+/*
+ 每个 histogram 只由一个 worker 线程写入, 按 cache line 对齐
+*/
+typedef struct GNB_CACHE_ALIGNED _gnb_latency_histogram_t {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t bucket[GNB_LATENCY_BUCKET_NUM];
+} gnb_latency_histogram_t;
+
+extern const char *gnb_latency_stage_strings[GNB_LATENCY_STAGE_NUM];
+
+static inline uint64_t gnb_latency_clock_nsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline uint64_t gnb_latency_now() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (ticks));
+    return ticks;
+#else
+    return gnb_latency_clock_nsec();
+#endif
+}
+
+static inline int gnb_latency_bucket_idx(uint64_t ticks) {
+    int shift;
+    if ( ticks < GNB_LATENCY_SUB_BUCKET_NUM ) {
+        return (int)ticks;
+    }
+    shift = 63 - __builtin_clzll(ticks) - GNB_LATENCY_SUB_BUCKET_BITS;
+    return (shift + 1) * GNB_LATENCY_SUB_BUCKET_NUM + (int)((ticks >> shift) & (GNB_LATENCY_SUB_BUCKET_NUM - 1));
+}
+
+/*
+ 批量处理时把一个 batch 的耗时平均到每个 packet, 按 num 个样本计入
+*/
+static inline void gnb_latency_record(gnb_latency_histogram_t *histogram, uint64_t ticks, uint64_t num) {
+    histogram->count += num;
+    histogram->sum   += ticks * num;
+    histogram->bucket[ gnb_latency_bucket_idx(ticks) ] += num;
+    if ( ticks > histogram->max ) {
+        histogram->max = ticks;
+    }
+}
+
+//bucket 所代表的值, 取区间的中点
+uint64_t gnb_latency_bucket_value(int bucket_idx);
+
+/*
+ q 取 0.5 0.99 0.999 等, 返回值的单位与记录时相同
+*/
+uint64_t gnb_latency_percentile(gnb_latency_histogram_t *histogram, double q);
+
+#endif
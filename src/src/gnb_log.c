@@ -17,9 +17,12 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
 #include <string.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #if defined(__linux__) || defined(__FreeBSD__) || defined(__APPLE__) || defined(__OpenBSD__)
@@ -39,9 +42,78 @@
 #include "gnb_log.h"
 #include "gnb_time.h"
 #include "gnb_payload16.h"
+#include "gnb_ring_buffer_var.h"
 
 #define GNB_LOG_LINE_MAX 1024*4
 
+/*
+ 异步日志:
+ 每个线程第一次写日志时分配一个只属于自己的 ring buffer, 写日志时只把 format 指针、参数和时间戳写入 ring,
+ 不做格式化和 I/O, 生产者之间没有锁;
+ writer 线程轮询所有 ring, 取出记录后格式化并输出到 console file udp
+ ERROR 类型的日志和 writer 线程启动之前的日志仍然同步输出
+*/
+#define GNB_LOG_ASYNC_MAX_RING         64
+#define GNB_LOG_ASYNC_RING_SIZE        (1024*128)
+#define GNB_LOG_ASYNC_MAX_RECORD_SIZE  2048
+#define GNB_LOG_ASYNC_MAX_STRING       1024
+#define GNB_LOG_ASYNC_MAX_ARGS         32
+#define GNB_LOG_ASYNC_IDLE_MSEC        2
+
+typedef struct _gnb_log_record_t {
+    uint64_t ts_usec;
+    const char *format;
+    uint8_t log_type;
+    uint8_t log_id;
+    uint8_t level;
+    uint8_t reserved;
+    uint32_t args_size;
+    unsigned char args[0];
+} gnb_log_record_t;
+
+typedef struct _gnb_log_async_t {
+    gnb_log_ctx_t *log;
+    int running;
+    pthread_t writer_thread;
+    //只在线程注册 ring 时使用, drain 只在 writer 线程中执行, 不需要拿锁
+    pthread_mutex_t lock;
+    uint32_t ring_num;
+    gnb_ring_buffer_var_t *rings[GNB_LOG_ASYNC_MAX_RING];
+    uint64_t drop_num;
+    uint64_t last_sec;
+    char now_time_string[GNB_TIME_STRING_MAX];
+} gnb_log_async_t;
+
+static gnb_log_async_t log_async = { .lock = PTHREAD_MUTEX_INITIALIZER };
+
+static __thread gnb_ring_buffer_var_t *thread_log_ring = NULL;
+static __thread int thread_log_ring_failed = 0;
+
+#define GNB_LOG_ARG_INT64   0
+#define GNB_LOG_ARG_UINT64  1
+#define GNB_LOG_ARG_CHAR    2
+#define GNB_LOG_ARG_DOUBLE  3
+#define GNB_LOG_ARG_STRING  4
+#define GNB_LOG_ARG_POINTER 5
+#define GNB_LOG_ARG_NONE    6
+
+/*
+ printf 格式中的一个转换说明, 由 log_next_spec 从 format 中解析出来
+*/
+typedef struct _gnb_log_spec_t {
+    const char *start;
+    const char *length_start;
+    const char *end;
+    int stars;
+    //精度, 没有精度时为 -1, 精度为 '*' 时由参数给出, precision_star 为 1
+    int precision;
+    int precision_star;
+    //hh h l ll j z t L 
+    char length[3];
+    char conversion;
+    int arg_type;
+} gnb_log_spec_t;
+
 static void open_log_file(gnb_log_ctx_t *log) {
     log->std_fd   = open(log->log_file_name_std,   O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR);
     log->debug_fd = open(log->log_file_name_debug, O_WRONLY|O_CREAT|O_APPEND, S_IRUSR|S_IWUSR);
@@ -138,13 +210,505 @@ static void log_udp_binary_output(gnb_log_ctx_t *log, uint8_t log_type, uint8_t
     }
 }
 
+/*
+ log_string_buffer 前面 4 个字节留给 udp binary output 的 gnb_payload 首部, 日志内容从 log_string_buffer+4 开始
+*/
+static void log_output(gnb_log_ctx_t *log, uint8_t log_type, uint8_t log_id, uint8_t level, char *log_string_buffer, int log_string_len) {
+    char *log_string = log_string_buffer+4;
+    if ( (log->output_type & GNB_LOG_OUTPUT_STDOUT) && (log->config_table[log_id].console_level >= level) ) {
+        log_console_output(log_type, log_string, log_string_len);
+    }
+    if ( log->output_type & GNB_LOG_OUTPUT_FILE && (log->config_table[log_id].file_level >= level) ) {
+        log_file_output(log, log_type, log_string, log_string_len);
+    }
+    if ( log->output_type & GNB_LOG_OUTPUT_UDP && (log->config_table[log_id].udp_level >= level) ) {
+        if ( GNB_LOG_UDP_TYPE_BINARY == log->log_udp_type ) {
+            log_udp_binary_output(log, log_type, log_id, log_string_buffer, log_string_len);
+        } else {
+            log_udp_output(log, log_type, log_string, log_string_len);
+        }
+    }
+}
+
+/*
+ 从 p 开始找下一个转换说明, "%%" 不是转换说明, 没有找到时返回 NULL
+*/
+static const char* log_next_spec(const char *p, gnb_log_spec_t *spec) {
+    const char *q;
+    int i;
+    while ( '\0' != *p ) {
+        if ( '%' != *p ) {
+            p++;
+            continue;
+        }
+        if ( '%' == p[1] ) {
+            p += 2;
+            continue;
+        }
+        spec->start = p;
+        spec->stars = 0;
+        spec->precision = -1;
+        spec->precision_star = 0;
+        memset(spec->length, 0, sizeof(spec->length));
+        q = p + 1;
+        while ( '\0' != *q && NULL != strchr("-+ #0'", *q) ) {
+            q++;
+        }
+        if ( '*' == *q ) {
+            spec->stars++;
+            q++;
+        } else {
+            while ( *q >= '0' && *q <= '9' ) {
+                q++;
+            }
+        }
+        if ( '.' == *q ) {
+            q++;
+            if ( '*' == *q ) {
+                spec->stars++;
+                spec->precision_star = 1;
+                q++;
+            } else {
+                spec->precision = 0;
+                while ( *q >= '0' && *q <= '9' ) {
+                    if ( spec->precision < GNB_LOG_ASYNC_MAX_STRING ) {
+                        spec->precision = spec->precision * 10 + (*q - '0');
+                    }
+                    q++;
+                }
+            }
+        }
+        spec->length_start = q;
+        for ( i=0; i<2 && '\0' != *q && NULL != strchr("hljztLq", *q); i++ ) {
+            spec->length[i] = *q++;
+        }
+        if ( '\0' == *q ) {
+            return NULL;
+        }
+        spec->conversion = *q;
+        spec->end = q + 1;
+        switch ( spec->conversion ) {
+            case 'd':
+            case 'i':
+                spec->arg_type = GNB_LOG_ARG_INT64;
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                spec->arg_type = GNB_LOG_ARG_UINT64;
+                break;
+            case 'c':
+                spec->arg_type = GNB_LOG_ARG_CHAR;
+                break;
+            case 'e':
+            case 'E':
+            case 'f':
+            case 'F':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                spec->arg_type = GNB_LOG_ARG_DOUBLE;
+                break;
+            case 's':
+                spec->arg_type = GNB_LOG_ARG_STRING;
+                break;
+            case 'p':
+                spec->arg_type = GNB_LOG_ARG_POINTER;
+                break;
+            default:
+                spec->arg_type = GNB_LOG_ARG_NONE;
+                break;
+        }
+        return spec->end;
+    }
+    return NULL;
+}
+
+static gnb_ring_buffer_var_t* log_async_thread_ring() {
+    size_t memory_size;
+    void *memory;
+    if ( NULL != thread_log_ring || thread_log_ring_failed ) {
+        return thread_log_ring;
+    }
+    pthread_mutex_lock(&log_async.lock);
+    if ( log_async.ring_num < GNB_LOG_ASYNC_MAX_RING ) {
+        memory_size = gnb_ring_buffer_var_sum_size(GNB_LOG_ASYNC_RING_SIZE, GNB_LOG_ASYNC_MAX_RECORD_SIZE);
+        //gnb_ring_buffer_var_t 的 head/tail 按 cache line 对齐, ring 在进程退出前不会释放, 多申请一个 cache line 用于对齐
+        memory = malloc(memory_size + GNB_CACHE_LINE_SIZE);
+        if ( NULL != memory ) {
+            memory = (void *)(((uintptr_t)memory + GNB_CACHE_LINE_SIZE - 1) & ~((uintptr_t)GNB_CACHE_LINE_SIZE - 1));
+            thread_log_ring = gnb_ring_buffer_var_init(memory, GNB_LOG_ASYNC_RING_SIZE, GNB_LOG_ASYNC_MAX_RECORD_SIZE);
+            log_async.rings[log_async.ring_num] = thread_log_ring;
+            __atomic_store_n(&log_async.ring_num, log_async.ring_num + 1, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&log_async.lock);
+    if ( NULL == thread_log_ring ) {
+        thread_log_ring_failed = 1;
+    }
+    return thread_log_ring;
+}
+
+#define GNB_LOG_RECORD_PUT(p, end, value)               \
+        do{                                              \
+            if ( (p) + sizeof(value) > (end) ) {         \
+                goto finish;                             \
+            }                                            \
+            memcpy((p), &(value), sizeof(value));        \
+            (p) += sizeof(value);                        \
+        }while(0)
+
+/*
+ 按 format 中的转换说明从 ap 中取出参数, 整数统一保存为 64 位, 字符串复制到记录中
+ 记录写不下的参数被丢弃, 输出时对应的转换说明为空
+ 没有可用的 ring 时返回 -1, 由调用者同步输出
+*/
+static int log_async_push(uint8_t log_type, uint8_t log_id, uint8_t level, const char *format, va_list ap) {
+    gnb_ring_buffer_var_t *ring;
+    gnb_log_record_t *record;
+    gnb_log_spec_t spec;
+    unsigned char *p;
+    unsigned char *end;
+    const char *s;
+    const char *str;
+    int64_t  i64;
+    uint64_t u64;
+    int32_t  i32;
+    double d;
+    void *ptr;
+    uint32_t len;
+    uint32_t max_len;
+    int i;
+    ring = log_async_thread_ring();
+    if ( NULL == ring ) {
+        return -1;
+    }
+    record = (gnb_log_record_t *)gnb_ring_buffer_var_push(ring, GNB_LOG_ASYNC_MAX_RECORD_SIZE);
+    if ( NULL == record ) {
+        __atomic_add_fetch(&log_async.drop_num, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+    record->ts_usec  = gnb_timestamp_usec();
+    record->format   = format;
+    record->log_type = log_type;
+    record->log_id   = log_id;
+    record->level    = level;
+    p   = record->args;
+    end = (unsigned char *)record + GNB_LOG_ASYNC_MAX_RECORD_SIZE;
+    s = format;
+    while ( NULL != (s = log_next_spec(s, &spec)) ) {
+        for ( i=0; i<spec.stars; i++ ) {
+            i32 = va_arg(ap, int);
+            GNB_LOG_RECORD_PUT(p, end, i32);
+            //'.*' 总是最后一个 '*', 负数的精度等于没有精度
+            if ( spec.precision_star && i == spec.stars - 1 ) {
+                spec.precision = i32 < 0 ? -1 : i32;
+            }
+        }
+        switch ( spec.arg_type ) {
+            case GNB_LOG_ARG_INT64:
+                if ( 'h' == spec.length[0] && 'h' == spec.length[1] ) {
+                    i64 = (signed char)va_arg(ap, int);
+                } else if ( 'h' == spec.length[0] ) {
+                    i64 = (short)va_arg(ap, int);
+                } else if ( ('l' == spec.length[0] && 'l' == spec.length[1]) || 'q' == spec.length[0] ) {
+                    i64 = va_arg(ap, long long);
+                } else if ( 'l' == spec.length[0] ) {
+                    i64 = va_arg(ap, long);
+                } else if ( 'j' == spec.length[0] ) {
+                    i64 = va_arg(ap, intmax_t);
+                } else if ( 'z' == spec.length[0] || 't' == spec.length[0] ) {
+                    i64 = va_arg(ap, ptrdiff_t);
+                } else {
+                    i64 = va_arg(ap, int);
+                }
+                GNB_LOG_RECORD_PUT(p, end, i64);
+                break;
+            case GNB_LOG_ARG_UINT64:
+                if ( 'h' == spec.length[0] && 'h' == spec.length[1] ) {
+                    u64 = (unsigned char)va_arg(ap, unsigned int);
+                } else if ( 'h' == spec.length[0] ) {
+                    u64 = (unsigned short)va_arg(ap, unsigned int);
+                } else if ( ('l' == spec.length[0] && 'l' == spec.length[1]) || 'q' == spec.length[0] ) {
+                    u64 = va_arg(ap, unsigned long long);
+                } else if ( 'l' == spec.length[0] ) {
+                    u64 = va_arg(ap, unsigned long);
+                } else if ( 'j' == spec.length[0] ) {
+                    u64 = va_arg(ap, uintmax_t);
+                } else if ( 'z' == spec.length[0] || 't' == spec.length[0] ) {
+                    u64 = va_arg(ap, size_t);
+                } else {
+                    u64 = va_arg(ap, unsigned int);
+                }
+                GNB_LOG_RECORD_PUT(p, end, u64);
+                break;
+            case GNB_LOG_ARG_CHAR:
+                i32 = va_arg(ap, int);
+                GNB_LOG_RECORD_PUT(p, end, i32);
+                break;
+            case GNB_LOG_ARG_DOUBLE:
+                if ( 'L' == spec.length[0] ) {
+                    d = (double)va_arg(ap, long double);
+                } else {
+                    d = va_arg(ap, double);
+                }
+                GNB_LOG_RECORD_PUT(p, end, d);
+                break;
+            case GNB_LOG_ARG_STRING:
+                str = va_arg(ap, const char *);
+                if ( NULL == str ) {
+                    str = "(null)";
+                }
+                if ( p + sizeof(len) + 1 > end ) {
+                    goto finish;
+                }
+                //"%.*s" 输出的字段可能没有 '\0' 结尾, 不能读超过精度的字节
+                max_len = GNB_LOG_ASYNC_MAX_STRING;
+                if ( spec.precision >= 0 && spec.precision < GNB_LOG_ASYNC_MAX_STRING ) {
+                    max_len = (uint32_t)spec.precision;
+                }
+                len = strnlen(str, max_len);
+                if ( len > end - p - sizeof(len) - 1 ) {
+                    len = end - p - sizeof(len) - 1;
+                }
+                memcpy(p, &len, sizeof(len));
+                p += sizeof(len);
+                memcpy(p, str, len);
+                p[len] = '\0';
+                p += len + 1;
+                break;
+            case GNB_LOG_ARG_POINTER:
+                ptr = va_arg(ap, void *);
+                GNB_LOG_RECORD_PUT(p, end, ptr);
+                break;
+            default:
+                //%n 等不支持的转换说明, 丢弃参数
+                ptr = va_arg(ap, void *);
+                break;
+        }
+    }
+
+finish:
+    record->args_size = (uint32_t)(p - record->args);
+    gnb_ring_buffer_var_push_submit(ring, sizeof(gnb_log_record_t) + record->args_size);
+    return 0;
+}
+
+/*
+ 复制 format 中两个转换说明之间的文本, "%%" 替换为 "%"
+*/
+static int log_append_literal(char *out, int out_len, int max_len, const char *from, const char *to) {
+    while ( from < to && out_len < max_len ) {
+        if ( '%' == *from && from + 1 < to && '%' == from[1] ) {
+            from++;
+        }
+        out[out_len++] = *from++;
+    }
+    return out_len;
+}
+
+#define GNB_LOG_RECORD_GET(p, end, value)               \
+        do{                                              \
+            if ( (p) + sizeof(value) > (end) ) {         \
+                goto finish;                             \
+            }                                            \
+            memcpy(&(value), (p), sizeof(value));        \
+            (p) += sizeof(value);                        \
+        }while(0)
+
+#define GNB_LOG_SPEC_SNPRINTF(out, size, spec_string, stars, star, value)                                   \
+        ( 0 == (stars) ? snprintf((out), (size), (spec_string), (value)) :                                   \
+          1 == (stars) ? snprintf((out), (size), (spec_string), (star)[0], (value)) :                        \
+                         snprintf((out), (size), (spec_string), (star)[0], (star)[1], (value)) )
+
+static void log_async_output(gnb_log_ctx_t *log, gnb_log_record_t *record) {
+    char log_string_buffer[GNB_LOG_LINE_MAX+4];
+    char *log_string = log_string_buffer+4;
+    int log_string_len;
+    char spec_string[64];
+    size_t spec_len;
+    gnb_log_spec_t spec;
+    const char *s;
+    const char *next;
+    unsigned char *p   = record->args;
+    unsigned char *end = record->args + record->args_size;
+    int star[2];
+    int64_t  i64;
+    uint64_t u64;
+    int32_t  i32;
+    double d;
+    void *ptr;
+    uint32_t len;
+    int ret;
+    int i;
+    if ( record->ts_usec / 1000000 != log_async.last_sec ) {
+        log_async.last_sec = record->ts_usec / 1000000;
+        gnb_timef("%y-%m-%d %H:%M:%S", (time_t)log_async.last_sec, log_async.now_time_string, GNB_TIME_STRING_MAX);
+    }
+    log_string_len = snprintf(log_string, GNB_LOG_LINE_MAX, "%s %s ", log_async.now_time_string, log->config_table[record->log_id].log_name);
+    s = record->format;
+    while ( NULL != (next = log_next_spec(s, &spec)) ) {
+        log_string_len = log_append_literal(log_string, log_string_len, GNB_LOG_LINE_MAX, s, spec.start);
+        s = next;
+        spec_len = spec.length_start - spec.start;
+        if ( spec_len + 4 > sizeof(spec_string) ) {
+            continue;
+        }
+        memcpy(spec_string, spec.start, spec_len);
+        if ( GNB_LOG_ARG_INT64 == spec.arg_type || GNB_LOG_ARG_UINT64 == spec.arg_type ) {
+            spec_string[spec_len++] = 'l';
+            spec_string[spec_len++] = 'l';
+        }
+        spec_string[spec_len++] = spec.conversion;
+        spec_string[spec_len]   = '\0';
+        for ( i=0; i<spec.stars; i++ ) {
+            GNB_LOG_RECORD_GET(p, end, i32);
+            star[i] = i32;
+        }
+        ret = 0;
+        switch ( spec.arg_type ) {
+            case GNB_LOG_ARG_INT64:
+                GNB_LOG_RECORD_GET(p, end, i64);
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, (long long)i64);
+                break;
+            case GNB_LOG_ARG_UINT64:
+                GNB_LOG_RECORD_GET(p, end, u64);
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, (unsigned long long)u64);
+                break;
+            case GNB_LOG_ARG_CHAR:
+                GNB_LOG_RECORD_GET(p, end, i32);
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, (int)i32);
+                break;
+            case GNB_LOG_ARG_DOUBLE:
+                GNB_LOG_RECORD_GET(p, end, d);
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, d);
+                break;
+            case GNB_LOG_ARG_STRING:
+                GNB_LOG_RECORD_GET(p, end, len);
+                if ( p + len + 1 > end ) {
+                    goto finish;
+                }
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, (const char *)p);
+                p += len + 1;
+                break;
+            case GNB_LOG_ARG_POINTER:
+                GNB_LOG_RECORD_GET(p, end, ptr);
+                ret = GNB_LOG_SPEC_SNPRINTF(log_string + log_string_len, GNB_LOG_LINE_MAX - log_string_len, spec_string, spec.stars, star, ptr);
+                break;
+            default:
+                break;
+        }
+        if ( ret > 0 ) {
+            log_string_len += ret;
+        }
+        if ( log_string_len >= GNB_LOG_LINE_MAX ) {
+            log_string_len = GNB_LOG_LINE_MAX - 1;
+            goto output;
+        }
+    }
+
+finish:
+    log_string_len = log_append_literal(log_string, log_string_len, GNB_LOG_LINE_MAX, s, s + strlen(s));
+
+output:
+    log_output(log, record->log_type, record->log_id, record->level, log_string_buffer, log_string_len);
+}
+
+/*
+ 取出所有 ring 中的记录并输出, 返回处理的记录数
+ 只在 writer 线程中执行, 每个 ring 只有这一个消费者
+ ring 在 rings 中写好之后才以 release 更新 ring_num, 这里不需要拿 lock
+*/
+static int log_async_drain() {
+    gnb_log_record_t *record;
+    uint32_t ring_num;
+    uint64_t drop_num;
+    char log_string_buffer[256+4];
+    int log_string_len;
+    int num = 0;
+    int n;
+    uint32_t i;
+    ring_num = __atomic_load_n(&log_async.ring_num, __ATOMIC_ACQUIRE);
+    for ( i=0; i<ring_num; i++ ) {
+        do {
+            for ( n=0; n<256; n++ ) {
+                record = (gnb_log_record_t *)gnb_ring_buffer_var_pop(log_async.rings[i], NULL);
+                if ( NULL == record ) {
+                    break;
+                }
+                log_async_output(log_async.log, record);
+            }
+            gnb_ring_buffer_var_pop_submit(log_async.rings[i]);
+            num += n;
+        } while ( 256 == n );
+    }
+    drop_num = __atomic_exchange_n(&log_async.drop_num, 0, __ATOMIC_RELAXED);
+    if ( drop_num > 0 ) {
+        log_string_len = snprintf(log_string_buffer+4, 256, "%s %s log ring full, %llu log records dropped\n", log_async.now_time_string, log_async.log->config_table[0].log_name, (unsigned long long)drop_num);
+        log_output(log_async.log, GNB_LOG_TYPE_STD, 0, GNB_LOG_LEVEL1, log_string_buffer, log_string_len);
+    }
+    return num;
+}
+
+static void* log_async_writer_thread_func(void *data) {
+    while ( __atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE) ) {
+        if ( 0 == log_async_drain() ) {
+            GNB_SLEEP_MILLISECOND(GNB_LOG_ASYNC_IDLE_MSEC);
+        }
+    }
+    //running 置 0 之后写日志的线程改为同步输出, 这里输出 ring 中剩下的记录
+    log_async_drain();
+    return NULL;
+}
+
+int gnb_log_async_start(gnb_log_ctx_t *log) {
+    if ( NULL != log_async.log ) {
+        return -1;
+    }
+    log_async.log = log;
+    __atomic_store_n(&log_async.running, 1, __ATOMIC_RELEASE);
+    if ( 0 != pthread_create(&log_async.writer_thread, NULL, log_async_writer_thread_func, NULL) ) {
+        log_async.running = 0;
+        log_async.log = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ 由 gnb_core_stop 调用, 调用者不会拿 log_async.lock, 在 signal handler 中调用也不会死锁
+*/
+void gnb_log_async_stop(gnb_log_ctx_t *log) {
+    if ( log != log_async.log || 0 == __atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE) ) {
+        return;
+    }
+    __atomic_store_n(&log_async.running, 0, __ATOMIC_RELEASE);
+    //信号落在 writer 线程上时不能 join 自己, 这时 drain 可能只执行了一半, 放弃剩下的记录
+    if ( pthread_equal(pthread_self(), log_async.writer_thread) ) {
+        return;
+    }
+    pthread_join(log_async.writer_thread, NULL);
+}
+
 void gnb_logf(gnb_log_ctx_t *log, uint8_t log_type, uint8_t log_id, uint8_t level, const char *format, ...) {
     char now_time_string[GNB_TIME_STRING_MAX];
     char log_string_buffer[GNB_LOG_LINE_MAX+4];
     char *log_string;
     int log_string_len;
     int len;
+    int ret;
     char *p;
+    va_list ap;
+    if ( log == log_async.log && GNB_LOG_TYPE_ERROR != log_type && __atomic_load_n(&log_async.running, __ATOMIC_ACQUIRE) ) {
+        va_start(ap, format);
+        ret = log_async_push(log_type, log_id, level, format, ap);
+        va_end(ap);
+        if ( 0 == ret ) {
+            return;
+        }
+    }
     //加上 一个 offset 4 用于后面的 udp binary output 可以加上一个4字节的 gnb_payload 首部
     log_string = log_string_buffer+4;
     p = log_string;
@@ -155,7 +719,6 @@ void gnb_logf(gnb_log_ctx_t *log, uint8_t log_type, uint8_t log_id, uint8_t leve
         return;
     }
     p += log_string_len;
-    va_list ap;
     va_start(ap, format);
     len = vsnprintf(p, GNB_LOG_LINE_MAX-log_string_len, format, ap);
     va_end(ap);
@@ -163,19 +726,7 @@ void gnb_logf(gnb_log_ctx_t *log, uint8_t log_type, uint8_t log_id, uint8_t leve
     if ( log_string_len > GNB_LOG_LINE_MAX ) {
         return;
     }
-    if ( (log->output_type & GNB_LOG_OUTPUT_STDOUT) && (log->config_table[log_id].console_level >= level) ) {
-        log_console_output(log_type, log_string, log_string_len);
-    }
-    if ( log->output_type & GNB_LOG_OUTPUT_FILE && (log->config_table[log_id].file_level >= level) ) {
-        log_file_output(log, log_type, log_string, log_string_len);
-    }
-    if ( log->output_type & GNB_LOG_OUTPUT_UDP && (log->config_table[log_id].udp_level >= level) ) {
-        if ( GNB_LOG_UDP_TYPE_BINARY == log->log_udp_type ) {
-            log_udp_binary_output(log, log_type, log_id, log_string_buffer, log_string_len);
-        } else {
-            log_udp_output(log, log_type, log_string, log_string_len);
-        }
-    }
+    log_output(log, log_type, log_id, level, log_string_buffer, log_string_len);
 }
 
 int gnb_log_udp_open(gnb_log_ctx_t *log) {
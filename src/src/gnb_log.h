@@ -44,6 +44,14 @@ STD DEBUG ERROR 只是作为一种日志的内置标签，不通过 level 细分
 */
 void gnb_logf(gnb_log_ctx_t *log, uint8_t log_type, uint8_t log_id, uint8_t level, const char *format, ...);
 int gnb_log_udp_open(gnb_log_ctx_t *log);
+
+/*
+ 启动 writer 线程后, 除了 ERROR 以外的日志由 writer 线程异步格式化和输出
+ 进程退出时会把 ring 中剩余的日志输出
+*/
+int gnb_log_async_start(gnb_log_ctx_t *log);
+void gnb_log_async_stop(gnb_log_ctx_t *log);
+
 int gnb_log_file_rotate(gnb_log_ctx_t *log);
 
 int gnb_log_udp_set_addr4(gnb_log_ctx_t *log, char *ip, uint16_t port4);
@@ -86,10 +86,16 @@ gnb_mmap_block_t* gnb_mmap_create(const char *filename, size_t block_size, int m
         prot = PROT_READ;
     }
     block = mmap(NULL, block_size, prot, MAP_SHARED, fd, 0);
-    if ( NULL==block ) {
+    if ( MAP_FAILED==block ) {
         close(fd);
         return NULL;
     }
+    #if defined(__linux__) && defined(MADV_HUGEPAGE)
+    if ( mmap_type & GNB_MMAP_TYPE_HUGEPAGE ) {
+        //文件位于 tmpfs 且 shmem 开启了 transparent huge page 时生效, 否则忽略
+        madvise(block, block_size, MADV_HUGEPAGE);
+    }
+    #endif
     mmap_block = (gnb_mmap_block_t *)malloc(sizeof(gnb_mmap_block_t));
     snprintf(mmap_block->filename, PATH_MAX, "%s", filename);
     mmap_block->fd = fd;
@@ -25,6 +25,8 @@ typedef struct _gnb_mmap_block_t gnb_mmap_block_t;
 #define GNB_MMAP_TYPE_READWRITE              (0x1)
 #define GNB_MMAP_TYPE_CREATE                 (0x1 << 1)
 #define GNB_MMAP_TYPE_CLEANEXIT              (0x1 << 2)
+//尽量使用 huge page, 不支持时按普通页映射
+#define GNB_MMAP_TYPE_HUGEPAGE               (0x1 << 3)
 
 gnb_mmap_block_t* gnb_mmap_create(const char *filename, size_t block_size, int mmap_type);
 void gnb_mmap_release(gnb_mmap_block_t *mmap_block);
@@ -27,6 +27,8 @@ extern gnb_pf_t gnb_pf_route;
 extern gnb_pf_t gnb_pf_crypto_xor;
 extern gnb_pf_t gnb_pf_crypto_arc4;
 extern gnb_pf_t gnb_pf_zip;
+extern gnb_pf_t gnb_pf_lz4;
+extern gnb_pf_t gnb_pf_header_zip;
 
 gnb_pf_t *gnb_pf_mods[] = {
     &gnb_pf_dump,
@@ -34,20 +36,42 @@ gnb_pf_t *gnb_pf_mods[] = {
     &gnb_pf_crypto_xor,
     &gnb_pf_crypto_arc4,
     &gnb_pf_zip,
+    &gnb_pf_lz4,
+    &gnb_pf_header_zip,
     0
 };
 
-gnb_pf_t* gnb_find_pf_mod_by_name(const char *name){
+/*
+ 每个 gnb_core 使用 gnb_pf_mods 的一份复制, pf 模块的 private_ctx 保存的是 gnb_core 相关的数据,
+ 同一个进程中有多个 gnb_core 时(如 gnb_bench)不能共用同一个 gnb_pf_t, 同一个 gnb_core 的各个 worker 仍然共用一份
+*/
+gnb_pf_array_t* gnb_pf_mod_array_create(gnb_heap_t *heap){
     int num =  sizeof(gnb_pf_mods)/sizeof(gnb_pf_t *);
+    gnb_pf_array_t *pf_mod_array;
+    gnb_pf_t *pf;
     int i;
+    pf_mod_array = (gnb_pf_array_t *)gnb_heap_alloc(heap, sizeof(gnb_pf_array_t) + sizeof(gnb_pf_t *)*num);
+    pf_mod_array->size = num;
+    pf_mod_array->num  = 0;
     for ( i=0; i<num; i++ ) {
         if (NULL==gnb_pf_mods[i]) {
             break;
         }
-        if ( 0 == strncmp(gnb_pf_mods[i]->name,name,128) ) {
-            return gnb_pf_mods[i];
-        }
+        pf = (gnb_pf_t *)gnb_heap_alloc(heap, sizeof(gnb_pf_t));
+        memcpy(pf, gnb_pf_mods[i], sizeof(gnb_pf_t));
+        pf_mod_array->pf[pf_mod_array->num] = pf;
+        pf_mod_array->num++;
+    }
+    return pf_mod_array;
+}
 
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name){
+    gnb_pf_array_t *pf_mod_array = gnb_core->pf_mod_array;
+    int i;
+    for ( i=0; i<pf_mod_array->num; i++ ) {
+        if ( 0 == strncmp(pf_mod_array->pf[i]->name,name,128) ) {
+            return pf_mod_array->pf[i];
+        }
     }
     return NULL;
 }
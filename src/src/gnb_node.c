@@ -23,6 +23,8 @@
 
 #ifdef __UNIX_LIKE_OS__
 #include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #endif
 
 #ifdef _WIN32
@@ -40,12 +42,15 @@
 #include "ed25519/sha512.h"
 #include "gnb_unified_forwarding.h"
 #include "gnb_binary.h"
+#include "gnb_trace.h"
 
 gnb_node_t * gnb_node_init(gnb_core_t *gnb_core, gnb_uuid_t uuid64){
     gnb_node_t *node = &gnb_core->ctl_block->node_zone->node[gnb_core->node_nums];
     memset(node,0,sizeof(gnb_node_t));
     node->uuid64 = uuid64;
     node->type =  GNB_NODE_TYPE_STD;
+    node->peer_socket4 = -1;
+    node->peer_socket6 = -1;
     gnb_uuid_t node_id_network_order;
     gnb_uuid_t local_node_id_network_order;
     gnb_address_list_t *static_address_list;
@@ -325,6 +330,62 @@ void gnb_send_udata_to_address(gnb_core_t *gnb_core, gnb_address_t *address, voi
     }
 }
 
+/*
+ 把 head 和 data 作为一个 udp 分组发送, 用于在 payload 前面加上首部转发时不需要把 payload 拷贝到新的 buffer 中
+*/
+void gnb_send_to_address_with_head(gnb_core_t *gnb_core, gnb_address_t *address, void *head, size_t head_size, void *data, size_t data_size){
+    struct sockaddr_in  in;
+    struct sockaddr_in6 in6;
+    struct sockaddr *sockaddr;
+    socklen_t sockaddr_len;
+    int sockfd;
+    if ( 0 == address->port ) {
+        return;
+    }
+    if ( AF_INET6 == address->type ) {
+        memset(&in6,0,sizeof(struct sockaddr_in6));
+        in6.sin6_family = AF_INET6;
+        in6.sin6_port = address->port;
+        memcpy(&in6.sin6_addr, address->address.addr6, 16);
+        sockfd = gnb_core->udp_ipv6_sockets[0];
+        sockaddr = (struct sockaddr *)&in6;
+        sockaddr_len = sizeof(struct sockaddr_in6);
+    } else if ( AF_INET == address->type ) {
+        memset(&in,0,sizeof(struct sockaddr_in));
+        in.sin_family = AF_INET;
+        in.sin_port = address->port;
+        memcpy(&in.sin_addr, address->address.addr4, 4);
+        sockfd = gnb_core->udp_ipv4_sockets[0];
+        sockaddr = (struct sockaddr *)&in;
+        sockaddr_len = sizeof(struct sockaddr_in);
+    } else {
+        return;
+    }
+#ifdef __UNIX_LIKE_OS__
+    struct iovec iov[2];
+    struct msghdr msg;
+    iov[0].iov_base = head;
+    iov[0].iov_len  = head_size;
+    iov[1].iov_base = data;
+    iov[1].iov_len  = data_size;
+    memset(&msg, 0, sizeof(struct msghdr));
+    msg.msg_name    = sockaddr;
+    msg.msg_namelen = sockaddr_len;
+    msg.msg_iov     = iov;
+    msg.msg_iovlen  = 2;
+    sendmsg(sockfd, &msg, 0);
+#endif
+#ifdef _WIN32
+    WSABUF wsa_buf[2];
+    DWORD send_bytes;
+    wsa_buf[0].buf = head;
+    wsa_buf[0].len = (ULONG)head_size;
+    wsa_buf[1].buf = data;
+    wsa_buf[1].len = (ULONG)data_size;
+    WSASendTo((SOCKET)sockfd, wsa_buf, 2, &send_bytes, 0, sockaddr, sockaddr_len, NULL, NULL);
+#endif
+}
+
 void gnb_send_address_list(gnb_core_t *gnb_core, gnb_address_list_t *address_list, gnb_payload16_t *payload){
     int i;
     for ( i=0; i<address_list->num; i++ ) {
@@ -564,8 +625,28 @@ finish:
     return 0;
 }
 
+/*
+ node 有 peer socket 时用 send() 发送, 内核不需要为每个分组查找路由
+*/
+static ssize_t send_to_node_ipv6(gnb_core_t *gnb_core, gnb_node_t *node, gnb_payload16_t *payload) {
+    int sockfd = __atomic_load_n(&node->peer_socket6, __ATOMIC_ACQUIRE);
+    if ( sockfd >= 0 ) {
+        return send(sockfd, (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0);
+    }
+    return sendto(gnb_core->udp_ipv6_sockets[node->socket6_idx], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr6, sizeof(struct sockaddr_in6));
+}
+
+static ssize_t send_to_node_ipv4(gnb_core_t *gnb_core, gnb_node_t *node, gnb_payload16_t *payload) {
+    int sockfd = __atomic_load_n(&node->peer_socket4, __ATOMIC_ACQUIRE);
+    if ( sockfd >= 0 ) {
+        return send(sockfd, (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0);
+    }
+    return sendto(gnb_core->udp_ipv4_sockets[node->socket4_idx], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr4, sizeof(struct sockaddr_in));
+}
+
 int gnb_p2p_forward_payload_to_node(gnb_core_t *gnb_core, gnb_node_t *node, gnb_payload16_t *payload){
     int ret;
+    GNB_TRACE3(p2p_forward, node->uuid64, GNB_PAYLOAD16_FRAME_SIZE(payload), node->udp_addr_status);
     // gnb_core->conf->udp_socket_type 默认是 GNB_ADDR_TYPE_IPV4 | GNB_ADDR_TYPE_IPV6;
     if ( GNB_ADDR_TYPE_IPV4 == gnb_core->conf->udp_socket_type ) {
         goto send_by_ipv4;
@@ -588,11 +669,11 @@ int gnb_p2p_forward_payload_to_node(gnb_core_t *gnb_core, gnb_node_t *node, gnb_
 
 send_by_ipv6:
     if ( (node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) && (gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV6) && memcmp(&node->udp_sockaddr6.sin6_addr,&in6addr_any,sizeof(struct in6_addr)) ) {
-        sendto(gnb_core->udp_ipv6_sockets[node->socket6_idx],(void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr6, sizeof(struct sockaddr_in6) );
+        send_to_node_ipv6(gnb_core, node, payload);
         goto finish;
     }
 send_by_ipv4:
-    ret = sendto(gnb_core->udp_ipv4_sockets[ node->socket4_idx ], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr4, sizeof(struct sockaddr_in));
+    ret = send_to_node_ipv4(gnb_core, node, payload);
 finish:
     return 0;
 }
@@ -637,13 +718,13 @@ p2p_forwarding:
         if ( memcmp(&node->udp_sockaddr6.sin6_addr, &in6addr_any,sizeof(struct in6_addr)) ) {
             return;
         }
-        sendto(gnb_core->udp_ipv6_sockets[node->socket6_idx],(void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr6, sizeof(struct sockaddr_in6) );
+        send_to_node_ipv6(gnb_core, node, payload);
         return;
     } else if ( GNB_SEND_BY_P2P_IPV4 == send_flag ) {
         if ( INADDR_ANY == node->udp_sockaddr4.sin_addr.s_addr ) {
             return;
         }
-        sendto(gnb_core->udp_ipv4_sockets[node->socket4_idx], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&node->udp_sockaddr4, sizeof(struct sockaddr_in));
+        send_to_node_ipv4(gnb_core, node, payload);
         return;
     }
 
@@ -684,13 +765,13 @@ standard_forwarding:
         if ( memcmp(&fwd_node->udp_sockaddr6.sin6_addr, &in6addr_any,sizeof(struct in6_addr)) ) {
             return;
         }
-        sendto(gnb_core->udp_ipv6_sockets[fwd_node->socket6_idx],(void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&fwd_node->udp_sockaddr6, sizeof(struct sockaddr_in6) );
+        send_to_node_ipv6(gnb_core, fwd_node, payload);
         return;
     } else if ( GNB_SEND_BY_FWD_IPV4 == send_flag ) {
         if ( INADDR_ANY == fwd_node->udp_sockaddr4.sin_addr.s_addr ) {
             return;
         }
-        sendto(gnb_core->udp_ipv4_sockets[fwd_node->socket4_idx], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&fwd_node->udp_sockaddr4, sizeof(struct sockaddr_in));
+        send_to_node_ipv4(gnb_core, fwd_node, payload);
         return;
     }
 
@@ -735,13 +816,13 @@ unified_forwarding:
         if ( memcmp(&fwd_node->udp_sockaddr6.sin6_addr,&in6addr_any,sizeof(struct in6_addr)) ) {
             return;
         }
-        sendto(gnb_core->udp_ipv6_sockets[fwd_node->socket6_idx],(void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&fwd_node->udp_sockaddr6, sizeof(struct sockaddr_in6) );
+        send_to_node_ipv6(gnb_core, fwd_node, payload);
         return;
     } else if ( GNB_SEND_BY_FWD_IPV4 == send_flag ) {
         if ( INADDR_ANY == fwd_node->udp_sockaddr4.sin_addr.s_addr ) {
             return;
         }
-        sendto(gnb_core->udp_ipv4_sockets[fwd_node->socket4_idx], (void *)payload, GNB_PAYLOAD16_FRAME_SIZE(payload), 0, (struct sockaddr *)&fwd_node->udp_sockaddr4, sizeof(struct sockaddr_in));
+        send_to_node_ipv4(gnb_core, fwd_node, payload);
         return;
     }
     return;
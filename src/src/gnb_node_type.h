@@ -19,6 +19,7 @@
 #define GNB_NODE_TYPE_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "gnb_address_type.h"
 #include "gnb_type.h"
 
@@ -27,43 +28,88 @@ typedef struct _gnb_unified_forwarding_node_t {
 	uint64_t   last_ts_sec;
 } gnb_unified_forwarding_node_t;
 
-typedef struct _gnb_node_t {
+/*
+ gnb_node_t 按访问频率分为 hot 和 cold 两部分:
+ hot 部分是 pf 转发路径上每个 packet 都会访问的字段，集中在结构体开头的 3 个 cache line 内;
+ cold 部分是 detect/index/ping 等控制面的字段，从一个新的 cache line 开始，避免转发时把它们带入 cache
+ gnb_node_t 按 cache line 对齐，ctl_block 中 node_zone 的起始地址也按 cache line 对齐
+*/
+typedef struct GNB_CACHE_ALIGNED _gnb_node_t {
+
+	/* hot */
 	gnb_uuid_t uuid64;
-	uint64_t in_bytes;
-	uint64_t out_bytes;
+
+	#define GNB_NODE_STATUS_UNREACHABL   (0x0)
+	#define GNB_NODE_STATUS_IPV4_PING    (0x1)
+	#define GNB_NODE_STATUS_IPV6_PING    (0x1 << 1)
+
+	#define GNB_NODE_STATUS_IPV4_PONG    (0x1 << 2)
+	#define GNB_NODE_STATUS_IPV6_PONG    (0x1 << 3)
+
+	#define GNB_NODE_STATUS_IPV4_STATIC  (0x1 << 2)
+	#define GNB_NODE_STATUS_IPV6_STATIC  (0x1 << 3)
+
+	//初始值为 GNB_NODE_STATUS_UNREACHABL, 实现ping pong 后用 GNB_NODE_STATUS_IPV4  GNB_NODE_STATUS_IPV6 置位
+	unsigned int udp_addr_status;
+
 	#define GNB_NODE_TYPE_STD               (0x0)
 	#define GNB_NODE_TYPE_IDX               (0x1)
 	#define GNB_NODE_TYPE_FWD               (0x1 << 1)
-    #define GNB_NODE_TYPE_RELAY             (0x1 << 2)
+	#define GNB_NODE_TYPE_RELAY             (0x1 << 2)
 	#define GNB_NODE_TYPE_SLIENCE           (0x1 << 3)
 	#define GNB_NODE_TYPE_STATIC_ADDR       (0x1 << 4)
 	//未使用
 	#define GNB_NODE_TYPE_DYNAMIC_ADDR      (0x1 << 5)
 	unsigned char type;
 
-	struct in_addr  tun_addr4;
-	struct in_addr  tun_netmask_addr4;
-	struct in_addr  tun_subnet_addr4;
-	uint16_t tun_sin_port4;
+	#define GNB_NODE_RELAY_DISABLE          (0x0)
+	#define GNB_NODE_RELAY_AUTO             (0x1)
+	#define GNB_NODE_RELAY_FORCE            (0x1 << 1)
+	#define GNB_NODE_RELAY_STATIC           (0x1 << 2)
+	#define GNB_NODE_RELAY_BALANCE          (0x1 << 3)
+
+	uint8_t  node_relay_mode;
 
-	struct in6_addr tun_ipv6_addr;
-	struct sockaddr_in  udp_sockaddr4;
-	struct sockaddr_in6 udp_sockaddr6;
 	uint8_t            socket6_idx;
 	uint8_t            socket4_idx;
+
 	#define GNB_MAX_NODE_ROUTE    8
 	#define GNB_MAX_NODE_RELAY    5
-	gnb_uuid_t route_node[GNB_MAX_NODE_ROUTE][GNB_MAX_NODE_RELAY];
-	uint8_t  route_node_ttls[GNB_MAX_NODE_ROUTE];
 	uint8_t  selected_route_node;
+	uint8_t  route_node_ttls[GNB_MAX_NODE_ROUTE];
 
-	#define GNB_NODE_RELAY_DISABLE          (0x0)
-	#define GNB_NODE_RELAY_AUTO             (0x1)
-	#define GNB_NODE_RELAY_FORCE            (0x1 << 1)
-	#define GNB_NODE_RELAY_STATIC           (0x1 << 2)
-	#define GNB_NODE_RELAY_BALANCE          (0x1 << 3)
+	struct in_addr  tun_addr4;
 
-	uint8_t  node_relay_mode;
+	//--peer-socket on 时 connect 到 udp_sockaddr4 udp_sockaddr6 的 socket, 由 primary worker 维护, 没有时为 -1
+	int peer_socket4;
+	int peer_socket6;
+
+	struct sockaddr_in  udp_sockaddr4;
+
+	struct sockaddr_in6 udp_sockaddr6;
+
+	//保护 udp_addr_status socket6_idx socket4_idx udp_sockaddr4 udp_sockaddr6 addr6/addr4_ping_latency_usec addr6/addr4_update_ts_sec 的 seqlock,
+	//外部进程用 gnb_ctl_block_node_addr_snapshot 读取这些字段, 放在 udp_sockaddr6 之后的空隙中, 不改变 hot 部分的布局
+	uint32_t addr_seq;
+
+	int64_t addr6_ping_latency_usec;
+	int64_t addr4_ping_latency_usec;
+
+	gnb_uuid_t last_relay_nodeid;
+	#define GNB_LAST_RELAY_NODE_EXPIRED_SEC         145
+	uint64_t last_relay_node_ts_sec;
+
+	//shared_secret 与 gnb_core->time_seed & 运算后再经过 sha512 的摘要信息
+	unsigned char crypto_key[64];     //当前通信密钥
+
+	/* cold */
+	gnb_uuid_t route_node[GNB_MAX_NODE_ROUTE][GNB_MAX_NODE_RELAY] GNB_CACHE_ALIGNED;
+
+	struct in_addr  tun_netmask_addr4;
+	struct in_addr  tun_subnet_addr4;
+	uint16_t tun_sin_port4;
+
+	struct in6_addr tun_ipv6_addr;
 
 	#define GNB_NODE_STATIC_ADDRESS_NUM   6
 	#define GNB_NODE_DYNAMIC_ADDRESS_NUM 16
@@ -83,7 +129,7 @@ typedef struct _gnb_node_t {
 	unsigned char push_address_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*GNB_NODE_PUSH_ADDRESS_NUM];
 
 	unsigned char available_address6_list3_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
-    unsigned char available_address4_list3_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
+	unsigned char available_address4_list3_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
 
 	unsigned char   detect_address4_block[sizeof(gnb_address_list_t) + sizeof(gnb_address_t)*3];
 	uint8_t         detect_address4_idx;
@@ -97,22 +143,6 @@ typedef struct _gnb_node_t {
 	uint64_t ping_ts_sec;
 	uint64_t ping_ts_usec;
 
-	#define GNB_NODE_STATUS_UNREACHABL   (0x0)
-	#define GNB_NODE_STATUS_IPV4_PING    (0x1)
-	#define GNB_NODE_STATUS_IPV6_PING    (0x1 << 1)
-
-	#define GNB_NODE_STATUS_IPV4_PONG    (0x1 << 2)
-	#define GNB_NODE_STATUS_IPV6_PONG    (0x1 << 3)
-
-	#define GNB_NODE_STATUS_IPV4_STATIC  (0x1 << 2)
-	#define GNB_NODE_STATUS_IPV6_STATIC  (0x1 << 3)
-
-	//初始值为 GNB_NODE_STATUS_UNREACHABL, 实现ping pong 后用 GNB_NODE_STATUS_IPV4  GNB_NODE_STATUS_IPV6 置位
-	unsigned int udp_addr_status;
-
-	int64_t addr6_ping_latency_usec;
-	int64_t addr4_ping_latency_usec;
-
 	//上次node发来 ping4 或 pong4 时间戳
 	uint64_t addr4_update_ts_sec;
 	//上次node发来 ping6 或 pong6 时间戳
@@ -124,29 +154,23 @@ typedef struct _gnb_node_t {
 	//ed25519 或 通过 passcode 产生的 share key
 	unsigned char shared_secret[32];
 
-	//shared_secret 与 gnb_core->time_seed & 运算后再经过 sha512 的摘要信息
-	unsigned char crypto_key[64];     //当前通信密钥
 	//由于 crypto_key 可以随时间变更,通信密钥在更换瞬间有一定概率会出现用新密钥解密对端发来的数据
 	//保留上一个的旧通信密钥,用于解密旧密钥加密的数据,当前支持 ur1 freame
 	unsigned char pre_crypto_key[64]; //上一个通信密钥
 	unsigned char key512[64];
 
-	gnb_uuid_t last_relay_nodeid;
-    #define GNB_LAST_RELAY_NODE_EXPIRED_SEC         145
-	uint64_t last_relay_node_ts_sec;
-
 	gnb_uuid_t unified_forwarding_nodeid;
-    #define GNB_UNIFIED_FORWARDING_NODE_EXPIRED_SEC 15
+	#define GNB_UNIFIED_FORWARDING_NODE_EXPIRED_SEC 15
 	uint64_t  unified_forwarding_node_ts_sec;
 
 	#define GNB_UNIFIED_FORWARDING_NODE_ARRAY_EXPIRED_SEC     90
-    #define GNB_UNIFIED_FORWARDING_NODE_ARRAY_SIZE            32
+	#define GNB_UNIFIED_FORWARDING_NODE_ARRAY_SIZE            32
 	gnb_unified_forwarding_node_t unified_forwarding_node_array[GNB_UNIFIED_FORWARDING_NODE_ARRAY_SIZE];
 
 	uint64_t unified_forwarding_send_seq;
 	uint64_t unified_forwarding_recv_seq;
 
-    #define UNIFIED_FORWARDING_RECV_SEQ_ARRAY_SIZE            32
+	#define UNIFIED_FORWARDING_RECV_SEQ_ARRAY_SIZE            32
 	uint64_t unified_forwarding_recv_seq_array[UNIFIED_FORWARDING_RECV_SEQ_ARRAY_SIZE];
 
 	uint64_t last_notify_uf_nodes_ts_sec;
@@ -154,10 +178,44 @@ typedef struct _gnb_node_t {
 	uint64_t last_request_addr_sec;
 	uint64_t last_push_addr_sec;
 	uint64_t last_detect_sec;
-    uint64_t last_send_detect_usec;
+	uint64_t last_send_detect_usec;
 	uint64_t last_full_detect_sec;
 } gnb_node_t;
 
+/*
+ hot 部分的布局检查, 调整 gnb_node_t 的字段时如果把 hot 字段挤出对应的 cache line 会编译失败:
+ 转发时最先访问的选路字段在第 1 个 cache line 内, hot 部分整体不超过 GNB_NODE_HOT_CACHE_LINES 个 cache line,
+ cold 部分从新的 cache line 开始
+*/
+#define GNB_NODE_HOT_CACHE_LINES 3
+#define GNB_NODE_FIELD_END(f) ( offsetof(gnb_node_t, f) + sizeof(((gnb_node_t *)0)->f) )
+
+_Static_assert(GNB_NODE_FIELD_END(uuid64)              <= GNB_CACHE_LINE_SIZE, "gnb_node_t uuid64 must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(udp_addr_status)     <= GNB_CACHE_LINE_SIZE, "gnb_node_t udp_addr_status must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(node_relay_mode)     <= GNB_CACHE_LINE_SIZE, "gnb_node_t node_relay_mode must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(socket4_idx)         <= GNB_CACHE_LINE_SIZE, "gnb_node_t socket4_idx must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(socket6_idx)         <= GNB_CACHE_LINE_SIZE, "gnb_node_t socket6_idx must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(selected_route_node) <= GNB_CACHE_LINE_SIZE, "gnb_node_t selected_route_node must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(tun_addr4)           <= GNB_CACHE_LINE_SIZE, "gnb_node_t tun_addr4 must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(udp_sockaddr4)       <= GNB_CACHE_LINE_SIZE, "gnb_node_t udp_sockaddr4 must stay in the first cache line");
+_Static_assert(GNB_NODE_FIELD_END(crypto_key) <= GNB_CACHE_LINE_SIZE * GNB_NODE_HOT_CACHE_LINES, "gnb_node_t hot fields must fit in GNB_NODE_HOT_CACHE_LINES cache lines");
+_Static_assert(offsetof(gnb_node_t, route_node) % GNB_CACHE_LINE_SIZE == 0, "gnb_node_t cold fields must start on a new cache line");
+
+/*
+ gnb_node_t 中由 addr_seq 保护的字段的一致快照
+*/
+typedef struct _gnb_node_addr_snapshot_t {
+	unsigned int udp_addr_status;
+	uint8_t socket6_idx;
+	uint8_t socket4_idx;
+	struct sockaddr_in  udp_sockaddr4;
+	struct sockaddr_in6 udp_sockaddr6;
+	int64_t addr6_ping_latency_usec;
+	int64_t addr4_ping_latency_usec;
+	uint64_t addr6_update_ts_sec;
+	uint64_t addr4_update_ts_sec;
+} gnb_node_addr_snapshot_t;
+
 #define GNB_MAX_NODE_RING 128
 typedef struct _gnb_node_ring_t {
 	int num;
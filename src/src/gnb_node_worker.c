@@ -39,7 +39,10 @@
 #include "gnb_worker_queue_data.h"
 #include "gnb_pingpong_frame_type.h"
 #include "gnb_uf_node_frame_type.h"
+#include "gnb_header_zip_frame_type.h"
 #include "gnb_unified_forwarding.h"
+#include "gnb_seqlock.h"
+#include "gnb_trace.h"
 #include "ed25519/ed25519.h"
 
 //节点同步检测的时间间隔
@@ -62,6 +65,9 @@ typedef struct _node_worker_ctx_t {
 
 void update_node_crypto_key(gnb_core_t *gnb_core, uint64_t now_sec);
 
+int gnb_pf_header_zip_pop_ir_request(gnb_core_t *gnb_core, gnb_uuid_t *src_uuid64, uint16_t *cid);
+void gnb_pf_header_zip_ir_request(gnb_core_t *gnb_core, gnb_uuid_t dst_uuid64, uint16_t cid);
+
 static void update_unified_forwarding_node_array(gnb_core_t *gnb_core, gnb_node_t *node, gnb_node_t *uf_node) {
     int i;
     int find_idx = -1;
@@ -163,6 +169,62 @@ static void unifield_forwarding_notify(gnb_core_t *gnb_core, gnb_node_t *dst_nod
     }
 }
 
+static void handle_header_zip_ir_request_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_worker_in_data){
+    header_zip_ir_request_frame_t *ir_request_frame = (header_zip_ir_request_frame_t *)&node_worker_in_data->payload_st.data;
+    gnb_uuid_t src_uuid64 = gnb_ntohll(ir_request_frame->data.src_uuid64);
+    gnb_uuid_t dst_uuid64 = gnb_ntohll(ir_request_frame->data.dst_uuid64);
+    uint16_t cid = ntohs(ir_request_frame->data.cid);
+    gnb_sockaddress_t *node_addr = &node_worker_in_data->node_addr_st;
+    if ( gnb_payload16_data_len(&node_worker_in_data->payload_st) < sizeof(header_zip_ir_request_frame_t) ) {
+        return;
+    }
+    if ( dst_uuid64 != gnb_core->local_node->uuid64 ) {
+        GNB_LOG2(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_header_zip_ir_request_frame error local=%llu src=%llu dst=%llu\n", gnb_core->local_node->uuid64, src_uuid64, dst_uuid64);
+        return;
+    }
+    gnb_node_t *src_node = GNB_HASH32_UINT64_GET_PTR(gnb_core->uuid_node_map, src_uuid64);
+    if ( NULL==src_node ) {
+        GNB_LOG2(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_header_zip_ir_request_frame src node=%llu is miss\n", src_uuid64);
+        return;
+    }
+    if ( 0 == gnb_core->conf->lite_mode && !ed25519_verify(ir_request_frame->src_sign, (const unsigned char *)&ir_request_frame->data, sizeof(struct header_zip_ir_request_frame_data), src_node->public_key) ) {
+        GNB_LOG2(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_header_zip_ir_request_frame invalid signature src=%llu %s\n", src_uuid64, GNB_SOCKETADDRSTR1(node_addr));
+        return;
+    }
+    GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_header_zip_ir_request_frame src=%llu cid=%u\n", src_uuid64, cid);
+    gnb_pf_header_zip_ir_request(gnb_core, src_uuid64, cid);
+}
+
+/*
+ gnb_pf_header_zip 在 pf worker 中记录找不到 context 的 (src node, cid), 在这里向 src node 请求重新发送 IR
+*/
+static void send_header_zip_ir_request_frames(gnb_core_t *gnb_core){
+    node_worker_ctx_t *node_worker_ctx = gnb_core->node_worker->ctx;
+    header_zip_ir_request_frame_t *ir_request_frame;
+    gnb_node_t *dst_node;
+    gnb_uuid_t dst_uuid64;
+    uint16_t cid;
+    while ( 0 == gnb_pf_header_zip_pop_ir_request(gnb_core, &dst_uuid64, &cid) ) {
+        dst_node = GNB_HASH32_UINT64_GET_PTR(gnb_core->uuid_node_map, dst_uuid64);
+        if ( NULL == dst_node ) {
+            continue;
+        }
+        node_worker_ctx->node_frame_payload->sub_type = PAYLOAD_SUB_TYPE_NODE_HEADER_ZIP_IR_REQUEST;
+        gnb_payload16_set_data_len(node_worker_ctx->node_frame_payload, sizeof(header_zip_ir_request_frame_t));
+        ir_request_frame = (header_zip_ir_request_frame_t *)node_worker_ctx->node_frame_payload->data;
+        memset(ir_request_frame, 0, sizeof(header_zip_ir_request_frame_t));
+        ir_request_frame->data.src_uuid64 = gnb_htonll(gnb_core->local_node->uuid64);
+        ir_request_frame->data.dst_uuid64 = gnb_htonll(dst_uuid64);
+        ir_request_frame->data.cid = htons(cid);
+        snprintf((char *)ir_request_frame->data.text, 32, "HEADER_ZIP_IR cid=%u", cid);
+        if ( 0 == gnb_core->conf->lite_mode ) {
+            ed25519_sign(ir_request_frame->src_sign, (const unsigned char *)&ir_request_frame->data, sizeof(struct header_zip_ir_request_frame_data), gnb_core->ed25519_public_key, gnb_core->ed25519_private_key);
+        }
+        gnb_p2p_forward_payload_to_node(gnb_core, dst_node, node_worker_ctx->node_frame_payload);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "send_header_zip_ir_request_frame dst=%llu cid=%u\n", dst_uuid64, cid);
+    }
+}
+
 static void send_ping_frame(gnb_core_t *gnb_core, gnb_node_t *node) {
     int ret;
     gnb_worker_t *primary_worker = gnb_core->primary_worker;
@@ -239,6 +301,7 @@ static void handle_ping_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
             );
             return;
         }
+        gnb_seqlock_write_begin(&src_node->addr_seq);
         //只在发生改变的时候才更新
         if ( 0 != gnb_cmp_sockaddr_in6(&src_node->udp_sockaddr6, &node_addr->addr.in6) || node_worker_in_data->socket_idx != src_node->socket6_idx ) {
             src_node->udp_sockaddr6 = node_addr->addr.in6;
@@ -247,6 +310,7 @@ static void handle_ping_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
         }
         src_node->udp_addr_status |= GNB_NODE_STATUS_IPV6_PING;
         src_node->addr6_update_ts_sec = node_worker_ctx->now_time_sec;
+        gnb_seqlock_write_end(&src_node->addr_seq);
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_NODE_WORKER, "handle_ping_frame IPV6 src[%llu]->dst[%llu] idx=%u %s now=%"PRIu64" src_ts=%"PRIu64" up=%u different=%"PRId64"\n",
                 src_node->uuid64, dst_uuid64,
                 node_worker_in_data->socket_idx,
@@ -263,6 +327,7 @@ static void handle_ping_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
             );
             return;
         }
+        gnb_seqlock_write_begin(&src_node->addr_seq);
         //只在发生改变的时候才更新
         if ( PAYLOAD_SUB_TYPE_PING == node_worker_in_data->payload_st.sub_type && (0 != gnb_cmp_sockaddr_in(&src_node->udp_sockaddr4, &node_addr->addr.in) || node_worker_in_data->socket_idx != src_node->socket4_idx) ) {
             src_node->udp_sockaddr4 = node_addr->addr.in;
@@ -284,6 +349,7 @@ static void handle_ping_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
         }
         src_node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PING;
         src_node->addr4_update_ts_sec = node_worker_ctx->now_time_sec;
+        gnb_seqlock_write_end(&src_node->addr_seq);
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_NODE_WORKER, "handle_ping_frame IPV4 src[%llu]->dst[%llu] idx=%u %s now=%"PRIu64" src_ts=%"PRIu64" up=%u different=%"PRId64"\n",
                 src_node->uuid64, dst_uuid64,
                 node_worker_in_data->socket_idx,
@@ -331,6 +397,7 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
     gnb_address_t address_st;
     gnb_address_list_t *address_list3;
     uint8_t addr_update = 0;
+    unsigned int old_udp_addr_status;
     if ( dst_uuid64 != gnb_core->local_node->uuid64 ) {
         GNB_LOG3(gnb_core->log,GNB_LOG_ID_NODE_WORKER, "handle_pong_frame dst_uuid64[%llu] != local_node[%llu] addr_type=%d\n", dst_uuid64, gnb_core->local_node->uuid64, node_worker_in_data->node_addr_st.addr_type);
         return;
@@ -356,6 +423,7 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
     } else {
         address_st.latency_usec = 1;
     }
+    old_udp_addr_status = src_node->udp_addr_status;
     if ( AF_INET6 == node_addr->addr_type ) {
         if ( 0 != gnb_determine_subnet6_prefixlen96(node_addr->addr.in6.sin6_addr, gnb_core->local_node->tun_ipv6_addr ) ) {
             GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_pong_frame IPV6 Warning src[%llu]->dst[%llu] idx=%u %s\n",
@@ -365,11 +433,12 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
             );
             return;
         }
-        src_node->udp_addr_status |= GNB_NODE_STATUS_IPV6_PONG;
         gnb_set_address6(&address_st, &node_addr->addr.in6);
         address_st.ts_sec = node_worker_ctx->now_time_sec;
         address_list3 = (gnb_address_list_t *)src_node->available_address6_list3_block;
         gnb_address_list3_fifo(address_list3, &address_st);
+        gnb_seqlock_write_begin(&src_node->addr_seq);
+        src_node->udp_addr_status |= GNB_NODE_STATUS_IPV6_PONG;
         //只在发生改变的时候才更新
         if ( 0 != gnb_cmp_sockaddr_in6(&src_node->udp_sockaddr6, &node_addr->addr.in6) || node_worker_in_data->socket_idx != src_node->socket6_idx ) {
             src_node->udp_sockaddr6 = node_addr->addr.in6;
@@ -383,6 +452,7 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
                 GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "addr6_ping_latency_usec==0 now=%"PRIu64" dst_ts=%"PRIu64"\n", node_worker_ctx->now_time_usec, dst_ts_usec);
             }
         }
+        gnb_seqlock_write_end(&src_node->addr_seq);
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_pong_frame IPV6 src[%llu]->dst[%llu] idx=%u %s now=%"PRIu64" dst_ts=%"PRIu64" up=%u latency=%"PRId64"\n",
                 src_node->uuid64, dst_uuid64,
                 node_worker_in_data->socket_idx,
@@ -399,11 +469,12 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
             );
             return;
         }
-        src_node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PONG;
         gnb_set_address4(&address_st, &node_addr->addr.in);
         address_st.ts_sec = node_worker_ctx->now_time_sec;
         address_list3 = (gnb_address_list_t *)src_node->available_address4_list3_block;
         gnb_address_list3_fifo(address_list3, &address_st);
+        gnb_seqlock_write_begin(&src_node->addr_seq);
+        src_node->udp_addr_status |= GNB_NODE_STATUS_IPV4_PONG;
         //只在发生改变的时候才更新
         if ( 0 != gnb_cmp_sockaddr_in(&src_node->udp_sockaddr4, &node_addr->addr.in) || node_worker_in_data->socket_idx != src_node->socket4_idx ) {
             src_node->udp_sockaddr4 = node_addr->addr.in;
@@ -417,6 +488,7 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
                 GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "addr4_ping_latency_usec=0 now=%"PRIu64" dst_ts=%"PRIu64"\n", node_worker_ctx->now_time_usec, dst_ts_usec);
             }
         }
+        gnb_seqlock_write_end(&src_node->addr_seq);
 
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "handle_pong_frame IPV4 src[%llu]->dst[%llu] idx=%u %s now=%"PRIu64" dst_ts=%"PRIu64" up=%u latency=%"PRId64"\n",
                 src_node->uuid64, dst_uuid64,
@@ -424,6 +496,8 @@ static void handle_pong_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
                 GNB_SOCKADDR4STR1(&src_node->udp_sockaddr4),
                 node_worker_ctx->now_time_usec, dst_ts_usec, addr_update, src_node->addr4_ping_latency_usec);
     }
+    //每个 pong 都触发, old_status 和 new_status 不同时就是 node 的状态发生了变化
+    GNB_TRACE5(node_status, src_node->uuid64, node_addr->addr_type, old_udp_addr_status, src_node->udp_addr_status, address_st.latency_usec);
 
     //处理附件
     gnb_payload16_t *payload_attachment = (gnb_payload16_t *)node_pong_frame->data.attachment;
@@ -494,7 +568,9 @@ static void sync_node(gnb_worker_t *gnb_node_worker) {
         {
             if ( (node_worker_ctx->now_time_sec - node->ping_ts_sec) >= GNB_NODE_PING_INTERVAL_SEC ) {
                 //如果地址为 0.0.0.0 或 :: , 需要向 index node 发送 PAYLOAD_SUB_TYPE_ADDR_QUERY
+                gnb_seqlock_write_begin(&node->addr_seq);
                 node->udp_addr_status = GNB_NODE_STATUS_UNREACHABL;
+                gnb_seqlock_write_end(&node->addr_seq);
                 node->ping_ts_sec = node_worker_ctx->now_time_sec;
             }
             continue;
@@ -514,14 +590,18 @@ static void sync_node(gnb_worker_t *gnb_node_worker) {
             //节点状态超时，且不是idx node, 可能目标node已经下线或者更换了ip
             //IPV4 需要向 idx node 发送 PAYLOAD_SUB_TYPE_ADDR_QUERY
             if ( !(node->type & GNB_NODE_TYPE_IDX) ) {
+                gnb_seqlock_write_begin(&node->addr_seq);
                 node->udp_addr_status &= ~(GNB_NODE_STATUS_IPV4_PONG | GNB_NODE_STATUS_IPV4_PING);
+                gnb_seqlock_write_end(&node->addr_seq);
             }
 
         }
         if ( (node_worker_ctx->now_time_sec - node->addr6_update_ts_sec) > GNB_NODE_UPDATE_INTERVAL_SEC ) {
             //节点状态超时，且不是idx node, 可能目标node已经下线或者更换了ip
             if ( !(node->type & GNB_NODE_TYPE_IDX) ) {
+                gnb_seqlock_write_begin(&node->addr_seq);
                 node->udp_addr_status &= ~(GNB_NODE_STATUS_IPV6_PONG | GNB_NODE_STATUS_IPV6_PING);
+                gnb_seqlock_write_end(&node->addr_seq);
             }
         }
     }
@@ -545,6 +625,9 @@ static void handle_node_frame(gnb_core_t *gnb_core, gnb_worker_in_data_t *node_w
         case PAYLOAD_SUB_TYPE_NODE_UNIFIED_NOTIFY:
             handle_uf_node_notify_frame(gnb_core, node_worker_in_data);
             break;
+        case PAYLOAD_SUB_TYPE_NODE_HEADER_ZIP_IR_REQUEST:
+            handle_header_zip_ir_request_frame(gnb_core, node_worker_in_data);
+            break;
         default:
             break;
     }
@@ -566,6 +649,32 @@ static void handle_recv_queue(gnb_core_t *gnb_core) {
     }
 }
 
+static void node_worker_process(gnb_worker_t *gnb_node_worker) {
+    node_worker_ctx_t *node_worker_ctx = gnb_node_worker->ctx;
+    gnb_core_t *gnb_core = node_worker_ctx->gnb_core;
+    update_node_crypto_key(gnb_core, node_worker_ctx->now_time_sec);
+    handle_recv_queue(gnb_core);
+    if ( gnb_core->conf->header_zip ) {
+        send_header_zip_ir_request_frames(gnb_core);
+    }
+    //每经过一个时间间隔就检查一次各节点的状态
+    if ( node_worker_ctx->now_time_sec - node_worker_ctx->last_sync_ts_sec > GNB_NODE_SYNC_INTERVAL_TIME_SEC ) {
+        sync_node(gnb_node_worker);
+        node_worker_ctx->last_sync_ts_sec = node_worker_ctx->now_time_sec;
+    }
+}
+
+/*
+ 不启动 worker 的线程, 以调用者给出的时间执行一次线程循环中的处理
+ gnb_sim 在同一个线程中用虚拟时钟驱动所有节点的 node worker
+*/
+void gnb_node_worker_poll(gnb_worker_t *gnb_node_worker, uint64_t now_time_usec) {
+    node_worker_ctx_t *node_worker_ctx = gnb_node_worker->ctx;
+    node_worker_ctx->now_time_usec = now_time_usec;
+    node_worker_ctx->now_time_sec  = now_time_usec / 1000000;
+    node_worker_process(gnb_node_worker);
+}
+
 static void* thread_worker_func( void *data ) {
     gnb_worker_t *gnb_node_worker = (gnb_worker_t *)data;
     node_worker_ctx_t *node_worker_ctx = gnb_node_worker->ctx;
@@ -576,13 +685,7 @@ static void* thread_worker_func( void *data ) {
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_NODE_WORKER, "start %s success!\n", gnb_node_worker->name);
     do {
         gnb_worker_sync_time(&node_worker_ctx->now_time_sec, &node_worker_ctx->now_time_usec);
-        update_node_crypto_key(gnb_core, node_worker_ctx->now_time_sec);
-        handle_recv_queue(gnb_core);
-        //每经过一个时间间隔就检查一次各节点的状态
-        if ( node_worker_ctx->now_time_sec - node_worker_ctx->last_sync_ts_sec > GNB_NODE_SYNC_INTERVAL_TIME_SEC ) {
-            sync_node(gnb_node_worker);
-            node_worker_ctx->last_sync_ts_sec = node_worker_ctx->now_time_sec;
-        }
+        node_worker_process(gnb_node_worker);
         GNB_SLEEP_MILLISECOND(150);
     } while(gnb_node_worker->thread_worker_flag);
     gnb_node_worker->thread_worker_run_flag = 0;
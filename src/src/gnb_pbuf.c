@@ -0,0 +1,220 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "gnb_pbuf.h"
+
+static uint32_t gnb_pbuf_pool_id_seq = 0;
+
+//当前线程最近使用的 pool 和它在这个 pool 中的 cache, pool 被释放后 id 不同, 不会误用
+static __thread uint32_t pbuf_thread_pool_id = 0;
+static __thread gnb_pbuf_cache_t *pbuf_thread_cache = NULL;
+
+gnb_pbuf_pool_t* gnb_pbuf_pool_create(gnb_heap_t *heap, uint32_t num, uint32_t buffer_size) {
+    gnb_pbuf_pool_t *pool;
+    gnb_pbuf_t *pbuf;
+    uint32_t i;
+    if ( 0 == num || 0 == buffer_size ) {
+        return NULL;
+    }
+    pool = (gnb_pbuf_pool_t *)gnb_heap_alloc_aligned(heap, sizeof(gnb_pbuf_pool_t));
+    if ( NULL == pool ) {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(gnb_pbuf_pool_t));
+    pool->buffer_size = buffer_size;
+    pool->pbuf_size = (sizeof(gnb_pbuf_t) + GNB_PBUF_HEADROOM + buffer_size + 15) & ~15;
+    pool->memory_size = (size_t)pool->pbuf_size * num;
+    pool->memory = gnb_heap_alloc(heap, pool->memory_size);
+    if ( NULL == pool->memory ) {
+        gnb_heap_free(heap, pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pool->id = __sync_add_and_fetch(&gnb_pbuf_pool_id_seq, 1);
+    pool->num = num;
+    for ( i=num; i>0; i-- ) {
+        pbuf = (gnb_pbuf_t *)(pool->memory + (size_t)pool->pbuf_size * (i-1));
+        pbuf->pool = pool;
+        pbuf->cache = NULL;
+        pbuf->refcnt = 0;
+        pbuf->size = GNB_PBUF_HEADROOM + buffer_size;
+        pbuf->next = pool->free_list;
+        pool->free_list = pbuf;
+    }
+    pool->free_num = num;
+    return pool;
+}
+
+void gnb_pbuf_pool_release(gnb_heap_t *heap, gnb_pbuf_pool_t *pool) {
+    pthread_mutex_destroy(&pool->lock);
+    gnb_heap_free(heap, pool->memory);
+    gnb_heap_free(heap, pool);
+}
+
+static gnb_pbuf_cache_t* pbuf_thread_cache_get(gnb_pbuf_pool_t *pool) {
+    pthread_t self;
+    uint32_t cache_num;
+    uint32_t i;
+    if ( pbuf_thread_pool_id == pool->id ) {
+        return pbuf_thread_cache;
+    }
+    self = pthread_self();
+    cache_num = __atomic_load_n(&pool->cache_num, __ATOMIC_ACQUIRE);
+    for ( i=0; i<cache_num; i++ ) {
+        if ( pthread_equal(pool->caches[i].thread, self) ) {
+            goto finish;
+        }
+    }
+    pthread_mutex_lock(&pool->lock);
+    if ( pool->cache_num >= GNB_PBUF_CACHE_MAX ) {
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+    i = pool->cache_num;
+    pool->caches[i].thread = self;
+    pool->caches[i].free_list = NULL;
+    pool->caches[i].return_list = NULL;
+    __atomic_store_n(&pool->cache_num, i + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&pool->lock);
+
+finish:
+    pbuf_thread_pool_id = pool->id;
+    pbuf_thread_cache = &pool->caches[i];
+    return pbuf_thread_cache;
+}
+
+static gnb_pbuf_t* pbuf_pool_pop(gnb_pbuf_pool_t *pool, gnb_pbuf_cache_t *cache) {
+    gnb_pbuf_t *pbuf;
+    gnb_pbuf_t *tail = NULL;
+    int i;
+    pthread_mutex_lock(&pool->lock);
+    pbuf = pool->free_list;
+    if ( NULL == pbuf ) {
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+    if ( NULL == cache ) {
+        pool->free_list = pbuf->next;
+        pool->free_num--;
+        pthread_mutex_unlock(&pool->lock);
+        return pbuf;
+    }
+    //批量取出最多 GNB_PBUF_CACHE_BATCH 个 pbuf 放入 cache, 第一个直接返回
+    for ( i=0; i<GNB_PBUF_CACHE_BATCH && NULL != pool->free_list; i++ ) {
+        tail = pool->free_list;
+        pool->free_list = tail->next;
+        pool->free_num--;
+    }
+    tail->next = NULL;
+    pthread_mutex_unlock(&pool->lock);
+    cache->free_list = pbuf->next;
+    return pbuf;
+}
+
+gnb_pbuf_t* gnb_pbuf_alloc(gnb_pbuf_pool_t *pool) {
+    gnb_pbuf_cache_t *cache = pbuf_thread_cache_get(pool);
+    gnb_pbuf_t *pbuf;
+    if ( NULL == cache ) {
+        pbuf = pbuf_pool_pop(pool, NULL);
+        goto finish;
+    }
+    if ( NULL == cache->free_list ) {
+        cache->free_list = __atomic_exchange_n(&cache->return_list, NULL, __ATOMIC_ACQUIRE);
+    }
+    pbuf = cache->free_list;
+    if ( NULL != pbuf ) {
+        cache->free_list = pbuf->next;
+    } else {
+        pbuf = pbuf_pool_pop(pool, cache);
+    }
+
+finish:
+    if ( NULL == pbuf ) {
+        return NULL;
+    }
+    pbuf->cache  = cache;
+    pbuf->next   = NULL;
+    pbuf->refcnt = 1;
+    pbuf->head   = GNB_PBUF_HEADROOM;
+    pbuf->len    = 0;
+    return pbuf;
+}
+
+void gnb_pbuf_ref(gnb_pbuf_t *pbuf) {
+    __atomic_add_fetch(&pbuf->refcnt, 1, __ATOMIC_RELAXED);
+}
+
+void gnb_pbuf_unref(gnb_pbuf_t *pbuf) {
+    gnb_pbuf_pool_t *pool = pbuf->pool;
+    gnb_pbuf_cache_t *cache = pbuf->cache;
+    gnb_pbuf_t *head;
+    if ( 0 != __atomic_sub_fetch(&pbuf->refcnt, 1, __ATOMIC_ACQ_REL) ) {
+        return;
+    }
+    if ( NULL == cache ) {
+        pthread_mutex_lock(&pool->lock);
+        pbuf->next = pool->free_list;
+        pool->free_list = pbuf;
+        pool->free_num++;
+        pthread_mutex_unlock(&pool->lock);
+        return;
+    }
+    if ( cache == pbuf_thread_cache && pbuf_thread_pool_id == pool->id ) {
+        pbuf->next = cache->free_list;
+        cache->free_list = pbuf;
+        return;
+    }
+    //分配线程用 exchange 一次取走整个 return_list, 这里只有 push, 不存在 ABA 问题
+    head = __atomic_load_n(&cache->return_list, __ATOMIC_RELAXED);
+    do {
+        pbuf->next = head;
+    } while ( !__atomic_compare_exchange_n(&cache->return_list, &head, pbuf, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED) );
+}
+
+gnb_pbuf_t* gnb_pbuf_pool_find(gnb_pbuf_pool_t *pool, void *ptr) {
+    size_t offset;
+    gnb_pbuf_t *pbuf;
+    if ( NULL == pool || (unsigned char *)ptr < pool->memory || (unsigned char *)ptr >= pool->memory + pool->memory_size ) {
+        return NULL;
+    }
+    offset = (unsigned char *)ptr - pool->memory;
+    pbuf = (gnb_pbuf_t *)(pool->memory + offset - offset % pool->pbuf_size);
+    if ( (unsigned char *)ptr < pbuf->buffer ) {
+        return NULL;
+    }
+    return pbuf;
+}
+
+void* gnb_pbuf_push_head(gnb_pbuf_t *pbuf, uint32_t len) {
+    if ( len > pbuf->head ) {
+        return NULL;
+    }
+    pbuf->head -= len;
+    pbuf->len  += len;
+    return GNB_PBUF_DATA(pbuf);
+}
+
+void* gnb_pbuf_pull_head(gnb_pbuf_t *pbuf, uint32_t len) {
+    if ( len > pbuf->len ) {
+        return NULL;
+    }
+    pbuf->head += len;
+    pbuf->len  -= len;
+    return GNB_PBUF_DATA(pbuf);
+}
@@ -0,0 +1,114 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_PBUF_H
+#define GNB_PBUF_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "gnb_type.h"
+#include "gnb_alloc.h"
+
+/*
+ packet buffer, 在 worker 之间传递 packet 时只传递 gnb_pbuf_t 的指针
+
+ ┌──────────┬─────────────────────────────┬──────────┐
+ │ headroom │  gnb_payload16_t (len byte) │ tailroom │
+ └──────────┴─────────────────────────────┴──────────┘
+ ^buffer    ^buffer+head
+
+ headroom 用于在 payload 前面插入新的首部(例如 UR0 frame)而不需要拷贝 payload
+ refcnt 为 0 时 pbuf 回到分配它的线程的 cache 中
+
+ 每个分配 pbuf 的线程在 pool 中有一个 cache, 分配和同一线程的 unref 只操作 cache 的 free_list, 不需要加锁,
+ 其他线程 unref 的 pbuf 压入分配线程 cache 的 return_list(lock-free stack), 分配线程在 free_list 用完时一次取走整个 return_list,
+ 只有 cache 的 free_list 和 return_list 都为空时才加锁从 pool 的 free_list 批量取 pbuf
+*/
+
+#define GNB_PBUF_HEADROOM 64
+#define GNB_PBUF_TAILROOM 512
+
+//一个 pool 最多有多少个分配线程有自己的 cache, 超出的线程加锁使用 pool 的 free_list
+#define GNB_PBUF_CACHE_MAX   16
+//cache 为空时每次从 pool 的 free_list 取出的 pbuf 数量
+#define GNB_PBUF_CACHE_BATCH 32
+
+typedef struct _gnb_pbuf_pool_t gnb_pbuf_pool_t;
+typedef struct _gnb_pbuf_cache_t gnb_pbuf_cache_t;
+
+typedef struct _gnb_pbuf_t {
+    gnb_pbuf_pool_t *pool;
+    //分配这个 pbuf 的线程的 cache, 为 NULL 时 unref 后回到 pool 的 free_list
+    gnb_pbuf_cache_t *cache;
+    struct _gnb_pbuf_t *next;
+    uint32_t refcnt;
+    uint32_t head;
+    uint32_t len;
+    uint32_t size;
+    unsigned char buffer[0] __attribute__ ((aligned (16)));
+} gnb_pbuf_t;
+
+struct _gnb_pbuf_cache_t {
+    pthread_t thread;
+    //只有 thread 访问
+    gnb_pbuf_t *free_list;
+    //其他线程归还的 pbuf, 独占一个 cache line 避免与 free_list 伪共享
+    gnb_pbuf_t *return_list GNB_CACHE_ALIGNED;
+} GNB_CACHE_ALIGNED;
+
+typedef struct _gnb_pbuf_pool_t {
+    uint32_t id;
+    pthread_mutex_t lock;
+    //由 lock 保护
+    gnb_pbuf_t *free_list;
+    uint32_t num;
+    uint32_t free_num;
+    //线程 cache 在进程退出前不会解除绑定
+    uint32_t cache_num;
+    gnb_pbuf_cache_t caches[GNB_PBUF_CACHE_MAX];
+    uint32_t buffer_size;
+    uint32_t pbuf_size;
+    unsigned char *memory;
+    size_t memory_size;
+} gnb_pbuf_pool_t;
+
+/*
+ buffer_size 是每个 pbuf 中 headroom 之后可用的字节数, 包含 tailroom
+*/
+gnb_pbuf_pool_t* gnb_pbuf_pool_create(gnb_heap_t *heap, uint32_t num, uint32_t buffer_size);
+void gnb_pbuf_pool_release(gnb_heap_t *heap, gnb_pbuf_pool_t *pool);
+
+gnb_pbuf_t* gnb_pbuf_alloc(gnb_pbuf_pool_t *pool);
+void gnb_pbuf_ref(gnb_pbuf_t *pbuf);
+void gnb_pbuf_unref(gnb_pbuf_t *pbuf);
+
+/*
+ ptr 指向 pool 中某个 pbuf 的 buffer 时返回这个 pbuf, 否则返回 NULL
+*/
+gnb_pbuf_t* gnb_pbuf_pool_find(gnb_pbuf_pool_t *pool, void *ptr);
+
+/*
+ 在 data 前面扩展 len 字节, headroom 不足时返回 NULL
+*/
+void* gnb_pbuf_push_head(gnb_pbuf_t *pbuf, uint32_t len);
+void* gnb_pbuf_pull_head(gnb_pbuf_t *pbuf, uint32_t len);
+
+#define GNB_PBUF_DATA(pbuf)      ( (void *)((pbuf)->buffer + (pbuf)->head) )
+#define GNB_PBUF_HEADROOM_LEN(pbuf) ( (pbuf)->head )
+#define GNB_PBUF_ROOM(pbuf)      ( (pbuf)->size - (pbuf)->head )
+
+#endif
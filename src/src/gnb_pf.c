@@ -21,99 +21,125 @@
 #include "gnb_node.h"
 #include "gnb_hash32.h"
 #include "gnb_pf.h"
+#include "gnb_pf_status.h"
 #include "gnb_payload16.h"
 #include "gnb_unified_forwarding.h"
 #include "gnb_binary.h"
+#include "gnb_latency.h"
+#include "gnb_trace.h"
 
 void gnb_send_ur0_frame(gnb_core_t *gnb_core, gnb_node_t *dst_node, gnb_payload16_t *payload);
 
-#define GNB_PF_TUN_FRAME_INIT        0
-#define GNB_PF_TUN_FRAME_ERROR       1
-#define GNB_PF_TUN_FRAME_DROP        2
-#define GNB_PF_TUN_FRAME_NEXT        3
-#define GNB_PF_TUN_FRAME_FINISH      4
-
-#define GNB_PF_TUN_ROUTE_INIT        5
-#define GNB_PF_TUN_ROUTE_ERROR       6
-#define GNB_PF_TUN_ROUTE_DROP        7
-#define GNB_PF_TUN_ROUTE_NOROUTE     8
-#define GNB_PF_TUN_ROUTE_NEXT        9
-#define GNB_PF_TUN_ROUTE_FINISH     10
-
-#define GNB_PF_TUN_FORWARD_INIT     11
-#define GNB_PF_TUN_FORWARD_ERROR    12
-#define GNB_PF_TUN_FORWARD_NEXT     13
-#define GNB_PF_TUN_FORWARD_FINISH   14
-
-
-#define GNB_PF_INET_FRAME_INIT      15
-#define GNB_PF_INET_FRAME_ERROR     16
-#define GNB_PF_INET_FRAME_NOROUTE   17
-#define GNB_PF_INET_FRAME_DROP      18
-#define GNB_PF_INET_FRAME_NEXT      19
-#define GNB_PF_INET_FRAME_FINISH    20
-
-
-#define GNB_PF_INET_ROUTE_INIT      21
-#define GNB_PF_INET_ROUTE_ERROR     22
-#define GNB_PF_INET_ROUTE_DROP      23
-#define GNB_PF_INET_ROUTE_NOROUTE   24
-
-#define GNB_PF_INET_ROUTE_NEXT      25
-#define GNB_PF_INET_ROUTE_FINISH    26
-
-#define GNB_PF_INET_FORWARD_INIT    27
-#define GNB_PF_INET_FORWARD_ERROR   28
-#define GNB_PF_INET_FORWARD_DROP    29
-#define GNB_PF_INET_FORWARD_NEXT    30
-#define GNB_PF_INET_FORWARD_FINISH  31
-#define GNB_PF_INET_FORWARD_TO_TUN  32
-#define GNB_PF_INET_FORWARD_TO_INET 33
-
-static char* gnb_pf_status_strings[34];
-
-void gnb_pf_status_strings_init() {
-    gnb_pf_status_strings[GNB_PF_TUN_FRAME_INIT]       = "TUN_FRAME_INIT";
-    gnb_pf_status_strings[GNB_PF_TUN_FRAME_ERROR]      = "TUN_FRAME_ERROR";
-    gnb_pf_status_strings[GNB_PF_TUN_FRAME_DROP]       = "TUN_FRAME_DROP";
-    gnb_pf_status_strings[GNB_PF_TUN_FRAME_NEXT]       = "TUN_FRAME_NEXT";
-    gnb_pf_status_strings[GNB_PF_TUN_FRAME_FINISH]     = "TUN_FRAME_FINISH";
-
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_INIT]       = "TUN_ROUTE_INIT";
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_ERROR]      = "TUN_ROUTE_ERROR";
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_DROP]       = "TUN_ROUTE_DROP";
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_NOROUTE]    = "TUN_ROUTE_NOROUTE";
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_NEXT]       = "TUN_ROUTE_NEXT";
-    gnb_pf_status_strings[GNB_PF_TUN_ROUTE_FINISH]     = "TUN_ROUTE_FINISH";
-
-    gnb_pf_status_strings[GNB_PF_TUN_FORWARD_INIT]     = "TUN_FORWARD_INIT";
-    gnb_pf_status_strings[GNB_PF_TUN_FORWARD_ERROR]    = "TUN_FORWARD_ERROR";
-    gnb_pf_status_strings[GNB_PF_TUN_FORWARD_NEXT]     = "TUN_FORWARD_NEXT";
-    gnb_pf_status_strings[GNB_PF_TUN_FORWARD_FINISH]   = "TUN_FORWARD_FINISH";
-
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_INIT]      = "INET_FRAME_INIT";
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_ERROR]     = "INET_FRAME_ERROR";
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_NOROUTE]   = "INET_FRAME_NOROUTE";
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_DROP]      = "INET_FRAME_DROP";
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_NEXT]      = "INET_FRAME_NEXT";
-    gnb_pf_status_strings[GNB_PF_INET_FRAME_FINISH]    = "INET_FRAME_FINISH";
-
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_INIT]      = "INET_ROUTE_INIT";
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_ERROR]     = "INET_ROUTE_ERROR";
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_DROP]      = "INET_ROUTE_DROP";
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_NOROUTE]   = "INET_ROUTE_NOROUTE";
-
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_NEXT]      = "INET_ROUTE_NEXT";
-    gnb_pf_status_strings[GNB_PF_INET_ROUTE_FINISH]    = "INET_ROUTE_FINISH";
-
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_INIT]    = "INET_FORWARD_INIT";
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_ERROR]   = "INET_FORWARD_ERROR";
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_DROP]    = "INET_FORWARD_DROP";
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_NEXT]    = "INET_FORWARD_NEXT";
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_TO_TUN]  = "INET_FORWARD_TO_TUN";
-    gnb_pf_status_strings[GNB_PF_INET_FORWARD_TO_INET] = "INET_FORWARD_TO_INET";
+static void pf_core_conf_fast_path(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_t *pf_dump, gnb_pf_t *pf_route, gnb_pf_t *pf_zip, gnb_pf_t *pf_header_zip, gnb_pf_t *pf_crypto);
+
+#define GNB_PF_NODE_COUNTER(gnb_core,pf_core,pf_node) (&(pf_core)->node_counter_shard[ (pf_node) - (gnb_core)->ctl_block->node_zone->node ])
+
+/*
+ in_node 的 in_bytes 和 out_node 的 out_bytes 累加 ip_frame_size,
+ 计数写入当前 worker 的 shard, 由 gnb_ctl 汇总
+*/
+static void pf_count_frame(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_node_t *in_node, gnb_node_t *out_node, ssize_t ip_frame_size) {
+    gnb_node_counter_t *counter;
+    if ( NULL == pf_core->node_counter_shard ) {
+        return;
+    }
+    counter = GNB_PF_NODE_COUNTER(gnb_core, pf_core, in_node);
+    counter->in_bytes += ip_frame_size;
+    counter->in_packets++;
+    counter = GNB_PF_NODE_COUNTER(gnb_core, pf_core, out_node);
+    counter->out_bytes += ip_frame_size;
+    counter->out_packets++;
+}
+
+/*
+ 在当前 worker 的 flight recorder 中写入一条记录, 覆盖最旧的记录,
+ 写完记录之后再更新 write_idx, gnb_ctl 据此判断读到的记录是否完整
+*/
+static inline void pf_flight_record(gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, int pf_status) {
+    gnb_flight_recorder_t *recorder = pf_core->flight_recorder;
+    gnb_flight_record_t *record;
+    uint64_t idx;
+    if ( NULL == recorder ) {
+        return;
+    }
+    idx = recorder->write_idx;
+    record = &recorder->record[ idx & recorder->record_mask ];
+    record->ts_ticks      = gnb_latency_now();
+    record->src_uuid64    = pf_ctx->src_uuid64;
+    record->dst_uuid64    = pf_ctx->dst_uuid64;
+    record->fwd_uuid64    = NULL != pf_ctx->fwd_node ? pf_ctx->fwd_node->uuid64 : 0;
+    record->ip_frame_size = (uint16_t)pf_ctx->ip_frame_size;
+    record->direction     = pf_status < GNB_PF_INET_FRAME_INIT ? GNB_FLIGHT_DIRECTION_TUN : GNB_FLIGHT_DIRECTION_INET;
+    record->mode          = (pf_ctx->relay_forwarding     ? GNB_FLIGHT_MODE_RELAY   : 0) |
+                            (pf_ctx->unified_forwarding   ? GNB_FLIGHT_MODE_UNIFIED : 0) |
+                            (pf_ctx->direct_forwarding    ? GNB_FLIGHT_MODE_DIRECT  : 0) |
+                            (pf_ctx->std_forwarding       ? GNB_FLIGHT_MODE_STD     : 0) |
+                            (pf_ctx->universal_udp4_relay ? GNB_FLIGHT_MODE_UR0     : 0);
+    record->pf_status     = (uint8_t)pf_status;
+    __atomic_store_n(&recorder->write_idx, idx + 1, __ATOMIC_RELEASE);
+}
+
+//packet 在 pf 中的最终结果, 按 worker 计入 status_zone 并写入 flight recorder
+static inline void pf_count_status(gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, int pf_status) {
+    GNB_TRACE5(pf_status, pf_status, pf_ctx->src_uuid64, pf_ctx->dst_uuid64, NULL != pf_ctx->fwd_node ? pf_ctx->fwd_node->uuid64 : 0, pf_ctx->ip_frame_size);
+    pf_flight_record(pf_core, pf_ctx, pf_status);
+    if ( NULL == pf_core->pf_status_counter ) {
+        return;
+    }
+    pf_core->pf_status_counter->status[pf_status]++;
+}
+
+//node 为 NULL 时，丢弃的分组计入 local_node
+static void pf_count_drop(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, gnb_node_t *node, int pf_status) {
+    pf_count_status(pf_core, pf_ctx, pf_status);
+    if ( NULL == node ) {
+        node = gnb_core->local_node;
+    }
+    GNB_TRACE2(pf_drop, node->uuid64, pf_status);
+    if ( NULL == pf_core->node_counter_shard ) {
+        return;
+    }
+    GNB_PF_NODE_COUNTER(gnb_core, pf_core, node)->drops[pf_status]++;
+}
+
+/*
+ 各个阶段的耗时计入当前 worker 的 latency shard, 没有打开 latency_stats 时 latency_shard 为 NULL, 只多一次判断
+ 批量处理时 num 个 packet 平均分摊这段耗时
+*/
+static inline uint64_t pf_latency_begin(gnb_pf_core_t *pf_core) {
+    if ( NULL == pf_core->latency_shard ) {
+        return 0;
+    }
+    return gnb_latency_now();
+}
+
+static inline void pf_latency_end(gnb_pf_core_t *pf_core, int stage, uint64_t begin_ticks, int num) {
+    if ( NULL == pf_core->latency_shard || num <= 0 ) {
+        return;
+    }
+    gnb_latency_record(&pf_core->latency_shard[stage], (gnb_latency_now() - begin_ticks) / num, num);
 }
 
+//pf 模块按 type 计入 route zip crypto 三个阶段, 其他类型的模块不计时
+static inline int pf_latency_stage(gnb_pf_t *pf) {
+    switch (pf->type) {
+        case GNB_PF_TYEP_ROUTE:
+            return GNB_LATENCY_STAGE_PF_ROUTE;
+        case GNB_PF_TYEP_COMPRESS:
+            return GNB_LATENCY_STAGE_PF_ZIP;
+        case GNB_PF_TYEP_CRYPTO:
+            return GNB_LATENCY_STAGE_PF_CRYPTO;
+        default:
+            return -1;
+    }
+}
+
+#define PF_LATENCY_CALL(pf_core, stage, pf_status, call) do {          \
+    uint64_t latency_begin_ticks = pf_latency_begin(pf_core);          \
+    (pf_status) = (call);                                              \
+    pf_latency_end((pf_core), (stage), latency_begin_ticks, 1);         \
+} while(0)
+
 static gnb_pf_t* find_pf_in_array(gnb_pf_array_t *pf_array, const char *pf_name)  {
     int i;
     for ( i=0; i<pf_array->num; i++ ) {
@@ -145,6 +171,15 @@ gnb_pf_core_t* gnb_pf_core_init(gnb_heap_t *heap, int size) {
     pf_core->pf_inet_frame_array = gnb_pf_array_init(heap, size);
     pf_core->pf_inet_route_array = gnb_pf_array_init(heap, size);
     pf_core->pf_inet_fwd_array   = gnb_pf_array_init(heap, size);
+    pf_core->node_counter_shard  = NULL;
+    pf_core->latency_shard       = NULL;
+    pf_core->pf_status_counter   = NULL;
+    pf_core->flight_recorder     = NULL;
+    pf_core->pf_tun_fast_path    = NULL;
+    pf_core->pf_inet_fast_path   = NULL;
+    pf_core->fast_path_route     = NULL;
+    pf_core->fast_path_zip       = NULL;
+    pf_core->fast_path_crypto    = NULL;
     return pf_core;
 }
 
@@ -164,10 +199,15 @@ void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
     gnb_pf_t *pf_dump;
     gnb_pf_t *pf_route;
     gnb_pf_t *pf_zip;
+    gnb_pf_t *pf_header_zip;
     gnb_pf_t *pf_crypto;
     pf_dump   = find_pf_in_array(pf_array, "gnb_pf_dump");
     pf_route  = find_pf_in_array(pf_array, gnb_core->conf->pf_route);
     pf_zip    = find_pf_in_array(pf_array, "gnb_pf_zip");
+    if ( NULL == pf_zip ) {
+        pf_zip = find_pf_in_array(pf_array, "gnb_pf_lz4");
+    }
+    pf_header_zip = find_pf_in_array(pf_array, "gnb_pf_header_zip");
     pf_crypto = find_pf_in_array(pf_array, "gnb_pf_crypto_xor");
     if ( NULL == pf_crypto ) {
         pf_crypto = find_pf_in_array(pf_array, "gnb_pf_crypto_arc4");
@@ -181,9 +221,12 @@ void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
     }
     pf_core->pf_tun_frame_array->pf[idx++] = pf_route;
     pf_core->pf_tun_frame_array->num = idx;
-    //pf_tun_route            gnb_pf_route[+] ->   gnb_pf_zip -> gnb_pf_crypto(p2p)
+    //pf_tun_route            gnb_pf_route[+] -> gnb_pf_header_zip -> gnb_pf_zip -> gnb_pf_crypto(p2p)
     idx = 0;
     pf_core->pf_tun_route_array->pf[idx++] = pf_route;
+    if ( NULL != pf_header_zip ) {
+        pf_core->pf_tun_route_array->pf[idx++] = pf_header_zip;
+    }
     if ( NULL != pf_zip) {
         pf_core->pf_tun_route_array->pf[idx++] = pf_zip;
     }
@@ -205,7 +248,7 @@ void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
     }    
     pf_core->pf_inet_frame_array->pf[idx++] = pf_route;
     pf_core->pf_inet_frame_array->num = idx;
-    //pf_inet_route    gnb_pf_route -> gnb_pf_crypto(p2p) -> gnb_pf_zip
+    //pf_inet_route    gnb_pf_route -> gnb_pf_crypto(p2p) -> gnb_pf_zip -> gnb_pf_header_zip
     idx = 0;
     pf_core->pf_inet_route_array->pf[idx++] = pf_route;
     if ( NULL != pf_crypto ) {
@@ -214,6 +257,9 @@ void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
     if ( NULL != pf_zip ) {
         pf_core->pf_inet_route_array->pf[idx++] = pf_zip;
     }
+    if ( NULL != pf_header_zip ) {
+        pf_core->pf_inet_route_array->pf[idx++] = pf_header_zip;
+    }
     pf_core->pf_inet_route_array->num   = idx;
     //pf_inet_fwd              gnb_pf_dump -> gnb_pf_route -> gnb_pf_crypto(relay)
     idx = 0;
@@ -225,6 +271,7 @@ void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
         pf_core->pf_inet_fwd_array->pf[idx++] = pf_crypto; //relay
     }
     pf_core->pf_inet_fwd_array->num = idx;
+    pf_core_conf_fast_path(gnb_core, pf_core, pf_dump, pf_route, pf_zip, pf_header_zip, pf_crypto);
     return;
 }
 
@@ -258,361 +305,1018 @@ void gnb_pf_conf(gnb_core_t *gnb_core, gnb_pf_array_t *pf_array) {
 }
 
 /*
-把输入的 payload 加上offset，这样pf模块处理的时候，就可以在offset之前填充pf的头部，减少一次通过 memcpy 重组payload
+ 批量处理时每个 packet 的状态
+ PF_ITEM_RUN        继续执行当前 stage 的下一个 pf 模块
+ PF_ITEM_STAGE_DONE 当前 stage 中有 pf 模块返回了 GNB_PF_FINISH, 跳过当前 stage 余下的 pf 模块
+ PF_ITEM_FINISH     packet 的处理已经结束, 只执行 finish 部分
 */
-void gnb_pf_tun(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *payload) {
-    int i;
-    int ret;
+#define PF_ITEM_RUN        0
+#define PF_ITEM_STAGE_DONE 1
+#define PF_ITEM_FINISH     2
+
+#define GNB_PF_STAGE_TUN_FRAME   0
+#define GNB_PF_STAGE_TUN_ROUTE   1
+#define GNB_PF_STAGE_TUN_FWD     2
+#define GNB_PF_STAGE_INET_FRAME  3
+#define GNB_PF_STAGE_INET_ROUTE  4
+#define GNB_PF_STAGE_INET_FWD    5
+
+typedef struct _pf_batch_item_t {
+    //pf_ctx_st 必须是第一个成员, 通过 gnb_pf_ctx_t 指针可以得到 item
     gnb_pf_ctx_t pf_ctx_st;
-    gnb_pf_array_t *pf_tun_frame_array = pf_core->pf_tun_frame_array;
-    gnb_pf_array_t *pf_tun_route_array = pf_core->pf_tun_route_array;
-    gnb_pf_array_t *pf_tun_fwd_array   = pf_core->pf_tun_fwd_array;
-    memset(&pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
-    pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
-    pf_ctx_st.fwd_payload = payload;
-    pf_ctx_st.fwd_payload->type = GNB_PAYLOAD_TYPE_IPFRAME;
-    pf_ctx_st.fwd_payload->sub_type = GNB_PAYLOAD_SUB_TYPE_IPFRAME_INIT;
-    int pf_tun_frame_status   = GNB_PF_TUN_FRAME_INIT;
-    int pf_tun_route_status   = GNB_PF_TUN_ROUTE_INIT;
-    int pf_tun_forward_status = GNB_PF_TUN_FORWARD_INIT;
-    gnb_uuid_t fwd_uuid64 = 0;
-    gnb_core->select_fwd_node = gnb_select_forward_node(gnb_core);
-    pf_ctx_st.pf_status = GNB_PF_TUN_FRAME_INIT;
-    if ( 1 == gnb_core->conf->if_dump ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF TUN BEGIN -----\n");
-    }
-    for ( i=0; i<pf_tun_frame_array->num; i++ ) {
-        if ( NULL==pf_tun_frame_array->pf[i]->pf_tun_frame ) {
-            continue;
-        }
-        pf_ctx_st.pf_status = pf_tun_frame_array->pf[i]->pf_tun_frame(gnb_core, pf_tun_frame_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_ERROR:
-                pf_tun_frame_status = GNB_PF_TUN_FRAME_ERROR;
-                break;
-            case GNB_PF_DROP:
-                pf_tun_frame_status = GNB_PF_TUN_FRAME_DROP;
-                break;
-            case GNB_PF_NEXT:
-                pf_tun_frame_status = GNB_PF_TUN_FRAME_NEXT;
-                break;
-            case GNB_PF_FINISH:
-                pf_tun_frame_status = GNB_PF_TUN_FRAME_FINISH;
-                break;
-            default:
-                break;
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_frame:[%s] => %s\n", pf_tun_frame_array->pf[i]->name, gnb_pf_status_strings[pf_tun_frame_status]);
-        if ( GNB_PF_FINISH == pf_ctx_st.pf_status ) {
+    int frame_status;
+    int route_status;
+    int forward_status;
+    int state;
+} pf_batch_item_t;
+
+/*
+ 用 pf 模块的 batch call back 处理 pf_ctx_vec, 模块没有 batch call back 时逐个调用单个 packet 的 call back
+ 模块在这个 stage 没有 call back 时返回 0
+*/
+static int pf_stage_call(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_t *pf, int stage, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_batch_cb_t batch_cb;
+    gnb_pf_chain_cb_t chain_cb;
+    int latency_stage;
+    uint64_t latency_begin_ticks;
+    int i;
+    switch (stage) {
+        case GNB_PF_STAGE_TUN_FRAME:
+            batch_cb = pf->pf_tun_frame_batch;
+            chain_cb = pf->pf_tun_frame;
             break;
+        case GNB_PF_STAGE_TUN_ROUTE:
+            batch_cb = pf->pf_tun_route_batch;
+            chain_cb = pf->pf_tun_route;
+            break;
+        case GNB_PF_STAGE_TUN_FWD:
+            batch_cb = pf->pf_tun_fwd_batch;
+            chain_cb = pf->pf_tun_fwd;
+            break;
+        case GNB_PF_STAGE_INET_FRAME:
+            batch_cb = pf->pf_inet_frame_batch;
+            chain_cb = pf->pf_inet_frame;
+            break;
+        case GNB_PF_STAGE_INET_ROUTE:
+            batch_cb = pf->pf_inet_route_batch;
+            chain_cb = pf->pf_inet_route;
+            break;
+        case GNB_PF_STAGE_INET_FWD:
+            batch_cb = pf->pf_inet_fwd_batch;
+            chain_cb = pf->pf_inet_fwd;
+            break;
+        default:
+            return 0;
+    }
+    if ( NULL == batch_cb && NULL == chain_cb ) {
+        return 0;
+    }
+    latency_stage = pf_latency_stage(pf);
+    latency_begin_ticks = pf_latency_begin(pf_core);
+    if ( NULL != batch_cb ) {
+        batch_cb(gnb_core, pf, pf_ctx_vec, num);
+    } else {
+        for ( i=0; i<num; i++ ) {
+            pf_ctx_vec[i]->pf_status = chain_cb(gnb_core, pf, pf_ctx_vec[i]);
         }
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status || GNB_PF_DROP == pf_ctx_st.pf_status ) {
-            goto pf_tun_finish;
+    }
+    if ( latency_stage >= 0 ) {
+        pf_latency_end(pf_core, latency_stage, latency_begin_ticks, num);
+    }
+    return 1;
+}
+
+//收集处于 PF_ITEM_RUN 状态的 packet
+static int pf_batch_collect(pf_batch_item_t *item_vec, int num, gnb_pf_ctx_t **pf_ctx_vec) {
+    int i;
+    int n = 0;
+    for ( i=0; i<num; i++ ) {
+        if ( PF_ITEM_RUN == item_vec[i].state ) {
+            pf_ctx_vec[n++] = &item_vec[i].pf_ctx_st;
         }
     }
-    pf_ctx_st.pf_status = GNB_PF_TUN_ROUTE_INIT;
-    for ( i=0; i<pf_tun_route_array->num; i++ ) {
-        if ( NULL == pf_tun_route_array->pf[i]->pf_tun_route ) {
-            continue;
+    return n;
+}
+
+//进入下一个 stage, pf_status 小于 0 时保留上一个 stage 的 pf_status
+static void pf_batch_next_stage(pf_batch_item_t *item_vec, int num, int pf_status) {
+    int i;
+    for ( i=0; i<num; i++ ) {
+        if ( PF_ITEM_STAGE_DONE == item_vec[i].state ) {
+            item_vec[i].state = PF_ITEM_RUN;
         }
-        pf_ctx_st.pf_status = pf_tun_route_array->pf[i]->pf_tun_route(gnb_core, pf_tun_route_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_ERROR:
-                pf_tun_route_status = GNB_PF_TUN_ROUTE_ERROR;
-                break;
-            case GNB_PF_NOROUTE:
-                pf_tun_route_status = GNB_PF_TUN_ROUTE_NOROUTE;
-                break;
-            case GNB_PF_DROP:
-                pf_tun_route_status = GNB_PF_TUN_ROUTE_DROP;
-                break;
-            case GNB_PF_NEXT:
-                pf_tun_route_status = GNB_PF_TUN_ROUTE_NEXT;
-                break;
-            default:
-                break;
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_route:[%s] %s\n", pf_tun_route_array->pf[i]->name, gnb_pf_status_strings[pf_tun_route_status]);
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status ) {
-            goto pf_tun_finish;
+        if ( PF_ITEM_RUN == item_vec[i].state && pf_status >= 0 ) {
+            item_vec[i].pf_ctx_st.pf_status = pf_status;
         }
     }
+}
 
+/*
+ pf_tun_route 之后选择 forwarding 方式, 返回 0 表示 packet 的处理已经结束, 不需要进入 pf_tun_fwd
+*/
+static int pf_tun_forwarding(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx) {
+    int ret;
     /*
      * 一般的,forwarding 的优先级是 relay_forwarding > unified_forwarding > direct_forwarding > std_forwarding
      * 以下条件跳转是确保 relay_forwarding > unified_forwarding
      * */
-    if ( NULL != pf_ctx_st.fwd_node && 1 == pf_ctx_st.relay_forwarding ) {
-        goto pf_tun_fwd;
+    if ( NULL != pf_ctx->fwd_node && 1 == pf_ctx->relay_forwarding ) {
+        return 1;
     }
     if ( GNB_UNIFIED_FORWARDING_OFF == gnb_core->conf->unified_forwarding ) {
         goto skip_unified_forwarding;
     }
     if ( GNB_UNIFIED_FORWARDING_FORCE == gnb_core->conf->unified_forwarding ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Force src=%llu dst=%llu\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64);
-        ret = gnb_unified_forwarding_tun(gnb_core, &pf_ctx_st);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Force src=%llu dst=%llu\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64);
+        ret = gnb_unified_forwarding_tun(gnb_core, pf_ctx);
         if ( ret > 0 ) {
-            pf_ctx_st.unified_forwarding = 1;
+            pf_ctx->unified_forwarding = 1;
         } else {
-            pf_ctx_st.unified_forwarding = 0;
+            pf_ctx->unified_forwarding = 0;
         }
-        goto pf_tun_finish;
+        pf_count_status(pf_core, pf_ctx, GNB_PF_TUN_ROUTE_FINISH);
+        return 0;
     }
-    if ( NULL == pf_ctx_st.fwd_node && GNB_UNIFIED_FORWARDING_AUTO == gnb_core->conf->unified_forwarding ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Auto src=%llu dst=%llu\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64);
-        ret = gnb_unified_forwarding_tun(gnb_core, &pf_ctx_st);
+    if ( NULL == pf_ctx->fwd_node && GNB_UNIFIED_FORWARDING_AUTO == gnb_core->conf->unified_forwarding ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Auto src=%llu dst=%llu\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64);
+        ret = gnb_unified_forwarding_tun(gnb_core, pf_ctx);
         if ( ret > 0 ) {
-            pf_ctx_st.unified_forwarding = 1;
+            pf_ctx->unified_forwarding = 1;
         } else {
-            pf_ctx_st.unified_forwarding = 0;
+            pf_ctx->unified_forwarding = 0;
         }
-        goto pf_tun_finish;
+        pf_count_status(pf_core, pf_ctx, GNB_PF_TUN_ROUTE_FINISH);
+        return 0;
     }
     if ( GNB_UNIFIED_FORWARDING_SUPER == gnb_core->conf->unified_forwarding || GNB_UNIFIED_FORWARDING_HYPER == gnb_core->conf->unified_forwarding ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Multi-Path src=%llu dst=%llu\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64);
-        ret = gnb_unified_forwarding_with_multi_path_tun(gnb_core, &pf_ctx_st);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Unified Forwarding Multi-Path src=%llu dst=%llu\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64);
+        ret = gnb_unified_forwarding_with_multi_path_tun(gnb_core, pf_ctx);
         if ( 0 == ret ) {
-            pf_ctx_st.unified_forwarding = 1;
+            pf_ctx->unified_forwarding = 1;
         } else {
-            pf_ctx_st.unified_forwarding = 0;
+            pf_ctx->unified_forwarding = 0;
         }
-        goto pf_tun_finish;
+        pf_count_status(pf_core, pf_ctx, GNB_PF_TUN_ROUTE_FINISH);
+        return 0;
     }
-
 skip_unified_forwarding:
-    if ( NULL == pf_ctx_st.fwd_node ) {
-        goto pf_tun_finish;
+    if ( NULL == pf_ctx->fwd_node ) {
+        if ( 1 != pf_ctx->universal_udp4_relay ) {
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, GNB_PF_TUN_ROUTE_NOROUTE);
+        }
+        return 0;
     }
+    return 1;
+}
 
-pf_tun_fwd:
-    pf_ctx_st.pf_status = GNB_PF_TUN_FORWARD_INIT;
-    for ( i=0; i < pf_tun_fwd_array->num;  i++ ) {
-        if ( NULL==pf_tun_fwd_array->pf[i]->pf_tun_fwd ) {
-            continue;
+static void pf_tun_send(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx) {
+    uint64_t latency_begin_ticks = pf_latency_begin(pf_core);
+    gnb_p2p_forward_payload_to_node(gnb_core, pf_ctx->fwd_node, pf_ctx->fwd_payload);
+    pf_latency_end(pf_core, GNB_LATENCY_STAGE_SEND_INET, latency_begin_ticks, 1);
+    pf_count_status(pf_core, pf_ctx, GNB_PF_TUN_FORWARD_FINISH);
+    if ( 1 == gnb_core->conf->if_dump ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome TUN to INET node=%llu [%s]\n", pf_ctx->fwd_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx->fwd_payload) );
+    }
+    pf_count_frame(gnb_core, pf_core, pf_ctx->fwd_node, gnb_core->local_node, pf_ctx->ip_frame_size);
+    if ( pf_ctx->dst_uuid64 == pf_ctx->fwd_node->uuid64 ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload forward to inet src=%llu dst=%llu >>>\n", pf_ctx->src_uuid64, pf_ctx->fwd_node->uuid64);
+    } else {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "*>> tun payload forward to inet src=%llu dst=%llu fwd=%llu *>>\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64, pf_ctx->fwd_node->uuid64);
+    }
+}
+
+static void pf_tun_universal_relay(gnb_core_t *gnb_core, gnb_pf_ctx_t *pf_ctx) {
+    if ( 0 == pf_ctx->unified_forwarding && NULL != pf_ctx->dst_node && NULL == pf_ctx->fwd_node && 1 == pf_ctx->universal_udp4_relay ) {
+        gnb_send_ur0_frame(gnb_core, pf_ctx->dst_node, pf_ctx->fwd_payload);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "tun try to universal relay src=%llu dst=%llu\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64);
+    }
+}
+
+//返回 0 表示 payload 已经转发给其他节点或者出错, 不需要再经过 pf 处理
+static int pf_inet_unified_forwarding(gnb_core_t *gnb_core, gnb_payload16_t *payload) {
+    int ret;
+    if ( GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED == payload->sub_type ) {
+        //如果 ip分组 不是转发到本节点，就转发到目的节点
+        ret = gnb_unified_forwarding_inet(gnb_core, payload);
+        if ( UNIFIED_FORWARDING_TO_TUN != ret ) {
+            return 0;
         }
-        pf_ctx_st.pf_status = pf_tun_fwd_array->pf[i]->pf_tun_fwd(gnb_core, pf_tun_fwd_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_ERROR:
-                pf_tun_forward_status = GNB_PF_TUN_FORWARD_ERROR;
-                break;
-            case GNB_PF_NEXT:
-                pf_tun_forward_status = GNB_PF_TUN_FORWARD_NEXT;
-                break;
-            case GNB_PF_FINISH:
-                pf_tun_forward_status = GNB_PF_TUN_FORWARD_FINISH;
-                break;
-            default:
-                break;
-
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_fwd:[%s] %s\n", pf_tun_fwd_array->pf[i]->name, gnb_pf_status_strings[pf_tun_forward_status]);
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status ) {
-            goto pf_tun_finish;
+    }
+    if ( GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED_MULTI_PATH == payload->sub_type ) {
+        //如果 ip分组 不是转发到本节点，就转发到目的节点
+        ret = gnb_unified_forwarding_multi_path_inet(gnb_core, payload);
+        if ( UNIFIED_FORWARDING_TO_TUN != ret ) {
+            return 0;
         }
-        if ( GNB_PF_FINISH == pf_ctx_st.pf_status ) {
-            break;
+    }
+    return 1;
+}
+
+//返回 GNB_PF_INET_FORWARD_TO_TUN 或 GNB_PF_INET_FORWARD_TO_INET, 没有转发时返回 0
+static int pf_inet_send(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx) {
+    uint64_t latency_begin_ticks;
+    if ( NULL == pf_ctx->src_node ) {
+        return 0;
+    }
+    if ( gnb_core->conf->activate_tun && GNB_PF_FWD_TUN == pf_ctx->pf_fwd ) {
+        latency_begin_ticks = pf_latency_begin(pf_core);
+        gnb_core->drv->write_tun(gnb_core, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+        pf_latency_end(pf_core, GNB_LATENCY_STAGE_WRITE_TUN, latency_begin_ticks, 1);
+        pf_count_status(pf_core, pf_ctx, GNB_PF_INET_FORWARD_TO_TUN);
+        if ( 1 == gnb_core->conf->if_dump ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome INET to TUN src node=%llu [%s]\n", pf_ctx->src_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx->fwd_payload) );
+        }
+        pf_count_frame(gnb_core, pf_core, gnb_core->local_node, pf_ctx->src_node, pf_ctx->ip_frame_size);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload forward to tun src=%llu dst=%llu <<<\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64);
+        return GNB_PF_INET_FORWARD_TO_TUN;
+    }
+    if ( GNB_PF_FWD_INET == pf_ctx->pf_fwd && NULL != pf_ctx->fwd_node && NULL != pf_ctx->fwd_payload ) {
+        latency_begin_ticks = pf_latency_begin(pf_core);
+        gnb_p2p_forward_payload_to_node(gnb_core, pf_ctx->fwd_node, pf_ctx->fwd_payload);
+        pf_latency_end(pf_core, GNB_LATENCY_STAGE_SEND_INET, latency_begin_ticks, 1);
+        pf_count_status(pf_core, pf_ctx, GNB_PF_INET_FORWARD_TO_INET);
+        if ( 1 == gnb_core->conf->if_dump ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome INET to INET dst node=%llu [%s]\n", pf_ctx->fwd_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx->fwd_payload) );
         }
+        pf_count_frame(gnb_core, pf_core, pf_ctx->fwd_node, gnb_core->local_node, pf_ctx->ip_frame_size);
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<*< inet payload forward to inet src=%llu dst=%llu fwd=%llu >*>\n", pf_ctx->src_uuid64, pf_ctx->dst_uuid64, pf_ctx->fwd_node->uuid64);
+        return GNB_PF_INET_FORWARD_TO_INET;
     }
-    gnb_p2p_forward_payload_to_node(gnb_core, pf_ctx_st.fwd_node, pf_ctx_st.fwd_payload);
+    return 0;
+}
+
+/*
+ 常用 pf 组合的 fast path
+
+ gnb_pf_core_conf 根据装载的 pf 模块选择对应的 fast path 函数, 每个 packet 按固定的次序直接调用各个 pf 模块的 call back,
+ 不需要遍历 pf 数组和维护批量处理的状态, 也没有每个 stage 的 debug log, 处理的结果与通用的 pf chain 相同
+ zip 和 crypto 都是常量, 编译器为每种 zip 和 crypto 模块的组合生成一个单独的函数
+ 打开 if_dump 或者 GNB_LOG_ID_PF 的 log level 达到 3 时使用通用的 pf chain
+*/
+static int pf_fast_path_enable(gnb_core_t *gnb_core) {
+    gnb_log_ctx_t *log = gnb_core->log;
     if ( 1 == gnb_core->conf->if_dump ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome TUN to INET node=%llu [%s]\n", pf_ctx_st.fwd_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx_st.fwd_payload) );
+        return 0;
     }
-    pf_ctx_st.fwd_node->in_bytes     += pf_ctx_st.ip_frame_size;
-    gnb_core->local_node->out_bytes  += pf_ctx_st.ip_frame_size;
-    if ( pf_ctx_st.dst_uuid64 == pf_ctx_st.fwd_node->uuid64 ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload forward to inet src=%llu dst=%llu >>>\n", pf_ctx_st.src_uuid64, pf_ctx_st.fwd_node->uuid64);
-    } else {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "*>> tun payload forward to inet src=%llu dst=%llu fwd=%llu *>>\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64, pf_ctx_st.fwd_node->uuid64);
+    if ( NULL == log || GNB_LOG_OUTPUT_NONE == log->output_type ) {
+        return 1;
+    }
+    if ( log->config_table[GNB_LOG_ID_PF].console_level >= GNB_LOG_LEVEL3 ||
+         log->config_table[GNB_LOG_ID_PF].file_level    >= GNB_LOG_LEVEL3 ||
+         log->config_table[GNB_LOG_ID_PF].udp_level     >= GNB_LOG_LEVEL3 ) {
+        return 0;
     }
+    return 1;
+}
 
-pf_tun_finish:
+/*
+ fast path 中直接调用的 pf 模块 call back, 定义在各个 pf 模块中
+*/
+int gnb_pf_route_tun_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_route_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_route_inet_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_route_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_route_inet_fwd(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_zip_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_zip_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_lz4_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_lz4_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_xor_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_xor_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_xor_inet_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_xor_relay(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_arc4_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_arc4_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_arc4_inet_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+int gnb_pf_crypto_arc4_relay(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
+
+#define PF_FAST_ZIP_NONE      0
+#define PF_FAST_ZIP_ZLIB      1
+#define PF_FAST_ZIP_LZ4       2
 
-    if ( 0 == pf_ctx_st.unified_forwarding && NULL != pf_ctx_st.dst_node && NULL == pf_ctx_st.fwd_node && 1 == pf_ctx_st.universal_udp4_relay ) {
-        gnb_send_ur0_frame(gnb_core, pf_ctx_st.dst_node, pf_ctx_st.fwd_payload);
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "tun try to universal relay src=%llu dst=%llu\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64);
+#define PF_FAST_CRYPTO_NONE   0
+#define PF_FAST_CRYPTO_XOR    1
+#define PF_FAST_CRYPTO_ARC4   2
+
+/*
+ zip 和 crypto 在每个 fast path 中都是常量, 下面的分支在编译时就确定了, 每个 stage 都是直接调用
+*/
+static inline __attribute__((always_inline)) int pf_fast_zip_tun_route(const int zip, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_ZIP_LZ4 == zip ) {
+        return gnb_pf_lz4_tun_route(gnb_core, pf, pf_ctx);
     }
+    return gnb_pf_zip_tun_route(gnb_core, pf, pf_ctx);
+}
 
-if_dump:
+static inline __attribute__((always_inline)) int pf_fast_zip_inet_route(const int zip, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_ZIP_LZ4 == zip ) {
+        return gnb_pf_lz4_inet_route(gnb_core, pf, pf_ctx);
+    }
+    return gnb_pf_zip_inet_route(gnb_core, pf, pf_ctx);
+}
 
-    if ( 1 == gnb_core->conf->if_dump ) {
-        fwd_uuid64 = NULL != pf_ctx_st.fwd_node ? pf_ctx_st.fwd_node->uuid64:0;
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "tun src=%llu dst=%llu fwd=%llu [%s] [%s] relay=%d,unified=%d,direct=%d,forward=%d ip_frame_size=%u\n",
-               pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64, fwd_uuid64,
-               gnb_pf_status_strings[pf_tun_frame_status], gnb_pf_status_strings[pf_tun_route_status],
-               pf_ctx_st.relay_forwarding, pf_ctx_st.unified_forwarding, pf_ctx_st.direct_forwarding, pf_ctx_st.std_forwarding,
-               pf_ctx_st.ip_frame_size);
+static inline __attribute__((always_inline)) int pf_fast_crypto_tun_route(const int crypto, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_CRYPTO_ARC4 == crypto ) {
+        return gnb_pf_crypto_arc4_tun_route(gnb_core, pf, pf_ctx);
     }
-    if ( 1 == gnb_core->conf->if_dump ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF TUN   END -----\n");
+    return gnb_pf_crypto_xor_tun_route(gnb_core, pf, pf_ctx);
+}
+
+static inline __attribute__((always_inline)) int pf_fast_crypto_inet_route(const int crypto, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_CRYPTO_ARC4 == crypto ) {
+        return gnb_pf_crypto_arc4_inet_route(gnb_core, pf, pf_ctx);
+    }
+    return gnb_pf_crypto_xor_inet_route(gnb_core, pf, pf_ctx);
+}
+
+static inline __attribute__((always_inline)) int pf_fast_crypto_inet_frame(const int crypto, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_CRYPTO_ARC4 == crypto ) {
+        return gnb_pf_crypto_arc4_inet_frame(gnb_core, pf, pf_ctx);
     }
+    return gnb_pf_crypto_xor_inet_frame(gnb_core, pf, pf_ctx);
+}
+
+static inline __attribute__((always_inline)) int pf_fast_crypto_relay(const int crypto, gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    if ( PF_FAST_CRYPTO_ARC4 == crypto ) {
+        return gnb_pf_crypto_arc4_relay(gnb_core, pf, pf_ctx);
+    }
+    return gnb_pf_crypto_xor_relay(gnb_core, pf, pf_ctx);
+}
 
+static inline __attribute__((always_inline)) void pf_tun_fast_path_one(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, const int zip, const int crypto) {
+    gnb_pf_t *pf_route  = pf_core->fast_path_route;
+    gnb_pf_t *pf_zip    = pf_core->fast_path_zip;
+    gnb_pf_t *pf_crypto = pf_core->fast_path_crypto;
+    //pf_tun_frame    gnb_pf_route
+    pf_ctx->pf_status = GNB_PF_TUN_FRAME_INIT;
+    PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ROUTE, pf_ctx->pf_status, gnb_pf_route_tun_frame(gnb_core, pf_route, pf_ctx));
+    if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+        pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, GNB_PF_TUN_FRAME_ERROR);
+        goto finish;
+    }
+    if ( GNB_PF_DROP == pf_ctx->pf_status ) {
+        pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, GNB_PF_TUN_FRAME_DROP);
+        goto finish;
+    }
+    //pf_tun_route    gnb_pf_route -> gnb_pf_zip -> gnb_pf_crypto(p2p)
+    pf_ctx->pf_status = GNB_PF_TUN_ROUTE_INIT;
+    PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ROUTE, pf_ctx->pf_status, gnb_pf_route_tun_route(gnb_core, pf_route, pf_ctx));
+    if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+        goto route_error;
+    }
+    if ( PF_FAST_ZIP_NONE != zip ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ZIP, pf_ctx->pf_status, pf_fast_zip_tun_route(zip, gnb_core, pf_zip, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+            goto route_error;
+        }
+    }
+    if ( PF_FAST_CRYPTO_NONE != crypto ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_tun_route(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+            goto route_error;
+        }
+    }
+    if ( 0 == pf_tun_forwarding(gnb_core, pf_core, pf_ctx) ) {
+        goto finish;
+    }
+    //pf_tun_fwd      gnb_pf_crypto(relay)
+    if ( PF_FAST_CRYPTO_NONE != crypto ) {
+        pf_ctx->pf_status = GNB_PF_TUN_FORWARD_INIT;
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_relay(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, GNB_PF_TUN_FORWARD_ERROR);
+            goto finish;
+        }
+    }
+    pf_tun_send(gnb_core, pf_core, pf_ctx);
+    goto finish;
+route_error:
+    pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, GNB_PF_TUN_ROUTE_ERROR);
 finish:
+    pf_tun_universal_relay(gnb_core, pf_ctx);
+}
+
+static inline __attribute__((always_inline)) void pf_tun_fast_path(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num, const int zip, const int crypto) {
+    gnb_pf_ctx_t pf_ctx_st;
+    int j;
+    gnb_core->select_fwd_node = gnb_select_forward_node(gnb_core);
+    for ( j=0; j<num; j++ ) {
+        memset(&pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
+        pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
+        pf_ctx_st.fwd_payload = payload_vec[j];
+        pf_ctx_st.fwd_payload->type = GNB_PAYLOAD_TYPE_IPFRAME;
+        pf_ctx_st.fwd_payload->sub_type = GNB_PAYLOAD_SUB_TYPE_IPFRAME_INIT;
+        pf_tun_fast_path_one(gnb_core, pf_core, &pf_ctx_st, zip, crypto);
+    }
+}
+
+static void pf_inet_fast_path_count_route_drop(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx) {
+    switch (pf_ctx->pf_status) {
+        case GNB_PF_ERROR:
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_INET_ROUTE_ERROR);
+            break;
+        case GNB_PF_DROP:
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_INET_ROUTE_DROP);
+            break;
+        default:
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_INET_ROUTE_NOROUTE);
+            break;
+    }
+}
+
+/*
+ relay 和 standard forwarding 的 payload(pf_fwd 为 GNB_PF_FWD_INET)发往其他节点,
+ crypto/zip 的 pf_inet_route 和 gnb_pf_route 的 pf_inet_fwd 只处理 GNB_PF_FWD_TUN 的 payload, 这里跳过它们,
+ 只用下一跳的密钥加密后发送
+*/
+static inline __attribute__((always_inline)) void pf_inet_fast_path_relay(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, const int crypto) {
+    gnb_pf_t *pf_crypto = pf_core->fast_path_crypto;
+    if ( PF_FAST_CRYPTO_NONE != crypto ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_relay(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+            pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_ERROR == pf_ctx->pf_status ? GNB_PF_INET_FORWARD_ERROR : GNB_PF_INET_FORWARD_DROP);
+            return;
+        }
+    }
+    pf_inet_send(gnb_core, pf_core, pf_ctx);
+}
+
+static inline __attribute__((always_inline)) void pf_inet_fast_path_one(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_ctx_t *pf_ctx, const int zip, const int crypto) {
+    gnb_pf_t *pf_route  = pf_core->fast_path_route;
+    gnb_pf_t *pf_zip    = pf_core->fast_path_zip;
+    gnb_pf_t *pf_crypto = pf_core->fast_path_crypto;
+    //pf_inet_frame   gnb_pf_crypto(relay) -> gnb_pf_route
+    if ( PF_FAST_CRYPTO_NONE != crypto ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_inet_frame(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+            goto frame_drop;
+        }
+        if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+            goto route;
+        }
+    }
+    PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ROUTE, pf_ctx->pf_status, gnb_pf_route_inet_frame(gnb_core, pf_route, pf_ctx));
+    if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+        goto frame_drop;
+    }
+route:
+    //pf_inet_route   gnb_pf_route -> gnb_pf_crypto(p2p) -> gnb_pf_zip
+    PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ROUTE, pf_ctx->pf_status, gnb_pf_route_inet_route(gnb_core, pf_route, pf_ctx));
+    if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status || GNB_PF_NOROUTE == pf_ctx->pf_status ) {
+        goto route_drop;
+    }
+    if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+        goto fwd;
+    }
+    if ( GNB_PF_FWD_INET == pf_ctx->pf_fwd ) {
+        pf_inet_fast_path_relay(gnb_core, pf_core, pf_ctx, crypto);
+        return;
+    }
+    if ( PF_FAST_CRYPTO_NONE != crypto ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_inet_route(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status || GNB_PF_NOROUTE == pf_ctx->pf_status ) {
+            goto route_drop;
+        }
+        if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+            goto fwd;
+        }
+    }
+    if ( PF_FAST_ZIP_NONE != zip ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ZIP, pf_ctx->pf_status, pf_fast_zip_inet_route(zip, gnb_core, pf_zip, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status || GNB_PF_NOROUTE == pf_ctx->pf_status ) {
+            goto route_drop;
+        }
+    }
+fwd:
+    //pf_inet_fwd     gnb_pf_route -> gnb_pf_crypto(relay)
+    PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_ROUTE, pf_ctx->pf_status, gnb_pf_route_inet_fwd(gnb_core, pf_route, pf_ctx));
+    if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+        goto fwd_drop;
+    }
+    if ( PF_FAST_CRYPTO_NONE != crypto && GNB_PF_FINISH != pf_ctx->pf_status ) {
+        PF_LATENCY_CALL(pf_core, GNB_LATENCY_STAGE_PF_CRYPTO, pf_ctx->pf_status, pf_fast_crypto_relay(crypto, gnb_core, pf_crypto, pf_ctx));
+        if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+            goto fwd_drop;
+        }
+    }
+    pf_inet_send(gnb_core, pf_core, pf_ctx);
     return;
+frame_drop:
+    pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_ERROR == pf_ctx->pf_status ? GNB_PF_INET_FRAME_ERROR : GNB_PF_INET_FRAME_DROP);
+    return;
+route_drop:
+    pf_inet_fast_path_count_route_drop(gnb_core, pf_core, pf_ctx);
+    return;
+fwd_drop:
+    pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, GNB_PF_ERROR == pf_ctx->pf_status ? GNB_PF_INET_FORWARD_ERROR : GNB_PF_INET_FORWARD_DROP);
 }
 
-void gnb_pf_inet(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *payload, gnb_sockaddress_t *source_node_addr){
+static inline __attribute__((always_inline)) void pf_inet_fast_path(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num, const int zip, const int crypto) {
     gnb_pf_ctx_t pf_ctx_st;
-    gnb_pf_array_t *pf_inet_frame_array = pf_core->pf_inet_frame_array;
-    gnb_pf_array_t *pf_inet_route_array = pf_core->pf_inet_route_array;
-    gnb_pf_array_t *pf_inet_fwd_array   = pf_core->pf_inet_fwd_array;
-    memset(&pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
-    pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
-    pf_ctx_st.fwd_payload = payload;
-    pf_ctx_st.source_node_addr = source_node_addr;
+    int j;
+    gnb_core->select_fwd_node = gnb_select_forward_node(gnb_core);
+    for ( j=0; j<num; j++ ) {
+        memset(&pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
+        pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
+        pf_ctx_st.fwd_payload = payload_vec[j];
+        pf_ctx_st.source_node_addr = source_node_addr_vec[j];
+        if ( 0 == pf_inet_unified_forwarding(gnb_core, payload_vec[j]) ) {
+            pf_ctx_st.unified_forwarding = 1;
+            pf_count_status(pf_core, &pf_ctx_st, GNB_PF_INET_FRAME_FINISH);
+            continue;
+        }
+        pf_inet_fast_path_one(gnb_core, pf_core, &pf_ctx_st, zip, crypto);
+    }
+}
+
+#define GNB_PF_FAST_PATH(name, zip, crypto)                                                                                                                \
+static void pf_tun_fast_path_##name(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num) {                                  \
+    pf_tun_fast_path(gnb_core, pf_core, payload_vec, num, zip, crypto);                                                                                    \
+}                                                                                                                                                           \
+static void pf_inet_fast_path_##name(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num) { \
+    pf_inet_fast_path(gnb_core, pf_core, payload_vec, source_node_addr_vec, num, zip, crypto);                                                             \
+}
+
+GNB_PF_FAST_PATH(route,           PF_FAST_ZIP_NONE, PF_FAST_CRYPTO_NONE)
+GNB_PF_FAST_PATH(route_xor,       PF_FAST_ZIP_NONE, PF_FAST_CRYPTO_XOR)
+GNB_PF_FAST_PATH(route_arc4,      PF_FAST_ZIP_NONE, PF_FAST_CRYPTO_ARC4)
+GNB_PF_FAST_PATH(route_zip,       PF_FAST_ZIP_ZLIB, PF_FAST_CRYPTO_NONE)
+GNB_PF_FAST_PATH(route_zip_xor,   PF_FAST_ZIP_ZLIB, PF_FAST_CRYPTO_XOR)
+GNB_PF_FAST_PATH(route_zip_arc4,  PF_FAST_ZIP_ZLIB, PF_FAST_CRYPTO_ARC4)
+GNB_PF_FAST_PATH(route_lz4,       PF_FAST_ZIP_LZ4,  PF_FAST_CRYPTO_NONE)
+GNB_PF_FAST_PATH(route_lz4_xor,   PF_FAST_ZIP_LZ4,  PF_FAST_CRYPTO_XOR)
+GNB_PF_FAST_PATH(route_lz4_arc4,  PF_FAST_ZIP_LZ4,  PF_FAST_CRYPTO_ARC4)
+
+typedef struct _pf_fast_path_entry_t {
+    const char *name;
+    gnb_pf_tun_fast_path_t  pf_tun_fast_path;
+    gnb_pf_inet_fast_path_t pf_inet_fast_path;
+} pf_fast_path_entry_t;
+
+//按 [zip][crypto] 索引
+static const pf_fast_path_entry_t pf_fast_path_table[3][3] = {
+    {
+        { "route",           pf_tun_fast_path_route,          pf_inet_fast_path_route          },
+        { "route+xor",       pf_tun_fast_path_route_xor,      pf_inet_fast_path_route_xor      },
+        { "route+arc4",      pf_tun_fast_path_route_arc4,     pf_inet_fast_path_route_arc4     },
+    },
+    {
+        { "route+zip",       pf_tun_fast_path_route_zip,      pf_inet_fast_path_route_zip      },
+        { "route+zip+xor",   pf_tun_fast_path_route_zip_xor,  pf_inet_fast_path_route_zip_xor  },
+        { "route+zip+arc4",  pf_tun_fast_path_route_zip_arc4, pf_inet_fast_path_route_zip_arc4 },
+    },
+    {
+        { "route+lz4",       pf_tun_fast_path_route_lz4,      pf_inet_fast_path_route_lz4      },
+        { "route+lz4+xor",   pf_tun_fast_path_route_lz4_xor,  pf_inet_fast_path_route_lz4_xor  },
+        { "route+lz4+arc4",  pf_tun_fast_path_route_lz4_arc4, pf_inet_fast_path_route_lz4_arc4 },
+    },
+};
+
+/*
+ pf chain 是 gnb_pf_route [-> gnb_pf_zip | gnb_pf_lz4] [-> gnb_pf_crypto_xor | gnb_pf_crypto_arc4] 时选择 fast path, 安装了 gnb_pf_header_zip 时不使用 fast path,
+ 每种 zip 和 crypto 的组合都有单独的 fast path, 各 stage 直接调用对应 pf 模块的函数而不经过 gnb_pf_t 中的函数指针
+*/
+static void pf_core_conf_fast_path(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_pf_t *pf_dump, gnb_pf_t *pf_route, gnb_pf_t *pf_zip, gnb_pf_t *pf_header_zip, gnb_pf_t *pf_crypto) {
+    const pf_fast_path_entry_t *entry;
+    int zip = PF_FAST_ZIP_NONE;
+    int crypto = PF_FAST_CRYPTO_NONE;
+    pf_core->pf_tun_fast_path  = NULL;
+    pf_core->pf_inet_fast_path = NULL;
+    pf_core->fast_path_route   = pf_route;
+    pf_core->fast_path_zip     = pf_zip;
+    pf_core->fast_path_crypto  = pf_crypto;
+    if ( NULL != pf_dump || NULL != pf_header_zip || NULL == pf_route || 0 != strncmp(pf_route->name, "gnb_pf_route", 128) ) {
+        return;
+    }
+    if ( NULL != pf_zip ) {
+        if ( 0 == strncmp(pf_zip->name, "gnb_pf_zip", 128) ) {
+            zip = PF_FAST_ZIP_ZLIB;
+        } else if ( 0 == strncmp(pf_zip->name, "gnb_pf_lz4", 128) ) {
+            zip = PF_FAST_ZIP_LZ4;
+        } else {
+            return;
+        }
+    }
+    if ( NULL != pf_crypto ) {
+        if ( 0 == strncmp(pf_crypto->name, "gnb_pf_crypto_xor", 128) ) {
+            crypto = PF_FAST_CRYPTO_XOR;
+        } else if ( 0 == strncmp(pf_crypto->name, "gnb_pf_crypto_arc4", 128) ) {
+            crypto = PF_FAST_CRYPTO_ARC4;
+        } else {
+            return;
+        }
+    }
+    entry = &pf_fast_path_table[zip][crypto];
+    pf_core->pf_tun_fast_path  = entry->pf_tun_fast_path;
+    pf_core->pf_inet_fast_path = entry->pf_inet_fast_path;
+    GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "pf fast path %s [%s %s %s]\n", entry->name, pf_route->name, NULL != pf_zip ? pf_zip->name:"", NULL != pf_crypto ? pf_crypto->name:"");
+}
+
+/*
+把输入的 payload 加上offset，这样pf模块处理的时候，就可以在offset之前填充pf的头部，减少一次通过 memcpy 重组payload
+*/
+static void pf_tun_batch(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num) {
     int i;
-    int pf_inet_frame_status  = GNB_PF_INET_FRAME_INIT;
-    int pf_inet_route_status  = GNB_PF_INET_ROUTE_INIT;
-    int pf_inet_forwad_status = GNB_PF_INET_FORWARD_INIT;
-    int ret;
+    int j;
+    int n;
+    pf_batch_item_t item_vec[GNB_PF_BATCH_MAX];
+    gnb_pf_ctx_t *pf_ctx_vec[GNB_PF_BATCH_MAX];
+    pf_batch_item_t *item;
+    gnb_pf_ctx_t *pf_ctx;
+    gnb_pf_array_t *pf_tun_frame_array = pf_core->pf_tun_frame_array;
+    gnb_pf_array_t *pf_tun_route_array = pf_core->pf_tun_route_array;
+    gnb_pf_array_t *pf_tun_fwd_array   = pf_core->pf_tun_fwd_array;
     gnb_uuid_t fwd_uuid64 = 0;
+    if ( NULL != pf_core->pf_tun_fast_path && pf_fast_path_enable(gnb_core) ) {
+        pf_core->pf_tun_fast_path(gnb_core, pf_core, payload_vec, num);
+        return;
+    }
+    if ( num > GNB_PF_BATCH_MAX ) {
+        pf_tun_batch(gnb_core, pf_core, payload_vec, GNB_PF_BATCH_MAX);
+        pf_tun_batch(gnb_core, pf_core, payload_vec + GNB_PF_BATCH_MAX, num - GNB_PF_BATCH_MAX);
+        return;
+    }
+    for ( j=0; j<num; j++ ) {
+        item = &item_vec[j];
+        memset(&item->pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
+        item->pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
+        item->pf_ctx_st.fwd_payload = payload_vec[j];
+        item->pf_ctx_st.fwd_payload->type = GNB_PAYLOAD_TYPE_IPFRAME;
+        item->pf_ctx_st.fwd_payload->sub_type = GNB_PAYLOAD_SUB_TYPE_IPFRAME_INIT;
+        item->pf_ctx_st.pf_status = GNB_PF_TUN_FRAME_INIT;
+        item->frame_status   = GNB_PF_TUN_FRAME_INIT;
+        item->route_status   = GNB_PF_TUN_ROUTE_INIT;
+        item->forward_status = GNB_PF_TUN_FORWARD_INIT;
+        item->state = PF_ITEM_RUN;
+    }
     gnb_core->select_fwd_node = gnb_select_forward_node(gnb_core);
     if ( 1 == gnb_core->conf->if_dump ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF INET BEGIN -----\n");
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF TUN BEGIN -----\n");
     }
-    if ( GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED == payload->sub_type ) {
-        //如果 ip分组 不是转发到本节点，就转发到目的节点
-        ret = gnb_unified_forwarding_inet(gnb_core, payload);
-        if ( UNIFIED_FORWARDING_TO_TUN != ret ) {
-            goto pf_inet_finish;
+    for ( i=0; i<pf_tun_frame_array->num; i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
+            break;
+        }
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_tun_frame_array->pf[i], GNB_PF_STAGE_TUN_FRAME, pf_ctx_vec, n) ) {
+            continue;
+        }
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_ERROR:
+                    item->frame_status = GNB_PF_TUN_FRAME_ERROR;
+                    break;
+                case GNB_PF_DROP:
+                    item->frame_status = GNB_PF_TUN_FRAME_DROP;
+                    break;
+                case GNB_PF_NEXT:
+                    item->frame_status = GNB_PF_TUN_FRAME_NEXT;
+                    break;
+                case GNB_PF_FINISH:
+                    item->frame_status = GNB_PF_TUN_FRAME_FINISH;
+                    break;
+                default:
+                    break;
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_frame:[%s] => %s\n", pf_tun_frame_array->pf[i]->name, gnb_pf_status_strings[item->frame_status]);
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                item->state = PF_ITEM_STAGE_DONE;
+                continue;
+            }
+            if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, item->frame_status);
+                item->state = PF_ITEM_FINISH;
+            }
         }
     }
-    if ( GNB_PAYLOAD_SUB_TYPE_IPFRAME_UNIFIED_MULTI_PATH == payload->sub_type ) {
-        //如果 ip分组 不是转发到本节点，就转发到目的节点
-        ret = gnb_unified_forwarding_multi_path_inet(gnb_core, payload);
-        if ( UNIFIED_FORWARDING_TO_TUN != ret ) {
-            goto pf_inet_finish;
+    pf_batch_next_stage(item_vec, num, GNB_PF_TUN_ROUTE_INIT);
+    for ( i=0; i<pf_tun_route_array->num; i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
+            break;
+        }
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_tun_route_array->pf[i], GNB_PF_STAGE_TUN_ROUTE, pf_ctx_vec, n) ) {
+            continue;
+        }
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_ERROR:
+                    item->route_status = GNB_PF_TUN_ROUTE_ERROR;
+                    break;
+                case GNB_PF_NOROUTE:
+                    item->route_status = GNB_PF_TUN_ROUTE_NOROUTE;
+                    break;
+                case GNB_PF_DROP:
+                    item->route_status = GNB_PF_TUN_ROUTE_DROP;
+                    break;
+                case GNB_PF_NEXT:
+                    item->route_status = GNB_PF_TUN_ROUTE_NEXT;
+                    break;
+                default:
+                    break;
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_route:[%s] %s\n", pf_tun_route_array->pf[i]->name, gnb_pf_status_strings[item->route_status]);
+            if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, item->route_status);
+                item->state = PF_ITEM_FINISH;
+            }
         }
     }
 
-    for ( i=0; i<pf_inet_frame_array->num; i++ ) {
-        if ( NULL == pf_inet_frame_array->pf[i]->pf_inet_frame ) {
+    for ( j=0; j<num; j++ ) {
+        item = &item_vec[j];
+        if ( PF_ITEM_FINISH == item->state ) {
             continue;
         }
-        pf_ctx_st.pf_status = pf_inet_frame_array->pf[i]->pf_inet_frame(gnb_core, pf_inet_frame_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_NOROUTE:
-                pf_inet_frame_status = GNB_PF_INET_FRAME_NOROUTE;
-                break;
-            case GNB_PF_ERROR:
-                pf_inet_frame_status = GNB_PF_INET_FRAME_ERROR;
-                break;
-            case GNB_PF_DROP:
-                pf_inet_frame_status = GNB_PF_INET_FRAME_DROP;
-                break;
-            case GNB_PF_FINISH:
-                pf_inet_frame_status = GNB_PF_INET_FRAME_FINISH;
-                break;
-            default:
-                break;
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_frame:[%s] %s\n", pf_inet_frame_array->pf[i]->name, gnb_pf_status_strings[pf_inet_frame_status]);
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status || GNB_PF_DROP == pf_ctx_st.pf_status ) {
-            goto pf_inet_finish;
+        if ( 0 == pf_tun_forwarding(gnb_core, pf_core, &item->pf_ctx_st) ) {
+            item->state = PF_ITEM_FINISH;
         }
-        if ( GNB_PF_FINISH == pf_ctx_st.pf_status ) {
+    }
+
+    pf_batch_next_stage(item_vec, num, GNB_PF_TUN_FORWARD_INIT);
+    for ( i=0; i < pf_tun_fwd_array->num;  i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
             break;
         }
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_tun_fwd_array->pf[i], GNB_PF_STAGE_TUN_FWD, pf_ctx_vec, n) ) {
+            continue;
+        }
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_ERROR:
+                    item->forward_status = GNB_PF_TUN_FORWARD_ERROR;
+                    break;
+                case GNB_PF_NEXT:
+                    item->forward_status = GNB_PF_TUN_FORWARD_NEXT;
+                    break;
+                case GNB_PF_FINISH:
+                    item->forward_status = GNB_PF_TUN_FORWARD_FINISH;
+                    break;
+                default:
+                    break;
+
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, ">>> tun payload pf_tun_fwd:[%s] %s\n", pf_tun_fwd_array->pf[i]->name, gnb_pf_status_strings[item->forward_status]);
+            if ( GNB_PF_ERROR == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->dst_node, item->forward_status);
+                item->state = PF_ITEM_FINISH;
+                continue;
+            }
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                item->state = PF_ITEM_STAGE_DONE;
+            }
+        }
     }
 
-    for ( i=0; i<pf_inet_route_array->num; i++ ) {
-        if ( NULL == pf_inet_route_array->pf[i]->pf_inet_route ) {
-            continue;
+    for ( j=0; j<num; j++ ) {
+        item = &item_vec[j];
+        pf_ctx = &item->pf_ctx_st;
+        if ( PF_ITEM_FINISH == item->state ) {
+            goto pf_tun_finish;
         }
-        pf_ctx_st.pf_status = pf_inet_route_array->pf[i]->pf_inet_route(gnb_core, pf_inet_route_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_ERROR:
-                pf_inet_route_status = GNB_PF_INET_ROUTE_ERROR;
-                break;
-            case GNB_PF_DROP:
-                pf_inet_route_status = GNB_PF_INET_ROUTE_DROP;
-                break;
-            case GNB_PF_NOROUTE:
-                pf_inet_route_status = GNB_PF_INET_ROUTE_NOROUTE;
-                break;
-            case GNB_PF_NEXT:
-                pf_inet_route_status = GNB_PF_INET_ROUTE_NEXT;
-                break;
-            case GNB_PF_FINISH:
-                pf_inet_route_status = GNB_PF_INET_ROUTE_FINISH;
-                break;
-            default:
-                break;
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_route:[%s] %s\n", pf_inet_route_array->pf[i]->name, gnb_pf_status_strings[pf_inet_route_status]);
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status || GNB_PF_DROP == pf_ctx_st.pf_status || GNB_PF_NOROUTE == pf_ctx_st.pf_status ) {
-            goto pf_inet_finish;
+        pf_tun_send(gnb_core, pf_core, pf_ctx);
+
+pf_tun_finish:
+
+        pf_tun_universal_relay(gnb_core, pf_ctx);
+        if ( 1 == gnb_core->conf->if_dump ) {
+            fwd_uuid64 = NULL != pf_ctx->fwd_node ? pf_ctx->fwd_node->uuid64:0;
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "tun src=%llu dst=%llu fwd=%llu [%s] [%s] relay=%d,unified=%d,direct=%d,forward=%d ip_frame_size=%u\n",
+                   pf_ctx->src_uuid64, pf_ctx->dst_uuid64, fwd_uuid64,
+                   gnb_pf_status_strings[item->frame_status], gnb_pf_status_strings[item->route_status],
+                   pf_ctx->relay_forwarding, pf_ctx->unified_forwarding, pf_ctx->direct_forwarding, pf_ctx->std_forwarding,
+                   pf_ctx->ip_frame_size);
         }
-        if ( GNB_PF_FINISH == pf_ctx_st.pf_status ) {
-            break;
+    }
+    if ( 1 == gnb_core->conf->if_dump ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF TUN   END -----\n");
+    }
+}
+
+void gnb_pf_tun_batch(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num) {
+    uint64_t latency_begin_ticks = pf_latency_begin(pf_core);
+    GNB_TRACE1(pf_tun_begin, num);
+    pf_tun_batch(gnb_core, pf_core, payload_vec, num);
+    GNB_TRACE1(pf_tun_end, num);
+    pf_latency_end(pf_core, GNB_LATENCY_STAGE_PF_TUN, latency_begin_ticks, num);
+}
+
+void gnb_pf_tun(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *payload) {
+    gnb_pf_tun_batch(gnb_core, pf_core, &payload, 1);
+}
+
+static void pf_inet_batch(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num) {
+    int i;
+    int j;
+    int n;
+    int ret;
+    pf_batch_item_t item_vec[GNB_PF_BATCH_MAX];
+    gnb_pf_ctx_t *pf_ctx_vec[GNB_PF_BATCH_MAX];
+    pf_batch_item_t *item;
+    gnb_pf_ctx_t *pf_ctx;
+    gnb_payload16_t *payload;
+    gnb_pf_array_t *pf_inet_frame_array = pf_core->pf_inet_frame_array;
+    gnb_pf_array_t *pf_inet_route_array = pf_core->pf_inet_route_array;
+    gnb_pf_array_t *pf_inet_fwd_array   = pf_core->pf_inet_fwd_array;
+    gnb_uuid_t fwd_uuid64 = 0;
+    if ( NULL != pf_core->pf_inet_fast_path && pf_fast_path_enable(gnb_core) ) {
+        pf_core->pf_inet_fast_path(gnb_core, pf_core, payload_vec, source_node_addr_vec, num);
+        return;
+    }
+    if ( num > GNB_PF_BATCH_MAX ) {
+        pf_inet_batch(gnb_core, pf_core, payload_vec, source_node_addr_vec, GNB_PF_BATCH_MAX);
+        pf_inet_batch(gnb_core, pf_core, payload_vec + GNB_PF_BATCH_MAX, source_node_addr_vec + GNB_PF_BATCH_MAX, num - GNB_PF_BATCH_MAX);
+        return;
+    }
+    gnb_core->select_fwd_node = gnb_select_forward_node(gnb_core);
+    if ( 1 == gnb_core->conf->if_dump ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "----- GNB PF INET BEGIN -----\n");
+    }
+    for ( j=0; j<num; j++ ) {
+        item = &item_vec[j];
+        payload = payload_vec[j];
+        memset(&item->pf_ctx_st,0,sizeof(gnb_pf_ctx_t));
+        item->pf_ctx_st.pf_fwd = GNB_PF_FWD_INIT;
+        item->pf_ctx_st.fwd_payload = payload;
+        item->pf_ctx_st.source_node_addr = source_node_addr_vec[j];
+        item->frame_status   = GNB_PF_INET_FRAME_INIT;
+        item->route_status   = GNB_PF_INET_ROUTE_INIT;
+        item->forward_status = GNB_PF_INET_FORWARD_INIT;
+        item->state = PF_ITEM_RUN;
+        if ( 0 == pf_inet_unified_forwarding(gnb_core, payload) ) {
+            item->pf_ctx_st.unified_forwarding = 1;
+            pf_count_status(pf_core, &item->pf_ctx_st, GNB_PF_INET_FRAME_FINISH);
+            item->state = PF_ITEM_FINISH;
         }
     }
 
-    for ( i=0; i<pf_inet_fwd_array->num; i++ ) {
-        if ( NULL == pf_inet_fwd_array->pf[i]->pf_inet_fwd ) {
+    for ( i=0; i<pf_inet_frame_array->num; i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
+            break;
+        }
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_inet_frame_array->pf[i], GNB_PF_STAGE_INET_FRAME, pf_ctx_vec, n) ) {
             continue;
         }
-        pf_ctx_st.pf_status = pf_inet_fwd_array->pf[i]->pf_inet_fwd(gnb_core, pf_inet_fwd_array->pf[i], &pf_ctx_st);
-        switch (pf_ctx_st.pf_status) {
-            case GNB_PF_ERROR:
-                pf_inet_forwad_status = GNB_PF_INET_FORWARD_ERROR;
-                break;
-            case GNB_PF_DROP:
-                pf_inet_forwad_status = GNB_PF_INET_FORWARD_DROP;
-                break;
-            case GNB_PF_NEXT:
-                pf_inet_forwad_status = GNB_PF_INET_FORWARD_NEXT;
-                break;
-            case GNB_PF_FINISH:
-                pf_inet_forwad_status = GNB_PF_INET_FORWARD_FINISH;
-                break;
-            default:
-                break;
-        }
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_fwd:[%s] %s\n", pf_inet_fwd_array->pf[i]->name, gnb_pf_status_strings[pf_inet_forwad_status]);
-        if ( GNB_PF_ERROR == pf_ctx_st.pf_status || GNB_PF_DROP == pf_ctx_st.pf_status ) {
-            goto pf_inet_finish;
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_NOROUTE:
+                    item->frame_status = GNB_PF_INET_FRAME_NOROUTE;
+                    break;
+                case GNB_PF_ERROR:
+                    item->frame_status = GNB_PF_INET_FRAME_ERROR;
+                    break;
+                case GNB_PF_DROP:
+                    item->frame_status = GNB_PF_INET_FRAME_DROP;
+                    break;
+                case GNB_PF_FINISH:
+                    item->frame_status = GNB_PF_INET_FRAME_FINISH;
+                    break;
+                default:
+                    break;
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_frame:[%s] %s\n", pf_inet_frame_array->pf[i]->name, gnb_pf_status_strings[item->frame_status]);
+            if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, item->frame_status);
+                item->state = PF_ITEM_FINISH;
+                continue;
+            }
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                item->state = PF_ITEM_STAGE_DONE;
+            }
         }
-        if ( GNB_PF_FINISH == pf_ctx_st.pf_status ) {            
+    }
+
+    pf_batch_next_stage(item_vec, num, -1);
+    for ( i=0; i<pf_inet_route_array->num; i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
             break;
         }
-    }
-    fwd_uuid64 = NULL!=pf_ctx_st.fwd_node ? pf_ctx_st.fwd_node->uuid64:0;
-    if ( NULL == pf_ctx_st.src_node ) {
-        goto pf_inet_finish;
-    }
-    if ( gnb_core->conf->activate_tun && GNB_PF_FWD_TUN == pf_ctx_st.pf_fwd ) {
-        gnb_core->drv->write_tun(gnb_core, pf_ctx_st.ip_frame, pf_ctx_st.ip_frame_size);
-        if ( 1 == gnb_core->conf->if_dump ) {
-            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome INET to TUN src node=%llu [%s]\n", pf_ctx_st.src_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx_st.fwd_payload) );
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_inet_route_array->pf[i], GNB_PF_STAGE_INET_ROUTE, pf_ctx_vec, n) ) {
+            continue;
+        }
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_ERROR:
+                    item->route_status = GNB_PF_INET_ROUTE_ERROR;
+                    break;
+                case GNB_PF_DROP:
+                    item->route_status = GNB_PF_INET_ROUTE_DROP;
+                    break;
+                case GNB_PF_NOROUTE:
+                    item->route_status = GNB_PF_INET_ROUTE_NOROUTE;
+                    break;
+                case GNB_PF_NEXT:
+                    item->route_status = GNB_PF_INET_ROUTE_NEXT;
+                    break;
+                case GNB_PF_FINISH:
+                    item->route_status = GNB_PF_INET_ROUTE_FINISH;
+                    break;
+                default:
+                    break;
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_route:[%s] %s\n", pf_inet_route_array->pf[i]->name, gnb_pf_status_strings[item->route_status]);
+            if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status || GNB_PF_NOROUTE == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, item->route_status);
+                item->state = PF_ITEM_FINISH;
+                continue;
+            }
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                item->state = PF_ITEM_STAGE_DONE;
+            }
         }
-        fwd_uuid64 = pf_ctx_st.dst_uuid64;
-        pf_inet_forwad_status = GNB_PF_INET_FORWARD_TO_TUN;
-        gnb_core->local_node->in_bytes += pf_ctx_st.ip_frame_size;
-        pf_ctx_st.src_node->out_bytes  += pf_ctx_st.ip_frame_size;
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload forward to tun src=%llu dst=%llu <<<\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64);
-        goto pf_inet_finish;
     }
-    if ( GNB_PF_FWD_INET == pf_ctx_st.pf_fwd && NULL != pf_ctx_st.fwd_node && NULL != pf_ctx_st.fwd_payload ) {
-        gnb_p2p_forward_payload_to_node(gnb_core, pf_ctx_st.fwd_node, pf_ctx_st.fwd_payload);
-        if ( 1 == gnb_core->conf->if_dump ) {
-            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "payload frome INET to INET dst node=%llu [%s]\n", pf_ctx_st.fwd_node->uuid64, GNB_HEX2_BYTE256((void *)pf_ctx_st.fwd_payload) );
+
+    pf_batch_next_stage(item_vec, num, -1);
+    for ( i=0; i<pf_inet_fwd_array->num; i++ ) {
+        n = pf_batch_collect(item_vec, num, pf_ctx_vec);
+        if ( 0 == n ) {
+            break;
+        }
+        if ( 0 == pf_stage_call(gnb_core, pf_core, pf_inet_fwd_array->pf[i], GNB_PF_STAGE_INET_FWD, pf_ctx_vec, n) ) {
+            continue;
+        }
+        for ( j=0; j<n; j++ ) {
+            pf_ctx = pf_ctx_vec[j];
+            item = (pf_batch_item_t *)pf_ctx;
+            switch (pf_ctx->pf_status) {
+                case GNB_PF_ERROR:
+                    item->forward_status = GNB_PF_INET_FORWARD_ERROR;
+                    break;
+                case GNB_PF_DROP:
+                    item->forward_status = GNB_PF_INET_FORWARD_DROP;
+                    break;
+                case GNB_PF_NEXT:
+                    item->forward_status = GNB_PF_INET_FORWARD_NEXT;
+                    break;
+                case GNB_PF_FINISH:
+                    item->forward_status = GNB_PF_INET_FORWARD_FINISH;
+                    break;
+                default:
+                    break;
+            }
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<<< inet payload pf_inet_fwd:[%s] %s\n", pf_inet_fwd_array->pf[i]->name, gnb_pf_status_strings[item->forward_status]);
+            if ( GNB_PF_ERROR == pf_ctx->pf_status || GNB_PF_DROP == pf_ctx->pf_status ) {
+                pf_count_drop(gnb_core, pf_core, pf_ctx, pf_ctx->src_node, item->forward_status);
+                item->state = PF_ITEM_FINISH;
+                continue;
+            }
+            if ( GNB_PF_FINISH == pf_ctx->pf_status ) {
+                item->state = PF_ITEM_STAGE_DONE;
+            }
         }
-        pf_inet_forwad_status = GNB_PF_INET_FORWARD_TO_INET;
-        gnb_core->local_node->out_bytes += pf_ctx_st.ip_frame_size;
-        pf_ctx_st.fwd_node->in_bytes    += pf_ctx_st.ip_frame_size;
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "<*< inet payload forward to inet src=%llu dst=%llu fwd=%llu >*>\n", pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64, fwd_uuid64);
     }
 
+    for ( j=0; j<num; j++ ) {
+        item = &item_vec[j];
+        pf_ctx = &item->pf_ctx_st;
+        fwd_uuid64 = 0;
+        if ( PF_ITEM_FINISH == item->state ) {
+            goto pf_inet_finish;
+        }
+        fwd_uuid64 = NULL!=pf_ctx->fwd_node ? pf_ctx->fwd_node->uuid64:0;
+        ret = pf_inet_send(gnb_core, pf_core, pf_ctx);
+        if ( 0 != ret ) {
+            item->forward_status = ret;
+        }
+        if ( GNB_PF_INET_FORWARD_TO_TUN == ret ) {
+            fwd_uuid64 = pf_ctx->dst_uuid64;
+        }
+
 pf_inet_finish:
 
-    if ( 1 == gnb_core->conf->if_dump ) {
-        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "inet src=%llu dst=%llu fwd=%llu [%s] [%s] [%s] ip_frame_size=%u\n",
-                   pf_ctx_st.src_uuid64, pf_ctx_st.dst_uuid64, fwd_uuid64,
-                   gnb_pf_status_strings[pf_inet_frame_status], gnb_pf_status_strings[pf_inet_route_status], gnb_pf_status_strings[pf_inet_forwad_status],
-                   pf_ctx_st.ip_frame_size);
+        if ( 1 == gnb_core->conf->if_dump ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "inet src=%llu dst=%llu fwd=%llu [%s] [%s] [%s] ip_frame_size=%u\n",
+                       pf_ctx->src_uuid64, pf_ctx->dst_uuid64, fwd_uuid64,
+                       gnb_pf_status_strings[item->frame_status], gnb_pf_status_strings[item->route_status], gnb_pf_status_strings[item->forward_status],
+                       pf_ctx->ip_frame_size);
+        }
     }
     if ( 1 == gnb_core->conf->if_dump ) {
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF,"----- GNB PF INET END -----\n");
     }
-    return;
+}
+
+void gnb_pf_inet_batch(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num) {
+    uint64_t latency_begin_ticks = pf_latency_begin(pf_core);
+    GNB_TRACE1(pf_inet_begin, num);
+    pf_inet_batch(gnb_core, pf_core, payload_vec, source_node_addr_vec, num);
+    GNB_TRACE1(pf_inet_end, num);
+    pf_latency_end(pf_core, GNB_LATENCY_STAGE_PF_INET, latency_begin_ticks, num);
+}
+
+void gnb_pf_inet(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *payload, gnb_sockaddress_t *source_node_addr){
+    gnb_pf_inet_batch(gnb_core, pf_core, &payload, &source_node_addr, 1);
 }
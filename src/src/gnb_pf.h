@@ -42,14 +42,23 @@ gnb_pf_inet:
 │                          │                        ├─   crypto segment        ─┤         │ 8byte │
 │                          │                        ├─  relay crypto segmen              ─┤       │
 └──────────────────────────┴────────────────────────┴─────────────────────────────────────┴───────┘
+
+relay cut-through 模式下 relay crypto segment 只包括 gnb route frame header 和 relay node id(不包括最后 8 byte),
+ip frame 只在 src node 用 dst node 的密钥加密一次, relay 节点转发时不处理 ip frame
 */
 
 #include <stdio.h>
 #include <stdint.h>
 
+#include "gnb_pf_status.h"
+
 typedef struct _gnb_core_t gnb_core_t;
 typedef struct _gnb_payload16_t gnb_payload16_t;
 typedef struct _gnb_node_t  gnb_node_t;
+typedef struct _gnb_node_counter_t gnb_node_counter_t;
+typedef struct _gnb_latency_histogram_t gnb_latency_histogram_t;
+typedef struct _gnb_pf_status_counter_t gnb_pf_status_counter_t;
+typedef struct _gnb_flight_recorder_t gnb_flight_recorder_t;
 typedef struct _gnb_sockaddress_t gnb_sockaddress_t;
 typedef struct _gnb_pf_ctx_t {
 	int pf_fwd;
@@ -88,6 +97,12 @@ typedef struct _gnb_pf_ctx_t {
 #define GNB_PF_DROP     0x02    //当前PF模块认为该数据分组应被丢弃
 #define GNB_PF_NOROUTE  0x03    //没有找到转发的节点
 
+//gnb route frame header 中 ttl 的偏移, relay cut-through 模式下 crypto 模块根据 ttl 得到 relay node id 的长度
+#define GNB_PF_ROUTE_FRAME_TTL_OFFSET 3
+
+//gnb route frame header 中 pf_type_bits 的偏移, relay 时 crypto 模块在这里标记 GNB_PF_BITS_RELAY_CUT_THROUGH
+#define GNB_PF_ROUTE_FRAME_PF_BITS_OFFSET 2
+
 #define GNB_PF_FWD_INIT 0x0
 #define GNB_PF_FWD_TUN  0x1
 #define GNB_PF_FWD_INET 0x2
@@ -97,6 +112,14 @@ typedef void(*gnb_pf_init_cb_t)(gnb_core_t *gnb_core, gnb_pf_t *pf);
 typedef void(*gnb_pf_conf_cb_t)(gnb_core_t *gnb_core, gnb_pf_t *pf);
 typedef int(*gnb_pf_chain_cb_t)(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx);
 typedef void(*gnb_pf_release_cb_t)(gnb_core_t *gnb_core, gnb_pf_t *pf);
+/*
+ 批量处理 num 个 packet, 每个 packet 的处理结果写入 pf_ctx_vec[i]->pf_status
+ pf 模块没有提供 batch call back 时, 由 gnb_pf.c 逐个调用对应的单个 packet 的 call back
+*/
+typedef void(*gnb_pf_batch_cb_t)(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num);
+
+//一次批量处理的 packet 的最大数量
+#define GNB_PF_BATCH_MAX 64
 
 typedef struct _gnb_pf_t {
 	const char *name;
@@ -143,6 +166,14 @@ typedef struct _gnb_pf_t {
     */
 	gnb_pf_chain_cb_t    pf_inet_fwd;
 
+	//可选的批量处理 call back, 与上面 6 个 call back 一一对应
+	gnb_pf_batch_cb_t    pf_tun_frame_batch;
+	gnb_pf_batch_cb_t    pf_tun_route_batch;
+	gnb_pf_batch_cb_t    pf_tun_fwd_batch;
+	gnb_pf_batch_cb_t    pf_inet_frame_batch;
+	gnb_pf_batch_cb_t    pf_inet_route_batch;
+	gnb_pf_batch_cb_t    pf_inet_fwd_batch;
+
 	gnb_pf_release_cb_t  pf_release;
 } gnb_pf_t;
 
@@ -152,6 +183,11 @@ typedef struct _gnb_pf_array_t {
 	gnb_pf_t *pf[0];
 }gnb_pf_array_t;
 
+typedef struct _gnb_pf_core_t gnb_pf_core_t;
+
+typedef void(*gnb_pf_tun_fast_path_t)(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num);
+typedef void(*gnb_pf_inet_fast_path_t)(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num);
+
 typedef struct _gnb_pf_core_t {
 	// pf_registered_array
 	gnb_pf_array_t *pf_install_array;
@@ -161,10 +197,22 @@ typedef struct _gnb_pf_core_t {
 	gnb_pf_array_t *pf_inet_frame_array;
 	gnb_pf_array_t *pf_inet_route_array;
 	gnb_pf_array_t *pf_inet_fwd_array;
+	//当前 worker 在 ctl_block counter_zone 中的 shard, 只由当前 worker 线程写入
+	gnb_node_counter_t *node_counter_shard;
+	//当前 worker 在 ctl_block latency_zone 中的 shard, 没有打开 latency_stats 时为 NULL
+	gnb_latency_histogram_t *latency_shard;
+	//当前 worker 在 ctl_block status_zone 中的 pf status 计数, 只由当前 worker 线程写入
+	gnb_pf_status_counter_t *pf_status_counter;
+	//当前 worker 在 ctl_block flight_zone 中的 recorder, flight_record_num 为 0 时为 NULL
+	gnb_flight_recorder_t *flight_recorder;
+	//常用 pf 组合的 fast path, 由 gnb_pf_core_conf 选择, 为 NULL 时使用通用的 pf chain
+	gnb_pf_tun_fast_path_t  pf_tun_fast_path;
+	gnb_pf_inet_fast_path_t pf_inet_fast_path;
+	gnb_pf_t *fast_path_route;
+	gnb_pf_t *fast_path_zip;
+	gnb_pf_t *fast_path_crypto;
 }gnb_pf_core_t;
 
-void gnb_pf_status_strings_init();
-
 gnb_pf_core_t* gnb_pf_core_init(gnb_heap_t *heap, int size);
 //初始化 call back 次序
 void gnb_pf_core_conf(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core);
@@ -174,5 +222,10 @@ void gnb_pf_init(gnb_core_t *gnb_core, gnb_pf_array_t *pf_array);
 void gnb_pf_conf(gnb_core_t *gnb_core, gnb_pf_array_t *pf_array);
 void gnb_pf_tun(gnb_core_t *gnb_core,  gnb_pf_core_t *pf_core, gnb_payload16_t *payload);
 void gnb_pf_inet(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *payload, gnb_sockaddress_t *source_node_addr);
+/*
+ 批量处理, 每个 stage 中一个 pf 模块依次处理所有 packet 之后再交给下一个 pf 模块
+*/
+void gnb_pf_tun_batch(gnb_core_t *gnb_core,  gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, int num);
+void gnb_pf_inet_batch(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t **payload_vec, gnb_sockaddress_t **source_node_addr_vec, int num);
 
 #endif
@@ -0,0 +1,65 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gnb_pf_status.h"
+
+/*
+ 每个状态都必须有名字, gnb_ctl 把它们作为 json 的 key 和 prometheus 的 label 输出
+*/
+const char * const gnb_pf_status_strings[] = {
+    [GNB_PF_TUN_FRAME_INIT]        = "TUN_FRAME_INIT",
+    [GNB_PF_TUN_FRAME_ERROR]       = "TUN_FRAME_ERROR",
+    [GNB_PF_TUN_FRAME_DROP]        = "TUN_FRAME_DROP",
+    [GNB_PF_TUN_FRAME_NEXT]        = "TUN_FRAME_NEXT",
+    [GNB_PF_TUN_FRAME_FINISH]      = "TUN_FRAME_FINISH",
+
+    [GNB_PF_TUN_ROUTE_INIT]        = "TUN_ROUTE_INIT",
+    [GNB_PF_TUN_ROUTE_ERROR]       = "TUN_ROUTE_ERROR",
+    [GNB_PF_TUN_ROUTE_DROP]        = "TUN_ROUTE_DROP",
+    [GNB_PF_TUN_ROUTE_NOROUTE]     = "TUN_ROUTE_NOROUTE",
+    [GNB_PF_TUN_ROUTE_NEXT]        = "TUN_ROUTE_NEXT",
+    [GNB_PF_TUN_ROUTE_FINISH]      = "TUN_ROUTE_FINISH",
+
+    [GNB_PF_TUN_FORWARD_INIT]      = "TUN_FORWARD_INIT",
+    [GNB_PF_TUN_FORWARD_ERROR]     = "TUN_FORWARD_ERROR",
+    [GNB_PF_TUN_FORWARD_NEXT]      = "TUN_FORWARD_NEXT",
+    [GNB_PF_TUN_FORWARD_FINISH]    = "TUN_FORWARD_FINISH",
+
+    [GNB_PF_INET_FRAME_INIT]       = "INET_FRAME_INIT",
+    [GNB_PF_INET_FRAME_ERROR]      = "INET_FRAME_ERROR",
+    [GNB_PF_INET_FRAME_NOROUTE]    = "INET_FRAME_NOROUTE",
+    [GNB_PF_INET_FRAME_DROP]       = "INET_FRAME_DROP",
+    [GNB_PF_INET_FRAME_NEXT]       = "INET_FRAME_NEXT",
+    [GNB_PF_INET_FRAME_FINISH]     = "INET_FRAME_FINISH",
+
+    [GNB_PF_INET_ROUTE_INIT]       = "INET_ROUTE_INIT",
+    [GNB_PF_INET_ROUTE_ERROR]      = "INET_ROUTE_ERROR",
+    [GNB_PF_INET_ROUTE_DROP]       = "INET_ROUTE_DROP",
+    [GNB_PF_INET_ROUTE_NOROUTE]    = "INET_ROUTE_NOROUTE",
+    [GNB_PF_INET_ROUTE_NEXT]       = "INET_ROUTE_NEXT",
+    [GNB_PF_INET_ROUTE_FINISH]     = "INET_ROUTE_FINISH",
+
+    [GNB_PF_INET_FORWARD_INIT]     = "INET_FORWARD_INIT",
+    [GNB_PF_INET_FORWARD_ERROR]    = "INET_FORWARD_ERROR",
+    [GNB_PF_INET_FORWARD_DROP]     = "INET_FORWARD_DROP",
+    [GNB_PF_INET_FORWARD_NEXT]     = "INET_FORWARD_NEXT",
+    [GNB_PF_INET_FORWARD_FINISH]   = "INET_FORWARD_FINISH",
+    [GNB_PF_INET_FORWARD_TO_TUN]   = "INET_FORWARD_TO_TUN",
+    [GNB_PF_INET_FORWARD_TO_INET]  = "INET_FORWARD_TO_INET",
+};
+
+_Static_assert(sizeof(gnb_pf_status_strings)/sizeof(gnb_pf_status_strings[0]) == GNB_PF_STATUS_NUM, "gnb_pf_status_strings must name every pf status");
@@ -0,0 +1,74 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_PF_STATUS_H
+#define GNB_PF_STATUS_H
+
+/*
+ gnb_pf_tun gnb_pf_inet 在各个 filter 阶段的处理结果,
+ node counter 按这些状态统计丢弃的分组, status_zone 按 worker 统计每个 packet 的最终结果,
+ gnb_ctl 也用 gnb_pf_status_strings 输出丢弃原因
+*/
+
+#define GNB_PF_TUN_FRAME_INIT        0
+#define GNB_PF_TUN_FRAME_ERROR       1
+#define GNB_PF_TUN_FRAME_DROP        2
+#define GNB_PF_TUN_FRAME_NEXT        3
+#define GNB_PF_TUN_FRAME_FINISH      4
+
+#define GNB_PF_TUN_ROUTE_INIT        5
+#define GNB_PF_TUN_ROUTE_ERROR       6
+#define GNB_PF_TUN_ROUTE_DROP        7
+#define GNB_PF_TUN_ROUTE_NOROUTE     8
+#define GNB_PF_TUN_ROUTE_NEXT        9
+#define GNB_PF_TUN_ROUTE_FINISH     10
+
+#define GNB_PF_TUN_FORWARD_INIT     11
+#define GNB_PF_TUN_FORWARD_ERROR    12
+#define GNB_PF_TUN_FORWARD_NEXT     13
+#define GNB_PF_TUN_FORWARD_FINISH   14
+
+
+#define GNB_PF_INET_FRAME_INIT      15
+#define GNB_PF_INET_FRAME_ERROR     16
+#define GNB_PF_INET_FRAME_NOROUTE   17
+#define GNB_PF_INET_FRAME_DROP      18
+#define GNB_PF_INET_FRAME_NEXT      19
+#define GNB_PF_INET_FRAME_FINISH    20
+
+
+#define GNB_PF_INET_ROUTE_INIT      21
+#define GNB_PF_INET_ROUTE_ERROR     22
+#define GNB_PF_INET_ROUTE_DROP      23
+#define GNB_PF_INET_ROUTE_NOROUTE   24
+
+#define GNB_PF_INET_ROUTE_NEXT      25
+#define GNB_PF_INET_ROUTE_FINISH    26
+
+#define GNB_PF_INET_FORWARD_INIT    27
+#define GNB_PF_INET_FORWARD_ERROR   28
+#define GNB_PF_INET_FORWARD_DROP    29
+#define GNB_PF_INET_FORWARD_NEXT    30
+#define GNB_PF_INET_FORWARD_FINISH  31
+#define GNB_PF_INET_FORWARD_TO_TUN  32
+#define GNB_PF_INET_FORWARD_TO_INET 33
+
+#define GNB_PF_STATUS_NUM           34
+
+extern const char * const gnb_pf_status_strings[];
+
+#endif
@@ -51,7 +51,7 @@
 #include <pthread.h>
 
 #include "gnb_node.h"
-#include "gnb_ring_buffer_fixed.h"
+#include "gnb_ring_buffer_var.h"
 #include "gnb_worker_queue_data.h"
 #include "gnb_ur1_frame_type.h"
 #include "gnb_time.h"
@@ -61,7 +61,7 @@
 void bind_socket_if(gnb_core_t *gnb_core);
 #endif
 
-gnb_pf_t* gnb_find_pf_mod_by_name(const char *name);
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name);
 
 typedef struct _pf_worker_ctx_t{
     gnb_core_t *gnb_core;
@@ -69,32 +69,81 @@ typedef struct _pf_worker_ctx_t{
     pthread_t thread_worker;
 }pf_worker_ctx_t;
 
+/*
+ 统计 packet 在 ring buffer 中等待的时间, 在一批 packet 都 pop 出来之后只读一次计数器
+*/
+static void record_queue_latency(gnb_pf_core_t *pf_core, int stage, gnb_worker_queue_data_t **queue_data_vec, int num) {
+    uint64_t now_ticks;
+    int i;
+    if ( NULL == pf_core->latency_shard ) {
+        return;
+    }
+    now_ticks = gnb_latency_now();
+    for ( i=0; i<num; i++ ) {
+        if ( 0 == queue_data_vec[i]->enqueue_ticks || queue_data_vec[i]->enqueue_ticks > now_ticks ) {
+            continue;
+        }
+        gnb_latency_record(&pf_core->latency_shard[stage], now_ticks - queue_data_vec[i]->enqueue_ticks, 1);
+    }
+}
+
+/*
+ 每次从 ring buffer 中取出最多 GNB_PF_BATCH_MAX 个 packet 批量交给 pf 处理,
+ 处理完之后再一次性释放 ring buffer 中的这些 block
+*/
 static void handle_queue(gnb_core_t *gnb_core, gnb_worker_t *pf_worker){
     int i;
+    int in_num;
+    int out_num;
+    int pbuf_num;
+    int j;
     pf_worker_ctx_t *pf_worker_ctx = pf_worker->ctx;
-    gnb_payload16_t *payload_from_tun;
     gnb_worker_queue_data_t *receive_queue_data;
     gnb_worker_queue_data_t *send_queue_data;
-    gnb_payload16_t *payload_from_inet;
-    gnb_sockaddress_t *node_addr;
-    int ret;
-    for ( i=0; i<1024; i++ ) {
-        receive_queue_data = gnb_ring_buffer_fixed_pop( pf_worker->ring_buffer_in );
-        if ( NULL != receive_queue_data ) {
-            payload_from_inet = &receive_queue_data->data.node_in.payload_st;
-            node_addr = &receive_queue_data->data.node_in.node_addr_st;
-            gnb_pf_inet(gnb_core, pf_worker_ctx->pf_core, payload_from_inet, node_addr);
-            gnb_ring_buffer_fixed_pop_submit( pf_worker->ring_buffer_in );
-            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "[%s] handle queue frome inet\n", pf_worker->name);
+    gnb_payload16_t   *payload_vec[GNB_PF_BATCH_MAX];
+    gnb_sockaddress_t *node_addr_vec[GNB_PF_BATCH_MAX];
+    gnb_pbuf_t        *pbuf_vec[GNB_PF_BATCH_MAX];
+    gnb_worker_queue_data_t *queue_data_vec[GNB_PF_BATCH_MAX];
+    for ( i=0; i<1024/GNB_PF_BATCH_MAX; i++ ) {
+        for ( in_num=0; in_num<GNB_PF_BATCH_MAX; in_num++ ) {
+            receive_queue_data = gnb_ring_buffer_var_pop( pf_worker->ring_buffer_var_in, NULL );
+            if ( NULL == receive_queue_data ) {
+                break;
+            }
+            payload_vec[in_num]    = &receive_queue_data->data.node_in.payload_st;
+            node_addr_vec[in_num]  = &receive_queue_data->data.node_in.node_addr_st;
+            queue_data_vec[in_num] = receive_queue_data;
+        }
+        if ( in_num > 0 ) {
+            record_queue_latency(pf_worker_ctx->pf_core, GNB_LATENCY_STAGE_RING_IN, queue_data_vec, in_num);
+            gnb_pf_inet_batch(gnb_core, pf_worker_ctx->pf_core, payload_vec, node_addr_vec, in_num);
+            gnb_ring_buffer_var_pop_submit( pf_worker->ring_buffer_var_in );
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "[%s] handle queue frome inet num=%d\n", pf_worker->name, in_num);
+        }
+        pbuf_num = 0;
+        for ( out_num=0; out_num<GNB_PF_BATCH_MAX; out_num++ ) {
+            send_queue_data = gnb_ring_buffer_var_pop( pf_worker->ring_buffer_var_out, NULL );
+            if ( NULL == send_queue_data ) {
+                break;
+            }
+            if ( GNB_WORKER_QUEUE_DATA_TYPE_PBUF_OUT == send_queue_data->type ) {
+                pbuf_vec[pbuf_num++] = send_queue_data->data.pbuf.pbuf;
+                payload_vec[out_num] = (gnb_payload16_t *)GNB_PBUF_DATA(send_queue_data->data.pbuf.pbuf);
+            } else {
+                payload_vec[out_num] = &send_queue_data->data.node_in.payload_st;
+            }
+            queue_data_vec[out_num] = send_queue_data;
         }
-        send_queue_data = gnb_ring_buffer_fixed_pop( pf_worker->ring_buffer_out );
-        if ( NULL != send_queue_data ) {
-            payload_from_tun = &send_queue_data->data.node_in.payload_st;
-            gnb_pf_tun(gnb_core, pf_worker_ctx->pf_core, payload_from_tun);
-            gnb_ring_buffer_fixed_pop_submit( pf_worker->ring_buffer_out );
-            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "[%s] handle queue frome tun\n", pf_worker->name);
+        if ( out_num > 0 ) {
+            record_queue_latency(pf_worker_ctx->pf_core, GNB_LATENCY_STAGE_RING_OUT, queue_data_vec, out_num);
+            gnb_pf_tun_batch(gnb_core, pf_worker_ctx->pf_core, payload_vec, out_num);
+            for ( j=0; j<pbuf_num; j++ ) {
+                gnb_pbuf_unref(pbuf_vec[j]);
+            }
+            gnb_ring_buffer_var_pop_submit( pf_worker->ring_buffer_var_out );
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "[%s] handle queue frome tun num=%d\n", pf_worker->name, out_num);
         }
-        if ( NULL == receive_queue_data && NULL == send_queue_data ) {
+        if ( 0 == in_num && 0 == out_num ) {
             break;
         }
     }
@@ -116,6 +165,13 @@ static void* thread_worker_func( void *data ) {
     return NULL;
 }
 
+static void* pf_worker_ring_alloc(gnb_core_t *gnb_core, size_t memory_size) {
+    if ( gnb_core->conf->hugepage ) {
+        return gnb_heap_alloc_hugepage(gnb_core->heap, memory_size);
+    }
+    return gnb_heap_alloc_aligned(gnb_core->heap, memory_size);
+}
+
 static void init(gnb_worker_t *gnb_worker, void *ctx) {
     gnb_core_t *gnb_core = (gnb_core_t *)ctx;
     pf_worker_ctx_t *pf_worker_ctx = (pf_worker_ctx_t *)gnb_heap_alloc(gnb_core->heap, sizeof(pf_worker_ctx_t));
@@ -124,17 +180,23 @@ static void init(gnb_worker_t *gnb_worker, void *ctx) {
     gnb_pf_t *pf;
     void *memory;
     size_t memory_size;
+    size_t max_block_size;
     memset(pf_worker_ctx, 0, sizeof(pf_worker_ctx_t));
     pf_worker_ctx->gnb_core = gnb_core;
     pf_worker_ctx->pf_core = gnb_pf_core_init(gnb_core->heap, 32);
     gnb_pf_core_t *pf_core = pf_worker_ctx->pf_core;
+    //shard 0 由 primary worker 使用
+    pf_core->node_counter_shard = gnb_ctl_block_counter_shard(gnb_core->ctl_block, 1 + gnb_core->pf_worker_ring->cur_idx);
+    pf_core->latency_shard      = gnb_ctl_block_latency_shard(gnb_core->ctl_block, 1 + gnb_core->pf_worker_ring->cur_idx);
+    pf_core->pf_status_counter  = gnb_ctl_block_pf_status_shard(gnb_core->ctl_block, 1 + gnb_core->pf_worker_ring->cur_idx);
+    pf_core->flight_recorder    = gnb_ctl_block_flight_shard(gnb_core->ctl_block, 1 + gnb_core->pf_worker_ring->cur_idx);
     if ( 1==gnb_core->conf->if_dump ) {
-        find_pf = gnb_find_pf_mod_by_name("gnb_pf_dump");
+        find_pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_dump");
         pf = (gnb_pf_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_pf_t));
         *pf = *find_pf;
         gnb_pf_install(pf_core->pf_install_array, pf);
     }
-    find_pf = gnb_find_pf_mod_by_name(gnb_core->conf->pf_route);
+    find_pf = gnb_find_pf_mod_by_name(gnb_core, gnb_core->conf->pf_route);
     if ( NULL == find_pf ) {
         GNB_ERROR1(gnb_core->log, GNB_LOG_ID_PF, "pf_route '%s' not exist\n", gnb_core->conf->pf_route);
         exit(1);
@@ -143,22 +205,28 @@ static void init(gnb_worker_t *gnb_worker, void *ctx) {
     *pf = *find_pf;
     gnb_pf_install(pf_core->pf_install_array, pf);
     if ( 0 != gnb_core->conf->zip_level ) {
-        find_pf = gnb_find_pf_mod_by_name("gnb_pf_zip");
+        find_pf = gnb_find_pf_mod_by_name(gnb_core, GNB_ZIP_TYPE_LZ4 == gnb_core->conf->zip_type ? "gnb_pf_lz4":"gnb_pf_zip");
         pf = (gnb_pf_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_pf_t));
         *pf = *find_pf;
         gnb_pf_install(pf_core->pf_install_array, pf);        
     }
+    if ( gnb_core->conf->header_zip ) {
+        find_pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_header_zip");
+        pf = (gnb_pf_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_pf_t));
+        *pf = *find_pf;
+        gnb_pf_install(pf_core->pf_install_array, pf);
+    }
     if ( !(GNB_PF_BITS_CRYPTO_XOR & gnb_core->conf->pf_bits) && !(GNB_PF_BITS_CRYPTO_ARC4 & gnb_core->conf->pf_bits) ) {
         goto skip_crypto;
     }
     if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_XOR ) {
-        find_pf = gnb_find_pf_mod_by_name("gnb_pf_crypto_xor");
+        find_pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_xor");
         pf = (gnb_pf_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_pf_t));
         *pf = *find_pf;
         gnb_pf_install(pf_worker_ctx->pf_core->pf_install_array, pf);
     }
     if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_ARC4 ) {
-        find_pf = gnb_find_pf_mod_by_name("gnb_pf_crypto_arc4");
+        find_pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_arc4");
         pf = (gnb_pf_t *)gnb_heap_alloc(gnb_core->heap, sizeof(gnb_pf_t));
         *pf = *find_pf;
         gnb_pf_install(pf_core->pf_install_array, pf);
@@ -174,12 +242,16 @@ skip_crypto:
     p = gnb_worker->name;
     gnb_worker->name = (char *)gnb_heap_alloc(gnb_core->heap, 16);
     snprintf(gnb_worker->name, 16, "%s_%d", p, gnb_core->pf_worker_ring->cur_idx);
-    memory_size = gnb_ring_buffer_fixed_sum_size(sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size, gnb_core->conf->pf_woker_in_queue_length);
-    memory = gnb_heap_alloc(gnb_core->heap, memory_size);
-    gnb_worker->ring_buffer_in = gnb_ring_buffer_fixed_init(memory, sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size, gnb_core->conf->pf_woker_in_queue_length);
-    memory_size = gnb_ring_buffer_fixed_sum_size(sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size, gnb_core->conf->pf_woker_out_queue_length);
-    memory = gnb_heap_alloc(gnb_core->heap, memory_size);
-    gnb_worker->ring_buffer_out = gnb_ring_buffer_fixed_init(memory, sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size, gnb_core->conf->pf_woker_out_queue_length);
+    //ring buffer 的容量按 packet 的平均长度计算, 每个 block 只占用 packet 的实际长度
+    max_block_size = GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE + sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size + GNB_WORKER_QUEUE_DATA_TAILROOM;
+    memory_size = gnb_ring_buffer_var_sum_size(((size_t)gnb_core->conf->pf_woker_in_queue_length + 1) * GNB_PF_WORKER_QUEUE_AVG_BLOCK_SIZE, max_block_size);
+    memory = pf_worker_ring_alloc(gnb_core, memory_size);
+    gnb_worker->ring_buffer_var_in = gnb_ring_buffer_var_init(memory, ((size_t)gnb_core->conf->pf_woker_in_queue_length + 1) * GNB_PF_WORKER_QUEUE_AVG_BLOCK_SIZE, max_block_size);
+    memory_size = gnb_ring_buffer_var_sum_size(((size_t)gnb_core->conf->pf_woker_out_queue_length + 1) * GNB_PF_WORKER_QUEUE_AVG_BLOCK_SIZE, max_block_size);
+    memory = pf_worker_ring_alloc(gnb_core, memory_size);
+    gnb_worker->ring_buffer_var_out = gnb_ring_buffer_var_init(memory, ((size_t)gnb_core->conf->pf_woker_out_queue_length + 1) * GNB_PF_WORKER_QUEUE_AVG_BLOCK_SIZE, max_block_size);
+    gnb_worker->ring_buffer_in  = NULL;
+    gnb_worker->ring_buffer_out = NULL;
     gnb_worker->ctx = pf_worker_ctx;
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s init finish\n", gnb_worker->name);
 }
@@ -53,18 +53,47 @@
 #include "gnb_node.h"
 
 #include "gnb_ring_buffer_fixed.h"
+#include "gnb_ring_buffer_var.h"
 #include "gnb_worker_queue_data.h"
 #include "gnb_ur1_frame_type.h"
 #include "gnb_time.h"
 #include "gnb_udp.h"
 #include "gnb_binary.h"
 #include "crypto/xor/xor.h"
+#include "gnb_trace.h"
 
 #ifdef __UNIX_LIKE_OS__
 void bind_socket_if(gnb_core_t *gnb_core);
 #endif
 
-gnb_pf_t* gnb_find_pf_mod_by_name(const char *name);
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name);
+
+#if defined(__UNIX_LIKE_OS__) && defined(SO_REUSEPORT)
+#define GNB_PEER_SOCKET_ENABLE 1
+#endif
+
+#ifdef GNB_PEER_SOCKET_ENABLE
+
+#define GNB_MAX_PEER_SOCKET 256
+
+/*
+ --peer-socket on 时为每个 P2P 通信中的节点打开一个 connect 到该节点地址的 udp socket,
+ 它和监听 socket 通过 SO_REUSEPORT 绑定同一个本地端口, 内核按源地址把这个节点发来的 udp 分组投递到该 socket,
+ 发送时用 send() 代替 sendto(), 省去每个分组的路由查找
+ peer socket 只在 primary worker 的线程中创建和关闭, 其他线程只读取 node->peer_socket4 node->peer_socket6
+*/
+typedef struct _gnb_peer_socket_t {
+    gnb_node_t *node;
+    int sockfd;
+    int af;
+    uint8_t socket_idx;
+    union {
+        struct sockaddr_in  in;
+        struct sockaddr_in6 in6;
+    } addr;
+} gnb_peer_socket_t;
+
+#endif
 
 typedef struct _primary_worker_ctx_t{
     gnb_core_t *gnb_core;
@@ -74,6 +103,15 @@ typedef struct _primary_worker_ctx_t{
     pthread_t tun_udp_loop_thread;
 #endif
 
+#ifdef GNB_PEER_SOCKET_ENABLE
+    gnb_peer_socket_t peer_sockets[GNB_MAX_PEER_SOCKET];
+    int peer_socket_num;
+    //已经从 node 上摘下的 socket, 发送线程可能还持有它, 到下一次检查时再关闭
+    int closing_sockets[GNB_MAX_PEER_SOCKET];
+    int closing_socket_num;
+    uint64_t peer_socket_check_sec;
+#endif
+
 #ifdef _WIN32
     pthread_t tun_loop_thread;
     pthread_t udp_loop_thread;
@@ -102,9 +140,25 @@ gnb_worker_t * select_pf_worker(gnb_core_t *gnb_core){
     return pf_worker;
 }
 
+/*
+ payload 前面有没有足够的 headroom 写入 UR0 首部:
+ 来自 pbuf 的 payload 有 GNB_PBUF_HEADROOM, gnb_core->tun_payload 前面有 GNB_PAYLOAD_BUFFER_PADDING_SIZE
+*/
+static int ur0_headroom_available(gnb_core_t *gnb_core, gnb_payload16_t *payload) {
+    gnb_pbuf_t *pbuf;
+    if ( payload == gnb_core->tun_payload ) {
+        return 1;
+    }
+    pbuf = gnb_pbuf_pool_find(gnb_core->pbuf_pool, payload);
+    if ( NULL != pbuf && (unsigned char *)payload - pbuf->buffer >= GNB_PAYLOAD16_HEAD_SIZE + sizeof(gnb_ur0_frame_head_t) ) {
+        return 1;
+    }
+    return 0;
+}
+
 void gnb_send_ur0_frame(gnb_core_t *gnb_core, gnb_node_t *dst_node, gnb_payload16_t *payload) {
-    unsigned char buffer[gnb_core->conf->payload_block_size];
-    gnb_payload16_t *fwd_payload = (gnb_payload16_t *)buffer;
+    unsigned char head_buffer[GNB_PAYLOAD16_HEAD_SIZE + sizeof(gnb_ur0_frame_head_t)];
+    gnb_payload16_t *fwd_payload;
     gnb_address_t *dst_address = gnb_select_available_address4(gnb_core, dst_node);
     gnb_address_t node_address_st;
     if( NULL == dst_address ) {
@@ -119,15 +173,24 @@ void gnb_send_ur0_frame(gnb_core_t *gnb_core, gnb_node_t *dst_node, gnb_payload1
         return;
     }
     gnb_address_t *fwd_address = &gnb_core->fwdu0_address_ring.address_list->array[0];
+    uint16_t payload_size = gnb_payload16_size(payload);
+    //headroom 足够时直接把 UR0 首部写在 payload 前面, 否则用 sendmsg 把 UR0 首部和 payload 一起发送, 都不需要拷贝 payload
+    if ( ur0_headroom_available(gnb_core, payload) ) {
+        fwd_payload = (gnb_payload16_t *)((unsigned char *)payload - sizeof(head_buffer));
+    } else {
+        fwd_payload = (gnb_payload16_t *)head_buffer;
+    }
     gnb_ur0_frame_head_t *ur0_frame_head = (gnb_ur0_frame_head_t *)fwd_payload->data;
     fwd_payload->type = GNB_PAYLOAD_TYPE_UR0;
     memcpy(ur0_frame_head->dst_addr4, &dst_address->m_address4, 4);
     ur0_frame_head->dst_port4 = dst_address->port;
     memcpy(ur0_frame_head->passcode, gnb_core->conf->crypto_passcode, 4);
-    uint16_t payload_size = gnb_payload16_size(payload);
-    memcpy(fwd_payload->data + sizeof(gnb_ur0_frame_head_t), payload, payload_size);
     gnb_payload16_set_data_len(fwd_payload, sizeof(gnb_ur0_frame_head_t) + payload_size);
-    gnb_send_to_address(gnb_core, fwd_address, fwd_payload);
+    if ( (unsigned char *)fwd_payload == head_buffer ) {
+        gnb_send_to_address_with_head(gnb_core, fwd_address, head_buffer, sizeof(head_buffer), payload, payload_size);
+    } else {
+        gnb_send_to_address(gnb_core, fwd_address, fwd_payload);
+    }
     if ( 1==gnb_core->conf->if_dump ) {
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "send ur0 local =>[%s]=>dst_addr[%s:%d]\n", GNB_IP_PORT_STR1(fwd_address), GNB_ADDR4STR2(ur0_frame_head->dst_addr4), ntohs(ur0_frame_head->dst_port4));
     }
@@ -312,7 +375,7 @@ static gnb_worker_queue_data_t* make_worker_receive_queue_data(gnb_worker_t *wor
 }
 
 static gnb_worker_queue_data_t* make_worker_send_queue_data(gnb_worker_t *worker, gnb_payload16_t *payload) {
-    gnb_worker_queue_data_t *send_queue_data = (gnb_worker_queue_data_t *)gnb_ring_buffer_fixed_push(worker->ring_buffer_out);
+    gnb_worker_queue_data_t *send_queue_data = (gnb_worker_queue_data_t *)gnb_ring_buffer_var_push(worker->ring_buffer_var_out, GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE + gnb_payload16_size(payload) + GNB_WORKER_QUEUE_DATA_TAILROOM);
     if ( NULL == send_queue_data ) {
         return NULL;
     }
@@ -321,7 +384,79 @@ static gnb_worker_queue_data_t* make_worker_send_queue_data(gnb_worker_t *worker
     return send_queue_data;
 }
 
-static void handle_udp(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, uint8_t socket_idx, int af) {
+/*
+ 把 ip frame 以外的 payload 交给对应的 worker 处理
+*/
+static void dispatch_udp_payload(gnb_core_t *gnb_core, gnb_payload16_t *inet_payload, gnb_sockaddress_t *node_addr, uint8_t socket_idx) {
+    gnb_worker_queue_data_t *receive_queue_data;
+    //收到 index 类型的paload 就放到 index_worker 或 index_service_worker queue 中
+    if( GNB_PAYLOAD_TYPE_INDEX == inet_payload->type ) {
+        switch ( inet_payload->sub_type ) {
+        case PAYLOAD_SUB_TYPE_POST_ADDR    :
+        case PAYLOAD_SUB_TYPE_REQUEST_ADDR :
+				if ( 0 == gnb_core->conf->activate_index_service_worker ) {
+                    return;
+                }
+                receive_queue_data = make_worker_receive_queue_data(gnb_core->index_service_worker, node_addr, socket_idx, inet_payload);
+                if ( NULL == receive_queue_data ) {
+                    //ringbuffer is full
+                    GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp index_service_worker ringbuffer is full!\n");
+                    gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_INDEX_SERVICE_RING_FULL]++;
+                    return;
+                }
+                gnb_ring_buffer_fixed_push_submit(gnb_core->index_service_worker->ring_buffer_in);
+                gnb_core->index_service_worker->notify(gnb_core->index_service_worker);
+             break;
+
+        case PAYLOAD_SUB_TYPE_ECHO_ADDR    :
+        case PAYLOAD_SUB_TYPE_PUSH_ADDR    :
+        case PAYLOAD_SUB_TYPE_DETECT_ADDR  :
+                if ( 0 == gnb_core->conf->activate_index_worker ) {
+                    return;
+                }
+                receive_queue_data = make_worker_receive_queue_data(gnb_core->index_worker, node_addr, socket_idx, inet_payload);
+                if ( NULL == receive_queue_data ) {
+                    //ringbuffer is full
+                    GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp index_worker ringbuffer is full!\n");
+                    gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_INDEX_RING_FULL]++;
+                    return;
+                }
+                gnb_ring_buffer_fixed_push_submit(gnb_core->index_worker->ring_buffer_in);
+                gnb_core->index_worker->notify(gnb_core->index_worker);
+            break;
+        default :
+            break;
+        }
+        return;
+    }
+
+    //收到 node 类型的paload 就放到 node_worker queue 中
+    if ( GNB_PAYLOAD_TYPE_NODE == inet_payload->type ) {
+        if ( 0 == gnb_core->conf->activate_node_worker ) {
+            return;
+        }
+        receive_queue_data = make_worker_receive_queue_data(gnb_core->node_worker, node_addr, socket_idx, inet_payload);
+        if ( NULL == receive_queue_data ) {
+            //ringbuffer is full
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp node_worker ringbuffer is full!\n");
+            gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_NODE_RING_FULL]++;
+            return;
+        }
+        gnb_ring_buffer_fixed_push_submit(gnb_core->node_worker->ring_buffer_in);
+        gnb_core->node_worker->notify(gnb_core->node_worker);
+        return;
+    }
+    if ( GNB_PAYLOAD_TYPE_UR1 == inet_payload->type && 1 == gnb_core->conf->universal_relay1 ) {
+        handle_ur1_frame(gnb_core, inet_payload, node_addr);
+        return;
+    }
+    if ( GNB_PAYLOAD_TYPE_UR0 == inet_payload->type && 1 == gnb_core->conf->universal_relay0 ) {
+        handle_ur0_frame(gnb_core, inet_payload, node_addr);
+        return;
+    }
+}
+
+static void handle_udp(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, int sockfd, uint8_t socket_idx, int af) {
     ssize_t n_recv;
     uint16_t payload_size;
     gnb_sockaddress_t node_addr_st;
@@ -336,8 +471,10 @@ static void handle_udp(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, uint8_t soc
         inet_payload = gnb_core->inet_payload;
     } else {
         pf_worker = select_pf_worker(gnb_core);
-        receive_queue_data = (gnb_worker_queue_data_t *)gnb_ring_buffer_fixed_push(pf_worker->ring_buffer_in);
+        //还不知道 packet 的长度,先按最大长度预留, submit 时只占用实际长度
+        receive_queue_data = (gnb_worker_queue_data_t *)gnb_ring_buffer_var_push(pf_worker->ring_buffer_var_in, GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE + sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size + GNB_WORKER_QUEUE_DATA_TAILROOM);
         if ( NULL == receive_queue_data ) {
+            gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_PF_IN_RING_FULL]++;
             return;
         }
         inet_payload = &receive_queue_data->data.node_in.payload_st;
@@ -348,12 +485,12 @@ skip_tun:
     switch (af) {
         case AF_INET6:
             node_addr_st.socklen = sizeof(struct sockaddr_in6);
-            n_recv = recvfrom(gnb_core->udp_ipv6_sockets[socket_idx], (void *)inet_payload, gnb_core->conf->payload_block_size, 0, (struct sockaddr *)&node_addr_st.addr.in6, &node_addr_st.socklen);
+            n_recv = recvfrom(sockfd, (void *)inet_payload, gnb_core->conf->payload_block_size, 0, (struct sockaddr *)&node_addr_st.addr.in6, &node_addr_st.socklen);
             node_addr_st.addr_type = AF_INET6;
             break;
         case AF_INET:
             node_addr_st.socklen = sizeof(struct sockaddr_in);
-            n_recv = recvfrom(gnb_core->udp_ipv4_sockets[socket_idx], (void *)inet_payload, gnb_core->conf->payload_block_size, 0, (struct sockaddr *)&node_addr_st.addr.in, &node_addr_st.socklen);
+            n_recv = recvfrom(sockfd, (void *)inet_payload, gnb_core->conf->payload_block_size, 0, (struct sockaddr *)&node_addr_st.addr.in, &node_addr_st.socklen);
             node_addr_st.addr_type = AF_INET;
             break;
         default:
@@ -364,13 +501,16 @@ skip_tun:
     if ( n_recv <= 0 ) {
         goto finish;
     }
+    GNB_TRACE3(udp_recv, af, n_recv, inet_payload->type);
     if ( 1 == gnb_core->conf->if_dump ) {
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_CORE, "Payload INET in buffer[%s..]\n", GNB_HEX2_BYTE256((void *)inet_payload));
     }
     node_addr_st.protocol = SOCK_DGRAM;
     payload_size = gnb_payload16_size(inet_payload);
     if ( payload_size != n_recv ) {
+        GNB_TRACE2(udp_invalid, n_recv, payload_size);
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp n_recv=%lu payload_size=%u payload invalid!\n", n_recv, payload_size);
+        gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_UDP_PAYLOAD_INVALID]++;
         goto finish;
     }
     if ( 1 == gnb_core->conf->activate_tun && GNB_PAYLOAD_TYPE_IPFRAME == inet_payload->type ) {
@@ -378,88 +518,86 @@ skip_tun:
             gnb_pf_inet(gnb_core, pf_core, inet_payload, &node_addr_st);
         } else {
             receive_queue_data->type = GNB_WORKER_QUEUE_DATA_TYPE_NODE_IN;
+            receive_queue_data->enqueue_ticks = NULL != pf_core->latency_shard ? gnb_latency_now() : 0;
             memcpy(&receive_queue_data->data.node_in.node_addr_st, &node_addr_st, sizeof(gnb_sockaddress_t));
             receive_queue_data->data.node_in.socket_idx = socket_idx;
-            gnb_ring_buffer_fixed_push_submit(pf_worker->ring_buffer_in);
+            gnb_ring_buffer_var_push_submit(pf_worker->ring_buffer_var_in, GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE + payload_size + GNB_WORKER_QUEUE_DATA_TAILROOM);
             pf_worker->notify(pf_worker);
         }
         goto finish;
     }
-    //收到 index 类型的paload 就放到 index_worker 或 index_service_worker queue 中
-    if( GNB_PAYLOAD_TYPE_INDEX == inet_payload->type ) {
-        switch ( inet_payload->sub_type ) {
-        case PAYLOAD_SUB_TYPE_POST_ADDR    :
-        case PAYLOAD_SUB_TYPE_REQUEST_ADDR :
-				if ( 0 == gnb_core->conf->activate_index_service_worker ) {
-                    goto finish;
-                }
-                receive_queue_data = make_worker_receive_queue_data(gnb_core->index_service_worker, &node_addr_st, socket_idx, inet_payload);
-                if ( NULL == receive_queue_data ) {
-                    //ringbuffer is full
-                    GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp index_service_worker ringbuffer is full!\n");
-                    goto finish;
-                }
-                gnb_ring_buffer_fixed_push_submit(gnb_core->index_service_worker->ring_buffer_in);
-                gnb_core->index_service_worker->notify(gnb_core->index_service_worker);
-             break;
+    dispatch_udp_payload(gnb_core, inet_payload, &node_addr_st, socket_idx);
+finish:
+    return;
+}
 
-        case PAYLOAD_SUB_TYPE_ECHO_ADDR    :
-        case PAYLOAD_SUB_TYPE_PUSH_ADDR    :
-        case PAYLOAD_SUB_TYPE_DETECT_ADDR  :
-                if ( 0 == gnb_core->conf->activate_index_worker ) {
-                    goto finish;
-                }
-                receive_queue_data = make_worker_receive_queue_data(gnb_core->index_worker, &node_addr_st, socket_idx, inet_payload);
-                if ( NULL == receive_queue_data ) {
-                    //ringbuffer is full
-                    GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp index_worker ringbuffer is full!\n");
-                    goto finish;
-                }
-                gnb_ring_buffer_fixed_push_submit(gnb_core->index_worker->ring_buffer_in);
-                gnb_core->index_worker->notify(gnb_core->index_worker);
-            break;
-        default :
-            break;
-        }
-        goto finish;
+/*
+ 处理一个已经收到的 udp payload, 与 handle_udp 在 recvfrom 之后的处理相同, 没有 pf worker 时 ip frame 直接交给 pf_core
+ gnb_sim 用它把虚拟网络中到达的 udp 分组交给 gnb core
+*/
+void gnb_primary_worker_handle_payload(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core, gnb_payload16_t *inet_payload, gnb_sockaddress_t *node_addr, uint8_t socket_idx) {
+    if ( 1 == gnb_core->conf->activate_tun && GNB_PAYLOAD_TYPE_IPFRAME == inet_payload->type ) {
+        gnb_pf_inet(gnb_core, pf_core, inet_payload, node_addr);
+        return;
     }
+    dispatch_udp_payload(gnb_core, inet_payload, node_addr, socket_idx);
+}
 
-    //收到 node 类型的paload 就放到 node_worker queue 中
-    if ( GNB_PAYLOAD_TYPE_NODE == inet_payload->type ) {
-        if ( 0 == gnb_core->conf->activate_node_worker ) {
-            goto finish;
-        }
-        receive_queue_data = make_worker_receive_queue_data(gnb_core->node_worker, &node_addr_st, socket_idx, inet_payload);
-        if ( NULL == receive_queue_data ) {
-            //ringbuffer is full
-            GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "handle_udp node_worker ringbuffer is full!\n");
-            goto finish;
-        }
-        gnb_ring_buffer_fixed_push_submit(gnb_core->node_worker->ring_buffer_in);
-        gnb_core->node_worker->notify(gnb_core->node_worker);
+/*
+ 有 pf worker 时 packet 直接读入 pbuf, ring buffer 中只传递 pbuf 的指针
+*/
+static ssize_t handle_tun_pbuf(gnb_core_t *gnb_core, gnb_pbuf_t *pbuf) {
+    ssize_t rlen;
+    gnb_worker_t *pf_worker;
+    gnb_worker_queue_data_t *send_queue_data;
+    gnb_payload16_t *tun_payload = (gnb_payload16_t *)GNB_PBUF_DATA(pbuf);
+    rlen = gnb_core->drv->read_tun(gnb_core, tun_payload->data + gnb_core->tun_payload_offset, GNB_PBUF_ROOM(pbuf) - GNB_PAYLOAD16_HEAD_SIZE - gnb_core->tun_payload_offset - GNB_PBUF_TAILROOM);
+    if ( rlen<=0 ) {
         goto finish;
     }
-    if ( GNB_PAYLOAD_TYPE_UR1 == inet_payload->type && 1 == gnb_core->conf->universal_relay1 ) {
-        handle_ur1_frame(gnb_core, inet_payload, &node_addr_st);
-        goto finish;
+    GNB_TRACE1(tun_read, rlen);
+    if ( 1 == gnb_core->conf->if_dump ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_CORE, "Payload TUN out buffer[%s..]\n", GNB_HEX2_BYTE128((void *)(tun_payload->data + gnb_core->tun_payload_offset)));
     }
-    if ( GNB_PAYLOAD_TYPE_UR0 == inet_payload->type && 1 == gnb_core->conf->universal_relay0 ) {
-        handle_ur0_frame(gnb_core, inet_payload, &node_addr_st);
+    gnb_payload16_set_size(tun_payload, GNB_PAYLOAD16_HEAD_SIZE + gnb_core->tun_payload_offset + rlen);
+    pbuf->len = gnb_payload16_size(tun_payload);
+    pf_worker = select_pf_worker(gnb_core);
+    send_queue_data = (gnb_worker_queue_data_t *)gnb_ring_buffer_var_push(pf_worker->ring_buffer_var_out, GNB_WORKER_QUEUE_DATA_PBUF_SIZE);
+    if ( NULL == send_queue_data ) {
+        //ringbuffer is full
+        gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_PF_OUT_RING_FULL]++;
         goto finish;
     }
+    send_queue_data->type = GNB_WORKER_QUEUE_DATA_TYPE_PBUF_OUT;
+    send_queue_data->enqueue_ticks = NULL != gnb_core->ctl_block->latency_zone ? gnb_latency_now() : 0;
+    send_queue_data->data.pbuf.pbuf = pbuf;
+    gnb_ring_buffer_var_push_submit(pf_worker->ring_buffer_var_out, GNB_WORKER_QUEUE_DATA_PBUF_SIZE);
+    pf_worker->notify(pf_worker);
+    return rlen;
 finish:
-    return;
+    gnb_pbuf_unref(pbuf);
+    return rlen;
 }
 
 static ssize_t handle_tun(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
     ssize_t rlen;
     gnb_worker_t *pf_worker;
     gnb_worker_queue_data_t *send_queue_data;
+    gnb_pbuf_t *pbuf;
+    if ( NULL != gnb_core->pbuf_pool ) {
+        pbuf = gnb_pbuf_alloc(gnb_core->pbuf_pool);
+        //pbuf 用完时退回到把 payload 拷贝进 ring buffer 的方式
+        if ( NULL != pbuf ) {
+            return handle_tun_pbuf(gnb_core, pbuf);
+        }
+        gnb_core->ctl_block->status_zone->pbuf_exhausted_num++;
+    }
     //tun模式下这里得到的payload是ip分组, tap模式下是以太网分组,现在都是tun模式
     rlen = gnb_core->drv->read_tun(gnb_core, gnb_core->tun_payload->data + gnb_core->tun_payload_offset, gnb_core->conf->payload_block_size);
     if ( rlen<=0 ) {
         goto finish;
     }
+    GNB_TRACE1(tun_read, rlen);
     if ( 1 == gnb_core->conf->if_dump ) {
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_CORE, "Payload TUN out buffer[%s..]\n", GNB_HEX2_BYTE128((void *)(gnb_core->tun_payload->data + gnb_core->tun_payload_offset)));
     }
@@ -471,9 +609,11 @@ static ssize_t handle_tun(gnb_core_t *gnb_core, gnb_pf_core_t *pf_core) {
         send_queue_data = make_worker_send_queue_data(pf_worker, gnb_core->tun_payload);
         if ( NULL == send_queue_data ) {
             //ringbuffer is full
+            gnb_core->ctl_block->status_zone->drop_num[GNB_CTL_DROP_PF_OUT_RING_FULL]++;
             goto finish;
         }
-        gnb_ring_buffer_fixed_push_submit(pf_worker->ring_buffer_out);
+        send_queue_data->enqueue_ticks = NULL != pf_core->latency_shard ? gnb_latency_now() : 0;
+        gnb_ring_buffer_var_push_submit(pf_worker->ring_buffer_var_out, GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE + gnb_payload16_size(gnb_core->tun_payload) + GNB_WORKER_QUEUE_DATA_TAILROOM);
         pf_worker->notify(pf_worker);
     }
 
@@ -481,6 +621,134 @@ finish:
     return rlen;
 }
 
+#ifdef GNB_PEER_SOCKET_ENABLE
+static int open_peer_socket(gnb_core_t *gnb_core, gnb_peer_socket_t *peer_socket) {
+    int on = 1;
+    int ret;
+    peer_socket->sockfd = socket(peer_socket->af, SOCK_DGRAM, 0);
+    if ( -1 == peer_socket->sockfd ) {
+        return -1;
+    }
+    setsockopt(peer_socket->sockfd, SOL_SOCKET, SO_REUSEADDR, (char *)&on, sizeof(on));
+    setsockopt(peer_socket->sockfd, SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on));
+    #ifdef SO_BINDTODEVICE
+    if ( '\0' != gnb_core->conf->socket_ifname[0] ) {
+        setsockopt(peer_socket->sockfd, SOL_SOCKET, SO_BINDTODEVICE, gnb_core->conf->socket_ifname, strlen(gnb_core->conf->socket_ifname));
+    }
+    #endif
+    if ( AF_INET6 == peer_socket->af ) {
+        ret = gnb_bind_udp_socket_ipv6(peer_socket->sockfd, gnb_core->conf->listen_address6_string, gnb_core->conf->udp6_ports[peer_socket->socket_idx]);
+        if ( 0 == ret ) {
+            ret = connect(peer_socket->sockfd, (struct sockaddr *)&peer_socket->addr.in6, sizeof(struct sockaddr_in6));
+        }
+    } else {
+        ret = gnb_bind_udp_socket_ipv4(peer_socket->sockfd, gnb_core->conf->listen_address4_string, gnb_core->conf->udp4_ports[peer_socket->socket_idx]);
+        if ( 0 == ret ) {
+            ret = connect(peer_socket->sockfd, (struct sockaddr *)&peer_socket->addr.in, sizeof(struct sockaddr_in));
+        }
+    }
+    if ( 0 != ret ) {
+        close(peer_socket->sockfd);
+        peer_socket->sockfd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ node 的 P2P 地址或使用的本地端口变化后, 旧的 socket 就不再有效
+*/
+static int peer_socket_available(gnb_peer_socket_t *peer_socket) {
+    gnb_node_t *node = peer_socket->node;
+    if ( AF_INET6 == peer_socket->af ) {
+        return (node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) && peer_socket->socket_idx == node->socket6_idx &&
+               peer_socket->addr.in6.sin6_port == node->udp_sockaddr6.sin6_port &&
+               0 == memcmp(&peer_socket->addr.in6.sin6_addr, &node->udp_sockaddr6.sin6_addr, sizeof(struct in6_addr));
+    }
+    return (node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) && peer_socket->socket_idx == node->socket4_idx &&
+           peer_socket->addr.in.sin_port == node->udp_sockaddr4.sin_port &&
+           peer_socket->addr.in.sin_addr.s_addr == node->udp_sockaddr4.sin_addr.s_addr;
+}
+
+static void add_peer_socket(primary_worker_ctx_t *primary_worker_ctx, gnb_node_t *node, int af) {
+    gnb_core_t *gnb_core = primary_worker_ctx->gnb_core;
+    gnb_peer_socket_t *peer_socket;
+    if ( primary_worker_ctx->peer_socket_num >= GNB_MAX_PEER_SOCKET ) {
+        return;
+    }
+    peer_socket = &primary_worker_ctx->peer_sockets[primary_worker_ctx->peer_socket_num];
+    peer_socket->node = node;
+    peer_socket->af   = af;
+    if ( AF_INET6 == af ) {
+        peer_socket->socket_idx = node->socket6_idx;
+        peer_socket->addr.in6   = node->udp_sockaddr6;
+    } else {
+        peer_socket->socket_idx = node->socket4_idx;
+        peer_socket->addr.in    = node->udp_sockaddr4;
+    }
+    if ( 0 != open_peer_socket(gnb_core, peer_socket) ) {
+        return;
+    }
+    if ( AF_INET6 == af ) {
+        __atomic_store_n(&node->peer_socket6, peer_socket->sockfd, __ATOMIC_RELEASE);
+    } else {
+        __atomic_store_n(&node->peer_socket4, peer_socket->sockfd, __ATOMIC_RELEASE);
+    }
+    primary_worker_ctx->peer_socket_num++;
+    GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "open peer socket[%d] node[%llu] af=%d\n", peer_socket->sockfd, node->uuid64, af);
+}
+
+/*
+ 每秒检查一次, 为新出现的 P2P 节点打开 peer socket, 关闭失效的 peer socket
+*/
+static void update_peer_sockets(primary_worker_ctx_t *primary_worker_ctx) {
+    gnb_core_t *gnb_core = primary_worker_ctx->gnb_core;
+    gnb_peer_socket_t *peer_socket;
+    gnb_node_t *node;
+    size_t num;
+    int i;
+    if ( primary_worker_ctx->peer_socket_check_sec == gnb_core->now_time_sec ) {
+        return;
+    }
+    primary_worker_ctx->peer_socket_check_sec = gnb_core->now_time_sec;
+    for ( i=0; i<primary_worker_ctx->closing_socket_num; i++ ) {
+        close(primary_worker_ctx->closing_sockets[i]);
+    }
+    primary_worker_ctx->closing_socket_num = 0;
+    for ( i=0; i<primary_worker_ctx->peer_socket_num; ) {
+        peer_socket = &primary_worker_ctx->peer_sockets[i];
+        if ( peer_socket_available(peer_socket) ) {
+            i++;
+            continue;
+        }
+        if ( AF_INET6 == peer_socket->af ) {
+            __atomic_store_n(&peer_socket->node->peer_socket6, -1, __ATOMIC_RELEASE);
+        } else {
+            __atomic_store_n(&peer_socket->node->peer_socket4, -1, __ATOMIC_RELEASE);
+        }
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "close peer socket[%d] node[%llu]\n", peer_socket->sockfd, peer_socket->node->uuid64);
+        primary_worker_ctx->closing_sockets[primary_worker_ctx->closing_socket_num++] = peer_socket->sockfd;
+        primary_worker_ctx->peer_socket_num--;
+        *peer_socket = primary_worker_ctx->peer_sockets[primary_worker_ctx->peer_socket_num];
+    }
+    num = gnb_core->ctl_block->node_zone->node_num;
+    for ( i=0; i<num; i++ ) {
+        node = &gnb_core->ctl_block->node_zone->node[i];
+        if ( gnb_core->local_node == node ) {
+            continue;
+        }
+        if ( -1 == node->peer_socket6 && (gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV6) &&
+             (node->udp_addr_status & GNB_NODE_STATUS_IPV6_PONG) && memcmp(&node->udp_sockaddr6.sin6_addr, &in6addr_any, sizeof(struct in6_addr)) ) {
+            add_peer_socket(primary_worker_ctx, node, AF_INET6);
+        }
+        if ( -1 == node->peer_socket4 && (gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV4) &&
+             (node->udp_addr_status & GNB_NODE_STATUS_IPV4_PONG) && INADDR_ANY != node->udp_sockaddr4.sin_addr.s_addr ) {
+            add_peer_socket(primary_worker_ctx, node, AF_INET);
+        }
+    }
+}
+#endif
+
 #ifdef _WIN32
 static void* tun_loop_thread_func( void *data ) {
     gnb_worker_t *gnb_worker = (gnb_worker_t *)data;
@@ -558,14 +826,14 @@ static void* udp_loop_thread_func( void *data ) {
         if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV6 ) {
             for ( i=0; i<gnb_core->conf->udp6_socket_num; i++ ) {
                 if ( FD_ISSET( gnb_core->udp_ipv6_sockets[i], &readfds ) ) {
-                    handle_udp(gnb_core, pf_core, i, AF_INET6);
+                    handle_udp(gnb_core, pf_core, gnb_core->udp_ipv6_sockets[i], i, AF_INET6);
                 }
             }
         }
         if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV4 ) {
             for ( i=0; i<gnb_core->conf->udp4_socket_num; i++ ) {
                 if ( FD_ISSET( gnb_core->udp_ipv4_sockets[i], &readfds ) ) {
-                    handle_udp(gnb_core, pf_core, i, AF_INET);
+                    handle_udp(gnb_core, pf_core, gnb_core->udp_ipv4_sockets[i], i, AF_INET);
                 }
             }
         }
@@ -629,11 +897,24 @@ static void* tun_udp_loop_thread_func(void *data) {
     gnb_worker->thread_worker_run_flag = 1;
     static unsigned long c = 0;
     GNB_LOG1(gnb_core->log, GNB_LOG_ID_MAIN_WORKER, "start %s success!\n", gnb_worker->name);
+    int loop_maxfd;
     while ( gnb_core->loop_flag ) {
         readfds = allset;
+        loop_maxfd = maxfd;
+        #ifdef GNB_PEER_SOCKET_ENABLE
+        if ( gnb_core->conf->peer_socket ) {
+            update_peer_sockets(primary_worker_ctx);
+            for ( i=0; i < primary_worker_ctx->peer_socket_num; i++ ) {
+                FD_SET(primary_worker_ctx->peer_sockets[i].sockfd, &readfds);
+                if ( primary_worker_ctx->peer_sockets[i].sockfd > loop_maxfd ) {
+                    loop_maxfd = primary_worker_ctx->peer_sockets[i].sockfd;
+                }
+            }
+        }
+        #endif
         timeout.tv_sec  = 1l;
         timeout.tv_usec = 10000l;
-        n_ready = select( maxfd + 1, &readfds, NULL, NULL, &timeout );
+        n_ready = select( loop_maxfd + 1, &readfds, NULL, NULL, &timeout );
         if ( -1 == n_ready ) {
             if ( EINTR == errno ) {
                 //检查一下有没到这里
@@ -646,17 +927,25 @@ static void* tun_udp_loop_thread_func(void *data) {
         if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV6 ) {
             for ( i=0; i < gnb_core->conf->udp6_socket_num; i++ ) {
                 if ( FD_ISSET( gnb_core->udp_ipv6_sockets[i], &readfds ) ) {
-                    handle_udp(gnb_core, pf_core, i, AF_INET6);
+                    handle_udp(gnb_core, pf_core, gnb_core->udp_ipv6_sockets[i], i, AF_INET6);
                 }
             }
         }
         if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV4 ) {
             for ( i=0; i < gnb_core->conf->udp4_socket_num; i++ ) {
                 if ( FD_ISSET( gnb_core->udp_ipv4_sockets[i], &readfds ) ) {
-                    handle_udp(gnb_core, pf_core, i, AF_INET);
+                    handle_udp(gnb_core, pf_core, gnb_core->udp_ipv4_sockets[i], i, AF_INET);
                 }
             }
         }
+        #ifdef GNB_PEER_SOCKET_ENABLE
+        //从 peer socket 收到的分组和从监听 socket 收到的一样处理, socket_idx 使用 peer socket 绑定的本地端口
+        for ( i=0; i < primary_worker_ctx->peer_socket_num; i++ ) {
+            if ( FD_ISSET( primary_worker_ctx->peer_sockets[i].sockfd, &readfds ) ) {
+                handle_udp(gnb_core, pf_core, primary_worker_ctx->peer_sockets[i].sockfd, primary_worker_ctx->peer_sockets[i].socket_idx, primary_worker_ctx->peer_sockets[i].af);
+            }
+        }
+        #endif
         if ( gnb_core->conf->activate_tun ) {
 
             if ( FD_ISSET( gnb_core->tun_fd, &readfds ) ) {
@@ -693,30 +982,38 @@ static void init(gnb_worker_t *gnb_worker, void *ctx) {
     gnb_worker->ctx = primary_worker_ctx;
     primary_worker_ctx->pf_core = gnb_pf_core_init(gnb_core->heap, 32);
     gnb_pf_core_t *pf_core = primary_worker_ctx->pf_core;
+    pf_core->node_counter_shard = gnb_ctl_block_counter_shard(gnb_core->ctl_block, 0);
+    pf_core->latency_shard      = gnb_ctl_block_latency_shard(gnb_core->ctl_block, 0);
+    pf_core->pf_status_counter  = gnb_ctl_block_pf_status_shard(gnb_core->ctl_block, 0);
+    pf_core->flight_recorder    = gnb_ctl_block_flight_shard(gnb_core->ctl_block, 0);
     gnb_pf_t *pf;
     if ( 1==gnb_core->conf->if_dump ) {
-        pf = gnb_find_pf_mod_by_name("gnb_pf_dump");
+        pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_dump");
         gnb_pf_install(primary_worker_ctx->pf_core->pf_install_array, pf);
     }
-    pf = gnb_find_pf_mod_by_name(gnb_core->conf->pf_route);
+    pf = gnb_find_pf_mod_by_name(gnb_core, gnb_core->conf->pf_route);
     if ( NULL == pf ) {
         GNB_ERROR1(gnb_core->log, GNB_LOG_ID_CORE, "pf_route '%s' not exist\n", gnb_core->conf->pf_route);
         exit(1);
     }
     gnb_pf_install(pf_core->pf_install_array, pf);
     if ( 0 != gnb_core->conf->zip_level ) {
-        pf = gnb_find_pf_mod_by_name("gnb_pf_zip");
+        pf = gnb_find_pf_mod_by_name(gnb_core, GNB_ZIP_TYPE_LZ4 == gnb_core->conf->zip_type ? "gnb_pf_lz4":"gnb_pf_zip");
         gnb_pf_install(pf_core->pf_install_array, pf);        
     }
+    if ( gnb_core->conf->header_zip ) {
+        pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_header_zip");
+        gnb_pf_install(pf_core->pf_install_array, pf);
+    }
     if ( !(GNB_PF_BITS_CRYPTO_XOR & gnb_core->conf->pf_bits) && !(GNB_PF_BITS_CRYPTO_ARC4 & gnb_core->conf->pf_bits) ) {
         goto skip_crypto;
     }
     if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_XOR ) {
-        pf = gnb_find_pf_mod_by_name("gnb_pf_crypto_xor");
+        pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_xor");
         gnb_pf_install(pf_core->pf_install_array, pf);
     }
     if ( gnb_core->conf->pf_bits & GNB_PF_BITS_CRYPTO_ARC4 ) {
-        pf = gnb_find_pf_mod_by_name("gnb_pf_crypto_arc4");
+        pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_crypto_arc4");
         gnb_pf_install(pf_core->pf_install_array, pf);
     }
 
@@ -742,9 +1039,16 @@ static int start(gnb_worker_t *gnb_worker){
     struct sockaddr_in6 sockaddr6;
     struct sockaddr_in  sockaddr;
     socklen_t sockaddr_len;
+    int on = 1;
     if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV6 ) {
         for ( i=0; i < gnb_core->conf->udp6_socket_num; i++ ) {
             gnb_core->udp_ipv6_sockets[i] = socket(AF_INET6, SOCK_DGRAM, 0);
+            #ifdef GNB_PEER_SOCKET_ENABLE
+            //peer socket 需要和监听 socket 绑定同一个端口
+            if ( gnb_core->conf->peer_socket ) {
+                setsockopt(gnb_core->udp_ipv6_sockets[i], SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on));
+            }
+            #endif
             gnb_bind_udp_socket_ipv6(gnb_core->udp_ipv6_sockets[i], gnb_core->conf->listen_address6_string,  gnb_core->conf->udp6_ports[i]);
             sockaddr_len = sizeof(struct sockaddr_in6);
             getsockname( gnb_core->udp_ipv6_sockets[i], (struct sockaddr *)&sockaddr6, &sockaddr_len );
@@ -756,6 +1060,11 @@ static int start(gnb_worker_t *gnb_worker){
     if ( gnb_core->conf->udp_socket_type & GNB_ADDR_TYPE_IPV4 ) {
         for ( i=0; i < gnb_core->conf->udp4_socket_num; i++ ) {
             gnb_core->udp_ipv4_sockets[i] = socket(AF_INET, SOCK_DGRAM, 0);
+            #ifdef GNB_PEER_SOCKET_ENABLE
+            if ( gnb_core->conf->peer_socket ) {
+                setsockopt(gnb_core->udp_ipv4_sockets[i], SOL_SOCKET, SO_REUSEPORT, (char *)&on, sizeof(on));
+            }
+            #endif
             gnb_bind_udp_socket_ipv4(gnb_core->udp_ipv4_sockets[i], gnb_core->conf->listen_address4_string, gnb_core->conf->udp4_ports[i]);
             if ( 0==gnb_core->conf->udp4_ports[i] ) {
                 sockaddr_len = sizeof(struct sockaddr_in);
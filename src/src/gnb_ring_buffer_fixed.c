@@ -19,6 +19,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "gnb_ring_buffer_fixed.h"
+#include "gnb_trace.h"
 size_t gnb_ring_buffer_fixed_sum_size(size_t block_size, unsigned short block_num_mask) {
     size_t memory_size;
     size_t block_num = 0xFF+1;
@@ -64,6 +65,8 @@ gnb_ring_buffer_fixed_t* gnb_ring_buffer_fixed_init(void *memory, size_t block_s
 void* gnb_ring_buffer_fixed_push(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
     int tail_next_idx = (ring_buffer_fixed->tail_idx + 1) & ring_buffer_fixed->block_num_mask;
     if ( tail_next_idx == ring_buffer_fixed->head_idx ) {
+        ring_buffer_fixed->full_num++;
+        GNB_TRACE2(ring_full, ring_buffer_fixed, ring_buffer_fixed->block_size);
         return  NULL;
     }
     void *buffer_header = ring_buffer_fixed->blocks + ring_buffer_fixed->block_size * ring_buffer_fixed->tail_idx;
@@ -71,8 +74,14 @@ void* gnb_ring_buffer_fixed_push(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
 }
 
 void gnb_ring_buffer_fixed_push_submit(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
+    unsigned int used;
     int tail_next_idx = (ring_buffer_fixed->tail_idx + 1) & ring_buffer_fixed->block_num_mask;
     ring_buffer_fixed->tail_idx = tail_next_idx;
+    used = gnb_ring_buffer_fixed_used(ring_buffer_fixed);
+    if ( used > ring_buffer_fixed->high_watermark ) {
+        ring_buffer_fixed->high_watermark = used;
+    }
+    GNB_TRACE3(ring_push, ring_buffer_fixed, ring_buffer_fixed->block_size, used);
 }
 
 void* gnb_ring_buffer_fixed_pop(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
@@ -80,6 +89,7 @@ void* gnb_ring_buffer_fixed_pop(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
         return NULL;
     }
     void *buffer_header = ring_buffer_fixed->blocks + ring_buffer_fixed->block_size * ring_buffer_fixed->head_idx;
+    GNB_TRACE2(ring_pop, ring_buffer_fixed, ring_buffer_fixed->block_size);
     return buffer_header;
 }
 
@@ -87,3 +97,7 @@ void gnb_ring_buffer_fixed_pop_submit(gnb_ring_buffer_fixed_t *ring_buffer_fixed
     int head_next_idx = (ring_buffer_fixed->head_idx + 1) & ring_buffer_fixed->block_num_mask;
     ring_buffer_fixed->head_idx = head_next_idx;
 }
+
+unsigned int gnb_ring_buffer_fixed_used(gnb_ring_buffer_fixed_t *ring_buffer_fixed) {
+    return (ring_buffer_fixed->tail_idx - ring_buffer_fixed->head_idx) & ring_buffer_fixed->block_num_mask;
+}
@@ -25,6 +25,9 @@ typedef struct _gnb_ring_buffer_fixed_t {
     size_t memory_size;
     unsigned int head_idx;
     unsigned int tail_idx;
+    //以下由生产者更新: 曾经达到的最大 block 数, push 时 ring 已满的次数
+    unsigned int high_watermark;
+    uint64_t full_num;
     unsigned char blocks[0];
 } __attribute__ ((aligned (4))) gnb_ring_buffer_fixed_t;
 
@@ -53,5 +56,7 @@ void* gnb_ring_buffer_fixed_push(gnb_ring_buffer_fixed_t *ring_buffer_fixed);
 void gnb_ring_buffer_fixed_push_submit(gnb_ring_buffer_fixed_t *ring_buffer_fixed);
 void* gnb_ring_buffer_fixed_pop(gnb_ring_buffer_fixed_t *ring_buffer_fixed);
 void gnb_ring_buffer_fixed_pop_submit(gnb_ring_buffer_fixed_t *ring_buffer_fixed);
+//当前已经使用的 block 数
+unsigned int gnb_ring_buffer_fixed_used(gnb_ring_buffer_fixed_t *ring_buffer_fixed);
 
 #endif
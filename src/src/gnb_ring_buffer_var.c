@@ -0,0 +1,160 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "gnb_ring_buffer_var.h"
+#include "gnb_trace.h"
+
+#define GNB_RING_BUFFER_VAR_WRAP 0xFFFFFFFF
+
+#define GNB_RING_BUFFER_VAR_ALIGN(size) ( ((size) + 7) & ~((size_t)7) )
+
+#define GNB_RING_BUFFER_VAR_BLOCK_SIZE(size) ( GNB_RING_BUFFER_VAR_BLOCK_HEAD_SIZE + GNB_RING_BUFFER_VAR_ALIGN(size) )
+
+typedef struct _gnb_ring_buffer_var_block_t {
+    uint32_t size;
+    uint32_t reserved;
+    unsigned char data[0];
+} gnb_ring_buffer_var_block_t;
+
+/*
+ capacity 至少要能放下两个最大的 block,
+ 否则当 head 停在中间时,即使 ring 为空也可能在尾部和头部都放不下一个 block
+*/
+static size_t ring_buffer_var_capacity(size_t capacity, size_t max_block_size) {
+    size_t min_capacity = GNB_RING_BUFFER_VAR_BLOCK_SIZE(max_block_size) * 2;
+    capacity = capacity & ~((size_t)7);
+    if ( capacity < min_capacity ) {
+        capacity = min_capacity;
+    }
+    return capacity;
+}
+
+size_t gnb_ring_buffer_var_sum_size(size_t capacity, size_t max_block_size) {
+    return sizeof(gnb_ring_buffer_var_t) + ring_buffer_var_capacity(capacity, max_block_size);
+}
+
+gnb_ring_buffer_var_t* gnb_ring_buffer_var_init(void *memory, size_t capacity, size_t max_block_size) {
+    gnb_ring_buffer_var_t *ring_buffer_var = (gnb_ring_buffer_var_t*)memory;
+    memset(ring_buffer_var, 0, sizeof(gnb_ring_buffer_var_t));
+    ring_buffer_var->capacity = (uint32_t)ring_buffer_var_capacity(capacity, max_block_size);
+    ring_buffer_var->max_block_size = (uint32_t)max_block_size;
+    ring_buffer_var->memory_size = sizeof(gnb_ring_buffer_var_t) + ring_buffer_var->capacity;
+    return ring_buffer_var;
+}
+
+void* gnb_ring_buffer_var_push(gnb_ring_buffer_var_t *ring_buffer_var, size_t size) {
+    uint32_t head_idx;
+    uint32_t tail_idx = ring_buffer_var->tail_idx;
+    uint32_t capacity = ring_buffer_var->capacity;
+    size_t block_size;
+    gnb_ring_buffer_var_block_t *block;
+    if ( size > ring_buffer_var->max_block_size ) {
+        return NULL;
+    }
+    block_size = GNB_RING_BUFFER_VAR_BLOCK_SIZE(size);
+    head_idx = __atomic_load_n(&ring_buffer_var->head_idx, __ATOMIC_ACQUIRE);
+    if ( tail_idx >= head_idx ) {
+        if ( capacity - tail_idx >= block_size ) {
+            ring_buffer_var->reserve_idx = tail_idx;
+            ring_buffer_var->wrap_flag = 0;
+        } else if ( head_idx > block_size ) {
+            //尾部放不下,从头开始写, submit 时在 tail 处留下回绕标记
+            ring_buffer_var->reserve_idx = 0;
+            ring_buffer_var->wrap_flag = 1;
+        } else {
+            ring_buffer_var->full_num++;
+            GNB_TRACE2(ring_full, ring_buffer_var, size);
+            return NULL;
+        }
+    } else {
+        //tail 不能追上 head, 否则无法区分空和满
+        if ( head_idx - tail_idx > block_size ) {
+            ring_buffer_var->reserve_idx = tail_idx;
+            ring_buffer_var->wrap_flag = 0;
+        } else {
+            ring_buffer_var->full_num++;
+            GNB_TRACE2(ring_full, ring_buffer_var, size);
+            return NULL;
+        }
+    }
+    block = (gnb_ring_buffer_var_block_t *)(ring_buffer_var->blocks + ring_buffer_var->reserve_idx);
+    return block->data;
+}
+
+void gnb_ring_buffer_var_push_submit(gnb_ring_buffer_var_t *ring_buffer_var, size_t size) {
+    uint32_t used;
+    uint32_t tail_idx = ring_buffer_var->tail_idx;
+    gnb_ring_buffer_var_block_t *block;
+    if ( 1 == ring_buffer_var->wrap_flag && ring_buffer_var->capacity - tail_idx >= GNB_RING_BUFFER_VAR_BLOCK_HEAD_SIZE ) {
+        block = (gnb_ring_buffer_var_block_t *)(ring_buffer_var->blocks + tail_idx);
+        block->size = GNB_RING_BUFFER_VAR_WRAP;
+    }
+    block = (gnb_ring_buffer_var_block_t *)(ring_buffer_var->blocks + ring_buffer_var->reserve_idx);
+    block->size = (uint32_t)size;
+    tail_idx = ring_buffer_var->reserve_idx + (uint32_t)GNB_RING_BUFFER_VAR_BLOCK_SIZE(size);
+    __atomic_store_n(&ring_buffer_var->tail_idx, tail_idx, __ATOMIC_RELEASE);
+    used = gnb_ring_buffer_var_used(ring_buffer_var);
+    if ( used > ring_buffer_var->high_watermark ) {
+        ring_buffer_var->high_watermark = used;
+    }
+    GNB_TRACE3(ring_push, ring_buffer_var, size, used);
+}
+
+/*
+ pop 只移动消费者私有的 read_idx, pop_submit 之前 block 的内存不会被生产者覆盖
+*/
+void* gnb_ring_buffer_var_pop(gnb_ring_buffer_var_t *ring_buffer_var, size_t *size_ptr) {
+    uint32_t read_idx = ring_buffer_var->read_idx;
+    uint32_t tail_idx = __atomic_load_n(&ring_buffer_var->tail_idx, __ATOMIC_ACQUIRE);
+    gnb_ring_buffer_var_block_t *block;
+    if ( read_idx == tail_idx ) {
+        return NULL;
+    }
+    if ( ring_buffer_var->capacity - read_idx < GNB_RING_BUFFER_VAR_BLOCK_HEAD_SIZE ||
+         GNB_RING_BUFFER_VAR_WRAP == ((gnb_ring_buffer_var_block_t *)(ring_buffer_var->blocks + read_idx))->size ) {
+        read_idx = 0;
+        if ( read_idx == tail_idx ) {
+            ring_buffer_var->read_idx = read_idx;
+            return NULL;
+        }
+    }
+    block = (gnb_ring_buffer_var_block_t *)(ring_buffer_var->blocks + read_idx);
+    if ( NULL != size_ptr ) {
+        *size_ptr = block->size;
+    }
+    ring_buffer_var->read_idx = read_idx + (uint32_t)GNB_RING_BUFFER_VAR_BLOCK_SIZE(block->size);
+    GNB_TRACE2(ring_pop, ring_buffer_var, block->size);
+    return block->data;
+}
+
+void gnb_ring_buffer_var_pop_submit(gnb_ring_buffer_var_t *ring_buffer_var) {
+    __atomic_store_n(&ring_buffer_var->head_idx, ring_buffer_var->read_idx, __ATOMIC_RELEASE);
+}
+
+/*
+ tail 回绕到 head 之前时, 尾部没有使用的空间也算作占用
+*/
+uint32_t gnb_ring_buffer_var_used(gnb_ring_buffer_var_t *ring_buffer_var) {
+    uint32_t head_idx = __atomic_load_n(&ring_buffer_var->head_idx, __ATOMIC_ACQUIRE);
+    uint32_t tail_idx = __atomic_load_n(&ring_buffer_var->tail_idx, __ATOMIC_ACQUIRE);
+    if ( tail_idx >= head_idx ) {
+        return tail_idx - head_idx;
+    }
+    return ring_buffer_var->capacity - head_idx + tail_idx;
+}
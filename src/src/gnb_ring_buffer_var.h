@@ -0,0 +1,64 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef gnb_ring_buffer_var_h
+#define gnb_ring_buffer_var_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include "gnb_type.h"
+
+/*
+ 单生产者单消费者的变长 ring buffer,
+ 每个 block 只占用实际写入的字节数(8字节对齐)加上 8 字节的头部,
+ 生产者先用 push 预留最大可能的长度, 写入完成后用 push_submit 提交实际长度
+ 消费者可以连续 pop 多个 block 批量处理, 之后用 pop_submit 一次释放所有已经 pop 的 block
+*/
+typedef struct _gnb_ring_buffer_var_t {
+
+    size_t memory_size;
+    uint32_t capacity;
+    uint32_t max_block_size;
+
+    //生产者使用
+    uint32_t tail_idx GNB_CACHE_ALIGNED;
+    uint32_t reserve_idx;
+    uint32_t wrap_flag;
+    //曾经占用的最大字节数, push 时空间不足的次数
+    uint32_t high_watermark;
+    uint64_t full_num;
+
+    //消费者使用
+    uint32_t head_idx GNB_CACHE_ALIGNED;
+    uint32_t read_idx;
+
+    unsigned char blocks[0] GNB_CACHE_ALIGNED;
+
+} gnb_ring_buffer_var_t;
+
+#define GNB_RING_BUFFER_VAR_BLOCK_HEAD_SIZE 8
+
+size_t gnb_ring_buffer_var_sum_size(size_t capacity, size_t max_block_size);
+gnb_ring_buffer_var_t* gnb_ring_buffer_var_init(void *memory, size_t capacity, size_t max_block_size);
+void* gnb_ring_buffer_var_push(gnb_ring_buffer_var_t *ring_buffer_var, size_t size);
+void gnb_ring_buffer_var_push_submit(gnb_ring_buffer_var_t *ring_buffer_var, size_t size);
+void* gnb_ring_buffer_var_pop(gnb_ring_buffer_var_t *ring_buffer_var, size_t *size_ptr);
+void gnb_ring_buffer_var_pop_submit(gnb_ring_buffer_var_t *ring_buffer_var);
+//当前占用的字节数, 在生产者以外的线程调用时只是一个近似值
+uint32_t gnb_ring_buffer_var_used(gnb_ring_buffer_var_t *ring_buffer_var);
+
+#endif
@@ -0,0 +1,69 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_SEQLOCK_H
+#define GNB_SEQLOCK_H
+
+#include <stdint.h>
+
+/*
+ ctl_block 中的数据由 gnb 的 worker 更新, gnb_ctl gnb_es 等外部进程通过 mmap 读取,
+ seq 为奇数时表示正在写入, 读者在读取前后各读一次 seq, 为奇数或者不一致就重新读取, 读者不会阻塞写者
+
+ 同一块数据可能由多个 worker 更新(例如 node 的地址由 node worker 和 index worker 更新),
+ write_begin 用 CAS 把 seq 从偶数改为奇数, 写者之间因此互斥, 只在控制面使用, 冲突的概率很低
+*/
+
+static inline void gnb_seqlock_cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__ ("yield");
+#endif
+}
+
+static inline void gnb_seqlock_write_begin(uint32_t *seq) {
+    uint32_t s;
+    while (1) {
+        s = __atomic_load_n(seq, __ATOMIC_RELAXED);
+        if ( !(s & 1) && __atomic_compare_exchange_n(seq, &s, s + 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) ) {
+            break;
+        }
+        gnb_seqlock_cpu_relax();
+    }
+    //seq 变为奇数之后才能写入数据
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static inline void gnb_seqlock_write_end(uint32_t *seq) {
+    __atomic_fetch_add(seq, 1, __ATOMIC_RELEASE);
+}
+
+static inline uint32_t gnb_seqlock_read_begin(uint32_t *seq) {
+    return __atomic_load_n(seq, __ATOMIC_ACQUIRE);
+}
+
+/*
+ 返回非 0 表示读取时正在写入或者读取期间数据被修改, 需要重新读取,
+ 读者自己限制重试的次数, 避免 gnb 进程在写入时退出后 seq 一直为奇数
+*/
+static inline int gnb_seqlock_read_retry(uint32_t *seq, uint32_t s) {
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (s & 1) || __atomic_load_n(seq, __ATOMIC_RELAXED) != s;
+}
+
+#endif
@@ -0,0 +1,110 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef GNB_TRACE_H
+#define GNB_TRACE_H
+
+#include <stdint.h>
+
+/*
+ 数据路径上的静态 tracepoint(USDT), provider 为 gnb
+
+ 每个 tracepoint 在代码中只是一条 nop, 同时在 .note.stapsdt section 中写入 probe 的地址和参数的位置,
+ 格式与 systemtap 的 sys/sdt.h 相同, 但不依赖 systemtap-sdt-dev, 没有 attach 时除了这条 nop 没有其他开销
+ bpftrace 等工具 attach 之后把 nop 替换为断点, 例如
+
+   bpftrace -e 'usdt:./gnb:gnb:pf_drop { @[arg0] = count(); }'
+
+ 所有参数都转换为 uint64_t, 传入的参数不能有副作用
+ 只在 x86_64 和 aarch64 的 linux 上生效, 其他平台或者编译时定义了 GNB_TRACE_DISABLE 时为空
+*/
+
+#if defined(__linux__) && defined(__ELF__) && ( defined(__x86_64__) || defined(__aarch64__) ) && !defined(GNB_TRACE_DISABLE)
+
+#define GNB_TRACE_ARG(x) "nor" ((uint64_t)(uintptr_t)(x))
+
+#define GNB_TRACE_PROBE(name, arg_format, ...)                                          \
+    __asm__ __volatile__ (                                                              \
+        "990: nop\n"                                                                    \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                   \
+        ".balign 4\n"                                                                   \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                              \
+        "991: .asciz \"stapsdt\"\n"                                                     \
+        "992: .balign 4\n"                                                              \
+        "993: .8byte 990b\n"                                                            \
+        ".8byte _.stapsdt.base\n"                                                       \
+        ".8byte 0\n"                                                                    \
+        ".asciz \"gnb\"\n"                                                              \
+        ".asciz \"" #name "\"\n"                                                        \
+        ".asciz \"" arg_format "\"\n"                                                   \
+        "994: .balign 4\n"                                                              \
+        ".popsection\n"                                                                 \
+        ".ifndef _.stapsdt.base\n"                                                      \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"         \
+        ".weak _.stapsdt.base\n"                                                        \
+        ".hidden _.stapsdt.base\n"                                                      \
+        "_.stapsdt.base: .space 1\n"                                                    \
+        ".size _.stapsdt.base, 1\n"                                                     \
+        ".popsection\n"                                                                 \
+        ".endif\n"                                                                      \
+        :: __VA_ARGS__ )
+
+#define GNB_TRACE0(name) GNB_TRACE_PROBE(name, "")
+
+#define GNB_TRACE1(name, x1)                                                            \
+    GNB_TRACE_PROBE(name, "8@%[a1]",                                                    \
+                    [a1] GNB_TRACE_ARG(x1))
+
+#define GNB_TRACE2(name, x1, x2)                                                        \
+    GNB_TRACE_PROBE(name, "8@%[a1] 8@%[a2]",                                            \
+                    [a1] GNB_TRACE_ARG(x1), [a2] GNB_TRACE_ARG(x2))
+
+#define GNB_TRACE3(name, x1, x2, x3)                                                    \
+    GNB_TRACE_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3]",                                    \
+                    [a1] GNB_TRACE_ARG(x1), [a2] GNB_TRACE_ARG(x2), [a3] GNB_TRACE_ARG(x3))
+
+#define GNB_TRACE4(name, x1, x2, x3, x4)                                                \
+    GNB_TRACE_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3] 8@%[a4]",                            \
+                    [a1] GNB_TRACE_ARG(x1), [a2] GNB_TRACE_ARG(x2), [a3] GNB_TRACE_ARG(x3), \
+                    [a4] GNB_TRACE_ARG(x4))
+
+#define GNB_TRACE5(name, x1, x2, x3, x4, x5)                                            \
+    GNB_TRACE_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3] 8@%[a4] 8@%[a5]",                    \
+                    [a1] GNB_TRACE_ARG(x1), [a2] GNB_TRACE_ARG(x2), [a3] GNB_TRACE_ARG(x3), \
+                    [a4] GNB_TRACE_ARG(x4), [a5] GNB_TRACE_ARG(x5))
+
+#define GNB_TRACE6(name, x1, x2, x3, x4, x5, x6)                                        \
+    GNB_TRACE_PROBE(name, "8@%[a1] 8@%[a2] 8@%[a3] 8@%[a4] 8@%[a5] 8@%[a6]",            \
+                    [a1] GNB_TRACE_ARG(x1), [a2] GNB_TRACE_ARG(x2), [a3] GNB_TRACE_ARG(x3), \
+                    [a4] GNB_TRACE_ARG(x4), [a5] GNB_TRACE_ARG(x5), [a6] GNB_TRACE_ARG(x6))
+
+#else
+
+//sizeof 不会对参数求值, 只是避免只为 tracepoint 准备的变量产生 unused 的警告
+#define GNB_TRACE_UNUSED(x) ((void)sizeof(x))
+
+#define GNB_TRACE0(name)
+#define GNB_TRACE1(name, x1) GNB_TRACE_UNUSED(x1)
+#define GNB_TRACE2(name, x1, x2) GNB_TRACE_UNUSED(x1), GNB_TRACE_UNUSED(x2)
+#define GNB_TRACE3(name, x1, x2, x3) GNB_TRACE2(name, x1, x2), GNB_TRACE_UNUSED(x3)
+#define GNB_TRACE4(name, x1, x2, x3, x4) GNB_TRACE3(name, x1, x2, x3), GNB_TRACE_UNUSED(x4)
+#define GNB_TRACE5(name, x1, x2, x3, x4, x5) GNB_TRACE4(name, x1, x2, x3, x4), GNB_TRACE_UNUSED(x5)
+#define GNB_TRACE6(name, x1, x2, x3, x4, x5, x6) GNB_TRACE5(name, x1, x2, x3, x4, x5), GNB_TRACE_UNUSED(x6)
+
+#endif
+
+#endif
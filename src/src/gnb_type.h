@@ -23,4 +23,14 @@ typedef unsigned long long int gnb_uint64_t;
 /* 64 bits node id*/
 typedef unsigned long long int gnb_uuid_t;
 
+#define GNB_CACHE_LINE_SIZE 64
+
+#if defined(__GNUC__) || defined(__clang__)
+#define GNB_CACHE_ALIGNED __attribute__((aligned(GNB_CACHE_LINE_SIZE)))
+#else
+#define GNB_CACHE_ALIGNED
+#endif
+
+#define GNB_CACHE_ALIGN_SIZE(size) ( ((size) + GNB_CACHE_LINE_SIZE - 1) & ~((size_t)GNB_CACHE_LINE_SIZE - 1) )
+
 #endif
@@ -18,6 +18,7 @@
 #ifndef GNB_NODE_WORKER_QUEUE_DATA_H
 #define GNB_NODE_WORKER_QUEUE_DATA_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct _gnb_node_t gnb_node_t;
@@ -30,19 +31,42 @@ typedef struct _gnb_node_worker_in_data_t {
 	gnb_payload16_t    payload_st;
 }gnb_worker_in_data_t;
 
+typedef struct _gnb_pbuf_t gnb_pbuf_t;
+
+typedef struct _gnb_worker_pbuf_data_t {
+	gnb_pbuf_t *pbuf;
+}gnb_worker_pbuf_data_t;
+
 typedef struct _gnb_worker_queue_data_t {
 
 	#define GNB_WORKER_QUEUE_DATA_TYPE_NODE_IN   0x1
 	#define GNB_WORKER_QUEUE_DATA_TYPE_NODE_OUT  0x2
+	//data.pbuf 持有 pbuf 的一个引用, 由接收的 worker 负责 unref
+	#define GNB_WORKER_QUEUE_DATA_TYPE_PBUF_OUT  0x3
 	int  type;
 
+	//放入 pf worker ring buffer 时的计数器值, 用于统计在 ring buffer 中等待的时间, 没有打开 latency_stats 时为 0
+	uint64_t enqueue_ticks;
+
 	union worker_data {
 		gnb_worker_in_data_t    node_in;
+		gnb_worker_pbuf_data_t  pbuf;
 	} data;
 	//这里可以定义宏方便操作union
 	
 }gnb_worker_queue_data_t;
 
+//node_in.payload_st 之前的部分, 加上 payload 的实际长度就是变长 ring buffer 中 block 的长度
+#define GNB_WORKER_QUEUE_DATA_NODE_IN_HEAD_SIZE offsetof(gnb_worker_queue_data_t, data.node_in.payload_st)
+
+//pf 会在 payload 尾部追加 relay nodeid 和 unified forwarding foot, block 需要在 payload 之后留出这些空间
+#define GNB_WORKER_QUEUE_DATA_TAILROOM 128
+
+#define GNB_WORKER_QUEUE_DATA_PBUF_SIZE ( offsetof(gnb_worker_queue_data_t, data.pbuf) + sizeof(gnb_worker_pbuf_data_t) )
+
+//pf worker 变长 ring buffer 按每个 packet 平均占用这么多字节来计算容量
+#define GNB_PF_WORKER_QUEUE_AVG_BLOCK_SIZE 2048
+
 //这个块不能太大，在嵌入设备上，这里是占用内存的大头
 #define GNB_NODE_WORKER_QUEUE_BLOCK_SIZE          512
 #define GNB_INDEX_WORKER_QUEUE_BLOCK_SIZE         512
@@ -20,6 +20,7 @@
 
 #include <stdint.h>
 #include "gnb_ring_buffer_fixed.h"
+#include "gnb_ring_buffer_var.h"
 
 typedef struct _gnb_worker_t gnb_worker_t;
 typedef struct _gnb_ring_buffer_t gnb_ring_buffer_t;
@@ -41,6 +42,9 @@ typedef struct _gnb_worker_t {
 	gnb_worker_notify_func_t    notify;
 	gnb_ring_buffer_fixed_t *ring_buffer_in;
 	gnb_ring_buffer_fixed_t *ring_buffer_out;
+	//pf worker 的 packet 长度差别很大,使用变长的 ring buffer
+	gnb_ring_buffer_var_t *ring_buffer_var_in;
+	gnb_ring_buffer_var_t *ring_buffer_var_out;
 
 	volatile int thread_worker_flag;
 	volatile int thread_worker_ready_flag;
@@ -21,6 +21,7 @@
 #include "crypto/arc4/arc4.h"
 #include "gnb_keys.h"
 #include "protocol/network_protocol.h"
+#include "gnb_trace.h"
 
 typedef struct _gnb_pf_private_ctx_t {
     int save_time_seed_update_factor;
@@ -75,11 +76,54 @@ static void pf_conf_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
     init_arc4_keys(gnb_core,pf);
 }
 
+/*
+ 逐跳加密解密 relay payload, 最后 8 byte 是上一跳的 node id 不加密
+ relay cut-through 模式下只加密解密 route frame head 和 relay node id, 否则加密解密整个 payload
+ 发送方在 route frame head 的 pf_type_bits 中标记是否使用 cut-through 模式, 接收方先解密 route frame head
+ (两种模式下 route frame head 的密文相同) 得到 ttl 和模式标记, 模式与本节点不一致的 payload 返回 -2
+*/
+static int relay_crypt(gnb_core_t *gnb_core, struct arc4_sbox *sbox, gnb_payload16_t *payload, int decrypt) {
+    unsigned char *data = payload->data;
+    uint16_t data_len = gnb_payload16_data_len(payload);
+    size_t head_size = gnb_core->route_frame_head_size;
+    uint8_t ttl;
+    uint8_t cut_through;
+    if ( data_len < head_size + sizeof(gnb_uuid_t) ) {
+        return -1;
+    }
+    if ( !decrypt ) {
+        if ( 1 == gnb_core->conf->relay_cut_through ) {
+            data[GNB_PF_ROUTE_FRAME_PF_BITS_OFFSET] |= GNB_PF_BITS_RELAY_CUT_THROUGH;
+        } else {
+            data[GNB_PF_ROUTE_FRAME_PF_BITS_OFFSET] &= ~GNB_PF_BITS_RELAY_CUT_THROUGH;
+        }
+    }
+    ttl = data[GNB_PF_ROUTE_FRAME_TTL_OFFSET];
+    cut_through = data[GNB_PF_ROUTE_FRAME_PF_BITS_OFFSET] & GNB_PF_BITS_RELAY_CUT_THROUGH;
+    arc4_crypt(sbox, data, head_size);
+    if ( decrypt ) {
+        ttl = data[GNB_PF_ROUTE_FRAME_TTL_OFFSET];
+        cut_through = data[GNB_PF_ROUTE_FRAME_PF_BITS_OFFSET] & GNB_PF_BITS_RELAY_CUT_THROUGH;
+        if ( (0 != cut_through) != (1 == gnb_core->conf->relay_cut_through) ) {
+            return -2;
+        }
+    }
+    if ( 0 == cut_through ) {
+        arc4_crypt(sbox, data + head_size, data_len - head_size - sizeof(gnb_uuid_t));
+        return 0;
+    }
+    if ( 0 == ttl || data_len < head_size + ttl*sizeof(gnb_uuid_t) ) {
+        return -1;
+    }
+    arc4_crypt(sbox, data + data_len - ttl*sizeof(gnb_uuid_t), (ttl-1)*sizeof(gnb_uuid_t));
+    return 0;
+}
+
 /*
  用dst node 的key 加密 ip frmae
  for P2P
 */
-static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_crypto_arc4_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
     gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t *)pf->private_ctx;
     if ( ctx->save_time_seed_update_factor != gnb_core->time_seed_update_factor ) {
         init_arc4_keys(gnb_core,pf);
@@ -94,7 +138,9 @@ static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_
         return GNB_PF_ERROR;
     }
     sbox = *sbox_init;
+    GNB_TRACE3(crypto_encrypt_begin, pf->name, pf_ctx->dst_uuid64, pf_ctx->ip_frame_size);
     arc4_crypt(&sbox, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+    GNB_TRACE3(crypto_encrypt_end, pf->name, pf_ctx->dst_uuid64, pf_ctx->ip_frame_size);
     return pf_ctx->pf_status;
 }
 
@@ -102,7 +148,7 @@ static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_
 用 src_node 的密钥对 payload 进行解密, 得到来自 src_node 的虚拟网卡的 ip frame,
 这些 ip frame 将被写入虚拟网卡
 */
-static int pf_inet_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_crypto_arc4_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
     gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t *)pf->private_ctx;
     if ( ctx->save_time_seed_update_factor != gnb_core->time_seed_update_factor ) {
         init_arc4_keys(gnb_core,pf);
@@ -114,7 +160,9 @@ static int pf_inet_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf
             return GNB_PF_ERROR;
         }
         struct arc4_sbox sbox = *sbox_init;
+        GNB_TRACE3(crypto_decrypt_begin, pf->name, pf_ctx->src_uuid64, pf_ctx->ip_frame_size);
         arc4_crypt(&sbox, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+        GNB_TRACE3(crypto_decrypt_end, pf->name, pf_ctx->src_uuid64, pf_ctx->ip_frame_size);
     }
     return pf_ctx->pf_status;
 }
@@ -123,7 +171,7 @@ static int pf_inet_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf
 只处理有 GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY 标记的 payload
 payload 发往用下一跳前，用下一跳节点的的密钥加密 payload
 */
-static int pf_chain_relay_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_crypto_arc4_relay(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
     gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t *)pf->private_ctx;
     struct arc4_sbox sbox;
     if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY) ) {
@@ -143,7 +191,9 @@ static int pf_chain_relay_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *p
             return GNB_PF_ERROR;
         }
         sbox = *sbox_init;
-        arc4_crypt(&sbox, pf_ctx->fwd_payload->data, gnb_payload16_data_len(pf_ctx->fwd_payload)-sizeof(gnb_uuid_t));
+        if ( 0 != relay_crypt(gnb_core, &sbox, pf_ctx->fwd_payload, 0) ) {
+            return GNB_PF_ERROR;
+        }
     }
 finish:
     return pf_ctx->pf_status;
@@ -153,10 +203,11 @@ finish:
  只处理有 GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY 标记的 payload
  用上一跳的 relay 节点(src_fwd_nodeb)的密钥为 payload 解密
 */
-static int pf_inet_frame_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_crypto_arc4_inet_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
     gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t *)pf->private_ctx;
     struct arc4_sbox sbox;
     uint16_t payload_size;
+    int ret;
     if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY) ) {
         return pf_ctx->pf_status;
     }
@@ -173,8 +224,15 @@ static int pf_inet_frame_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf
         return GNB_PF_ERROR;
     }
     sbox = *sbox_init;
-    arc4_crypt(&sbox, pf_ctx->fwd_payload->data, gnb_payload16_data_len(pf_ctx->fwd_payload)-sizeof(gnb_uuid_t));
-
+    ret = relay_crypt(gnb_core, &sbox, pf_ctx->fwd_payload, 1);
+    if ( -2 == ret ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "gnb_pf_crypto_arc4 pf_inet_frame_cb relay cut-through mode mismatch src_fwd node[%llu]\n", pf_ctx->src_fwd_uuid64);
+        pf_ctx->pf_status = GNB_PF_DROP;
+        goto finish;
+    }
+    if ( 0 != ret ) {
+        return GNB_PF_ERROR;
+    }
 finish:
     return pf_ctx->pf_status;
 }
@@ -185,15 +243,15 @@ static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
 
 gnb_pf_t gnb_pf_crypto_arc4 = {
     .name           = "gnb_pf_crypto_arc4",
-    .type           = GNB_PF_TYEP_UNSET,
+    .type           = GNB_PF_TYEP_CRYPTO,
     .private_ctx    = NULL,
     .pf_init        = pf_init_cb,
     .pf_conf        = pf_conf_cb,
     .pf_tun_frame   = NULL,                  // pf_tun_frame
-    .pf_tun_route   = pf_tun_route_cb,       // pf_tun_route
-    .pf_tun_fwd     = pf_chain_relay_cb,     // pf_tun_fwd     GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
-    .pf_inet_frame  = pf_inet_frame_cb,      // pf_inet_frame  GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
-    .pf_inet_route  = pf_inet_route_cb,      // pf_inet_route
-    .pf_inet_fwd    = pf_chain_relay_cb,     // pf_inet_fwd    GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
+    .pf_tun_route   = gnb_pf_crypto_arc4_tun_route,   // pf_tun_route
+    .pf_tun_fwd     = gnb_pf_crypto_arc4_relay,       // pf_tun_fwd     GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
+    .pf_inet_frame  = gnb_pf_crypto_arc4_inet_frame,  // pf_inet_frame  GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
+    .pf_inet_route  = gnb_pf_crypto_arc4_inet_route,  // pf_inet_route
+    .pf_inet_fwd    = gnb_pf_crypto_arc4_relay,       // pf_inet_fwd    GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
     .pf_release     = pf_release_cb          // pf_release
 };
@@ -147,7 +147,7 @@ static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf){
 
 gnb_pf_t gnb_pf_dump = {
     .name          = "gnb_pf_dump",
-    .type          = GNB_PF_TYEP_UNSET,
+    .type          = GNB_PF_TYEP_DUMP,
     .private_ctx   = NULL,
     .pf_init       = pf_init_cb,
     .pf_conf       = pf_conf_cb,
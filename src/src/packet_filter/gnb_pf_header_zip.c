@@ -0,0 +1,723 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gnb.h"
+#include "gnb_payload16.h"
+#include "protocol/network_protocol.h"
+
+/*
+ 参考 ROHC 的 ip/udp/tcp 首部压缩, 用于 VoIP 游戏等小 packet 为主的流量
+
+ 发送方按 (dst node, flow) 建立 context, context 在 hash table 中的位置就是 cid,
+ 接收方按 (src node, cid) 保存 context
+ 两边的 hash table 都从 hash 的位置开始最多探测 GNB_HEADER_ZIP_PROBE_NUM 个 slot, 没有空闲的 slot 时替换最久没有使用的 context
+
+ IR packet: 2 字节的 cid 之后是完整的 ip packet, 接收方收到后建立 context
+ +--------+--------+----------------------+
+ |0000 cid|  cid   |     ip packet        |
+ +--------+--------+----------------------+
+
+ CO packet: 只携带变化的字段, 不变的字段和长度字段由接收方根据 context 恢复
+ +--------+--------+---------+--------------------+------------+
+ |10I0 cid|  cid   |ipv4 id  | udp checksum       | l4 payload |
+ |        |        |1/2 byte | tcp 首部除 port 以外 |            |
+ +--------+--------+---------+--------------------+------------+
+ I 为 1 时 ipv4 id 为 2 字节, 否则为低 8 位, 接收方在上一个 id 附近的窗口中恢复
+
+ flow 的前 GNB_HEADER_ZIP_IR_NUM 个 packet 以及之后每隔 GNB_HEADER_ZIP_IR_INTERVAL_SEC 秒发送 IR,
+ IR 丢失或者 cid 被其他 flow 占用时, 接收方用 udp tcp 的 checksum 检查恢复后的 packet, 不一致时丢弃
+ 接收方收到找不到 context 的 CO packet 时, 由 node worker 向发送方发送 PAYLOAD_SUB_TYPE_NODE_HEADER_ZIP_IR_REQUEST,
+ 发送方收到后这个 cid 的下一个 packet 重新以 IR 发送, 不必等待 GNB_HEADER_ZIP_IR_INTERVAL_SEC
+
+ packet 被轮流分配到各个 pf worker, 所以 context 由同一个 gnb_core 的所有 pf worker 共享, 每个 context 有一个自旋锁
+ hash table 保存在 gnb_core 的 gnb_pf_header_zip 模块的 private_ctx 中, 同一个进程中的多个 gnb_core(gnb_sim gnb_bench)互不影响
+*/
+
+#define GNB_HEADER_ZIP_CTX_NUM          4096
+#define GNB_HEADER_ZIP_IR_NUM           3
+#define GNB_HEADER_ZIP_IR_INTERVAL_SEC  2
+#define GNB_HEADER_ZIP_PROBE_NUM        8
+
+//等待 node worker 发送的 IR 请求, 同一个 (src node, cid) 在 GNB_HEADER_ZIP_IR_REQUEST_INTERVAL_SEC 内只请求一次
+#define GNB_HEADER_ZIP_IR_REQUEST_NUM           64
+#define GNB_HEADER_ZIP_IR_REQUEST_INTERVAL_SEC  1
+
+//ipv4 最长 60 字节的首部加上 udp tcp 的 port
+#define GNB_HEADER_ZIP_MAX_HEADER       64
+
+#define GNB_HEADER_ZIP_CO               0x80
+#define GNB_HEADER_ZIP_IPID16           0x40
+#define GNB_HEADER_ZIP_CID_MASK         0x0f
+
+#define GNB_HEADER_ZIP_PROTO_TCP        6
+#define GNB_HEADER_ZIP_PROTO_UDP        17
+
+typedef struct _header_zip_ctx_t {
+    uint8_t lock;
+    uint8_t valid;
+    uint8_t ip_header_size;
+    uint8_t proto;
+    uint16_t cid;
+    uint16_t ipid;
+    uint32_t packet_count;
+    uint64_t ir_time_sec;
+    uint64_t last_time_sec;
+    gnb_uuid_t uuid64;
+    //ip 首部和 l4 的 port, ipv4 的 tot_len id check 和 ipv6 的 payload_len 置 0
+    unsigned char header[GNB_HEADER_ZIP_MAX_HEADER];
+} header_zip_ctx_t;
+
+typedef struct _header_zip_ir_request_t {
+    gnb_uuid_t uuid64;
+    uint16_t cid;
+    uint8_t pending;
+    uint64_t request_time_sec;
+} header_zip_ir_request_t;
+
+typedef struct _header_zip_table_t {
+    header_zip_ctx_t compress_ctx[GNB_HEADER_ZIP_CTX_NUM];
+    header_zip_ctx_t decompress_ctx[GNB_HEADER_ZIP_CTX_NUM];
+    uint8_t ir_request_lock;
+    uint32_t ir_request_idx;
+    header_zip_ir_request_t ir_request[GNB_HEADER_ZIP_IR_REQUEST_NUM];
+} header_zip_table_t;
+
+typedef struct _gnb_pf_private_ctx_t {
+    header_zip_table_t *table;
+    gnb_payload16_t *compressed_payload_vec[GNB_PF_BATCH_MAX];
+    gnb_payload16_t *decompressed_payload_vec[GNB_PF_BATCH_MAX];
+} gnb_pf_private_ctx_t;
+
+/*
+ 解析后的 ip packet
+*/
+typedef struct _header_zip_packet_t {
+    uint8_t version;
+    uint8_t proto;
+    uint8_t ip_header_size;
+    //ip 首部 + l4 首部
+    uint16_t header_size;
+} header_zip_packet_t;
+
+gnb_pf_t gnb_pf_header_zip;
+
+gnb_pf_t* gnb_find_pf_mod_by_name(gnb_core_t *gnb_core, const char *name);
+
+static inline void header_zip_spin_lock(uint8_t *lock) {
+    while ( __atomic_test_and_set(lock, __ATOMIC_ACQUIRE) ) {
+        ;
+    }
+}
+
+static inline void header_zip_spin_unlock(uint8_t *lock) {
+    __atomic_clear(lock, __ATOMIC_RELEASE);
+}
+
+static inline void header_zip_lock(header_zip_ctx_t *ctx) {
+    header_zip_spin_lock(&ctx->lock);
+}
+
+static inline void header_zip_unlock(header_zip_ctx_t *ctx) {
+    header_zip_spin_unlock(&ctx->lock);
+}
+
+static inline uint16_t read_u16(const unsigned char *p) {
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void write_u16(unsigned char *p, uint16_t v) {
+    p[0] = (unsigned char)(v >> 8);
+    p[1] = (unsigned char)(v & 0xff);
+}
+
+static uint32_t checksum_add(uint32_t sum, const unsigned char *data, size_t size) {
+    size_t i;
+    for ( i=0; i+1<size; i+=2 ) {
+        sum += (uint32_t)((data[i] << 8) | data[i+1]);
+    }
+    if ( size & 1 ) {
+        sum += (uint32_t)(data[size-1] << 8);
+    }
+    return sum;
+}
+
+static uint16_t checksum_fold(uint32_t sum) {
+    while ( sum >> 16 ) {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return (uint16_t)~sum;
+}
+
+/*
+ 检查 udp tcp 的 checksum, 包含 pseudo header
+*/
+static int l4_checksum_ok(const unsigned char *ip_frame, size_t ip_frame_size, const header_zip_packet_t *packet) {
+    uint32_t sum = 0;
+    size_t l4_size = ip_frame_size - packet->ip_header_size;
+    const unsigned char *l4 = ip_frame + packet->ip_header_size;
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet->proto && 4 == packet->version && 0 == read_u16(l4 + 6) ) {
+        return 1;
+    }
+    if ( 4 == packet->version ) {
+        sum = checksum_add(sum, ip_frame + 12, 8);
+    } else {
+        sum = checksum_add(sum, ip_frame + 8, 32);
+    }
+    sum += packet->proto;
+    sum += (uint32_t)l4_size;
+    sum = checksum_add(sum, l4, l4_size);
+    return 0 == checksum_fold(sum);
+}
+
+/*
+ 只处理没有分片, 没有扩展首部的 ipv4 ipv6 udp tcp packet, 其他 packet 返回 -1
+*/
+static int parse_packet(const unsigned char *ip_frame, size_t ip_frame_size, header_zip_packet_t *packet) {
+    size_t l4_header_size;
+    if ( ip_frame_size < 20 ) {
+        return -1;
+    }
+    packet->version = ip_frame[0] >> 4;
+    if ( 4 == packet->version ) {
+        packet->ip_header_size = (ip_frame[0] & 0x0f) * 4;
+        packet->proto = ip_frame[9];
+        if ( packet->ip_header_size < 20 || read_u16(ip_frame + 2) != ip_frame_size ) {
+            return -1;
+        }
+        //MF 或者 fragment offset 不为 0
+        if ( read_u16(ip_frame + 6) & 0x3fff ) {
+            return -1;
+        }
+    } else if ( 6 == packet->version ) {
+        if ( ip_frame_size < 40 ) {
+            return -1;
+        }
+        packet->ip_header_size = 40;
+        packet->proto = ip_frame[6];
+        if ( (size_t)read_u16(ip_frame + 4) + 40 != ip_frame_size ) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet->proto ) {
+        l4_header_size = 8;
+    } else if ( GNB_HEADER_ZIP_PROTO_TCP == packet->proto ) {
+        if ( ip_frame_size < (size_t)packet->ip_header_size + 20 ) {
+            return -1;
+        }
+        l4_header_size = (ip_frame[packet->ip_header_size + 12] >> 4) * 4;
+        if ( l4_header_size < 20 ) {
+            return -1;
+        }
+    } else {
+        return -1;
+    }
+    if ( ip_frame_size < packet->ip_header_size + l4_header_size ) {
+        return -1;
+    }
+    packet->header_size = (uint16_t)(packet->ip_header_size + l4_header_size);
+    return 0;
+}
+
+/*
+ 把 context 中保存的首部取出来, 长度为 ip_header_size + 4
+*/
+static void make_ctx_header(const unsigned char *ip_frame, const header_zip_packet_t *packet, unsigned char *header) {
+    memset(header, 0, GNB_HEADER_ZIP_MAX_HEADER);
+    memcpy(header, ip_frame, packet->ip_header_size + 4);
+    if ( 4 == packet->version ) {
+        //tot_len id check
+        memset(header + 2, 0, 4);
+        memset(header + 10, 0, 2);
+    } else {
+        //payload_len
+        memset(header + 4, 0, 2);
+    }
+}
+
+static uint32_t ctx_hash(gnb_uuid_t uuid64, const unsigned char *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325ULL ^ uuid64;
+    size_t i;
+    for ( i=0; i<size; i++ ) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return (uint32_t)(hash ^ (hash >> 32));
+}
+
+static gnb_pf_private_ctx_t* header_zip_private_ctx_create(gnb_core_t *gnb_core, header_zip_table_t *table) {
+    int i;
+    size_t block_size = sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size;
+    unsigned char *memory;
+    gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t*)gnb_heap_alloc(gnb_core->heap,sizeof(gnb_pf_private_ctx_t));
+    if ( NULL == table ) {
+        table = (header_zip_table_t *)gnb_heap_alloc(gnb_core->heap, sizeof(header_zip_table_t));
+        memset(table, 0, sizeof(header_zip_table_t));
+        for ( i=0; i<GNB_HEADER_ZIP_CTX_NUM; i++ ) {
+            table->compress_ctx[i].cid = (uint16_t)i;
+        }
+    }
+    ctx->table = table;
+    memory = (unsigned char *)gnb_heap_alloc(gnb_core->heap, block_size * 2 * GNB_PF_BATCH_MAX);
+    for ( i=0; i<GNB_PF_BATCH_MAX; i++ ) {
+        ctx->compressed_payload_vec[i]   = (gnb_payload16_t *)(memory + block_size * 2 * i);
+        ctx->decompressed_payload_vec[i] = (gnb_payload16_t *)(memory + block_size * 2 * i + block_size);
+    }
+    return ctx;
+}
+
+/*
+ primary worker 直接安装 gnb_core 的模块, pf worker 安装的是它的复制, 都在 gnb_core_create 的线程中初始化
+ hash table 挂在 gnb_core 的模块上, 由这个 gnb_core 的所有 worker 共享, 每个 worker 有自己的 payload 缓冲
+*/
+static void pf_init_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+    gnb_pf_t *core_pf = gnb_find_pf_mod_by_name(gnb_core, pf->name);
+    gnb_pf_private_ctx_t *core_ctx;
+    if ( NULL == core_pf->private_ctx ) {
+        core_pf->private_ctx = header_zip_private_ctx_create(gnb_core, NULL);
+    }
+    core_ctx = core_pf->private_ctx;
+    if ( pf != core_pf ) {
+        pf->private_ctx = header_zip_private_ctx_create(gnb_core, core_ctx->table);
+    }
+    GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s init\n", pf->name);
+}
+
+static header_zip_table_t* header_zip_core_table(gnb_core_t *gnb_core) {
+    gnb_pf_t *core_pf;
+    gnb_pf_private_ctx_t *core_ctx;
+    if ( !gnb_core->conf->header_zip ) {
+        return NULL;
+    }
+    core_pf = gnb_find_pf_mod_by_name(gnb_core, "gnb_pf_header_zip");
+    if ( NULL == core_pf || NULL == core_pf->private_ctx ) {
+        return NULL;
+    }
+    core_ctx = core_pf->private_ctx;
+    return core_ctx->table;
+}
+
+/*
+ 在 pf worker 中调用, 记录需要请求 IR 的 (src node, cid), 由 node worker 发送请求
+*/
+static void header_zip_add_ir_request(header_zip_table_t *table, gnb_uuid_t src_uuid64, uint16_t cid, uint64_t now_time_sec) {
+    header_zip_ir_request_t *ir_request;
+    int i;
+    header_zip_spin_lock(&table->ir_request_lock);
+    for ( i=0; i<GNB_HEADER_ZIP_IR_REQUEST_NUM; i++ ) {
+        ir_request = &table->ir_request[i];
+        if ( ir_request->uuid64 == src_uuid64 && ir_request->cid == cid && now_time_sec - ir_request->request_time_sec < GNB_HEADER_ZIP_IR_REQUEST_INTERVAL_SEC ) {
+            goto finish;
+        }
+    }
+    ir_request = &table->ir_request[ table->ir_request_idx % GNB_HEADER_ZIP_IR_REQUEST_NUM ];
+    table->ir_request_idx++;
+    ir_request->uuid64 = src_uuid64;
+    ir_request->cid = cid;
+    ir_request->pending = 1;
+    ir_request->request_time_sec = now_time_sec;
+finish:
+    header_zip_spin_unlock(&table->ir_request_lock);
+}
+
+/*
+ 在 node worker 中调用, 取出一个等待发送的 IR 请求, 没有时返回 -1
+*/
+int gnb_pf_header_zip_pop_ir_request(gnb_core_t *gnb_core, gnb_uuid_t *src_uuid64, uint16_t *cid) {
+    header_zip_table_t *table = header_zip_core_table(gnb_core);
+    int ret = -1;
+    int i;
+    if ( NULL == table ) {
+        return -1;
+    }
+    header_zip_spin_lock(&table->ir_request_lock);
+    for ( i=0; i<GNB_HEADER_ZIP_IR_REQUEST_NUM; i++ ) {
+        if ( table->ir_request[i].pending ) {
+            table->ir_request[i].pending = 0;
+            *src_uuid64 = table->ir_request[i].uuid64;
+            *cid = table->ir_request[i].cid;
+            ret = 0;
+            break;
+        }
+    }
+    header_zip_spin_unlock(&table->ir_request_lock);
+    return ret;
+}
+
+/*
+ 在 node worker 中调用, dst node 请求 cid 重新发送 IR
+*/
+void gnb_pf_header_zip_ir_request(gnb_core_t *gnb_core, gnb_uuid_t dst_uuid64, uint16_t cid) {
+    header_zip_table_t *table = header_zip_core_table(gnb_core);
+    header_zip_ctx_t *zip_ctx;
+    if ( NULL == table || cid >= GNB_HEADER_ZIP_CTX_NUM ) {
+        return;
+    }
+    zip_ctx = &table->compress_ctx[cid];
+    header_zip_lock(zip_ctx);
+    if ( zip_ctx->valid && zip_ctx->uuid64 == dst_uuid64 ) {
+        zip_ctx->packet_count = 0;
+    }
+    header_zip_unlock(zip_ctx);
+}
+
+static void pf_conf_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+}
+
+/*
+ 从 hash 的位置开始的 GNB_HEADER_ZIP_PROBE_NUM 个 slot 中选择空闲的或者最久没有使用的 context
+*/
+static header_zip_ctx_t* header_zip_probe_victim(header_zip_ctx_t *ctx_array, uint32_t hash) {
+    header_zip_ctx_t *zip_ctx;
+    header_zip_ctx_t *victim = NULL;
+    int i;
+    for ( i=0; i<GNB_HEADER_ZIP_PROBE_NUM; i++ ) {
+        zip_ctx = &ctx_array[ (hash + i) & (GNB_HEADER_ZIP_CTX_NUM - 1) ];
+        //不拿锁, 选择的结果只影响替换哪个 context
+        if ( !zip_ctx->valid ) {
+            return zip_ctx;
+        }
+        if ( NULL == victim || zip_ctx->last_time_sec < victim->last_time_sec ) {
+            victim = zip_ctx;
+        }
+    }
+    return victim;
+}
+
+/*
+ 把 ip_frame 的首部写成 IR 或者 CO 格式, 写入 out, 返回写入的长度
+*/
+static int compress_header(gnb_core_t *gnb_core, gnb_pf_private_ctx_t *ctx, gnb_pf_ctx_t *pf_ctx, const header_zip_packet_t *packet, unsigned char *out) {
+    const unsigned char *ip_frame = pf_ctx->ip_frame;
+    unsigned char header[GNB_HEADER_ZIP_MAX_HEADER];
+    header_zip_ctx_t *zip_ctx;
+    uint16_t ipid = 0;
+    uint16_t ipid_delta;
+    int is_ir = 0;
+    int len = 2;
+    uint32_t hash;
+    int i;
+    make_ctx_header(ip_frame, packet, header);
+    hash = ctx_hash(pf_ctx->dst_uuid64, header, packet->ip_header_size + 4);
+    if ( 4 == packet->version ) {
+        ipid = read_u16(ip_frame + 4);
+    }
+    for ( i=0; i<GNB_HEADER_ZIP_PROBE_NUM; i++ ) {
+        zip_ctx = &ctx->table->compress_ctx[ (hash + i) & (GNB_HEADER_ZIP_CTX_NUM - 1) ];
+        header_zip_lock(zip_ctx);
+        if ( zip_ctx->valid && zip_ctx->uuid64 == pf_ctx->dst_uuid64 && zip_ctx->ip_header_size == packet->ip_header_size &&
+             0 == memcmp(zip_ctx->header, header, packet->ip_header_size + 4) ) {
+            goto found;
+        }
+        header_zip_unlock(zip_ctx);
+    }
+    //新的 flow, 使用空闲的或者最久没有使用的 cid
+    zip_ctx = header_zip_probe_victim(ctx->table->compress_ctx, hash);
+    header_zip_lock(zip_ctx);
+    zip_ctx->valid = 1;
+    zip_ctx->uuid64 = pf_ctx->dst_uuid64;
+    zip_ctx->ip_header_size = packet->ip_header_size;
+    zip_ctx->proto = packet->proto;
+    memcpy(zip_ctx->header, header, GNB_HEADER_ZIP_MAX_HEADER);
+    zip_ctx->packet_count = 0;
+found:
+    zip_ctx->last_time_sec = gnb_core->now_time_sec;
+    if ( zip_ctx->packet_count < GNB_HEADER_ZIP_IR_NUM || gnb_core->now_time_sec - zip_ctx->ir_time_sec >= GNB_HEADER_ZIP_IR_INTERVAL_SEC ) {
+        is_ir = 1;
+        if ( zip_ctx->packet_count >= GNB_HEADER_ZIP_IR_NUM ) {
+            zip_ctx->packet_count = 0;
+        }
+        zip_ctx->ir_time_sec = gnb_core->now_time_sec;
+    }
+    zip_ctx->packet_count++;
+    ipid_delta = ipid - zip_ctx->ipid;
+    zip_ctx->ipid = ipid;
+    out[0] = (unsigned char)((zip_ctx->cid >> 8) & GNB_HEADER_ZIP_CID_MASK);
+    out[1] = (unsigned char)(zip_ctx->cid & 0xff);
+    header_zip_unlock(zip_ctx);
+    if ( is_ir ) {
+        return len;
+    }
+    out[0] |= GNB_HEADER_ZIP_CO;
+    if ( 4 == packet->version ) {
+        if ( ipid_delta < 192 ) {
+            out[len++] = (unsigned char)(ipid & 0xff);
+        } else {
+            out[0] |= GNB_HEADER_ZIP_IPID16;
+            write_u16(out + len, ipid);
+            len += 2;
+        }
+    }
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet->proto ) {
+        //udp checksum
+        memcpy(out + len, ip_frame + packet->ip_header_size + 6, 2);
+        len += 2;
+    } else {
+        //tcp 首部中 port 之后的部分
+        memcpy(out + len, ip_frame + packet->ip_header_size + 4, packet->header_size - packet->ip_header_size - 4);
+        len += packet->header_size - packet->ip_header_size - 4;
+    }
+    return len;
+}
+
+static int pf_compress(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *compressed_payload) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    header_zip_packet_t packet;
+    unsigned char *out;
+    int header_len;
+    size_t body_size;
+    size_t new_ip_frame_size;
+    uint16_t frame_header_size = gnb_core->tun_payload_offset;
+    uint16_t frame_tail_size = 0;
+    if ( 0 != parse_packet(pf_ctx->ip_frame, pf_ctx->ip_frame_size, &packet) ) {
+        return pf_ctx->pf_status;
+    }
+    if ( pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY ) {
+        frame_tail_size = gnb_payload16_data_len(pf_ctx->fwd_payload) - frame_header_size - pf_ctx->ip_frame_size;
+    }
+    out = compressed_payload->data + frame_header_size;
+    header_len = compress_header(gnb_core, ctx, pf_ctx, &packet, out);
+    if ( out[0] & GNB_HEADER_ZIP_CO ) {
+        body_size = pf_ctx->ip_frame_size - packet.header_size;
+        memcpy(out + header_len, (unsigned char *)pf_ctx->ip_frame + packet.header_size, body_size);
+    } else {
+        body_size = pf_ctx->ip_frame_size;
+        if ( frame_header_size + header_len + body_size + frame_tail_size > gnb_core->conf->payload_block_size ) {
+            return pf_ctx->pf_status;
+        }
+        memcpy(out + header_len, pf_ctx->ip_frame, body_size);
+    }
+    new_ip_frame_size = header_len + body_size;
+    GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "header zip %s ip_frame_size=%d new size=%d\n", (out[0] & GNB_HEADER_ZIP_CO) ? "CO":"IR", (int)pf_ctx->ip_frame_size, (int)new_ip_frame_size);
+    compressed_payload->type     = pf_ctx->fwd_payload->type;
+    compressed_payload->sub_type = pf_ctx->fwd_payload->sub_type | GNB_PAYLOAD_SUB_TYPE_IPFRAME_HEADER_ZIP;
+    memcpy(compressed_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
+    if ( 0 != frame_tail_size ) {
+        memcpy(out + new_ip_frame_size, (unsigned char *)pf_ctx->ip_frame + pf_ctx->ip_frame_size, frame_tail_size);
+    }
+    gnb_payload16_set_data_len(compressed_payload, frame_header_size + new_ip_frame_size + frame_tail_size);
+    pf_ctx->fwd_payload = compressed_payload;
+    pf_ctx->ip_frame = out;
+    pf_ctx->ip_frame_size = new_ip_frame_size;
+    return GNB_PF_NEXT;
+}
+
+/*
+ 恢复 CO packet 的首部, 写入 out, 返回 ip packet 的长度, 出错返回 -1
+*/
+static int decompress_header(gnb_core_t *gnb_core, gnb_pf_private_ctx_t *ctx, gnb_pf_ctx_t *pf_ctx, const unsigned char *in, size_t in_size, unsigned char *out, size_t out_capacity) {
+    header_zip_ctx_t *zip_ctx = NULL;
+    header_zip_packet_t packet;
+    uint16_t cid = (uint16_t)(((in[0] & GNB_HEADER_ZIP_CID_MASK) << 8) | in[1]);
+    uint16_t ipid = 0;
+    uint16_t ipid_ref;
+    size_t pos = 2;
+    size_t l4_rest_size;
+    size_t ip_frame_size;
+    uint32_t hash = ctx_hash(pf_ctx->src_uuid64, (const unsigned char *)&cid, sizeof(cid));
+    int i;
+    for ( i=0; i<GNB_HEADER_ZIP_PROBE_NUM; i++ ) {
+        zip_ctx = &ctx->table->decompress_ctx[ (hash + i) & (GNB_HEADER_ZIP_CTX_NUM - 1) ];
+        header_zip_lock(zip_ctx);
+        if ( zip_ctx->valid && zip_ctx->uuid64 == pf_ctx->src_uuid64 && zip_ctx->cid == cid ) {
+            break;
+        }
+        header_zip_unlock(zip_ctx);
+        zip_ctx = NULL;
+    }
+    if ( !(in[0] & GNB_HEADER_ZIP_CO) ) {
+        //IR
+        in += 2;
+        in_size -= 2;
+        if ( NULL == zip_ctx ) {
+            zip_ctx = header_zip_probe_victim(ctx->table->decompress_ctx, hash);
+            header_zip_lock(zip_ctx);
+        }
+        if ( in_size > out_capacity || 0 != parse_packet(in, in_size, &packet) ) {
+            goto error;
+        }
+        zip_ctx->last_time_sec = gnb_core->now_time_sec;
+        zip_ctx->valid = 1;
+        zip_ctx->uuid64 = pf_ctx->src_uuid64;
+        zip_ctx->cid = cid;
+        zip_ctx->ip_header_size = packet.ip_header_size;
+        zip_ctx->proto = packet.proto;
+        make_ctx_header(in, &packet, zip_ctx->header);
+        if ( 4 == packet.version ) {
+            zip_ctx->ipid = read_u16(in + 4);
+        }
+        header_zip_unlock(zip_ctx);
+        memcpy(out, in, in_size);
+        return (int)in_size;
+    }
+    if ( NULL == zip_ctx ) {
+        //IR 丢失或者 context 被其他 flow 替换, 请求发送方重新发送 IR
+        header_zip_add_ir_request(ctx->table, pf_ctx->src_uuid64, cid, gnb_core->now_time_sec);
+        return -1;
+    }
+    zip_ctx->last_time_sec = gnb_core->now_time_sec;
+    packet.version = zip_ctx->header[0] >> 4;
+    packet.proto = zip_ctx->proto;
+    packet.ip_header_size = zip_ctx->ip_header_size;
+    if ( 4 == packet.version ) {
+        if ( in[0] & GNB_HEADER_ZIP_IPID16 ) {
+            if ( in_size < pos + 2 ) {
+                goto error;
+            }
+            ipid = read_u16(in + pos);
+            pos += 2;
+        } else {
+            if ( in_size < pos + 1 ) {
+                goto error;
+            }
+            //在 [ref-32, ref+223] 的窗口中找低 8 位相同的 id
+            ipid_ref = zip_ctx->ipid - 32;
+            ipid = ipid_ref + (uint8_t)(in[pos] - (ipid_ref & 0xff));
+            pos += 1;
+        }
+        zip_ctx->ipid = ipid;
+    }
+    memcpy(out, zip_ctx->header, packet.ip_header_size + 4);
+    header_zip_unlock(zip_ctx);
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet.proto ) {
+        l4_rest_size = 4;
+        if ( in_size < pos + 2 ) {
+            return -1;
+        }
+        memcpy(out + packet.ip_header_size + 6, in + pos, 2);
+        pos += 2;
+    } else {
+        //tcp 首部中 port 之后的部分, 长度由 data offset 决定
+        if ( in_size < pos + 16 ) {
+            return -1;
+        }
+        l4_rest_size = (in[pos + 8] >> 4) * 4 - 4;
+        if ( l4_rest_size < 16 || in_size < pos + l4_rest_size ) {
+            return -1;
+        }
+        memcpy(out + packet.ip_header_size + 4, in + pos, l4_rest_size);
+        pos += l4_rest_size;
+    }
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet.proto ) {
+        packet.header_size = packet.ip_header_size + 8;
+    } else {
+        packet.header_size = (uint16_t)(packet.ip_header_size + 4 + l4_rest_size);
+    }
+    ip_frame_size = packet.header_size + in_size - pos;
+    if ( ip_frame_size > out_capacity || ip_frame_size > 0xffff ) {
+        return -1;
+    }
+    memcpy(out + packet.header_size, in + pos, in_size - pos);
+    if ( 4 == packet.version ) {
+        write_u16(out + 2, (uint16_t)ip_frame_size);
+        write_u16(out + 4, ipid);
+        write_u16(out + 10, checksum_fold(checksum_add(0, out, packet.ip_header_size)));
+    } else {
+        write_u16(out + 4, (uint16_t)(ip_frame_size - 40));
+    }
+    if ( GNB_HEADER_ZIP_PROTO_UDP == packet.proto ) {
+        write_u16(out + packet.ip_header_size + 4, (uint16_t)(ip_frame_size - packet.ip_header_size));
+    }
+    //context 不是这个 flow 的时候 checksum 不一致
+    if ( !l4_checksum_ok(out, ip_frame_size, &packet) ) {
+        return -1;
+    }
+    return (int)ip_frame_size;
+error:
+    header_zip_unlock(zip_ctx);
+    return -1;
+}
+
+static int pf_decompress(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *decompressed_payload) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    uint16_t in_payload_data_len;
+    uint16_t frame_header_size = gnb_core->tun_payload_offset;
+    int ip_frame_size;
+    if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_HEADER_ZIP) ) {
+        return pf_ctx->pf_status;
+    }
+    //目标节点不是本地节点，不要解压
+    if ( pf_ctx->dst_uuid64 != gnb_core->local_node->uuid64 ) {
+        return pf_ctx->pf_status;
+    }
+    in_payload_data_len = gnb_payload16_data_len(pf_ctx->fwd_payload);
+    if ( in_payload_data_len < frame_header_size + 2 ) {
+        return GNB_PF_ERROR;
+    }
+    ip_frame_size = decompress_header(gnb_core, ctx, pf_ctx, pf_ctx->fwd_payload->data + frame_header_size, in_payload_data_len - frame_header_size,
+                                      decompressed_payload->data + frame_header_size, gnb_core->conf->payload_block_size - frame_header_size);
+    if ( ip_frame_size < 0 ) {
+        GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "header zip drop packet from %llu, no context\n", pf_ctx->src_uuid64);
+        return GNB_PF_DROP;
+    }
+    decompressed_payload->type     = pf_ctx->fwd_payload->type;
+    decompressed_payload->sub_type = pf_ctx->fwd_payload->sub_type;
+    memcpy(decompressed_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
+    pf_ctx->fwd_payload = decompressed_payload;
+    pf_ctx->ip_frame_size = ip_frame_size;
+    gnb_payload16_set_data_len(pf_ctx->fwd_payload, frame_header_size + pf_ctx->ip_frame_size);
+    pf_ctx->ip_frame = pf_ctx->fwd_payload->data + frame_header_size;
+    return GNB_PF_NEXT;
+}
+
+static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_compress(gnb_core, pf, pf_ctx, ctx->compressed_payload_vec[0]);
+}
+
+static void pf_tun_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_compress(gnb_core, pf, pf_ctx_vec[i], ctx->compressed_payload_vec[i]);
+    }
+}
+
+static int pf_inet_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_decompress(gnb_core, pf, pf_ctx, ctx->decompressed_payload_vec[0]);
+}
+
+static void pf_inet_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_decompress(gnb_core, pf, pf_ctx_vec[i], ctx->decompressed_payload_vec[i]);
+    }
+}
+
+static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+
+}
+
+gnb_pf_t gnb_pf_header_zip = {
+    .name          = "gnb_pf_header_zip",
+    .type          = GNB_PF_TYEP_COMPRESS,
+    .private_ctx   = NULL,
+    .pf_init       = pf_init_cb,
+    .pf_conf       = pf_conf_cb,
+    .pf_tun_frame  = NULL,                  // pf_tun_frame
+    .pf_tun_route  = pf_tun_route_cb,       // pf_tun_route
+    .pf_tun_fwd    = NULL,                  // pf_tun_fwd
+    .pf_inet_frame = NULL,                  // pf_inet_frame
+    .pf_inet_route = pf_inet_route_cb,      // pf_inet_route
+    .pf_inet_fwd   = NULL,                  // pf_inet_fwd
+    .pf_release    = pf_release_cb,         // pf_release
+    .pf_tun_route_batch  = pf_tun_route_batch_cb,
+    .pf_inet_route_batch = pf_inet_route_batch_cb
+};
@@ -0,0 +1,309 @@
+/*
+   Copyright (C) gnbdev
+
+   This program is free software; you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation; either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gnb.h"
+#include "gnb_payload16.h"
+#include "protocol/network_protocol.h"
+#include "compress/lz4/lz4.h"
+#include "compress/gnb_zip_flow.h"
+#include "gnb_binary.h"
+#include "zlib/zlib.h"
+
+/*
+ 与 gnb_pf_zip 相同的 frame 格式, 用 GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4 标记,
+ 压缩速度比 zlib 快一个数量级, 适合 cpu 受限的 relay 节点
+
+ GNB_ZIP_AUTO 时输出空间只给到 ip_frame_size - 1, 压缩后不能变小的 payload 在压缩过程中就会放弃,
+ 不需要先完整压缩再丢掉结果
+
+ 设置了 zip-dict 时每个 packet 都以字典作为前缀独立压缩, 小 packet 也能得到较高的压缩率,
+ 压缩后的数据前面加上 2 字节的 dict id(网络字节序), 用 GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP_DICT 标记,
+ 接收方的字典与 dict id 不一致时丢弃该 packet
+*/
+
+typedef struct _gnb_pf_private_ctx_t {
+    lz4_ctx_t lz4_ctx;
+    int acceleration;
+    //批量处理时每个 packet 使用独立的输出 buffer
+    gnb_payload16_t *compressed_payload_vec[GNB_PF_BATCH_MAX];
+    gnb_payload16_t *decompressed_payload_vec[GNB_PF_BATCH_MAX];
+    //GNB_ZIP_AUTO 时跳过不能压缩的 flow
+    gnb_zip_flow_table_t flow_table;
+    //dict_size 为 0 时不使用字典
+    int dict_size;
+    uint16_t dict_id;
+    //字典的 hash table, 每次压缩前复制到 lz4_ctx
+    lz4_ctx_t dict_lz4_ctx;
+    //字典 + 要压缩的 ip_frame
+    unsigned char *compress_buffer;
+    //字典 + 解压后的 ip_frame
+    unsigned char *decompress_buffer;
+} gnb_pf_private_ctx_t;
+
+gnb_pf_t gnb_pf_lz4;
+
+static void pf_load_dict(gnb_core_t *gnb_core, gnb_pf_private_ctx_t *ctx) {
+    //conf_dir + '/' + zip_dict_file, 按最长的情况分配, 避免路径被截断后打开一个错误的字典文件
+    char dict_file[PATH_MAX+1+PATH_MAX+NAME_MAX];
+    unsigned char *dict;
+    FILE *fp;
+    long file_size;
+    uLong adler;
+    ctx->dict_size = 0;
+    if ( '\0' == gnb_core->conf->zip_dict_file[0] ) {
+        return;
+    }
+    if ( '/' == gnb_core->conf->zip_dict_file[0] || '\0' == gnb_core->conf->conf_dir[0] ) {
+        snprintf(dict_file, sizeof(dict_file), "%s", gnb_core->conf->zip_dict_file);
+    } else {
+        snprintf(dict_file, sizeof(dict_file), "%s/%s", gnb_core->conf->conf_dir, gnb_core->conf->zip_dict_file);
+    }
+    fp = fopen(dict_file, "rb");
+    if ( NULL == fp ) {
+        GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s open dict file '%s' error\n", gnb_pf_lz4.name, dict_file);
+        return;
+    }
+    fseek(fp, 0, SEEK_END);
+    file_size = ftell(fp);
+    //只使用字典文件尾部的 LZ4_DICT_MAX_SIZE 个字节
+    if ( file_size > LZ4_DICT_MAX_SIZE ) {
+        fseek(fp, file_size - LZ4_DICT_MAX_SIZE, SEEK_SET);
+        file_size = LZ4_DICT_MAX_SIZE;
+    } else {
+        fseek(fp, 0, SEEK_SET);
+    }
+    if ( file_size <= 0 ) {
+        fclose(fp);
+        GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s dict file '%s' is empty\n", gnb_pf_lz4.name, dict_file);
+        return;
+    }
+    ctx->compress_buffer   = (unsigned char *)gnb_heap_alloc(gnb_core->heap, file_size + gnb_core->conf->payload_block_size);
+    ctx->decompress_buffer = (unsigned char *)gnb_heap_alloc(gnb_core->heap, file_size + gnb_core->conf->payload_block_size);
+    dict = ctx->compress_buffer;
+    if ( file_size != (long)fread(dict, 1, file_size, fp) ) {
+        fclose(fp);
+        GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s read dict file '%s' error\n", gnb_pf_lz4.name, dict_file);
+        return;
+    }
+    fclose(fp);
+    memcpy(ctx->decompress_buffer, dict, file_size);
+    lz4_ctx_load_dict(&ctx->dict_lz4_ctx, dict, (int)file_size);
+    adler = adler32(1L, dict, (uInt)file_size);
+    ctx->dict_id   = (uint16_t)((adler >> 16) ^ (adler & 0xffff));
+    ctx->dict_size = (int)file_size;
+    GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s load dict '%s' size=%d dict_id=%04x\n", gnb_pf_lz4.name, dict_file, ctx->dict_size, ctx->dict_id);
+}
+
+static void pf_init_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+    int i;
+    size_t block_size = sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size;
+    unsigned char *memory;
+    gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t*)gnb_heap_alloc(gnb_core->heap,sizeof(gnb_pf_private_ctx_t));
+    lz4_ctx_init(&ctx->lz4_ctx);
+    gnb_zip_flow_table_init(&ctx->flow_table);
+    //zip_level 1 最快, 9 压缩率最高
+    if ( gnb_core->conf->zip_level <= 0 ) {
+        ctx->acceleration = 1;
+    } else {
+        ctx->acceleration = 10 - gnb_core->conf->zip_level;
+    }
+    memory = (unsigned char *)gnb_heap_alloc(gnb_core->heap, block_size * 2 * GNB_PF_BATCH_MAX);
+    for ( i=0; i<GNB_PF_BATCH_MAX; i++ ) {
+        ctx->compressed_payload_vec[i]   = (gnb_payload16_t *)(memory + block_size * 2 * i);
+        ctx->decompressed_payload_vec[i] = (gnb_payload16_t *)(memory + block_size * 2 * i + block_size);
+    }
+    pf_load_dict(gnb_core, ctx);
+    pf->private_ctx = ctx;
+    GNB_LOG1(gnb_core->log, GNB_LOG_ID_PF, "%s init acceleration=%d\n", pf->name, ctx->acceleration);
+}
+
+static void pf_conf_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+}
+
+/*
+ 对 pf_ctx->ip_frame 起 pf_ctx->ip_frame_size 个字节压缩
+ 对于包含 GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY 标志的 payload 尾部的relay node id 数组需要保留
+*/
+static int pf_compress(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *compressed_payload) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int compressed_size;
+    int capacity;
+    unsigned char *out;
+    uint16_t frame_header_size = gnb_core->tun_payload_offset;
+    uint16_t frame_tail_size = 0;
+    gnb_zip_flow_t *flow = NULL;
+    if ( GNB_ZIP_AUTO == gnb_core->conf->zip ) {
+        flow = gnb_zip_flow_get(&ctx->flow_table, pf_ctx->dst_uuid64, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+        if ( NULL == flow ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "LZ4 bypass flow ip_frame_size=%d\n", pf_ctx->ip_frame_size);
+            return GNB_PF_NEXT;
+        }
+    }
+    if ( pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY ) {
+        frame_tail_size = gnb_payload16_data_len(pf_ctx->fwd_payload) - frame_header_size - pf_ctx->ip_frame_size;
+    }
+    capacity = gnb_core->conf->payload_block_size - frame_header_size - frame_tail_size;
+    if ( GNB_ZIP_AUTO == gnb_core->conf->zip && pf_ctx->ip_frame_size - 1 < capacity ) {
+        capacity = pf_ctx->ip_frame_size - 1;
+    }
+    if ( capacity <= 0 ) {
+        return GNB_PF_NEXT;
+    }
+    out = compressed_payload->data + frame_header_size;
+    if ( 0 == ctx->dict_size ) {
+        compressed_size = lz4_compress(&ctx->lz4_ctx, pf_ctx->ip_frame, pf_ctx->ip_frame_size, out, capacity, ctx->acceleration);
+    } else if ( capacity > 2 ) {
+        //每个 packet 都从只包含字典的 hash table 开始压缩
+        memcpy(&ctx->lz4_ctx, &ctx->dict_lz4_ctx, sizeof(lz4_ctx_t));
+        memcpy(ctx->compress_buffer + ctx->dict_size, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+        out[0] = (unsigned char)(ctx->dict_id >> 8);
+        out[1] = (unsigned char)(ctx->dict_id & 0xff);
+        compressed_size = lz4_compress_prefix(&ctx->lz4_ctx, ctx->compress_buffer, ctx->dict_size, pf_ctx->ip_frame_size, out + 2, capacity - 2, ctx->acceleration);
+        if ( 0 != compressed_size ) {
+            compressed_size += 2;
+        }
+    } else {
+        compressed_size = 0;
+    }
+    if ( NULL != flow ) {
+        gnb_zip_flow_update(flow, pf_ctx->ip_frame_size, 0 == compressed_size ? pf_ctx->ip_frame_size : compressed_size);
+    }
+    if ( 0 == compressed_size ) {
+        if ( GNB_ZIP_AUTO == gnb_core->conf->zip ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "LZ4 Skip in payload ip_frame_size=%d\n", pf_ctx->ip_frame_size);
+            return GNB_PF_NEXT;
+        }
+        return GNB_PF_ERROR;
+    }
+    GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "LZ4 in payload size=%d compressed_size=%d\n", pf_ctx->ip_frame_size, compressed_size);
+    compressed_payload->type     = pf_ctx->fwd_payload->type;
+    compressed_payload->sub_type = pf_ctx->fwd_payload->sub_type | GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4;
+    if ( 0 != ctx->dict_size ) {
+        compressed_payload->sub_type |= GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP_DICT;
+    }
+    //拷贝 ip_frame 前的 frame header 数据
+    memcpy(compressed_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
+    //拷贝 ip_frame 后的 relay node id
+    if ( 0 != frame_tail_size ) {
+        memcpy(compressed_payload->data + frame_header_size + compressed_size, pf_ctx->ip_frame + pf_ctx->ip_frame_size, frame_tail_size);
+    }
+    gnb_payload16_set_data_len(compressed_payload, frame_header_size + compressed_size + frame_tail_size);
+    pf_ctx->fwd_payload = compressed_payload;
+    //重新指定 ip_frame 位置 和 ip_frame_size
+    pf_ctx->ip_frame = pf_ctx->fwd_payload->data + frame_header_size;
+    pf_ctx->ip_frame_size = compressed_size;
+    return GNB_PF_NEXT;
+}
+
+static int pf_decompress(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *decompressed_payload) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    unsigned char *in;
+    uint16_t dict_id;
+    int decompressed_size;
+    uint16_t in_payload_data_len;
+    uint16_t frame_header_size = gnb_core->tun_payload_offset;
+    if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4) ) {
+        return pf_ctx->pf_status;
+    }
+    //目标节点不是本地节点，就不要解压数据
+    if ( pf_ctx->dst_uuid64 != gnb_core->local_node->uuid64 ) {
+        return pf_ctx->pf_status;
+    }
+    in_payload_data_len = gnb_payload16_data_len(pf_ctx->fwd_payload);
+    if ( in_payload_data_len <= frame_header_size ) {
+        return GNB_PF_ERROR;
+    }
+    in = pf_ctx->fwd_payload->data + frame_header_size;
+    if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP_DICT) ) {
+        decompressed_size = lz4_decompress(in, in_payload_data_len - frame_header_size,
+                                           decompressed_payload->data + frame_header_size, gnb_core->conf->payload_block_size - frame_header_size);
+        if ( decompressed_size < 0 ) {
+            return GNB_PF_ERROR;
+        }
+    } else {
+        if ( in_payload_data_len <= frame_header_size + 2 ) {
+            return GNB_PF_ERROR;
+        }
+        dict_id = (uint16_t)((in[0] << 8) | in[1]);
+        if ( 0 == ctx->dict_size || dict_id != ctx->dict_id ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "LZ4 dict_id=%04x mismatch local dict_id=%04x\n", dict_id, ctx->dict_id);
+            return GNB_PF_ERROR;
+        }
+        decompressed_size = lz4_decompress_prefix(in + 2, in_payload_data_len - frame_header_size - 2,
+                                                  ctx->decompress_buffer, ctx->dict_size, gnb_core->conf->payload_block_size - frame_header_size);
+        if ( decompressed_size < 0 ) {
+            return GNB_PF_ERROR;
+        }
+        memcpy(decompressed_payload->data + frame_header_size, ctx->decompress_buffer + ctx->dict_size, decompressed_size);
+    }
+    GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "LZ4 decompress payload size=%d decompressed_size=%d\n", in_payload_data_len, decompressed_size);
+    decompressed_payload->type     = pf_ctx->fwd_payload->type;
+    decompressed_payload->sub_type = pf_ctx->fwd_payload->sub_type;
+    memcpy(decompressed_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
+    pf_ctx->fwd_payload = decompressed_payload;
+    pf_ctx->ip_frame_size = decompressed_size;
+    gnb_payload16_set_data_len(pf_ctx->fwd_payload, frame_header_size + pf_ctx->ip_frame_size);
+    pf_ctx->ip_frame = pf_ctx->fwd_payload->data + frame_header_size;
+    return GNB_PF_NEXT;
+}
+
+int gnb_pf_lz4_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_compress(gnb_core, pf, pf_ctx, ctx->compressed_payload_vec[0]);
+}
+
+static void pf_tun_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_compress(gnb_core, pf, pf_ctx_vec[i], ctx->compressed_payload_vec[i]);
+    }
+}
+
+int gnb_pf_lz4_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_decompress(gnb_core, pf, pf_ctx, ctx->decompressed_payload_vec[0]);
+}
+
+static void pf_inet_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_decompress(gnb_core, pf, pf_ctx_vec[i], ctx->decompressed_payload_vec[i]);
+    }
+}
+
+static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
+
+}
+
+gnb_pf_t gnb_pf_lz4 = {
+    .name          = "gnb_pf_lz4",
+    .type          = GNB_PF_TYEP_COMPRESS,
+    .private_ctx   = NULL,
+    .pf_init       = pf_init_cb,
+    .pf_conf       = pf_conf_cb,
+    .pf_tun_frame  = NULL,                  // pf_tun_frame
+    .pf_tun_route  = gnb_pf_lz4_tun_route,           // pf_tun_route
+    .pf_tun_fwd    = NULL,                  // pf_tun_fwd
+    .pf_inet_frame = NULL,                  // pf_inet_frame
+    .pf_inet_route = gnb_pf_lz4_inet_route,          // pf_inet_route
+    .pf_inet_fwd   = NULL,                  // pf_inet_fwd
+    .pf_release    = pf_release_cb,         // pf_release
+    .pf_tun_route_batch  = pf_tun_route_batch_cb,
+    .pf_inet_route_batch = pf_inet_route_batch_cb
+};
@@ -39,6 +39,11 @@ typedef struct _gnb_route_frame_head_t {
 
 #define MIN_ROUTE_FRAME_SIZE ( sizeof(gnb_route_frame_head_t) + sizeof(struct iphdr) )
 
+//压缩后的 ip frame 可能比 ip 首部还短
+#define MIN_ROUTE_ZIP_FRAME_SIZE ( sizeof(gnb_route_frame_head_t) + 1 )
+
+#define ROUTE_ZIP_SUB_TYPE ( GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP | GNB_PAYLOAD_SUB_TYPE_IPFRAME_LZ4 | GNB_PAYLOAD_SUB_TYPE_IPFRAME_HEADER_ZIP )
+
 static void pf_init_cb(gnb_core_t *gnb_core, gnb_pf_t *pf){
 	gnb_route_ctx_t *ctx = (gnb_route_ctx_t*)gnb_heap_alloc(gnb_core->heap,sizeof(gnb_route_ctx_t));
 	ctx->udata = NULL;
@@ -56,7 +61,7 @@ static void pf_conf_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
 /*
  * 创建 route_frame ，填充 ip_frame, 得到dst_node
 */
-static int pf_tun_frame_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_route_tun_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
 	if ( NULL==pf_ctx->fwd_payload ) {
 		return GNB_PF_ERROR;
 	}
@@ -132,7 +137,7 @@ handle_ip_frame:
 /*
  * route，得到fwd_node
 */
-static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_route_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
 	int ret = GNB_PF_NEXT;
 	uint8_t relay_count;
 	uint16_t org_payload_size;
@@ -269,7 +274,7 @@ finish:
 
 }
 
-static int pf_inet_frame_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_route_inet_frame(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
 	int ret = GNB_PF_NEXT;
 	uint16_t payload_data_size;
 	gnb_uuid_t *relay_nodeid_ptr;
@@ -280,7 +285,7 @@ static int pf_inet_frame_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf
 		goto finish;
 	}
 	payload_data_size = gnb_payload16_data_len(pf_ctx->fwd_payload);
-	if( payload_data_size < MIN_ROUTE_FRAME_SIZE ) {
+	if( payload_data_size < ( (pf_ctx->fwd_payload->sub_type & ROUTE_ZIP_SUB_TYPE) ? MIN_ROUTE_ZIP_FRAME_SIZE : MIN_ROUTE_FRAME_SIZE ) ) {
 		ret = GNB_PF_ERROR;
 		goto finish;
 	}
@@ -332,7 +337,7 @@ finish:
 	return ret;
 }
 
-static int pf_inet_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_route_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
 	gnb_route_frame_head_t *route_frame_head;
 	gnb_payload16_t *payload_in = pf_ctx->fwd_payload;
 	route_frame_head = (gnb_route_frame_head_t *)payload_in->data;
@@ -444,7 +449,7 @@ finish:
 }
 
 /* 写入tun之前做最后的检查 */
-static int pf_inet_fwd_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+int gnb_pf_route_inet_fwd(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
 	if ( GNB_PF_FWD_TUN != pf_ctx->pf_fwd ) {
 		return pf_ctx->pf_status;
 	}
@@ -496,15 +501,15 @@ static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
 
 gnb_pf_t gnb_pf_route = {
 	.name          = "gnb_pf_route",
-	.type          = GNB_PF_TYEP_UNSET,
+	.type          = GNB_PF_TYEP_ROUTE,
 	.private_ctx   = NULL,
 	.pf_init       = pf_init_cb,
 	.pf_conf       = pf_conf_cb,
-	.pf_tun_frame  = pf_tun_frame_cb,
-	.pf_tun_route  = pf_tun_route_cb,
+	.pf_tun_frame  = gnb_pf_route_tun_frame,
+	.pf_tun_route  = gnb_pf_route_tun_route,
 	.pf_tun_fwd    = NULL,
-	.pf_inet_frame = pf_inet_frame_cb,
-	.pf_inet_route = pf_inet_route_cb,
-	.pf_inet_fwd   = pf_inet_fwd_cb,
+	.pf_inet_frame = gnb_pf_route_inet_frame,
+	.pf_inet_route = gnb_pf_route_inet_route,
+	.pf_inet_fwd   = gnb_pf_route_inet_fwd,
 	.pf_release    = pf_release_cb
 };
@@ -19,6 +19,7 @@
 #include "gnb_payload16.h"
 #include "protocol/network_protocol.h"
 #include "zlib/zlib.h"
+#include "compress/gnb_zip_flow.h"
 #include "gnb_binary.h"
 
 typedef struct _gnb_pf_private_ctx_t {
@@ -28,12 +29,23 @@ typedef struct _gnb_pf_private_ctx_t {
     gnb_payload16_t *deflated_payload;
     z_stream inflate_strm;    
     gnb_payload16_t *inflate_payload;
+    /*
+     批量处理时同一批 packet 的 fwd_payload 要在后面的 stage 中继续使用,
+     每个 packet 需要独立的输出 buffer, 第 0 个就是 deflated_payload / inflate_payload
+    */
+    gnb_payload16_t *deflated_payload_vec[GNB_PF_BATCH_MAX];
+    gnb_payload16_t *inflate_payload_vec[GNB_PF_BATCH_MAX];
+    //GNB_ZIP_AUTO 时跳过不能压缩的 flow
+    gnb_zip_flow_table_t flow_table;
 } gnb_pf_private_ctx_t;
 
 gnb_pf_t gnb_pf_zip;
 
 static void pf_init_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
     int ret;
+    int i;
+    size_t block_size = sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size;
+    unsigned char *batch_memory;
     gnb_pf_private_ctx_t *ctx = (gnb_pf_private_ctx_t*)gnb_heap_alloc(gnb_core->heap,sizeof(gnb_pf_private_ctx_t));
     ctx->max_deflate_chunk_size = gnb_core->conf->payload_block_size;
     ctx->max_inflate_chunk_size = gnb_core->conf->payload_block_size;
@@ -44,6 +56,14 @@ static void pf_init_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
         (sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size + sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size ) * (1+gnb_core->pf_worker_ring->cur_idx));
     }
     ctx->inflate_payload  = (gnb_payload16_t *)((unsigned char *)ctx->deflated_payload + sizeof(gnb_payload16_t) + gnb_core->conf->payload_block_size);
+    ctx->deflated_payload_vec[0] = ctx->deflated_payload;
+    ctx->inflate_payload_vec[0]  = ctx->inflate_payload;
+    batch_memory = (unsigned char *)gnb_heap_alloc(gnb_core->heap, block_size * 2 * (GNB_PF_BATCH_MAX-1));
+    for ( i=1; i<GNB_PF_BATCH_MAX; i++ ) {
+        ctx->deflated_payload_vec[i] = (gnb_payload16_t *)(batch_memory + block_size * 2 * (i-1));
+        ctx->inflate_payload_vec[i]  = (gnb_payload16_t *)(batch_memory + block_size * 2 * (i-1) + block_size);
+    }
+    gnb_zip_flow_table_init(&ctx->flow_table);
     ctx->deflate_strm.zalloc = Z_NULL;
     ctx->deflate_strm.zfree  = Z_NULL;
     ctx->deflate_strm.opaque = Z_NULL;
@@ -74,24 +94,35 @@ static void pf_conf_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
 对 pf_ctx->ip_frame 起 pf_ctx->ip_frame_size 个字节压缩
 对于包含 GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY 标志的 payload 尾部的relay node id 数组需要保留
 */
-static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+static int pf_deflate(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *deflated_payload) {
     int ret;
     int deflate_chunk_size;
     //uint16_t in_payload_data_len;
     uint16_t frame_header_size;
     uint16_t frame_tail_size;
+    gnb_zip_flow_t *flow = NULL;
     if ( 0==gnb_core->conf->zip_level ) {
         return pf_ctx->pf_status;
     }
     frame_header_size = gnb_core->tun_payload_offset;
     gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    if ( GNB_ZIP_AUTO == gnb_core->conf->zip ) {
+        flow = gnb_zip_flow_get(&ctx->flow_table, pf_ctx->dst_uuid64, pf_ctx->ip_frame, pf_ctx->ip_frame_size);
+        if ( NULL == flow ) {
+            GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Deflate bypass flow ip_frame_size=%d\n", pf_ctx->ip_frame_size);
+            return GNB_PF_NEXT;
+        }
+    }
     deflateReset(&ctx->deflate_strm);
     ctx->deflate_strm.next_in   = pf_ctx->ip_frame;
     ctx->deflate_strm.avail_in  = pf_ctx->ip_frame_size;
-    ctx->deflate_strm.next_out  = ctx->deflated_payload->data + frame_header_size;
+    ctx->deflate_strm.next_out  = deflated_payload->data + frame_header_size;
     ctx->deflate_strm.avail_out = gnb_core->conf->payload_block_size;
     ret = deflate(&ctx->deflate_strm, Z_FINISH);
     if ( ret != Z_STREAM_END ) {
+        if ( NULL != flow ) {
+            gnb_zip_flow_update(flow, pf_ctx->ip_frame_size, pf_ctx->ip_frame_size);
+        }
         return GNB_PF_ERROR;
     }
     // deflate_chunk_size is new ip_frame_size
@@ -102,25 +133,28 @@ static int pf_tun_route_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_
     if( deflate_chunk_size >= gnb_core->conf->payload_block_size ) {
         return GNB_PF_ERROR;
     }
+    if ( NULL != flow ) {
+        gnb_zip_flow_update(flow, pf_ctx->ip_frame_size, deflate_chunk_size);
+    }
     if ( GNB_ZIP_AUTO == gnb_core->conf->zip && deflate_chunk_size >= pf_ctx->ip_frame_size ) {
         GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Deflate Skip in payload ip_frame_size=%d deflate chunk size=%d\n", pf_ctx->ip_frame_size, deflate_chunk_size);
         goto skip_deflate;
     }
     GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Deflate in payload size=%d deflate_chunk_size=%d\n", pf_ctx->ip_frame_size, deflate_chunk_size);
-    ctx->deflated_payload->type     = pf_ctx->fwd_payload->type;
-    ctx->deflated_payload->sub_type = pf_ctx->fwd_payload->sub_type | GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP;
+    deflated_payload->type     = pf_ctx->fwd_payload->type;
+    deflated_payload->sub_type = pf_ctx->fwd_payload->sub_type | GNB_PAYLOAD_SUB_TYPE_IPFRAME_ZIP;
     //拷贝 ip_frame 前的 frame header 数据
-    memcpy(ctx->deflated_payload->data, pf_ctx->fwd_payload->data, gnb_core->tun_payload_offset);
+    memcpy(deflated_payload->data, pf_ctx->fwd_payload->data, gnb_core->tun_payload_offset);
     if ( !(pf_ctx->fwd_payload->sub_type & GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY) ) {
-        gnb_payload16_set_data_len(ctx->deflated_payload, frame_header_size + deflate_chunk_size);
+        gnb_payload16_set_data_len(deflated_payload, frame_header_size + deflate_chunk_size);
     } else {
         //GNB_PAYLOAD_SUB_TYPE_IPFRAME_RELAY
         //拷贝 ip_frame 后的数据
         frame_tail_size   = gnb_payload16_data_len(pf_ctx->fwd_payload) - frame_header_size - pf_ctx->ip_frame_size;
-        memcpy((ctx->deflated_payload->data + frame_header_size + deflate_chunk_size), (pf_ctx->ip_frame + pf_ctx->ip_frame_size), frame_tail_size);
-        gnb_payload16_set_data_len(ctx->deflated_payload, frame_header_size + deflate_chunk_size + frame_tail_size);
+        memcpy((deflated_payload->data + frame_header_size + deflate_chunk_size), (pf_ctx->ip_frame + pf_ctx->ip_frame_size), frame_tail_size);
+        gnb_payload16_set_data_len(deflated_payload, frame_header_size + deflate_chunk_size + frame_tail_size);
     }
-    pf_ctx->fwd_payload = ctx->deflated_payload;
+    pf_ctx->fwd_payload = deflated_payload;
     //重新指定 ip_frame 位置 和 ip_frame_size
     pf_ctx->ip_frame = pf_ctx->fwd_payload->data + frame_header_size;
     pf_ctx->ip_frame_size = deflate_chunk_size;
@@ -128,10 +162,23 @@ skip_deflate:
     return GNB_PF_NEXT;
 }
 
+int gnb_pf_zip_tun_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_deflate(gnb_core, pf, pf_ctx, ctx->deflated_payload);
+}
+
+static void pf_tun_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_deflate(gnb_core, pf, pf_ctx_vec[i], ctx->deflated_payload_vec[i]);
+    }
+}
+
 /*
   inflate 解压 payload
 */
-static int pf_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+static int pf_inflate(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx, gnb_payload16_t *inflate_payload) {
     int ret;
     int inflate_chunk_size;
     uint16_t in_payload_data_len;
@@ -152,7 +199,7 @@ static int pf_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ct
     in_payload_data_len = gnb_payload16_data_len(pf_ctx->fwd_payload);
     ctx->inflate_strm.next_in   = pf_ctx->fwd_payload->data + frame_header_size;
     ctx->inflate_strm.avail_in  = in_payload_data_len - frame_header_size;
-    ctx->inflate_strm.next_out  = ctx->inflate_payload->data + frame_header_size;
+    ctx->inflate_strm.next_out  = inflate_payload->data + frame_header_size;
     ctx->inflate_strm.avail_out = gnb_core->conf->payload_block_size;
     ret = inflate(&ctx->inflate_strm, Z_FINISH);
     if ( ret != Z_STREAM_END ) {
@@ -160,10 +207,10 @@ static int pf_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ct
     }
     inflate_chunk_size = gnb_core->conf->payload_block_size - ctx->inflate_strm.avail_out;
     GNB_LOG3(gnb_core->log, GNB_LOG_ID_PF, "Inflate payload size=%d inflate_chunk_size=%d\n", in_payload_data_len, inflate_chunk_size);
-    ctx->inflate_payload->type     = pf_ctx->fwd_payload->type;
-    ctx->inflate_payload->sub_type = pf_ctx->fwd_payload->sub_type;
-    memcpy(ctx->inflate_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
-    pf_ctx->fwd_payload = ctx->inflate_payload;
+    inflate_payload->type     = pf_ctx->fwd_payload->type;
+    inflate_payload->sub_type = pf_ctx->fwd_payload->sub_type;
+    memcpy(inflate_payload->data, pf_ctx->fwd_payload->data, frame_header_size);
+    pf_ctx->fwd_payload = inflate_payload;
     //new ip_frame_size
     pf_ctx->ip_frame_size = inflate_chunk_size;
     //new payload size
@@ -172,21 +219,36 @@ static int pf_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ct
     return GNB_PF_NEXT;
 }
 
+int gnb_pf_zip_inet_route(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t *pf_ctx) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    return pf_inflate(gnb_core, pf, pf_ctx, ctx->inflate_payload);
+}
+
+static void pf_inet_route_batch_cb(gnb_core_t *gnb_core, gnb_pf_t *pf, gnb_pf_ctx_t **pf_ctx_vec, int num) {
+    gnb_pf_private_ctx_t *ctx = pf->private_ctx;
+    int i;
+    for ( i=0; i<num; i++ ) {
+        pf_ctx_vec[i]->pf_status = pf_inflate(gnb_core, pf, pf_ctx_vec[i], ctx->inflate_payload_vec[i]);
+    }
+}
+
 static void pf_release_cb(gnb_core_t *gnb_core, gnb_pf_t *pf) {
 
 }
 
 gnb_pf_t gnb_pf_zip = {
     .name          = "gnb_pf_zip",
-    .type          = GNB_PF_TYEP_UNSET,
+    .type          = GNB_PF_TYEP_COMPRESS,
     .private_ctx   = NULL,
     .pf_init       = pf_init_cb,
     .pf_conf       = pf_conf_cb,
     .pf_tun_frame  = NULL,                  // pf_tun_frame
-    .pf_tun_route  = pf_tun_route_cb,       // pf_tun_route
+    .pf_tun_route  = gnb_pf_zip_tun_route,           // pf_tun_route
     .pf_tun_fwd    = NULL,                  // pf_tun_fwd
     .pf_inet_frame = NULL,                  // pf_inet_frame
-    .pf_inet_route = pf_inet_route,         // pf_inet_route
+    .pf_inet_route = gnb_pf_zip_inet_route,          // pf_inet_route
     .pf_inet_fwd   = NULL,                  // pf_inet_fwd
-    .pf_release    = pf_release_cb          // pf_release
+    .pf_release    = pf_release_cb,         // pf_release
+    .pf_tun_route_batch  = pf_tun_route_batch_cb,
+    .pf_inet_route_batch = pf_inet_route_batch_cb
 };